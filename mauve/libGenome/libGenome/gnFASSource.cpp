@@ -20,7 +20,14 @@
 #include "libGenome/gnSourceSpec.h"
 #include "libGenome/gnSourceHeader.h"
 #include "libGenome/gnDebug.h"
+#include <cstring>
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 namespace genome {
@@ -28,6 +35,9 @@ namespace genome {
 
 gnFASSource::gnFASSource()
 {
+	m_mapData = NULL;
+	m_mapSize = 0;
+	m_fileMapped = false;
 	m_openString = "";
 	m_pFilter = gnFilter::fullDNASeqFilter();
 	if(m_pFilter == NULL){
@@ -36,14 +46,20 @@ gnFASSource::gnFASSource()
 }
 gnFASSource::gnFASSource( const gnFASSource& s ) : gnFileSource(s)
 {
+	m_mapData = NULL;
+	m_mapSize = 0;
+	m_fileMapped = false;
 	vector< gnFileContig* >::const_iterator iter = s.m_contigList.begin();
 	for( ; iter != s.m_contigList.end(); ++iter )
 	{
 		m_contigList.push_back( (*iter)->Clone() );
 	}
+	if( s.m_mapData != NULL )
+		MapFile();
 }
 gnFASSource::~gnFASSource()
 {
+	UnmapFile();
 	m_ifstream.close();
 	vector< gnFileContig* >::iterator iter = m_contigList.begin();
 	for( ; iter != m_contigList.end(); ++iter )
@@ -100,6 +116,9 @@ gnFileContig* gnFASSource::GetContig( const uint32 i ) const
 
 boolean gnFASSource::SeqRead( const gnSeqI start, char* buf, gnSeqI& bufLen, const uint32 contigI ) 
 {
+	// the mapping is never modified so mapped reads need no lock
+	if( m_mapData != NULL )
+		return SeqReadMapped( start, buf, bufLen, contigI );
 	boolean result = true;
 #pragma omp critical
 {
@@ -108,6 +127,145 @@ boolean gnFASSource::SeqRead( const gnSeqI start, char* buf, gnSeqI& bufLen, con
 	return result;
 }
 
+boolean gnFASSource::SeqReadMapped( const gnSeqI start, char* buf, gnSeqI& bufLen, const uint32 contigI ) const
+{
+	if( contigI == ALL_CONTIGS ){
+		// find the contig containing start, then read across contig boundaries
+		gnSeqI curIndex = 0;
+		uint32 curContig = 0;
+		for( ; curContig < m_contigList.size(); curContig++ )
+		{
+			gnSeqI len = m_contigList[curContig]->GetSeqLength();
+			if( curIndex + len > start )
+				break;
+			curIndex += len;
+		}
+		if( curContig == m_contigList.size() ){
+			bufLen = 0;
+			return false;
+		}
+		gnSeqI curLen = 0;
+		gnSeqI contigStart = start - curIndex;
+		for( ; curLen < bufLen && curContig < m_contigList.size(); curContig++ ){
+			curLen += ReadMappedContig( curContig, contigStart, buf + curLen, bufLen - curLen );
+			contigStart = 0;
+		}
+		bufLen = curLen;
+		return true;
+	}
+	else if( contigI < m_contigList.size() )
+	{
+		gnSeqI contigSize = m_contigList[contigI]->GetSeqLength();
+		if( start >= contigSize ){
+			bufLen = 0;
+			return false;
+		}
+		bufLen = bufLen < contigSize - start ? bufLen : contigSize - start;
+		bufLen = ReadMappedContig( contigI, start, buf, bufLen );
+		return true;
+	}
+	bufLen = 0;
+	return false;
+}
+
+gnSeqI gnFASSource::ReadMappedContig( const uint32 contigI, const gnSeqI start, char* buf, const gnSeqI len ) const
+{
+	const gnFileContig& contig = *m_contigList[contigI];
+	uint64 pos = contig.GetSectStartEnd(gnContigSequence).first;
+	uint64 seqEnd = contig.GetSectStartEnd(gnContigSequence).second;
+	seqEnd = seqEnd < m_mapSize ? seqEnd : m_mapSize;
+	gnSeqI skip = start;
+	pair<uint64,uint64> lineSize = contig.GetRepeatSeqGapSize();
+	if( contig.HasRepeatSeqGap() && lineSize.first > 0 && lineSize.second > 0 ){
+		// every line has the same length so the offset can be computed
+		pos += start + (start / lineSize.first) * lineSize.second;
+		skip = 0;
+	}else if( !m_seqIndex[contigI].empty() ){
+		uint64 indexI = start / FAS_INDEX_INTERVAL;
+		if( indexI >= m_seqIndex[contigI].size() )
+			indexI = m_seqIndex[contigI].size() - 1;
+		pos = m_seqIndex[contigI][indexI];
+		skip = start - indexI * FAS_INDEX_INTERVAL;
+	}
+	// scan forward to the first requested base
+	for( ; skip > 0 && pos < seqEnd; pos++ )
+		if( m_pFilter->IsValid( m_mapData[pos] ) )
+			skip--;
+
+	gnSeqI curLen = 0;
+	while( curLen < len && pos < seqEnd ){
+		// at most one base comes from each byte so this never overfills buf
+		gnSeqI chunk = len - curLen;
+		chunk = chunk < seqEnd - pos ? chunk : seqEnd - pos;
+		curLen += m_pFilter->CopyValid( buf + curLen, m_mapData + pos, chunk );
+		pos += chunk;
+	}
+	return curLen;
+}
+
+void gnFASSource::MapFile()
+{
+	UnmapFile();
+	if( IsInflated() ){
+		// a compressed file is already in memory
+		m_mapData = &(*m_inflated)[0];
+		m_mapSize = m_inflated->size();
+	}
+#ifdef HAVE_SYS_MMAN_H
+	else{
+		int fd = open( m_openString.c_str(), O_RDONLY );
+		if( fd < 0 )
+			return;
+		struct stat st;
+		if( fstat( fd, &st ) == 0 && st.st_size > 0 ){
+			void* map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if( map != MAP_FAILED ){
+				m_mapData = (const char*)map;
+				m_mapSize = st.st_size;
+				m_fileMapped = true;
+			}
+		}
+		close( fd );
+	}
+#endif
+	if( m_mapData == NULL )
+		return;
+
+	// index the contigs that can't be navigated by line length alone
+	m_seqIndex.clear();
+	m_seqIndex.resize( m_contigList.size() );
+	for( uint32 contigI = 0; contigI < m_contigList.size(); contigI++ )
+	{
+		const gnFileContig& contig = *m_contigList[contigI];
+		pair<uint64,uint64> lineSize = contig.GetRepeatSeqGapSize();
+		if( contig.HasRepeatSeqGap() && lineSize.first > 0 && lineSize.second > 0 )
+			continue;
+		uint64 seqEnd = contig.GetSectStartEnd(gnContigSequence).second;
+		seqEnd = seqEnd < m_mapSize ? seqEnd : m_mapSize;
+		gnSeqI baseI = 0;
+		for( uint64 pos = contig.GetSectStartEnd(gnContigSequence).first; pos < seqEnd; pos++ )
+		{
+			if( !m_pFilter->IsValid( m_mapData[pos] ) )
+				continue;
+			if( baseI % FAS_INDEX_INTERVAL == 0 )
+				m_seqIndex[contigI].push_back( pos );
+			baseI++;
+		}
+	}
+}
+
+void gnFASSource::UnmapFile()
+{
+#ifdef HAVE_SYS_MMAN_H
+	if( m_fileMapped )
+		munmap( (void*)m_mapData, m_mapSize );
+#endif
+	m_fileMapped = false;
+	m_mapData = NULL;
+	m_mapSize = 0;
+	m_seqIndex.clear();
+}
+
 boolean gnFASSource::SeqReadImpl( const gnSeqI start, char* buf, gnSeqI& bufLen, const uint32 contigI ) 
 {
 	m_ifstream.clear();
@@ -421,16 +579,15 @@ boolean gnFASSource::ParseStream( istream& fin )
 	uint32 repeatSeqSize = 0;
 	boolean corrupt_msg = false;
 
-	//decide what type of newlines we have
-	DetermineNewlineType();
-
-	
 	while( !fin.eof() )
 	{
 		  // read chars
 		fin.read( buf, BUFFER_SIZE);
 		streamPos += bufReadLen;
 		bufReadLen = fin.gcount();
+		//decide what type of newlines we have
+		if( readState == 0 )
+			DetermineNewlineType( buf, bufReadLen );
 		for( uint32 i=0 ; i < bufReadLen ; i++ )
 		{
 			char ch = buf[i];
@@ -456,7 +613,13 @@ boolean gnFASSource::ParseStream( istream& fin )
 						nameFStr = "";
 					}
 					else
-						++gapLength;
+					{
+						// skip straight to the next record
+						const char* next = (const char*)memchr( buf + i, '>', bufReadLen - i );
+						uint32 skip = next == NULL ? bufReadLen - i : next - (buf + i);
+						gapLength += skip;
+						i += skip - 1;
+					}
 					break;
 				case 2: // > CONTIG NAME
 					if( isNewLine(ch) || ch == ';')
@@ -520,7 +683,11 @@ boolean gnFASSource::ParseStream( istream& fin )
 								seqLength = 0;
 								gapLength = 0;
 							}
-							seqLength++;
+							// count the rest of the bases on this line in one pass
+							uint32 run = m_pFilter->IsValid( buf + i, bufReadLen - i );
+							seqLength += run;
+							i += run;
+							continue;
 						}else if( ch == '>'){
 							currentContig->AddToSeqLength( seqLength );
 							currentContig->SetSectEnd( gnContigSequence, streamPos + i - 1);
@@ -575,6 +742,7 @@ boolean gnFASSource::ParseStream( istream& fin )
 		m_contigList.push_back(currentContig);
 	}
 	m_ifstream.clear();
+	MapFile();
 	return true;
 }
 
@@ -28,12 +28,17 @@
 namespace genome {
 
 #define FAS_LINE_WIDTH 80
+/** Number of bases between entries in the index of a contig with irregular line lengths */
+#define FAS_INDEX_INTERVAL 4096
 
 /**
  *	gnFASSource reads and writes FastA files.
  * gnFASSource is used by gnSourceFactory to read files. 
  * Files can be written in the FastA file format by calling
  * gnFASSource::Write( mySpec, "C:\\myFasFile.fas");
+ * Where the platform supports it the file is memory mapped once parsed,
+ * and SeqRead() may then be called from several threads at once.
+ * gzip and bgzip compressed files are decompressed into memory and read from there.
  */
 
 class GNDLLEXPORT gnFASSource : public gnFileSource
@@ -113,8 +118,19 @@ private:
 	boolean SeqSeek( const gnSeqI start, const uint32 contigI, uint64& startPos, uint64& readableBytes );
 	boolean SeqStartPos( const gnSeqI start, gnFileContig& contig, uint64& startPos, uint64& readableBytes );
 	boolean ParseStream( std::istream& fin );
+	/** Maps the open file into memory and indexes contigs with irregular line lengths */
+	void MapFile();
+	void UnmapFile();
+	boolean SeqReadMapped( const gnSeqI start, char* buf, gnSeqI& bufLen, const uint32 contigI ) const;
+	/** Copies up to len bases of contigI beginning at start from the mapped file, returns the number copied */
+	gnSeqI ReadMappedContig( const uint32 contigI, const gnSeqI start, char* buf, const gnSeqI len ) const;
 	
 	std::vector< gnFileContig* > m_contigList;
+	const char* m_mapData;	/**< The memory mapped file, or NULL when reads go through m_ifstream */
+	uint64 m_mapSize;	/**< Size of the mapping in bytes */
+	boolean m_fileMapped;	/**< False when m_mapData points at the decompressed file instead of an mmap */
+	/** File offsets of every FAS_INDEX_INTERVAL'th base, empty for contigs with regular lines */
+	std::vector< std::vector< uint64 > > m_seqIndex;
 };// class gnFASSource
 
 inline
@@ -16,12 +16,32 @@
 
 #include "libGenome/gnFileSource.h"
 #include <fstream>
+#include <cstring>
 #include "libGenome/gnFilter.h"
+#include "libGenome/gnDebug.h"
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#include <zlib.h>
+#endif
 
 
 using namespace std;
 namespace genome {
 
+streambuf::pos_type gnMemoryStreamBuf::seekoff( off_type off, ios_base::seekdir dir, ios_base::openmode which )
+{
+	char* base = dir == ios_base::beg ? eback() : dir == ios_base::cur ? gptr() : egptr();
+	if( off < eback() - base || off > egptr() - base )
+		return pos_type( off_type( -1 ) );
+	setg( eback(), base + off, egptr() );
+	return pos_type( gptr() - eback() );
+}
+
+streambuf::pos_type gnMemoryStreamBuf::seekpos( pos_type pos, ios_base::openmode which )
+{
+	return seekoff( off_type( pos ), ios_base::beg, which );
+}
+
 gnFileSource::gnFileSource() :
 m_pFilter(gnFilter::fullDNASeqFilter())
 {}
@@ -32,11 +52,14 @@ gnFileSource::gnFileSource(const gnFileSource& gnfs){
 	m_pFilter = gnfs.m_pFilter;
 	m_newlineType = gnfs.m_newlineType;
 	m_newlineSize = gnfs.m_newlineSize;
+	m_inflated = gnfs.m_inflated;
 #pragma omp critical
 {
 	m_ifstream.open( m_openString.c_str(), ios::in | ios::binary );
 	if( !m_ifstream.is_open() )
 		m_ifstream.clear();
+	else if( IsInflated() )
+		UseInflated();
 }
 }
 
@@ -44,13 +67,18 @@ gnFileSource::gnFileSource(const gnFileSource& gnfs){
 void gnFileSource::Open( string openString )
 {
 	boolean opened = true;
+	boolean inflated = true;
 #pragma omp critical
 {
+	// a previous Open() may have left the stream reading from memory
+	static_cast< istream& >( m_ifstream ).rdbuf( m_ifstream.rdbuf() );
+	m_inflated.reset();
 	m_ifstream.open(openString.c_str(), ios::in | ios::binary );
 	if( m_ifstream.is_open() )
 	{
 		m_openString = openString;
-		if( ParseStream(m_ifstream) )
+		inflated = InflateStream();
+		if( inflated && ParseStream(m_ifstream) )
 		{
 			;
 		}
@@ -65,6 +93,8 @@ void gnFileSource::Open( string openString )
 }
 	if(!opened)
 		Throw_gnEx(FileNotOpened());
+	if(!inflated)
+		Throw_gnExMsg(FileUnreadable(), ("Unable to decompress " + openString).c_str());
 }
 void gnFileSource::Open( )
 {
@@ -75,7 +105,8 @@ void gnFileSource::Open( )
 	if( !m_ifstream.is_open() ){
 		opened = false;
 		m_ifstream.clear();
-	}
+	}else if( IsInflated() )
+		UseInflated();
 }
 	if(!opened)
 		Throw_gnEx(FileNotOpened());
@@ -103,29 +134,212 @@ boolean gnFileSource::Read( const uint64 pos, char* buf, gnSeqI& bufLen)
 	return true;
 }
 
-void gnFileSource::DetermineNewlineType()
+void gnFileSource::DetermineNewlineType( const char* buf, const uint64 len )
 {
 	// set default values
 	m_newlineType = gnNewlineUnix;
 	m_newlineSize = 1;
 
-	//decide what type of newlines we have
-	char buf[ BUFFER_SIZE ];
-	m_ifstream.getline( buf, BUFFER_SIZE);
-	m_ifstream.seekg(-2, ios::cur);
-	m_ifstream.read( buf, 2);
-	m_ifstream.seekg(0);
-	if(buf[1] == '\n'){
-		if(buf[0] == '\r'){
-			m_newlineType = gnNewlineWindows;
-			m_newlineSize = 2;
-		}else{ 
-			if(buf[1] == '\r')
-				m_newlineType = gnNewlineMac;
-			else
-				m_newlineType = gnNewlineUnix;
+	//decide what type of newlines we have from the first line ending
+	const char* newline = (const char*)memchr( buf, '\n', len );
+	const char* cr = (const char*)memchr( buf, '\r', newline != NULL ? newline - buf : len );
+	if( cr == NULL )
+		return;
+	if( cr + 1 == newline ){
+		m_newlineType = gnNewlineWindows;
+		m_newlineSize = 2;
+	}else
+		m_newlineType = gnNewlineMac;
+}
+
+void gnFileSource::UseInflated()
+{
+	m_inflatedBuf.SetData( IsInflated() ? &(*m_inflated)[0] : NULL, IsInflated() ? m_inflated->size() : 0 );
+	static_cast< istream& >( m_ifstream ).rdbuf( &m_inflatedBuf );
+}
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+
+static const uint32 GZIP_HEADER_SIZE = 10;
+static const uint32 GZIP_TRAILER_SIZE = 8;
+static const uint32 INFLATE_CHUNK_SIZE = 1 << 20;
+static const uint32 BGZF_MAX_BLOCK_SIZE = 1 << 16;
+
+static uint32 readLE32( const uint8* d )
+{
+	return d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32)d[3] << 24);
+}
+
+/**
+ * Returns the size of the BGZF block at the start of d, or 0 if it is not a
+ * BGZF block.  bgzip records each block's size in a "BC" extra field.
+ */
+static uint64 bgzfBlockSize( const uint8* d, const uint64 len )
+{
+	if( len < GZIP_HEADER_SIZE + 2 || d[0] != 0x1f || d[1] != 0x8b || d[2] != 8 || !(d[3] & 4) )
+		return 0;
+	uint32 xlen = d[10] | (d[11] << 8);
+	uint64 extra_end = GZIP_HEADER_SIZE + 2 + xlen;
+	if( extra_end > len )
+		return 0;
+	for( uint64 x = GZIP_HEADER_SIZE + 2; x + 4 <= extra_end; ){
+		uint32 slen = d[x+2] | (d[x+3] << 8);
+		if( d[x] == 'B' && d[x+1] == 'C' && slen == 2 && x + 6 <= extra_end ){
+			uint64 bsize = (d[x+4] | (d[x+5] << 8)) + 1;
+			return bsize >= extra_end + GZIP_TRAILER_SIZE && bsize <= len ? bsize : 0;
+		}
+		x += 4 + slen;
+	}
+	return 0;
+}
+
+/**
+ * Inflates a bgzip file.  Every BGZF block is a complete gzip member that
+ * records its compressed and inflated sizes, so the blocks are inflated
+ * concurrently straight into their place in the output.
+ * @return false if data is not made entirely of intact BGZF blocks
+ */
+static boolean inflateBgzf( const vector< char >& data, vector< char >& out )
+{
+	const uint8* d = (const uint8*)&data[0];
+	vector< uint64 > block_start;
+	vector< uint64 > out_start;
+	uint64 pos = 0;
+	uint64 out_size = 0;
+	while( pos < data.size() ){
+		uint64 bsize = bgzfBlockSize( d + pos, data.size() - pos );
+		if( bsize == 0 )
+			return false;
+		block_start.push_back( pos );
+		out_start.push_back( out_size );
+		out_size += readLE32( d + pos + bsize - 4 );
+		pos += bsize;
+	}
+	block_start.push_back( pos );
+	out_start.push_back( out_size );
+	out.resize( out_size );
+	if( out_size == 0 )
+		return true;
+
+	boolean success = true;
+#pragma omp parallel for schedule(dynamic) if( block_start.size() > 16 ) reduction(&&:success)
+	for( int blockI = 0; blockI < (int)block_start.size() - 1; blockI++ ){
+		const uint8* block = d + block_start[blockI];
+		uint64 bsize = block_start[blockI + 1] - block_start[blockI];
+		uint64 data_start = GZIP_HEADER_SIZE + 2 + (block[10] | (block[11] << 8));
+		uInt out_len = out_start[blockI + 1] - out_start[blockI];
+		Bytef* block_out = (Bytef*)&out[0] + out_start[blockI];
+		z_stream zs;
+		memset( &zs, 0, sizeof(zs) );
+		if( inflateInit2( &zs, -MAX_WBITS ) != Z_OK ){
+			success = false;
+			continue;
+		}
+		zs.next_in = (Bytef*)block + data_start;
+		zs.avail_in = bsize - data_start - GZIP_TRAILER_SIZE;
+		zs.next_out = block_out;
+		zs.avail_out = out_len;
+		int ret = inflate( &zs, Z_FINISH );
+		inflateEnd( &zs );
+		if( ret != Z_STREAM_END || zs.avail_out != 0 ||
+			crc32( crc32( 0, Z_NULL, 0 ), block_out, out_len ) != readLE32( block + bsize - GZIP_TRAILER_SIZE ) )
+			success = false;
+	}
+	return success;
+}
+
+/**
+ * Inflates a gzip stream one chunk at a time.  Handles files made of several
+ * concatenated gzip members.  As with gzip itself, bytes after a complete
+ * member that do not start with the gzip magic number, such as zero padding
+ * or trailing garbage, are ignored.
+ */
+static boolean inflateGzip( istream& in, vector< char >& out )
+{
+	z_stream zs;
+	memset( &zs, 0, sizeof(zs) );
+	if( inflateInit2( &zs, 16 + MAX_WBITS ) != Z_OK )
+		return false;
+	vector< char > in_buf( INFLATE_CHUNK_SIZE );
+	uint64 out_size = 0;
+	out.resize( INFLATE_CHUNK_SIZE );
+	int ret = Z_OK;
+	boolean member_start = false;	// a member just ended, the next bytes may start another
+	for(;;){
+		if( zs.avail_in == 0 || (member_start && zs.avail_in < 2) ){
+			// a lone byte left at the end of the buffer is kept to check the magic number
+			uInt kept = zs.avail_in;
+			if( kept > 0 )
+				in_buf[0] = *zs.next_in;
+			in.read( &in_buf[kept], in_buf.size() - kept );
+			zs.next_in = (Bytef*)&in_buf[0];
+			zs.avail_in = kept + in.gcount();
+			if( zs.avail_in == 0 )
+				break;
 		}
+		if( member_start ){
+			member_start = false;
+			// ret is still Z_STREAM_END, so the members inflated so far are the result
+			if( zs.avail_in < 2 || zs.next_in[0] != 0x1f || zs.next_in[1] != 0x8b )
+				break;
+		}
+		if( out_size == out.size() )
+			out.resize( out.size() * 2 );
+		uInt out_len = min( (uint64)INFLATE_CHUNK_SIZE * 64, (uint64)(out.size() - out_size) );
+		zs.next_out = (Bytef*)&out[0] + out_size;
+		zs.avail_out = out_len;
+		ret = inflate( &zs, Z_NO_FLUSH );
+		out_size += out_len - zs.avail_out;
+		if( ret == Z_STREAM_END ){
+			inflateReset( &zs );	// another member may follow
+			member_start = true;
+		}
+		else if( ret != Z_OK && ret != Z_BUF_ERROR )
+			break;
 	}
+	inflateEnd( &zs );
+	out.resize( out_size );
+	return ret == Z_STREAM_END;
+}
+
+#endif
+
+boolean gnFileSource::InflateStream()
+{
+	uint8 header[ 2 ] = { 0, 0 };
+	m_ifstream.read( (char*)header, 2 );
+	m_ifstream.clear();
+	m_ifstream.seekg( 0 );
+	if( header[0] != 0x1f || header[1] != 0x8b )
+		return true;	// not compressed
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+	// bgzip files are read whole so their blocks can be inflated concurrently
+	vector< char > first_block( BGZF_MAX_BLOCK_SIZE );
+	m_ifstream.read( &first_block[0], first_block.size() );
+	m_ifstream.clear();
+	m_ifstream.seekg( 0 );
+	boost::shared_ptr< vector< char > > inflated( new vector< char >() );
+	boolean success = false;
+	if( bgzfBlockSize( (const uint8*)&first_block[0], m_ifstream.gcount() ) != 0 ){
+		m_ifstream.seekg( 0, ios::end );
+		vector< char > compressed( (size_t)m_ifstream.tellg() );
+		m_ifstream.seekg( 0 );
+		m_ifstream.read( &compressed[0], compressed.size() );
+		success = inflateBgzf( compressed, *inflated );
+		m_ifstream.clear();
+		m_ifstream.seekg( 0 );
+	}
+	if( !success )
+		success = inflateGzip( m_ifstream, *inflated );
+	if( success ){
+		m_inflated = inflated;
+		UseInflated();
+	}
+	return success;
+#else
+	ErrorMsg( "This build of libGenome can not read gzip compressed files\n" );
+	return false;
+#endif
 }
 
 }	// end namespace genome
@@ -20,12 +20,27 @@
 
 #include <string>
 #include <fstream>
+#include <vector>
+#include <boost/shared_ptr.hpp>
 #include "libGenome/gnBaseSource.h"
 #include "libGenome/gnFileContig.h"
 #include "libGenome/gnException.h"
 
 namespace genome {
 
+/**
+ * A read-only, seekable stream buffer over a block of memory.  gnFileSource
+ * swaps it in underneath its ifstream when the file had to be decompressed.
+ */
+class GNDLLEXPORT gnMemoryStreamBuf : public std::streambuf
+{
+public:
+	void SetData( char* data, const size_t len ){ setg( data, data, data + len ); }
+protected:
+	virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in );
+	virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which = std::ios_base::in );
+};
+
 /**
  * gnFileSource is a standard interface to all file based sources of genetic information.
  * All file source classes are derived from this class.
@@ -47,22 +62,39 @@ public:
 	virtual void SetFilter( gnFilter* filter );
 
 	virtual boolean Read( const uint64 pos, char* buf, gnSeqI& bufLen );
+	/**
+	 * Returns true if the file was gzip or bgzip compressed.  Compressed files
+	 * are decompressed into memory when opened and all reads are served from there.
+	 */
+	boolean IsInflated() const { return m_inflated.get() != NULL && m_inflated->size() > 0; }
 	/**
 	 * Returns a pointer to the file contig corresponding to contigI or
 	 * null if none exists.
 	 */
 	virtual gnFileContig* GetFileContig( const uint32 contigI ) const = 0;
 protected:
-	void DetermineNewlineType();
+	/** Sets the newline type from the first line ending found in buf */
+	void DetermineNewlineType( const char* buf, const uint64 len );
 
 	std::string m_openString;
 	std::ifstream m_ifstream;
 	const gnFilter* m_pFilter;
 	gnNewlineType m_newlineType;
 	uint32 m_newlineSize;
+	/** The decompressed file, NULL unless the file was compressed.  Copies of the source share it */
+	boost::shared_ptr< std::vector< char > > m_inflated;
 
 private:
+	/**
+	 * Decompresses m_ifstream into m_inflated if it holds gzip data.
+	 * @return false if the file is compressed but could not be decompressed
+	 */
+	boolean InflateStream();
+	/** Makes m_ifstream read from m_inflated */
+	void UseInflated();
 	virtual boolean ParseStream( std::istream& fin ) = 0;
+
+	gnMemoryStreamBuf m_inflatedBuf;
 };// class gnFileSource
 
 inline
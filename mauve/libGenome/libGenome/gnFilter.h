@@ -87,6 +87,13 @@ public:
 	 * @return The index of the first invalid character, or len if none exists
 	 */
 	uint32 IsValid( const gnSeqC* seq, const uint32 len ) const;
+	/** CopyValid() copies the valid characters in seq to dest, dropping the rest.
+	 * @param dest The destination, must have room for len characters.
+	 * @param seq The sequence to copy.
+	 * @param len The length of seq.
+	 * @return The number of characters copied to dest
+	 */
+	gnSeqI CopyValid( gnSeqC* dest, const gnSeqC* seq, const gnSeqI len ) const;
 	void MakeValid( gnSeqC* seq, const uint32 len ) const;
 	void Filter( gnSeqC** seq, gnSeqI& len ) const;
 	void ReverseFilter( gnSeqC** seq, gnSeqI& len ) const;
@@ -141,7 +148,7 @@ gnFilter* gnFilter::Clone() const
 inline
 boolean gnFilter::IsValid( const gnSeqC ch ) const
 {
-	return m_pairArray[(uint)ch] != NO_REVCOMP_CHAR;
+	return (unsigned char)ch < GNSEQC_MAX && m_pairArray[(unsigned char)ch] != NO_REVCOMP_CHAR;
 }
 inline
 gnSeqC gnFilter::MakeValid( const gnSeqC ch ) const
@@ -158,7 +165,16 @@ gnSeqC gnFilter::Filter( const gnSeqC ch ) const
 inline
 uint32 gnFilter::IsValid( const gnSeqC* seq, const uint32 len ) const
 {
-	for( uint32 i=0; i < len ; ++i )
+	// test eight characters per step without branching on each one,
+	// then find the exact position once a step turns up an invalid one
+	uint32 i=0;
+	for( ; i + 8 <= len ; i += 8 )
+	{
+		if( !( IsValid( seq[i] ) & IsValid( seq[i+1] ) & IsValid( seq[i+2] ) & IsValid( seq[i+3] ) &
+			IsValid( seq[i+4] ) & IsValid( seq[i+5] ) & IsValid( seq[i+6] ) & IsValid( seq[i+7] ) ) )
+			break;
+	}
+	for( ; i < len ; ++i )
 	{
 		if( !IsValid( seq[i] ) )
 			return i;
@@ -166,6 +182,19 @@ uint32 gnFilter::IsValid( const gnSeqC* seq, const uint32 len ) const
 	return len;
 }
 inline
+gnSeqI gnFilter::CopyValid( gnSeqC* dest, const gnSeqC* seq, const gnSeqI len ) const
+{
+	// write every character and only advance past the valid ones
+	// so the loop has no data dependent branches
+	gnSeqI destI = 0;
+	for( gnSeqI i=0; i < len ; ++i )
+	{
+		dest[destI] = seq[i];
+		destI += IsValid( seq[i] ) ? 1 : 0;
+	}
+	return destI;
+}
+inline
 void gnFilter::MakeValid( gnSeqC* seq, const uint32 len ) const
 {
 	for( uint32 i=0; i < len ; ++i )
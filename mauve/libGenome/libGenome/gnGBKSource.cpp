@@ -23,6 +23,7 @@
 #include "libGenome/gnStringTools.h"
 #include "libGenome/gnDebug.h"
 #include "libGenome/gnStringQualifier.h"
+#include <algorithm>
 #include <string>
 #include <cstring>
 
@@ -611,9 +612,6 @@ boolean gnGBKSource::ParseStream( istream& fin )
 	gnSeqI seqChunk, seqChunkCount, gapChunk;
 	boolean corruptWarning = false;
 	
-	//decide what type of newlines we have
-	DetermineNewlineType();
-
 	m_spec = new gnGenomeSpec();
 	while( !fin.eof() )
 	{
@@ -632,6 +630,13 @@ boolean gnGBKSource::ParseStream( istream& fin )
 		lineStart -= newstart;
 		bufReadLen = fin.gcount();
 		bufReadLen += remainingBuffer;
+		//decide what type of newlines we have
+		if( streamPos == 0 )
+			DetermineNewlineType( buf, bufReadLen );
+		// the parser ends lines at \n.  a Mac newline is a lone \r of the same
+		// length, so swapping it keeps every file offset intact
+		if( m_newlineType == gnNewlineMac )
+			replace( buf + remainingBuffer, buf + bufReadLen, '\r', '\n' );
 		
 		for( uint32 i=remainingBuffer ; i < bufReadLen ; i++ )
 		{
@@ -693,6 +698,10 @@ boolean gnGBKSource::ParseStream( istream& fin )
 					}
 					if(ch == '\n'){
 						lineStart = i + 1;
+					}else{
+						// nothing happens in the header until the end of the line
+						const char* newline = (const char*)memchr( buf + i, '\n', bufReadLen - i );
+						i = newline == NULL ? bufReadLen - 1 : newline - buf - 1;
 					}
 					break;
 				case 1:	//look for feature tag in column six.  ignore whitespace before feature.
@@ -905,8 +914,12 @@ boolean gnGBKSource::ParseStream( istream& fin )
 								}
 								gapChunk = 0;
 							}
-							seqChunk++;
-							seqLength++;
+							// count the rest of this group of bases in one pass
+							uint32 run = m_pFilter->IsValid( buf + i, bufReadLen - i );
+							seqChunk += run;
+							seqLength += run;
+							i += run;
+							continue;
 						}else{
 							gapChunk++;
 							if(seqChunk == 10){
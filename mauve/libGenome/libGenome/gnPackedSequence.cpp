@@ -0,0 +1,303 @@
+/////////////////////////////////////////////////////////////////////////////
+// File:            gnPackedSequence.cpp
+// Purpose:         Sequence class with 2-bit packed in-memory bases
+// Description:     packs, unpacks and reverse complements the bases
+// Changes:
+// Version:         libGenome 0.5.1
+// Author:          Aaron Darling
+// Modified by:
+// Copyright:       (c) Aaron Darling
+// Licenses:        See COPYING file for details
+/////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnPackedSequence.h"
+#include "libGenome/gnFilter.h"
+#include <cstring>
+#include <algorithm>
+
+
+using namespace std;
+namespace genome {
+
+static const uint8 NOT_PACKABLE = 0xFF;
+static const gnSeqI PACK_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Lookup tables for the 2-bit code.  A, C, G and T are 0 through 3 so the
+ * complement of a code is the code xor 3.  Each byte of packed bases unpacks
+ * to four characters with a single table lookup in either direction.
+ */
+class PackTables {
+public:
+	PackTables()
+	{
+		const char bases[] = "ACGT";
+		memset( encode, NOT_PACKABLE, sizeof(encode) );
+		for( uint codeI = 0; codeI < 4; codeI++ ){
+			encode[ (uint8)bases[codeI] ] = codeI;
+			encode[ (uint8)bases[codeI] + 'a' - 'A' ] = codeI;
+		}
+		for( uint byteI = 0; byteI < 256; byteI++ ){
+			for( uint baseI = 0; baseI < 4; baseI++ ){
+				uint code = (byteI >> (baseI * 2)) & 3;
+				forward[ byteI ][ baseI ] = bases[ code ];
+				reverse[ byteI ][ 3 - baseI ] = bases[ code ^ 3 ];
+			}
+		}
+	}
+	uint8 encode[256];
+	gnSeqC forward[256][4];
+	gnSeqC reverse[256][4];
+};
+
+static const PackTables pack_tables;
+
+gnPackedSequence::gnPackedSequence()
+{
+	Pack();
+}
+
+gnPackedSequence::gnPackedSequence( const gnSequence& seq ) : gnSequence( seq )
+{
+	Pack();
+}
+
+gnPackedSequence::gnPackedSequence( const string& filename )
+{
+	LoadSource( filename );
+}
+
+void gnPackedSequence::Pack()
+{
+	m_length = gnSequence::length();
+	m_packed.clear();
+	m_packed.resize( (m_length + 3) / 4, 0 );
+	m_runs.clear();
+	m_runBlocks.clear();
+	m_runBlocks.resize( ((m_length >> BLOCK_SHIFT) >> 6) + 1, 0 );
+
+	vector< gnSeqC > chunk;
+	for( gnSeqI chunk_start = 0; chunk_start < m_length; chunk_start += PACK_CHUNK_SIZE ){
+		gnSeqI chunk_len = min( PACK_CHUNK_SIZE, m_length - chunk_start );
+		chunk.resize( chunk_len );
+		gnSequence::ToArray( &chunk[0], chunk_len, chunk_start + 1 );
+		for( gnSeqI cI = 0; cI < chunk_len; cI++ ){
+			const gnSeqC ch = chunk[ cI ];
+			const gnSeqI baseI = chunk_start + cI;
+			uint8 code = pack_tables.encode[ (uint8)ch ];
+			gnSeqC run_base = ch;
+			if( code != NOT_PACKABLE ){
+				m_packed[ baseI >> 2 ] |= code << ((baseI & 3) * 2);
+				if( ch >= 'A' && ch <= 'Z' )
+					continue;
+				run_base = 0;
+			}
+			// extend the last run or start a new one
+			if( m_runs.size() > 0 && m_runs.back().base == run_base &&
+				m_runs.back().start + m_runs.back().length == baseI ){
+				m_runs.back().length++;
+			}else{
+				PackedRun run;
+				run.start = baseI;
+				run.length = 1;
+				run.base = run_base;
+				m_runs.push_back( run );
+			}
+			const gnSeqI blockI = baseI >> BLOCK_SHIFT;
+			m_runBlocks[ blockI >> 6 ] |= (uint64)1 << (blockI & 63);
+		}
+	}
+}
+
+size_t gnPackedSequence::FirstRun( const gnSeqI start ) const
+{
+	size_t lo = 0;
+	size_t hi = m_runs.size();
+	while( lo < hi ){
+		size_t mid = (lo + hi) / 2;
+		if( m_runs[ mid ].start + m_runs[ mid ].length <= start )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void gnPackedSequence::Unpack( gnSeqC* buf, const gnSeqI start, const gnSeqI len ) const
+{
+	const gnSeqI end = start + len;
+	gnSeqI baseI = start;
+	gnSeqC* out = buf;
+	for( ; baseI < end && (baseI & 3) != 0; baseI++ )
+		*out++ = pack_tables.forward[ m_packed[ baseI >> 2 ] ][ baseI & 3 ];
+	for( ; baseI + 4 <= end; baseI += 4, out += 4 )
+		memcpy( out, pack_tables.forward[ m_packed[ baseI >> 2 ] ], 4 );
+	for( ; baseI < end; baseI++ )
+		*out++ = pack_tables.forward[ m_packed[ baseI >> 2 ] ][ baseI & 3 ];
+
+	for( size_t runI = FirstRun( start ); runI < m_runs.size() && m_runs[ runI ].start < end; runI++ ){
+		const PackedRun& run = m_runs[ runI ];
+		gnSeqI run_start = max( run.start, start );
+		gnSeqI run_end = min( run.start + run.length, end );
+		if( run.base != 0 )
+			memset( buf + (run_start - start), run.base, run_end - run_start );
+		else
+			for( gnSeqI rI = run_start; rI < run_end; rI++ )
+				buf[ rI - start ] += 'a' - 'A';
+	}
+}
+
+void gnPackedSequence::UnpackReverseComplement( gnSeqC* buf, const gnSeqI start, const gnSeqI len ) const
+{
+	const gnSeqI end = start + len;
+	gnSeqI baseI = end;
+	gnSeqC* out = buf;
+	for( ; baseI > start && (baseI & 3) != 0; baseI-- )
+		*out++ = pack_tables.reverse[ m_packed[ (baseI - 1) >> 2 ] ][ 3 - ((baseI - 1) & 3) ];
+	for( ; baseI >= start + 4; baseI -= 4, out += 4 )
+		memcpy( out, pack_tables.reverse[ m_packed[ (baseI - 1) >> 2 ] ], 4 );
+	for( ; baseI > start; baseI-- )
+		*out++ = pack_tables.reverse[ m_packed[ (baseI - 1) >> 2 ] ][ 3 - ((baseI - 1) & 3) ];
+
+	// base i of the range lands at buf[ end - 1 - i ]
+	const gnFilter* comp_filter = gnFilter::DNAComplementFilter();
+	for( size_t runI = FirstRun( start ); runI < m_runs.size() && m_runs[ runI ].start < end; runI++ ){
+		const PackedRun& run = m_runs[ runI ];
+		gnSeqI run_start = max( run.start, start );
+		gnSeqI run_end = min( run.start + run.length, end );
+		if( run.base != 0 )
+			memset( buf + (end - run_end), comp_filter->Filter( run.base ), run_end - run_start );
+		else
+			for( gnSeqI rI = end - run_end; rI < end - run_start; rI++ )
+				buf[ rI ] += 'a' - 'A';
+	}
+}
+
+string gnPackedSequence::ToString( const gnSeqI len, const gnSeqI offset ) const
+{
+	string str;
+	ToString( str, len, offset );
+	return str;
+}
+
+boolean gnPackedSequence::ToString( string& str, const gnSeqI len, const gnSeqI offset ) const
+{
+	str.clear();
+	if( offset == 0 || offset - 1 > m_length )
+		return false;
+	gnSeqI real_offset = offset - 1;
+	gnSeqI readSize = len > m_length - real_offset ? m_length - real_offset : len;
+	str.resize( readSize );
+	if( readSize > 0 )
+		Unpack( &str[0], real_offset, readSize );
+	return true;
+}
+
+boolean gnPackedSequence::ToReverseComplement( string& str, const gnSeqI len, const gnSeqI offset ) const
+{
+	str.clear();
+	if( offset == 0 || offset - 1 > m_length )
+		return false;
+	gnSeqI real_offset = offset - 1;
+	gnSeqI readSize = len > m_length - real_offset ? m_length - real_offset : len;
+	str.resize( readSize );
+	if( readSize > 0 )
+		UnpackReverseComplement( &str[0], real_offset, readSize );
+	return true;
+}
+
+boolean gnPackedSequence::ToArray( gnSeqC* pSeqC, gnSeqI len, const gnSeqI offset ) const
+{
+	if( offset == 0 || offset - 1 > m_length )
+		return false;
+	gnSeqI real_offset = offset - 1;
+	gnSeqI readSize = len > m_length - real_offset ? m_length - real_offset : len;
+	Unpack( pSeqC, real_offset, readSize );
+	return true;
+}
+
+gnSeqC gnPackedSequence::GetSeqC( const gnSeqI offset ) const
+{
+	if( offset == 0 || offset > m_length )
+		return GNSEQC_NULL;
+	const gnSeqI baseI = offset - 1;
+	gnSeqC base = pack_tables.forward[ m_packed[ baseI >> 2 ] ][ baseI & 3 ];
+	if( !InRunBlock( baseI ) )
+		return base;
+	size_t runI = FirstRun( baseI );
+	if( runI == m_runs.size() || m_runs[ runI ].start > baseI )
+		return base;
+	return m_runs[ runI ].base != 0 ? m_runs[ runI ].base : base + 'a' - 'A';
+}
+
+gnSequence& gnPackedSequence::operator=( const gnSequence& seq )
+{
+	gnSequence::operator=( seq );
+	Pack();
+	return *this;
+}
+
+void gnPackedSequence::assign( gnSequence& seq )
+{
+	gnSequence::assign( seq );
+	Pack();
+}
+
+bool gnPackedSequence::LoadSource( const string sourcename )
+{
+	bool success = gnSequence::LoadSource( sourcename );
+	Pack();
+	return success;
+}
+
+void gnPackedSequence::SetSpec( gnGenomeSpec* s )
+{
+	gnSequence::SetSpec( s );
+	Pack();
+}
+
+void gnPackedSequence::setFilter( const gnBaseFilter* filt )
+{
+	gnSequence::setFilter( filt );
+	Pack();
+}
+
+void gnPackedSequence::setFilterList( list<const gnBaseFilter*>& filt_list )
+{
+	gnSequence::setFilterList( filt_list );
+	Pack();
+}
+
+void gnPackedSequence::setReverseComplement( const boolean revComp, const uint32 contigI )
+{
+	gnSequence::setReverseComplement( revComp, contigI );
+	Pack();
+}
+
+// gnSequence finishes both of these through insert( offset, gnGenomeSpec ), which repacks
+void gnPackedSequence::insert( const gnSeqI offset, const gnSeqC *bases, const gnSeqI len )
+{
+	gnSequence::insert( offset, bases, len );
+}
+
+void gnPackedSequence::insert( const gnSeqI offset, const gnSequence& seq )
+{
+	gnSequence::insert( offset, seq );
+}
+
+void gnPackedSequence::insert( const gnSeqI offset, const gnGenomeSpec& gnbs )
+{
+	gnSequence::insert( offset, gnbs );
+	Pack();
+}
+
+void gnPackedSequence::erase( const gnSeqI offset, const gnSeqI len )
+{
+	gnSequence::erase( offset, len );
+	Pack();
+}
+
+}	// end namespace genome
@@ -0,0 +1,120 @@
+/////////////////////////////////////////////////////////////////////////////
+// File:            gnPackedSequence.h
+// Purpose:         Sequence class with 2-bit packed in-memory bases
+// Description:     Keeps the bases of a whole genome packed four to a byte
+//					so that random access bypasses the spec and source chain.
+// Changes:
+// Version:         libGenome 0.5.1
+// Author:          Aaron Darling
+// Modified by:
+// Copyright:       (c) Aaron Darling
+// Licenses:        See COPYING file for details
+/////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _gnPackedSequence_h_
+#define _gnPackedSequence_h_
+
+#include "libGenome/gnDefs.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include "libGenome/gnSequence.h"
+
+namespace genome {
+
+
+/**
+ * gnPackedSequence is a gnSequence whose bases are held in memory at two bits
+ * per base.  Anything other than A, C, G or T, and runs of lower case bases,
+ * are kept in a sorted list of runs alongside the packed bases.
+ * Reads go straight to the packed bases without touching the spec, the
+ * source or the filter list, so they are cheap and safe to make from many
+ * threads at once.  The spec is kept for contig names, features and headers.
+ * Filters set on the sequence are applied once, when the bases are packed.
+ */
+class GNDLLEXPORT gnPackedSequence : public gnSequence
+{
+public:
+	/**
+	 * Empty Constructor, creates an empty gnPackedSequence.
+	 */
+	gnPackedSequence();
+	/**
+	 * Creates a packed copy of the bases in seq.
+	 * @param seq The sequence to pack.
+	 */
+	gnPackedSequence( const gnSequence& seq );
+	/**
+	 * Creates a gnPackedSequence from the sequence file specified by filename
+	 */
+	gnPackedSequence( const std::string& filename );
+
+	gnPackedSequence* Clone() const {return new gnPackedSequence(*this);}
+
+	virtual gnSequence& operator=( const gnSequence& seq );
+	virtual void assign( gnSequence& seq );
+
+	virtual bool LoadSource(const std::string sourcename);
+	virtual void SetSpec(gnGenomeSpec* s);
+	virtual void setFilter(const gnBaseFilter* filt);
+	virtual void setFilterList(std::list<const gnBaseFilter*>& filt_list);
+	virtual void setReverseComplement( const boolean revComp, const uint32 contigI=ALL_CONTIGS);
+	virtual void insert( const gnSeqI offset, const gnSeqC *bases, const gnSeqI length);
+	virtual void insert( const gnSeqI offset, const gnSequence& seq);
+	virtual void insert( const gnSeqI offset, const gnGenomeSpec& gnbs);
+	virtual void erase( const gnSeqI offset=0, const gnSeqI length=GNSEQI_END );
+
+	virtual gnSeqI length() const { return m_length; }
+	virtual gnSeqI size() const { return m_length; }
+
+	virtual std::string ToString( const gnSeqI length=GNSEQI_END, const gnSeqI offset=1 ) const;
+	virtual boolean ToString( std::string& str, const gnSeqI length=GNSEQI_END, const gnSeqI offset=1 ) const;
+	virtual boolean ToReverseComplement( std::string& str, const gnSeqI length=GNSEQI_END, const gnSeqI offset=1 ) const;
+	virtual boolean ToArray( gnSeqC* pSeqC, gnSeqI length, const gnSeqI offset=1 ) const;
+	virtual gnSeqC GetSeqC( const gnSeqI offset ) const;
+
+	/**
+	 * Rebuilds the packed bases from the spec.  This is done automatically
+	 * by every method that changes the bases of the sequence.
+	 */
+	void Pack();
+
+protected:
+	/**
+	 * A run of bases that can not be decoded from the packed bases alone
+	 */
+	struct PackedRun {
+		gnSeqI start;	/**< first base of the run, counting from 0 */
+		gnSeqI length;	/**< number of bases in the run */
+		gnSeqC base;	/**< the character repeated across the run, or 0 for lower case A, C, G and T */
+	};
+
+	void Unpack( gnSeqC* buf, const gnSeqI start, const gnSeqI len ) const;
+	void UnpackReverseComplement( gnSeqC* buf, const gnSeqI start, const gnSeqI len ) const;
+	/** Returns the index of the first run that ends after base start */
+	size_t FirstRun( const gnSeqI start ) const;
+	boolean InRunBlock( const gnSeqI baseI ) const;
+
+	static const uint BLOCK_SHIFT = 10;	/**< bases per m_runBlocks bit, as a power of two */
+	std::vector< uint8 > m_packed;	/**< four bases per byte, the first base in the low bits */
+	std::vector< PackedRun > m_runs;	/**< runs sorted by start, none overlapping */
+	std::vector< uint64 > m_runBlocks;	/**< one bit per block of bases, set when a run touches the block */
+	gnSeqI m_length;
+}; // class gnPackedSequence
+
+inline
+boolean gnPackedSequence::InRunBlock( const gnSeqI baseI ) const
+{
+	const gnSeqI blockI = baseI >> BLOCK_SHIFT;
+	return (m_runBlocks[ blockI >> 6 ] >> (blockI & 63)) & 1;
+}
+
+
+}	// end namespace genome
+
+#endif
+	// _gnPackedSequence_h_
@@ -21,6 +21,7 @@
 #include "libGenome/gnSourceSpec.h"
 #include "libGenome/gnStringSpec.h"
 #include "libGenome/gnStringHeader.h"
+#include "libGenome/gnFilter.h"
 #include <cstring>
 
 
@@ -286,12 +287,23 @@ boolean gnSequence::ToString( string& str, const gnSeqI len, const gnSeqI offset
 		return false;
 	STACK_TRACE_END
 }
+boolean gnSequence::ToReverseComplement( string& str, const gnSeqI len, const gnSeqI offset ) const
+{
+	STACK_TRACE_START
+		boolean success = ToString( str, len, offset );
+		gnFilter::DNAComplementFilter()->ReverseFilter( str );
+		return success;
+	STACK_TRACE_END
+}
 boolean gnSequence::ToArray( gnSeqC* pSeqC, gnSeqI length, const gnSeqI offset ) const
 {
 	STACK_TRACE_START
 		gnSeqI real_offset = offset - 1;
 		if(offset == GNSEQI_END)
 			return false;
+		// without filters there is no need for a scratch copy
+		if( filter_list.empty() )
+			return spec->SeqRead( real_offset, pSeqC, length, ALL_CONTIGS);
 		gnSeqC* tmp = new gnSeqC[length];
 		boolean success = spec->SeqRead( real_offset, tmp, length, ALL_CONTIGS);
 		
@@ -92,7 +92,7 @@ public:
 	/**
 	 * Copies the gnSequence.
 	 */
-	gnSequence& operator=( const gnSequence& seq);
+	virtual gnSequence& operator=( const gnSequence& seq);
 
 	gnSequence* Clone() const;
 
@@ -463,6 +463,15 @@ public:
 	 * @return True if successful, false otherwise.
 	 */
 	virtual boolean ToString( std::string& str, const gnSeqI length=GNSEQI_END, const gnSeqI offset=1 ) const;
+	/**
+	 * Converts the reverse complement of the "length" bases starting at "offset"
+	 * into the std::string "str".
+	 * @param str The std::string to store bases in.
+	 * @param length The length, in base pairs, to convert.
+	 * @param offset The base pair index of the leftmost base to convert.
+	 * @return True if successful, false otherwise.
+	 */
+	virtual boolean ToReverseComplement( std::string& str, const gnSeqI length=GNSEQI_END, const gnSeqI offset=1 ) const;
 	/**
 	 * Converts the "length" bases starting at "offset" into the character array "pSeqC"..
 	 * After converting, "length" will be set to the actual length of the sequence.
@@ -521,7 +530,7 @@ std::ostream& operator<<(std::ostream& os, const gnSequence& gns); //write to so
 // Assignment Operators
 inline
 void gnSequence::operator=(gnSequence& seq){
-	spec = seq.spec->Clone();
+	assign(seq);
 }
 inline
 void gnSequence::assign(gnSequence& seq){
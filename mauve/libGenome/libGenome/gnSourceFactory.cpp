@@ -89,6 +89,9 @@ gnBaseSource* gnSourceFactory::MatchSourceClass( const string& sourceStr ) const
 	string::size_type dot_loc = sourceStr.rfind('.');
 	if(dot_loc != string::npos){
 		string ext = sourceStr.substr(dot_loc, sourceStr.length() - dot_loc);
+		// compressed files are decompressed by the source, look at the extension underneath
+		if( ext == ".gz" || ext == ".GZ" || ext == ".bgz" )
+			return MatchSourceClass( sourceStr.substr(0, dot_loc) );
 		return GetSourceClass(ext);
 	}
 	return m_pDefaultSourceClass;
@@ -0,0 +1,64 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sys/time.h>
+#include "libGenome/gnSequence.h"
+
+using namespace std;
+using namespace genome;
+
+/**
+ * Measures how fast sequence files are read.  Each file named on the command
+ * line, e.g. every genome in a directory, is parsed and all of its bases are
+ * read back out.  Compressed files are counted at their compressed size.
+ */
+
+static double wallTime()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int32 main( int32 argc, char* argv[])
+{
+	if( argc < 2 ){
+		cerr << "Usage: " << argv[0] << " <sequence file> [sequence file]...\n";
+		return -1;
+	}
+	uint64 total_bytes = 0;
+	gnSeqI total_bases = 0;
+	double total_time = 0;
+	cout << "file\tbytes\tbases\tseconds\tMB/s\n";
+	cout << setiosflags( ios::fixed ) << setprecision( 3 );
+	for( int fileI = 1; fileI < argc; fileI++ ){
+		ifstream in_file( argv[fileI], ios::in | ios::binary );
+		in_file.seekg( 0, ios::end );
+		uint64 bytes = in_file.tellg();
+		in_file.close();
+
+		double start = wallTime();
+		gnSequence seq;
+		gnSeqI bases = 0;
+		try{
+			seq.LoadSource( argv[fileI] );
+			string str;
+			seq.ToString( str );
+			bases = str.size();
+		}catch( gnException& gne ){
+			cerr << gne << endl;
+			return -2;
+		}
+		double elapsed = wallTime() - start;
+		cout << argv[fileI] << "\t" << bytes << "\t" << bases << "\t" << elapsed << "\t" << bytes / elapsed / 1000000.0 << endl;
+		total_bytes += bytes;
+		total_bases += bases;
+		total_time += elapsed;
+	}
+	cout << "total\t" << total_bytes << "\t" << total_bases << "\t" << total_time << "\t" << total_bytes / total_time / 1000000.0 << endl;
+	return 0;
+}
@@ -0,0 +1,318 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnSequence.h"
+#include "libGenome/gnFASSource.h"
+#include "libGenome/gnGBKSource.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#include <zlib.h>
+#endif
+
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that the same FASTA and GenBank records read the same whether their
+ * lines end in Unix, Windows or Mac newlines and whether they are stored
+ * plain, gzip compressed in one or several members, or bgzip compressed in
+ * enough blocks to inflate them concurrently.  Zero padding or garbage after
+ * the last member is ignored, as gzip ignores it.  Truncated and corrupt
+ * compressed files must throw FileUnreadable, including a corrupt member
+ * that follows a complete one.  A copy of a gnFASSource, which
+ * reads inflated data through the stream it shares, must read the same bases.
+ */
+
+static const int CONTIG_COUNT = 3;
+
+static string randomBases( size_t len )
+{
+	string seq( len, 'A' );
+	for( size_t charI = 0; charI < len; charI++ )
+		seq[charI] = "ACGT"[ rand() % 4 ];
+	return seq;
+}
+
+static string contigName( int contigI )
+{
+	stringstream name;
+	name << "contig" << contigI + 1;
+	return name.str();
+}
+
+static string fastaRecords( const vector< string >& contigs )
+{
+	stringstream out;
+	for( size_t contigI = 0; contigI < contigs.size(); contigI++ )
+	{
+		out << '>' << contigName( contigI ) << " test contig\n";
+		for( size_t baseI = 0; baseI < contigs[contigI].size(); baseI += 60 )
+			out << contigs[contigI].substr( baseI, 60 ) << '\n';
+	}
+	return out.str();
+}
+
+static string genbankRecords( const vector< string >& contigs )
+{
+	stringstream out;
+	for( size_t contigI = 0; contigI < contigs.size(); contigI++ )
+	{
+		out << "LOCUS       " << contigName( contigI ) << "    " << contigs[contigI].size() << " bp    DNA     linear   BCT 01-JAN-2000\n";
+		out << "DEFINITION  test contig.\n";
+		out << "FEATURES             Location/Qualifiers\n";
+		out << "     source          1.." << contigs[contigI].size() << "\n";
+		out << "ORIGIN\n";
+		for( size_t baseI = 0; baseI < contigs[contigI].size(); baseI += 60 )
+		{
+			char pos[32];
+			sprintf( pos, "%9lu", (unsigned long)baseI + 1 );
+			out << pos;
+			for( size_t groupI = baseI; groupI < baseI + 60 && groupI < contigs[contigI].size(); groupI += 10 )
+				out << ' ' << contigs[contigI].substr( groupI, 10 );
+			out << '\n';
+		}
+		out << "//\n";
+	}
+	return out.str();
+}
+
+/** replaces every \n in text with newline */
+static string withNewlines( const string& text, const string& newline )
+{
+	string out;
+	for( size_t charI = 0; charI < text.size(); charI++ )
+	{
+		if( text[charI] == '\n' )
+			out += newline;
+		else
+			out += text[charI];
+	}
+	return out;
+}
+
+static void writeFile( const string& fname, const string& data )
+{
+	ofstream out( fname.c_str(), ios::out | ios::binary );
+	out.write( data.data(), data.size() );
+}
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+
+/** @return text compressed as a single gzip member */
+static string gzipMember( const string& text )
+{
+	z_stream zs;
+	memset( &zs, 0, sizeof(zs) );
+	deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+	vector< char > out( deflateBound( &zs, text.size() ) + 32 );
+	zs.next_in = (Bytef*)text.data();
+	zs.avail_in = text.size();
+	zs.next_out = (Bytef*)&out[0];
+	zs.avail_out = out.size();
+	deflate( &zs, Z_FINISH );
+	string member( &out[0], out.size() - zs.avail_out );
+	deflateEnd( &zs );
+	return member;
+}
+
+static void appendLE( string& out, uint32 value, int bytes )
+{
+	for( int byteI = 0; byteI < bytes; byteI++ )
+		out += (char)( (value >> (8 * byteI)) & 0xff );
+}
+
+/** @return text compressed as one BGZF block, with the size of the block recorded in its BC field */
+static string bgzfBlock( const string& text )
+{
+	z_stream zs;
+	memset( &zs, 0, sizeof(zs) );
+	deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+	vector< char > data( deflateBound( &zs, text.size() ) + 32 );
+	zs.next_in = (Bytef*)text.data();
+	zs.avail_in = text.size();
+	zs.next_out = (Bytef*)&data[0];
+	zs.avail_out = data.size();
+	deflate( &zs, Z_FINISH );
+	size_t data_len = data.size() - zs.avail_out;
+	deflateEnd( &zs );
+
+	const char header[] = { 0x1f, (char)0x8b, 8, 4, 0, 0, 0, 0, 0, (char)0xff, 6, 0, 'B', 'C', 2, 0 };
+	string block( header, sizeof(header) );
+	appendLE( block, sizeof(header) + 2 + data_len + 8 - 1, 2 );
+	block.append( &data[0], data_len );
+	appendLE( block, crc32( crc32( 0, Z_NULL, 0 ), (const Bytef*)text.data(), text.size() ), 4 );
+	appendLE( block, text.size(), 4 );
+	return block;
+}
+
+/** @return text compressed in BGZF blocks of block_size bytes, followed by the empty end of file block */
+static string bgzf( const string& text, size_t block_size )
+{
+	string out;
+	for( size_t pos = 0; pos < text.size(); pos += block_size )
+		out += bgzfBlock( text.substr( pos, block_size ) );
+	return out + bgzfBlock( "" );
+}
+
+#endif
+
+/** loads fname and returns its bases and contig names, or an empty string if it could not be loaded */
+static string loadSequence( const string& fname )
+{
+	gnSequence seq;
+	try{
+		if( !seq.LoadSource( fname ) )
+			return "";
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return "";
+	}
+	string loaded = seq.ToString();
+	for( uint32 contigI = 0; contigI < seq.contigListSize(); contigI++ )
+		loaded += "|" + seq.contigName( contigI );
+	return loaded;
+}
+
+/** @return true if opening fname as a FASTA file throws FileUnreadable */
+static bool isUnreadable( const string& fname )
+{
+	gnFASSource source;
+	try{
+		source.Open( fname );
+	}catch( gnException& gne ){
+		return gne.GetCode().GetName() == "FileUnreadable";
+	}
+	return false;
+}
+
+/** @return the bases read from source, or an empty string if the read failed */
+static string readBases( gnFASSource& source, gnSeqI length )
+{
+	string read( length, '\0' );
+	if( !source.SeqRead( 0, &read[0], length ) )
+		return "";
+	read.resize( length );
+	return read;
+}
+
+/** @return true if a FASTA source in fname and a copy of it both read the expected bases */
+static bool copyReadsSame( const string& fname, const string& expected )
+{
+	gnFASSource source;
+	source.Open( fname );
+	gnFASSource copy( source );
+	return readBases( source, expected.size() ) == expected && readBases( copy, expected.size() ) == expected;
+}
+
+int main( int32 argc, char* argv[] )
+{
+	srand( argc > 1 ? atoi( argv[1] ) : 11 );
+	vector< string > contigs;
+	string bases;
+	for( int contigI = 0; contigI < CONTIG_COUNT; contigI++ )
+	{
+		contigs.push_back( randomBases( 3000 + rand() % 5000 ) );
+		bases += contigs.back();
+	}
+
+	const char* formats[] = { "fas", "gbk" };
+	string records[] = { fastaRecords( contigs ), genbankRecords( contigs ) };
+	vector< string > written;
+	int failures = 0;
+	for( int formatI = 0; formatI < 2; formatI++ )
+	{
+		const string ext = string( "." ) + formats[formatI];
+		vector< pair< string, string > > files;
+		files.push_back( make_pair( "testgnFileSource.unix" + ext, records[formatI] ) );
+		files.push_back( make_pair( "testgnFileSource.windows" + ext, withNewlines( records[formatI], "\r\n" ) ) );
+		files.push_back( make_pair( "testgnFileSource.mac" + ext, withNewlines( records[formatI], "\r" ) ) );
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+		const string& text = records[formatI];
+		files.push_back( make_pair( "testgnFileSource" + ext + ".gz", gzipMember( text ) ) );
+		files.push_back( make_pair( "testgnFileSource.members" + ext + ".gz", gzipMember( text.substr( 0, text.size() / 3 ) ) + gzipMember( text.substr( text.size() / 3 ) ) ) );
+		string bgzipped = bgzf( text, 512 );
+		files.push_back( make_pair( "testgnFileSource" + ext + ".bgz", bgzipped ) );
+		files.push_back( make_pair( "testgnFileSource.padded" + ext + ".gz", gzipMember( text ) + string( 1024, '\0' ) ) );
+		files.push_back( make_pair( "testgnFileSource.garbage" + ext + ".gz", gzipMember( text.substr( 0, text.size() / 2 ) ) + gzipMember( text.substr( text.size() / 2 ) ) + "trailing garbage\n" ) );
+		files.push_back( make_pair( "testgnFileSource.byte" + ext + ".gz", gzipMember( text ) + "\n" ) );
+		files.push_back( make_pair( "testgnFileSource.padded" + ext + ".bgz", bgzipped + string( 512, '\0' ) ) );
+#endif
+		// every file must give the bases that were written and the contig names of the Unix file
+		string expected;
+		for( size_t fileI = 0; fileI < files.size(); fileI++ )
+		{
+			writeFile( files[fileI].first, files[fileI].second );
+			written.push_back( files[fileI].first );
+			string loaded = loadSequence( files[fileI].first );
+			if( fileI == 0 )
+				expected = loaded;
+			if( count( loaded.begin(), loaded.end(), '|' ) != CONTIG_COUNT )
+			{
+				cerr << files[fileI].first << " has the wrong number of contigs\n";
+				failures++;
+			}
+			if( loaded.substr( 0, loaded.find( '|' ) ) != bases || loaded != expected )
+			{
+				cerr << files[fileI].first << " read different bases or contig names\n";
+				failures++;
+			}
+		}
+		if( formatI == 0 )
+		{
+			for( size_t fileI = 0; fileI < files.size(); fileI++ )
+			{
+				if( !copyReadsSame( files[fileI].first, bases ) )
+				{
+					cerr << "a copy of the source for " << files[fileI].first << " read different bases\n";
+					failures++;
+				}
+			}
+		}
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+		string gzipped = gzipMember( text );
+		string corrupt_gzip = gzipped;
+		corrupt_gzip[ corrupt_gzip.size() / 2 ] ^= 0x55;
+		string corrupt_bgzip = bgzipped;
+		corrupt_bgzip[ corrupt_bgzip.size() / 2 ] ^= 0x55;
+		vector< pair< string, string > > bad_files;
+		bad_files.push_back( make_pair( "testgnFileSource.truncated" + ext + ".gz", gzipped.substr( 0, gzipped.size() / 2 ) ) );
+		bad_files.push_back( make_pair( "testgnFileSource.corrupt" + ext + ".gz", corrupt_gzip ) );
+		bad_files.push_back( make_pair( "testgnFileSource.truncated" + ext + ".bgz", bgzipped.substr( 0, bgzipped.size() / 2 + 7 ) ) );
+		bad_files.push_back( make_pair( "testgnFileSource.corrupt" + ext + ".bgz", corrupt_bgzip ) );
+		bad_files.push_back( make_pair( "testgnFileSource.corrupt_member" + ext + ".gz", gzipped + corrupt_gzip ) );
+		bad_files.push_back( make_pair( "testgnFileSource.truncated_member" + ext + ".gz", gzipped + gzipped.substr( 0, gzipped.size() / 2 ) ) );
+		for( size_t fileI = 0; fileI < bad_files.size(); fileI++ )
+		{
+			writeFile( bad_files[fileI].first, bad_files[fileI].second );
+			written.push_back( bad_files[fileI].first );
+			if( !isUnreadable( bad_files[fileI].first ) )
+			{
+				cerr << bad_files[fileI].first << " did not throw FileUnreadable\n";
+				failures++;
+			}
+		}
+#endif
+	}
+
+	for( size_t fileI = 0; fileI < written.size(); fileI++ )
+		remove( written[fileI].c_str() );
+	if( failures > 0 )
+	{
+		cerr << "sequence files read differently depending on how they were stored\n";
+		return 1;
+	}
+	cout << "sequence files read the same however they were stored\n";
+	return 0;
+}
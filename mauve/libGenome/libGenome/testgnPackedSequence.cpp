@@ -0,0 +1,150 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnSequence.h"
+#include "libGenome/gnPackedSequence.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that gnPackedSequence reads the same bases as a plain gnSequence.
+ * ToString, ToReverseComplement and ToArray are compared at every offset for
+ * each length modulo 4, short and long, and GetSeqC at every base.  The
+ * sequences mix runs of N, IUPAC codes and lower case runs, some of them
+ * crossing the blocks the packed sequence indexes its runs by.  Replacing the
+ * bases through assign() and operator=, also through a gnSequence reference,
+ * must repack them.
+ */
+
+static const char* BASES = "ACGT";
+static const char* IUPAC = "RYKMSWBDHV";
+
+/** random bases with runs of N, IUPAC codes and lower case, at the given rate per thousand bases */
+static string randomSequence( size_t len, int run_rate )
+{
+	string seq( len, 'A' );
+	for( size_t charI = 0; charI < len; charI++ )
+		seq[charI] = BASES[ rand() % 4 ];
+	size_t run_count = run_rate > 0 ? 1 + len * run_rate / 1000 : 0;
+	for( size_t runI = 0; runI < run_count; runI++ )
+	{
+		size_t pos = rand() % len;
+		size_t run_len = 1 + rand() % (rand() % 10 == 0 ? 1500 : 12);
+		int kind = rand() % 4;
+		for( size_t charI = pos; charI < pos + run_len && charI < len; charI++ )
+		{
+			if( kind == 0 )
+				seq[charI] = 'N';
+			else if( kind == 1 )
+				seq[charI] = IUPAC[ rand() % 10 ];
+			else
+				seq[charI] = tolower( seq[charI] );
+		}
+	}
+	return seq;
+}
+
+/** @return the number of reads in which packed and plain differ */
+static size_t compareReads( const gnSequence& plain, const gnPackedSequence& packed, const gnSeqI length, const gnSeqI offset )
+{
+	size_t mismatches = 0;
+	if( plain.ToString( length, offset ) != packed.ToString( length, offset ) )
+		mismatches++;
+	string plain_rc, packed_rc;
+	boolean plain_ok = plain.ToReverseComplement( plain_rc, length, offset );
+	boolean packed_ok = packed.ToReverseComplement( packed_rc, length, offset );
+	if( plain_ok != packed_ok || plain_rc != packed_rc )
+		mismatches++;
+	if( length == GNSEQI_END || offset - 1 + length > plain.length() )
+		return mismatches;
+	string plain_array( length, '\0' );
+	string packed_array( length, '\0' );
+	plain_ok = plain.ToArray( &plain_array[0], length, offset );
+	packed_ok = packed.ToArray( &packed_array[0], length, offset );
+	if( plain_ok != packed_ok || plain_array != packed_array )
+		mismatches++;
+	return mismatches;
+}
+
+/** @return the number of reads in which packed and plain differ */
+static size_t compareSequence( const string& seq )
+{
+	gnSequence plain( seq );
+	gnPackedSequence packed( plain );
+	size_t mismatches = packed.length() == plain.length() ? 0 : 1;
+	for( gnSeqI offset = 1; offset <= plain.length(); offset++ )
+	{
+		if( packed.GetSeqC( offset ) != plain.GetSeqC( offset ) )
+			mismatches++;
+		// every length modulo 4, short enough to stay inside one packed byte and long enough to span blocks
+		for( gnSeqI length = 0; length < 8; length++ )
+			mismatches += compareReads( plain, packed, length, offset );
+		for( gnSeqI length = 1021; length < 1029; length++ )
+			mismatches += compareReads( plain, packed, length, offset );
+		mismatches += compareReads( plain, packed, plain.length() - offset + 1, offset );
+		mismatches += compareReads( plain, packed, GNSEQI_END, offset );
+	}
+	return mismatches;
+}
+
+/** @return the number of ways of replacing the bases that left the packed bases stale */
+static size_t checkReassignment()
+{
+	size_t stale = 0;
+	gnSequence longer( "ACGTTGCAnn" );
+	const gnSequence shorter( "GGCAT" );
+
+	gnPackedSequence assigned( gnSequence( "ACGTACGT" ) );
+	assigned.assign( longer );
+	if( assigned.length() != 10 || assigned.ToString() != "ACGTTGCAnn" )
+		stale++;
+
+	gnPackedSequence packed( gnSequence( "ACGTACGT" ) );
+	gnSequence& base_ref = packed;
+	base_ref = longer;
+	if( packed.length() != 10 || packed.ToString() != "ACGTTGCAnn" )
+		stale++;
+	base_ref = shorter;
+	if( packed.length() != 5 || packed.ToString() != "GGCAT" )
+		stale++;
+
+	gnPackedSequence copied( gnSequence( "ACGTACGT" ) );
+	copied = gnPackedSequence( shorter );
+	if( copied.length() != 5 || copied.ToString() != "GGCAT" )
+		stale++;
+	return stale;
+}
+
+int main( int32 argc, char* argv[] )
+{
+	srand( argc > 1 ? atoi( argv[1] ) : 5 );
+	int failures = 0;
+	const size_t lengths[] = { 1, 2, 3, 4, 5, 7, 130, 3000, 6000 };
+	const int run_rates[] = { 0, 5, 50 };
+	for( size_t lenI = 0; lenI < sizeof(lengths) / sizeof(lengths[0]); lenI++ )
+	{
+		for( size_t rateI = 0; rateI < sizeof(run_rates) / sizeof(run_rates[0]); rateI++ )
+		{
+			string seq = randomSequence( lengths[lenI], run_rates[rateI] );
+			size_t mismatches = compareSequence( seq );
+			cout << lengths[lenI] << " bases, " << run_rates[rateI] << " runs per kb: " << mismatches << " mismatches\n";
+			failures += mismatches > 0 ? 1 : 0;
+		}
+	}
+	size_t stale = checkReassignment();
+	cout << "reassignment: " << stale << " stale reads\n";
+	failures += stale > 0 ? 1 : 0;
+	if( failures > 0 )
+	{
+		cerr << "gnPackedSequence and gnSequence read different bases\n";
+		return 1;
+	}
+	return 0;
+}
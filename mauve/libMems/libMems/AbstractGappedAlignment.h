@@ -86,16 +86,16 @@ void GetAlignment( const AbstractMatch& ga, const std::vector< genome::gnSequenc
 	std::vector< bitset_t > aln_mat;
 	ga.GetAlignment(aln_mat);
 	alignment = std::vector<std::string>( aln_mat.size() );
-	const genome::gnFilter* comp_filter = genome::gnFilter::DNAComplementFilter();
 	for( std::size_t seqI = 0; seqI < alignment.size(); seqI++ )
 	{
 		alignment[seqI] = std::string( aln_mat[0].size(), '-' );
 		if( ga.LeftEnd(seqI) == NO_MATCH )
 			continue;
 		std::string cur_seq;
-		seq_table[seqI]->ToString( cur_seq, ga.Length(seqI), ga.LeftEnd(seqI) );
 		if( ga.Orientation(seqI) == AbstractMatch::reverse )
-			comp_filter->ReverseFilter(cur_seq);
+			seq_table[seqI]->ToReverseComplement( cur_seq, ga.Length(seqI), ga.LeftEnd(seqI) );
+		else
+			seq_table[seqI]->ToString( cur_seq, ga.Length(seqI), ga.LeftEnd(seqI) );
 		std::size_t cI = 0; 
 		for( std::size_t gI = 0; gI < alignment[seqI].size(); gI++ )
 			if( aln_mat[seqI][gI] )
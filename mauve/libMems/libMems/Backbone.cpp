@@ -315,11 +315,39 @@ double computeGC( std::vector< gnSequence* >& seq_table )
 void makeAllPairwiseGenomeHSS( IntervalList& iv_list, vector< CompactGappedAlignment<>* >& iv_ptrs, vector< CompactGappedAlignment<>* >& iv_orig_ptrs, pairwise_genome_hss_t& hss_cols, const HssDetector* detector )
 {
 	uint seq_count = iv_list.seq_table.size();
-	// make pairwise projections of intervals and find LCBs...
+
+	// each genome pair is processed independently with private state.  the
+	// interval orderings, maps and breakpoint lists that pairs share are
+	// computed up front and only read inside the parallel loop.
+	vector< vector< CompactGappedAlignment<>* > > sorted_ivs( seq_count );
+	vector< vector< size_t > > iv_maps( seq_count );
+	vector< vector< gnSeqI > > bp_lists( seq_count );
 	for( size_t seqI = 0; seqI < seq_count; ++seqI )
 	{
-		for( size_t seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+		getBpList( iv_ptrs, seqI, bp_lists[seqI] );
+		if( seqI + 1 == seq_count )
+			continue;
+		SingleStartComparator< CompactGappedAlignment<> > ivcomp(seqI);
+		std::sort( iv_ptrs.begin(), iv_ptrs.end(), ivcomp );
+		sorted_ivs[seqI] = iv_ptrs;
+		createMap( iv_ptrs, iv_orig_ptrs, iv_maps[seqI] );
+	}
+
+	vector< pair< uint, uint > > genome_pairs;
+	for( uint seqI = 0; seqI < seq_count; ++seqI )
+		for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+			genome_pairs.push_back( make_pair( seqI, seqJ ) );
+
+	// make pairwise projections of intervals and find LCBs...
+	// every pair writes only to its own hss_cols[seqI][seqJ] slice, so no locking is needed
+#pragma omp parallel for schedule(dynamic)
+	for( int pairI = 0; pairI < (int)genome_pairs.size(); ++pairI )
+	{
 		{
+			const size_t seqI = genome_pairs[pairI].first;
+			const size_t seqJ = genome_pairs[pairI].second;
+			const vector< CompactGappedAlignment<>* >& iv_ptrs = sorted_ivs[seqI];
+			const vector< size_t >& iv_map = iv_maps[seqI];
 			vector< uint > projection;
 			projection.push_back( seqI );
 			projection.push_back( seqJ );
@@ -366,26 +394,19 @@ void makeAllPairwiseGenomeHSS( IntervalList& iv_list, vector< CompactGappedAlign
 			pair_cgas.clear();
 
 			// now split up on iv boundaries
-			vector< gnSeqI > bp_list;
-			getBpList( iv_ptrs, seqI, bp_list );
 			GenericMatchSeqManipulator< CompactGappedAlignment<> > gmsm(0);
 			SingleStartComparator< CompactGappedAlignment<> > ssc(0);
 			std::sort(hss_list.begin(), hss_list.end(), ssc );
-			applyBreakpoints( bp_list, hss_list, gmsm );
+			applyBreakpoints( bp_lists[seqI], hss_list, gmsm );
 			// and again on seqJ
-			getBpList( iv_ptrs, seqJ, bp_list );
 			GenericMatchSeqManipulator< CompactGappedAlignment<> > gmsm1(1);
 			SingleStartComparator< CompactGappedAlignment<> > ssc1(1);
 			std::sort(hss_list.begin(), hss_list.end(), ssc1 );
-			applyBreakpoints( bp_list, hss_list, gmsm1 );
+			applyBreakpoints( bp_lists[seqJ], hss_list, gmsm1 );
 
 			// now transform into interval-specific columns
 			std::sort(hss_list.begin(), hss_list.end(), ssc );
 
-			SingleStartComparator< CompactGappedAlignment<> > ivcomp(seqI);
-			std::sort( iv_ptrs.begin(), iv_ptrs.end(), ivcomp );
-			vector< size_t > iv_map;
-			createMap( iv_ptrs, iv_orig_ptrs, iv_map );
 			size_t ivI = 0;
 			while( ivI < iv_ptrs.size() && iv_ptrs[ivI]->LeftEnd(0) == NO_MATCH )
 				++ivI;
@@ -462,6 +483,26 @@ void makeAllPairwiseGenomeHSS( IntervalList& iv_list, vector< CompactGappedAlign
 	}
 }
 
+/**
+ * Removes and frees the ULAs that were merged into others.  The survivors keep
+ * their order: ordering them by address would make the merge depend on where
+ * the allocator happened to place each ULA, which varies with the thread count.
+ */
+static void eraseMergedUlas( vector< ULA* >& iv_ulas, vector< ULA* >& to_delete )
+{
+	std::sort( to_delete.begin(), to_delete.end() );
+	vector< ULA* >::iterator last = std::unique( to_delete.begin(), to_delete.end() );
+	to_delete.erase( last, to_delete.end() );
+	vector< ULA* > new_iv_ulas;
+	new_iv_ulas.reserve( iv_ulas.size() - to_delete.size() );
+	for( size_t ivuI = 0; ivuI < iv_ulas.size(); ++ivuI )
+		if( !std::binary_search( to_delete.begin(), to_delete.end(), iv_ulas[ivuI] ) )
+			new_iv_ulas.push_back( iv_ulas[ivuI] );
+	swap( iv_ulas, new_iv_ulas );
+	for( size_t delI = 0; delI < to_delete.size(); ++delI )
+		to_delete[delI]->Free();
+}
+
 void mergePairwiseHomologyPredictions( 	vector< CompactGappedAlignment<>* >& iv_orig_ptrs, pairwise_genome_hss_t& hss_cols, vector< vector< ULA* > >& ula_list )
 {
 	uint seq_count = hss_cols.shape()[0];
@@ -559,15 +600,7 @@ void mergePairwiseHomologyPredictions( 	vector< CompactGappedAlignment<>* >& iv_
 				}
 
 				// delete to_delete...
-				std::sort( to_delete.begin(), to_delete.end() );
-				vector< ULA* >::iterator last = std::unique( to_delete.begin(), to_delete.end() );
-				to_delete.erase( last, to_delete.end() );
-				vector< ULA* > new_iv_ulas( iv_ulas.size() - to_delete.size() );
-				std::sort( iv_ulas.begin(), iv_ulas.end() );
-				std::set_difference( iv_ulas.begin(), iv_ulas.end(), to_delete.begin(), to_delete.end(), new_iv_ulas.begin() );
-				swap( iv_ulas, new_iv_ulas );
-				for( size_t delI = 0; delI < to_delete.size(); ++delI )
-					to_delete[delI]->Free();
+				eraseMergedUlas( iv_ulas, to_delete );
 
 				vector< ULA* > orig_ula_order = cur_ulas;
 				// now do something similar for seqJ
@@ -622,15 +655,7 @@ void mergePairwiseHomologyPredictions( 	vector< CompactGappedAlignment<>* >& iv_
 						cur_ulas[curuI]->Free();
 				}
 				// delete to_delete...
-				std::sort( to_delete.begin(), to_delete.end() );
-				last = std::unique( to_delete.begin(), to_delete.end() );
-				to_delete.erase( last, to_delete.end() );
-				new_iv_ulas = vector< ULA* >( iv_ulas.size() - to_delete.size() );
-				std::sort( iv_ulas.begin(), iv_ulas.end() );
-				std::set_difference( iv_ulas.begin(), iv_ulas.end(), to_delete.begin(), to_delete.end(), new_iv_ulas.begin() );
-				swap( iv_ulas, new_iv_ulas );
-				for( size_t delI = 0; delI < to_delete.size(); ++delI )
-					to_delete[delI]->Free();
+				eraseMergedUlas( iv_ulas, to_delete );
 			}
 		}
 	}
@@ -0,0 +1,384 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * Please see the file called COPYING for licensing, copying, and modification
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/BinaryAlignment.h"
+#include "libMems/MatchList.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace genome;
+namespace mems {
+
+static const char MBA_MAGIC[8] = { 'M', 'A', 'U', 'V', 'E', 'M', 'B', 'A' };
+static const uint32 MBA_VERSION = 2;
+
+static const char NUCLEOTIDES[4] = { 'A', 'C', 'G', 'T' };
+
+/** the four residues packed in each byte value */
+struct UnpackTable {
+	char bytes[256][4];
+	UnpackTable(){
+		for( uint byteI = 0; byteI < 256; byteI++ )
+			for( uint resI = 0; resI < 4; resI++ )
+				bytes[ byteI ][ resI ] = NUCLEOTIDES[ (byteI >> (resI * 2)) & 3 ];
+	}
+};
+static const UnpackTable unpack_table;
+
+static void appendVarint( string& block, uint64 value ){
+	while( value >= 0x80 ){
+		block += (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	block += (char)value;
+}
+
+/** reads integers from an encoded block, throwing InvalidFileFormat if the block ends early */
+class BlockDecoder {
+public:
+	BlockDecoder( const uint8* data, const uint8* end ) : data( data ), end( end ){}
+	uint64 varint(){
+		uint64 value = 0;
+		for( uint shift = 0; shift < 64; shift += 7 ){
+			if( data == end )
+				Throw_gnEx( InvalidFileFormat() );
+			uint8 b = *data++;
+			value |= (uint64)(b & 0x7F) << shift;
+			if( (b & 0x80) == 0 )
+				return value;
+		}
+		Throw_gnEx( InvalidFileFormat() );
+		return value;
+	}
+	int64 signedVarint(){
+		uint64 value = varint();
+		return (int64)(value >> 1) ^ -(int64)(value & 1);
+	}
+	const uint8* bytes( size_t count ){
+		if( (size_t)(end - data) < count )
+			Throw_gnEx( InvalidFileFormat() );
+		const uint8* b = data;
+		data += count;
+		return b;
+	}
+private:
+	const uint8* data;
+	const uint8* end;
+};
+
+static void setColumns( vector< bitset_t::block_type >& words, uint64 first, uint64 count ){
+	const uint64 word_bits = bitset_t::bits_per_block;
+	while( count > 0 ){
+		uint64 wordI = first / word_bits;
+		uint64 bitI = first % word_bits;
+		uint64 span = (std::min)( count, word_bits - bitI );
+		bitset_t::block_type mask = span == word_bits ? ~(bitset_t::block_type)0 : (((bitset_t::block_type)1 << span) - 1);
+		words[ wordI ] |= mask << bitI;
+		first += span;
+		count -= span;
+	}
+}
+
+BinaryAlignment::BinaryAlignment() : 
+	block_offsets( NULL ),
+	block_count( 0 ),
+	seq_count( 0 ),
+	has_residues( false )
+{}
+
+bool BinaryAlignment::IsBinaryAlignment( const string& fname ){
+	ifstream in_file( fname.c_str(), ios::binary );
+	char magic[ sizeof(MBA_MAGIC) ];
+	if( !in_file.read( magic, sizeof(magic) ) )
+		return false;
+	return memcmp( magic, MBA_MAGIC, sizeof(magic) ) == 0;
+}
+
+void BinaryAlignment::Open( const string& fname ){
+	boost::iostreams::mapped_file_source aln_file;
+	try{
+		aln_file.open( fname );
+	}catch( exception& e ){
+		// an empty file can be opened but not mapped, and is no binary alignment
+		ifstream in_file( fname.c_str(), ios::binary );
+		if( in_file.is_open() && in_file.peek() == EOF )
+			Throw_gnEx( InvalidFileFormat() );
+		Throw_gnExMsg( FileNotOpened(), "Unable to open binary alignment file.\n");
+	}
+	if( !aln_file.is_open() )
+		Throw_gnExMsg( FileNotOpened(), "Unable to open binary alignment file.\n");
+	const uint64 file_size = aln_file.size();
+	if( file_size < sizeof(FileHeader) + sizeof(FileTrailer) )
+		Throw_gnEx( InvalidFileFormat() );
+	const uint8* data = (const uint8*)aln_file.data();
+
+	FileHeader header;
+	memcpy( &header, data, sizeof(header) );
+	FileTrailer trailer;
+	memcpy( &trailer, data + file_size - sizeof(trailer), sizeof(trailer) );
+	if( memcmp( header.magic, MBA_MAGIC, sizeof(header.magic) ) != 0 ||
+		memcmp( trailer.magic, MBA_MAGIC, sizeof(trailer.magic) ) != 0 ||
+		header.version != MBA_VERSION ||
+		trailer.table_offset % sizeof(uint64) != 0 ||
+		trailer.table_offset > file_size - sizeof(trailer) ||
+		(file_size - sizeof(trailer) - trailer.table_offset) / sizeof(uint64) != trailer.block_count + 1 )
+		Throw_gnEx( InvalidFileFormat() );
+
+	BlockDecoder names( data + sizeof(header), data + trailer.table_offset );
+	seq_filename.resize( header.seq_filename_count );
+	for( uint nameI = 0; nameI <= header.seq_filename_count; nameI++ ){
+		uint32 name_length;
+		memcpy( &name_length, names.bytes( sizeof(name_length) ), sizeof(name_length) );
+		const char* name = (const char*)names.bytes( name_length );
+		if( nameI < header.seq_filename_count )
+			seq_filename[ nameI ].assign( name, name_length );
+		else
+			backbone_filename.assign( name, name_length );
+	}
+
+	mapped_data = aln_file;
+	block_offsets = (const uint64*)(data + trailer.table_offset);
+	block_count = trailer.block_count;
+	seq_count = header.seq_count;
+	has_residues = (header.flags & HAS_RESIDUES) != 0;
+	for( size_t blockI = 0; blockI < block_count; blockI++ )
+		if( block_offsets[ blockI ] > block_offsets[ blockI + 1 ] || block_offsets[ blockI + 1 ] > trailer.table_offset )
+			Throw_gnEx( InvalidFileFormat() );
+}
+
+void BinaryAlignment::ReadBlock( size_t blockI, vector< int64 >& starts, vector< gnSeqI >& lengths, 
+		vector< bitset_t >& aln_mat, vector< string >* residues ) const {
+	if( blockI >= block_count )
+		Throw_gnEx( IndexOutOfBounds() );
+	const uint8* data = (const uint8*)mapped_data.data();
+	BlockDecoder block( data + block_offsets[ blockI ], data + block_offsets[ blockI + 1 ] );
+
+	const uint64 aln_length = block.varint();
+	if( block.varint() != seq_count )
+		Throw_gnEx( InvalidFileFormat() );
+	starts.resize( seq_count );
+	lengths.resize( seq_count );
+	aln_mat.resize( seq_count );
+	vector< uint64 > residue_count( seq_count, 0 );
+	vector< vector< uint64 > > residue_runs( seq_count );	// first column and length of each run of residues
+	vector< bitset_t::block_type > words;
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		starts[ seqI ] = block.signedVarint();
+		lengths[ seqI ] = block.varint();
+		// runs alternate between gaps and residues, starting with gaps
+		words.assign( (aln_length + bitset_t::bits_per_block - 1) / bitset_t::bits_per_block, 0 );
+		uint64 run_count = block.varint();
+		uint64 colI = 0;
+		for( uint64 runI = 0; runI < run_count; runI++ ){
+			uint64 run = block.varint();
+			if( run > aln_length - colI )
+				Throw_gnEx( InvalidFileFormat() );
+			if( runI % 2 == 1 ){
+				setColumns( words, colI, run );
+				residue_count[ seqI ] += run;
+				residue_runs[ seqI ].push_back( colI );
+				residue_runs[ seqI ].push_back( run );
+			}
+			colI += run;
+		}
+		aln_mat[ seqI ] = bitset_t( words.begin(), words.end() );
+		aln_mat[ seqI ].resize( aln_length );
+	}
+
+	if( residues == NULL || !has_residues )
+		return;
+	const char (*unpacked)[4] = unpack_table.bytes;
+	residues->resize( seq_count );
+	string seq;
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		// unpack the residues four at a time, lowercase the runs in the case mask,
+		// then apply the exceptions and place the residues between the gaps
+		const uint64 seq_length = residue_count[ seqI ];
+		const uint8* packed = block.bytes( (seq_length + 3) / 4 );
+		seq.resize( ((seq_length + 3) / 4) * 4 );
+		for( uint64 byteI = 0; byteI < (seq_length + 3) / 4; byteI++ )
+			memcpy( &seq[ byteI * 4 ], unpacked[ packed[ byteI ] ], 4 );
+		// case runs alternate between uppercase and lowercase residues, starting with uppercase
+		uint64 case_run_count = block.varint();
+		uint64 resI = 0;
+		for( uint64 runI = 0; runI < case_run_count; runI++ ){
+			uint64 run = block.varint();
+			if( run > seq_length - resI )
+				Throw_gnEx( InvalidFileFormat() );
+			if( runI % 2 == 1 )
+				for( uint64 caseI = resI; caseI < resI + run; caseI++ )
+					seq[ caseI ] = tolower( seq[ caseI ] );
+			resI += run;
+		}
+		uint64 exception_count = block.varint();
+		resI = 0;
+		for( uint64 exceptionI = 0; exceptionI < exception_count; exceptionI++ ){
+			resI += block.varint();
+			if( resI >= seq_length )
+				Throw_gnEx( InvalidFileFormat() );
+			seq[ resI ] = (char)*block.bytes( 1 );
+		}
+
+		string& row = (*residues)[ seqI ];
+		row.assign( aln_length, '-' );
+		const vector< uint64 >& runs = residue_runs[ seqI ];
+		resI = 0;
+		for( size_t runI = 0; runI < runs.size(); runI += 2 ){
+			memcpy( &row[ runs[ runI ] ], &seq[ resI ], runs[ runI + 1 ] );
+			resI += runs[ runI + 1 ];
+		}
+	}
+}
+
+static void writeName( ostream& out, const string& name ){
+	uint32 name_length = name.size();
+	out.write( (const char*)&name_length, sizeof(name_length) );
+	out.write( name.data(), name.size() );
+}
+
+BinaryAlignmentWriter::BinaryAlignmentWriter( ostream& out, uint seq_count, const vector< string >& seq_filename, 
+		const string& backbone_filename, bool write_residues ) :
+	out( out ),
+	write_residues( write_residues )
+{
+	BinaryAlignment::FileHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, MBA_MAGIC, sizeof(header.magic) );
+	header.version = MBA_VERSION;
+	header.flags = write_residues ? BinaryAlignment::HAS_RESIDUES : 0;
+	header.seq_count = seq_count;
+	header.seq_filename_count = seq_filename.size();
+	out.write( (const char*)&header, sizeof(header) );
+	bytes_written = sizeof(header);
+	for( size_t nameI = 0; nameI < seq_filename.size(); nameI++ ){
+		writeName( out, seq_filename[ nameI ] );
+		bytes_written += sizeof(uint32) + seq_filename[ nameI ].size();
+	}
+	writeName( out, backbone_filename );
+	bytes_written += sizeof(uint32) + backbone_filename.size();
+}
+
+void BinaryAlignmentWriter::EncodeBlock( const vector< int64 >& starts, const vector< gnSeqI >& lengths, 
+		const vector< bitset_t >& aln_mat, const vector< string >* residues, string& block ){
+	block.clear();
+	const uint64 aln_length = aln_mat.size() > 0 ? aln_mat[0].size() : 0;
+	appendVarint( block, aln_length );
+	appendVarint( block, aln_mat.size() );
+	vector< vector< uint64 > > row_runs( aln_mat.size() );
+	for( size_t seqI = 0; seqI < aln_mat.size(); seqI++ ){
+		appendVarint( block, ((uint64)starts[ seqI ] << 1) ^ (uint64)(starts[ seqI ] >> 63) );
+		appendVarint( block, lengths[ seqI ] );
+		vector< uint64 >& runs = row_runs[ seqI ];
+		const bitset_t& row = aln_mat[ seqI ];
+		uint64 colI = 0;
+		while( colI < aln_length ){
+			bitset_t::size_type residue_col = row.test( colI ) ? colI : row.find_next( colI );
+			if( residue_col == bitset_t::npos )
+				residue_col = aln_length;
+			runs.push_back( residue_col - colI );
+			colI = residue_col;
+			while( colI < aln_length && row.test( colI ) )
+				colI++;
+			if( colI > residue_col )
+				runs.push_back( colI - residue_col );
+		}
+		appendVarint( block, runs.size() );
+		for( size_t runI = 0; runI < runs.size(); runI++ )
+			appendVarint( block, runs[ runI ] );
+	}
+
+	if( residues == NULL )
+		return;
+	string seq;
+	string packed;
+	string exceptions;
+	vector< uint64 > case_runs;
+	for( size_t seqI = 0; seqI < aln_mat.size(); seqI++ ){
+		// gather the residues from the runs between gaps, then pack them
+		const string& aln_row = (*residues)[ seqI ];
+		const vector< uint64 >& runs = row_runs[ seqI ];
+		seq.clear();
+		uint64 colI = 0;
+		for( size_t runI = 0; runI < runs.size(); runI++ ){
+			if( runI % 2 == 1 )
+				seq.append( aln_row, colI, runs[ runI ] );
+			colI += runs[ runI ];
+		}
+		packed.assign( (seq.size() + 3) / 4, 0 );
+		exceptions.clear();
+		case_runs.clear();
+		uint64 exception_count = 0;
+		uint64 last_exception = 0;
+		uint64 case_run_start = 0;
+		for( uint64 resI = 0; resI < seq.size(); resI++ ){
+			// a run of the other case starts here
+			const bool lower = seq[ resI ] >= 'a' && seq[ resI ] <= 'z';
+			if( lower != (case_runs.size() % 2 == 1) ){
+				case_runs.push_back( resI - case_run_start );
+				case_run_start = resI;
+			}
+			uint8 code;
+			switch( seq[ resI ] ){
+				case 'A': case 'a': code = 0; break;
+				case 'C': case 'c': code = 1; break;
+				case 'G': case 'g': code = 2; break;
+				case 'T': case 't': code = 3; break;
+				default:
+					code = 0;
+					appendVarint( exceptions, resI - last_exception );
+					exceptions += seq[ resI ];
+					last_exception = resI;
+					exception_count++;
+			}
+			packed[ resI / 4 ] |= code << ((resI % 4) * 2);
+		}
+		if( case_runs.size() > 0 )
+			case_runs.push_back( seq.size() - case_run_start );
+		block += packed;
+		appendVarint( block, case_runs.size() );
+		for( size_t runI = 0; runI < case_runs.size(); runI++ )
+			appendVarint( block, case_runs[ runI ] );
+		appendVarint( block, exception_count );
+		block += exceptions;
+	}
+}
+
+void BinaryAlignmentWriter::WriteBlock( const string& block ){
+	block_offsets.push_back( bytes_written );
+	out.write( block.data(), block.size() );
+	bytes_written += block.size();
+}
+
+uint64 BinaryAlignmentWriter::Finish(){
+	// align the offset table so that it can be read in place from a mapped file
+	char padding[8] = { 0 };
+	uint64 pad_size = (sizeof(uint64) - bytes_written % sizeof(uint64)) % sizeof(uint64);
+	out.write( padding, pad_size );
+	bytes_written += pad_size;
+
+	BinaryAlignment::FileTrailer trailer;
+	trailer.block_count = block_offsets.size();
+	trailer.table_offset = bytes_written;
+	memcpy( trailer.magic, MBA_MAGIC, sizeof(trailer.magic) );
+	block_offsets.push_back( bytes_written - pad_size );
+	out.write( (const char*)&block_offsets[0], block_offsets.size() * sizeof(uint64) );
+	out.write( (const char*)&trailer, sizeof(trailer) );
+	bytes_written += block_offsets.size() * sizeof(uint64) + sizeof(trailer);
+	block_offsets.pop_back();
+	out.flush();
+	if( !out.good() )
+		Throw_gnExMsg( FileUnreadable(), "Error writing binary alignment file.\n");
+	return bytes_written;
+}
+
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * This file is licensed under the GPL.
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifndef _BinaryAlignment_h_
+#define _BinaryAlignment_h_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnDefs.h"
+#include "libMems/AbstractMatch.h"
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mems {
+
+/**
+ * A BinaryAlignment reads the Mauve binary alignment format, a compact alternative to
+ * XMFA.  Each aligned block holds the coordinates of every genome and the gap pattern of
+ * every row as alternating run lengths of gap and residue columns.  Files may also hold
+ * the residues, two bits per nucleotide in either case, with the runs of lowercase
+ * residues and any other character listed separately, so that the alignment can be
+ * rendered without the genome sequences.  Integers within a block are stored seven bits
+ * per byte, and a table of block offsets at the end of the file lets each block be
+ * decoded on its own from the memory mapped file.
+ * @see BinaryAlignmentWriter
+ */
+class BinaryAlignment {
+public:
+	BinaryAlignment();
+
+	/** Memory maps a binary alignment file, throwing InvalidFileFormat if it is not one */
+	void Open( const std::string& fname );
+
+	/** @return true if the named file begins like a binary alignment */
+	static bool IsBinaryAlignment( const std::string& fname );
+
+	/** @return the number of genomes in the alignment */
+	uint SeqCount() const { return seq_count; }
+	/** @return the number of aligned blocks */
+	size_t BlockCount() const { return block_count; }
+	/** @return true if the file stores residues along with the gap patterns */
+	bool HasResidues() const { return has_residues; }
+	/** @return the sequence file names of the alignment */
+	const std::vector< std::string >& SeqFilenames() const { return seq_filename; }
+	/** @return the name of the alignment's backbone file, or empty if none was given */
+	const std::string& BackboneFilename() const { return backbone_filename; }
+
+	/**
+	 * Decodes one block
+	 * @param blockI	The block to decode
+	 * @param starts	(output) The start of each genome, negative on the reverse strand and 0 when the genome is absent
+	 * @param lengths	(output) The number of residues of each genome
+	 * @param aln_mat	(output) The gap pattern of each row, true for residues and false for gaps
+	 * @param residues	(output) If not NULL and the file stores residues, each row of the alignment with gaps as '-'
+	 */
+	void ReadBlock( size_t blockI, std::vector< int64 >& starts, std::vector< gnSeqI >& lengths, 
+		std::vector< bitset_t >& aln_mat, std::vector< std::string >* residues ) const;
+
+	/** The fixed part of the file header, followed by the file names as a uint32 length and characters */
+	struct FileHeader {
+		char magic[8];
+		uint32 version;
+		uint32 flags;	/**< HAS_RESIDUES when residues are stored */
+		uint32 seq_count;
+		uint32 seq_filename_count;	/**< number of sequence file names, the backbone file name comes last */
+	};
+	/** The end of the file, preceded by the offset of each block and the end of the last block */
+	struct FileTrailer {
+		uint64 block_count;
+		uint64 table_offset;
+		char magic[8];
+	};
+	static const uint32 HAS_RESIDUES = 1;
+
+protected:
+	boost::iostreams::mapped_file_source mapped_data;
+	const uint64* block_offsets;	/**< points into mapped_data */
+	size_t block_count;
+	uint seq_count;
+	bool has_residues;
+	std::vector< std::string > seq_filename;
+	std::string backbone_filename;
+};
+
+/**
+ * Writes an alignment in the Mauve binary alignment format.  Blocks are encoded with
+ * EncodeBlock(), which may run concurrently, and written in order with WriteBlock().
+ * @see BinaryAlignment
+ */
+class BinaryAlignmentWriter {
+public:
+	/** Writes the file header to out, which must stay open until Finish() */
+	BinaryAlignmentWriter( std::ostream& out, uint seq_count, const std::vector< std::string >& seq_filename, 
+		const std::string& backbone_filename, bool write_residues );
+
+	/**
+	 * Encodes one block
+	 * @param starts	The start of each genome, negative on the reverse strand and 0 when the genome is absent
+	 * @param lengths	The number of residues of each genome
+	 * @param aln_mat	The gap pattern of each row
+	 * @param residues	Each row of the alignment, used only when it is not NULL
+	 * @param block		(output) The encoded block
+	 */
+	static void EncodeBlock( const std::vector< int64 >& starts, const std::vector< gnSeqI >& lengths, 
+		const std::vector< bitset_t >& aln_mat, const std::vector< std::string >* residues, std::string& block );
+
+	/** Writes a block made by EncodeBlock(), which must include residues if the file does */
+	void WriteBlock( const std::string& block );
+
+	/** Writes the block offsets and trailer, @return the number of bytes written in total */
+	uint64 Finish();
+
+	bool WritesResidues() const { return write_residues; }
+
+protected:
+	std::ostream& out;
+	bool write_residues;
+	uint64 bytes_written;
+	std::vector< uint64 > block_offsets;
+};
+
+}
+
+#endif	// _BinaryAlignment_h_
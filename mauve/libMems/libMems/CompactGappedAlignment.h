@@ -22,6 +22,7 @@
 #include "libMems/UngappedLocalAlignment.h"
 
 #include <algorithm>
+#include <bitset>
 
 #ifdef WIN32
 #include "windows.h"
@@ -279,12 +280,16 @@ void CompactGappedAlignment<BaseType>::create_bitcount()
 		bitset_t& bvec = align_matrix[seqI];
 		bcount[seqI].clear();
 		bcount[seqI].push_back(0);
+		// count a block of bits at a time
+		std::vector< bitset_t::block_type > blocks( bvec.num_blocks() );
+		boost::to_block_range( bvec, blocks.begin() );
+		const size_t blocks_per_interval = INDEX_INTERVAL / bitset_t::bits_per_block;
 		for( size_t indie = 0; indie + INDEX_INTERVAL <= bvec.size(); indie += INDEX_INTERVAL )
 		{
-			size_t end = indie + INDEX_INTERVAL;
+			size_t first_block = indie / bitset_t::bits_per_block;
 			size_t ct = 0;
-			for( size_t i = indie; i < end; ++i )
-				ct += bvec.test(i);
+			for( size_t i = first_block; i < first_block + blocks_per_interval; ++i )
+				ct += std::bitset< bitset_t::bits_per_block >( blocks[i] ).count();
 			bcount[seqI].push_back( ct + bcount[seqI].back() );
 		}
 	}
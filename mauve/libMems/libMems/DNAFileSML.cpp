@@ -45,6 +45,8 @@ uint64 DNAFileSML::GetNeededMemory(gnSeqI len){
 	//forward and reverse copies of the sequence
 	neededmem += len * 2;
 	neededmem += sizeof(bmer) * len;
+	// scratch space for the radix sort
+	neededmem += sizeof(bmer) * len;
 	return neededmem;
 }
 
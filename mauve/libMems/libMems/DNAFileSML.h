@@ -55,9 +55,10 @@ protected:
 // version 3 was original DNAFileSML format
 // version 4 was introduction of inexact seeds
 // version 5 was fix in header struct for 64-bit seed size
+// version 6 added variable width positions for sequences over 4 Gbp
 inline
 uint32 DNAFileSML::FormatVersion(){
-	static uint32 f_version = 5;
+	static uint32 f_version = 6;
 	return f_version;
 }
 
@@ -19,6 +19,9 @@
 #include "libMems/GappedAlignment.h"
 #include "libMems/CompactGappedAlignment.h"
 
+#include <algorithm>
+#include <map>
+
 
 namespace mems {
 
@@ -191,74 +194,159 @@ void AddToMatchIdentityMatrix( const Match& m, const std::vector< genome::gnSequ
 }
 */
 
+/**
+ * A range of positions [left, right) in one genome that is aligned to every
+ * genome in a column pattern.  Patterns are identified by the interval they
+ * came from and their index among that interval's distinct patterns.
+ */
+struct CoverageRun
+{
+	gnSeqI left;
+	gnSeqI right;
+	uint ivI;
+	uint patternI;
+};
+
+inline
+bool coverage_run_lessthan( const CoverageRun& a, const CoverageRun& b )
+{
+	return a.left < b.left;
+}
+
+/**
+ * Splits an alignment into blocks of consecutive columns that contain the
+ * same set of genomes, and appends a CoverageRun for each genome in each block
+ * to the run list of that genome.
+ * @param patterns		Receives each distinct set of genomes aligned in a block.
+ *						Blocks with the same set share one entry, so an alignment
+ *						with many short blocks does not store a copy per block.
+ */
+template< typename MatchType >
+void GetCoverageRuns( const MatchType& iv, uint ivI, std::vector< std::vector< uint > >& patterns, std::vector< std::vector< CoverageRun > >& runs )
+{
+	uint seq_count = iv.SeqCount();
+	std::vector< bitset_t > aln_table;
+	iv.GetAlignment(aln_table);
+	std::vector< gnSeqI > seq_pos( seq_count, NO_MATCH );
+	for( uint seqI = 0; seqI < seq_count; ++seqI )
+	{
+		if( iv.LeftEnd(seqI) == NO_MATCH )
+			continue;
+		seq_pos[seqI] = iv.Orientation(seqI) == AbstractMatch::forward ? iv.LeftEnd(seqI) : iv.RightEnd(seqI);
+	}
+
+	std::map< std::vector< uint >, uint > pattern_ids;
+	std::vector< uint > cur_pattern;
+	std::vector< uint > col_pattern;
+	size_t aln_length = aln_table.size() > 0 ? aln_table[0].size() : 0;
+	size_t block_start = 0;
+	for( size_t colI = 0; colI <= aln_length; ++colI )
+	{
+		col_pattern.clear();
+		for( uint seqI = 0; colI < aln_length && seqI < seq_count; ++seqI )
+			if( seq_pos[seqI] != NO_MATCH && aln_table[seqI].test(colI) )
+				col_pattern.push_back(seqI);
+		if( colI > 0 && col_pattern == cur_pattern && colI < aln_length )
+			continue;
+		// the previous block ends here
+		gnSeqI block_len = colI - block_start;
+		if( cur_pattern.size() > 1 )
+		{
+			std::map< std::vector< uint >, uint >::iterator id_iter = pattern_ids.find( cur_pattern );
+			if( id_iter == pattern_ids.end() )
+			{
+				id_iter = pattern_ids.insert( std::make_pair( cur_pattern, (uint)patterns.size() ) ).first;
+				patterns.push_back( cur_pattern );
+			}
+			for( size_t pI = 0; pI < cur_pattern.size(); ++pI )
+			{
+				uint seqI = cur_pattern[pI];
+				CoverageRun run;
+				if( iv.Orientation(seqI) == AbstractMatch::forward )
+					run.left = seq_pos[seqI];
+				else
+					run.left = seq_pos[seqI] - block_len + 1;
+				run.right = run.left + block_len;
+				run.ivI = ivI;
+				run.patternI = id_iter->second;
+				runs[seqI].push_back(run);
+			}
+		}
+		for( size_t pI = 0; pI < cur_pattern.size(); ++pI )
+		{
+			uint seqI = cur_pattern[pI];
+			if( iv.Orientation(seqI) == AbstractMatch::forward )
+				seq_pos[seqI] += block_len;
+			else
+				seq_pos[seqI] -= block_len;
+		}
+		cur_pattern.swap(col_pattern);
+		block_start = colI;
+	}
+}
+
+/**
+ * Computes the genome conservation distance, the average over each pair of
+ * genomes of the fraction of each genome aligned to the other.  Each genome's
+ * aligned positions are kept as runs of positions rather than bit vectors, so
+ * memory grows with the size of the alignment instead of with the number of
+ * genome pairs times genome length.
+ */
 template< typename MatchVector >
 void SingleCopyDistanceMatrix( MatchVector& iv_list, std::vector< genome::gnSequence* >& seq_table, NumericMatrix<double>& distance )
 {
 	uint seq_count = seq_table.size();
 	distance = NumericMatrix<double>( seq_count, seq_count );
 	distance.init( 0 );
-	uint seqI;
-	uint seqJ;
-	std::vector< std::pair< bitset_t, bitset_t > > tmp_comp( seq_count );
-	std::vector< std::vector< std::pair< bitset_t, bitset_t > > > pair_comp( seq_count, tmp_comp );
-	for( uint seqI = 0; seqI < seq_count; ++seqI )
+
+	// find the runs of aligned positions in each interval
+	std::vector< std::vector< std::vector< uint > > > iv_patterns( iv_list.size() );
+	std::vector< std::vector< std::vector< CoverageRun > > > iv_runs( iv_list.size() );
+	const int iv_count = iv_list.size();
+#pragma omp parallel for schedule(dynamic)
+	for( int ivI = 0; ivI < iv_count; ++ivI )
 	{
-		for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
-		{
-			pair_comp[seqI][seqJ].first.resize( seq_table[seqI]->length(), false );
-			pair_comp[seqI][seqJ].second.resize( seq_table[seqJ]->length(), false );
-		}
+		iv_runs[ivI].resize( seq_count );
+		GetCoverageRuns( *iv_list[ivI], ivI, iv_patterns[ivI], iv_runs[ivI] );
 	}
-#pragma omp parallel for
-	for( int ivI = 0; ivI < iv_list.size(); ++ivI )
+
+	// count the positions of each genome aligned to each other genome
+	std::vector< std::vector< gnSeqI > > covered( seq_count, std::vector< gnSeqI >( seq_count, 0 ) );
+#pragma omp parallel for schedule(dynamic)
+	for( int seqI = 0; seqI < (int)seq_count; ++seqI )
 	{
-		std::vector< bitset_t > aln_table;
-#pragma omp critical
-{
-		iv_list[ivI]->GetAlignment(aln_table);
-}
-		for( uint seqI = 0; seqI < seq_count; ++seqI )
+		std::vector< CoverageRun > runs;
+		for( size_t ivI = 0; ivI < iv_runs.size(); ++ivI )
+			runs.insert( runs.end(), iv_runs[ivI][seqI].begin(), iv_runs[ivI][seqI].end() );
+		std::sort( runs.begin(), runs.end(), coverage_run_lessthan );
+		// runs arrive in order of left end, so the union of the runs aligned to
+		// seqJ only grows past the rightmost position covered so far
+		std::vector< gnSeqI > covered_to( seq_count, 0 );
+		for( size_t runI = 0; runI < runs.size(); ++runI )
 		{
-			for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+			const std::vector< uint >& pattern = iv_patterns[ runs[runI].ivI ][ runs[runI].patternI ];
+			for( size_t pI = 0; pI < pattern.size(); ++pI )
 			{
-				gnSeqI seqI_pos = iv_list[ivI]->LeftEnd(seqI);
-				gnSeqI seqJ_pos = iv_list[ivI]->LeftEnd(seqJ);
-				AbstractMatch::orientation o_i = iv_list[ivI]->Orientation(seqI);
-				AbstractMatch::orientation o_j = iv_list[ivI]->Orientation(seqJ);
-				if( o_i == AbstractMatch::reverse )
-					seqI_pos = iv_list[ivI]->RightEnd(seqI);
-				if( o_j == AbstractMatch::reverse )
-					seqJ_pos = iv_list[ivI]->RightEnd(seqJ);
-				if( seqI_pos == NO_MATCH || seqJ_pos == NO_MATCH )
+				uint seqJ = pattern[pI];
+				if( seqJ == (uint)seqI )
 					continue;
-				for( size_t colI = 0; colI < aln_table[seqI].size(); ++colI )
+				gnSeqI left = runs[runI].left > covered_to[seqJ] ? runs[runI].left : covered_to[seqJ];
+				if( runs[runI].right > left )
 				{
-					if( aln_table[seqI].test(colI) && aln_table[seqJ].test(colI) )
-					{
-						pair_comp[seqI][seqJ].first.set(seqI_pos-1,true);
-						pair_comp[seqI][seqJ].second.set(seqJ_pos-1,true);
-					}
-					if( aln_table[seqI].test(colI) )
-						if( o_i == AbstractMatch::forward )
-							seqI_pos++;
-						else
-							seqI_pos--;
-					if( aln_table[seqJ].test(colI) )
-						if( o_j == AbstractMatch::forward )
-							seqJ_pos++;
-						else
-							seqJ_pos--;
+					covered[seqI][seqJ] += runs[runI].right - left;
+					covered_to[seqJ] = runs[runI].right;
 				}
 			}
 		}
 	}
+
 	for( uint seqI = 0; seqI < seq_count; ++seqI )
 	{
 		distance(seqI,seqI) = 1;
 		for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
 		{
-			double pI = ((double)pair_comp[seqI][seqJ].first.count())/((double)pair_comp[seqI][seqJ].first.size());
-			double pJ = ((double)pair_comp[seqI][seqJ].second.count())/((double)pair_comp[seqI][seqJ].second.size());
+			double pI = ((double)covered[seqI][seqJ])/((double)seq_table[seqI]->length());
+			double pJ = ((double)covered[seqJ][seqI])/((double)seq_table[seqJ]->length());
 			distance(seqI,seqJ) = (pI + pJ) / 2.0;
 			distance(seqJ,seqI) = (pI + pJ) / 2.0;
 		}
@@ -14,6 +14,10 @@
 #include "libGenome/gnRAWSource.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
 #include "boost/filesystem/operations.hpp"
 
 using namespace std;
@@ -26,6 +30,7 @@ FileSML& FileSML::operator=(const FileSML& sa)
  	filename = sa.filename;
 	sarray_start_offset = sa.sarray_start_offset;
 	seq_coords = sa.seq_coords;
+	create_working_mb = sa.create_working_mb;
 	sarfile.open(filename.c_str(), ios::binary | ios::in );
 	if(!sarfile.is_open()){
 		DebugMsg("FileSML::=: Unable to open suffix array file.\n");
@@ -87,7 +92,7 @@ void FileSML::LoadFile(const string& fname){
 	}
 
 	sarray_start_offset = sarfile.tellg();
-	sarfile.seekg(sarray_start_offset + sizeof(gnSeqI) * header.length);
+	sarfile.seekg(sarray_start_offset + (uint64)header.position_bytes * header.length);
 	if(!sarfile.good()){
 		sarfile.clear();
 		Throw_gnExMsg( FileUnreadable(), "Premature end of file.");
@@ -177,6 +182,7 @@ extern "C" {
 }
 
 char** FileSML::tmp_paths = NULL;
+std::string FileSML::cache_path;
 
 void FileSML::registerTempPath( const string& path ) {
 	string tmp_path = path;
@@ -228,6 +234,95 @@ int FileSML::getTempPathCount(){
 	return path_count;
 }
 
+void FileSML::registerCachePath( const string& path ){
+	try{
+		boost::filesystem::create_directories( path );
+	}catch( boost::filesystem::filesystem_error& fse ){
+		cerr << "Unable to create sorted mer list cache directory " << path << endl;
+		cerr << fse.what() << endl;
+		return;
+	}
+	cache_path = path;
+}
+
+const string& FileSML::getCachePath(){
+	return cache_path;
+}
+
+string FileSML::CacheFileName( const gnSequence& seq, const uint64 seed ){
+	// two independent 64 bit hashes of the sequence content, FNV-1a and a multiplicative one
+	uint64 hash_a = 14695981039346656037ULL;
+	uint64 hash_b = seq.length();
+	const gnSeqI read_length = 1024*1024;
+	string cur_seq;
+	for( gnSeqI seqI = 1; seqI <= seq.length(); seqI += read_length ){
+		gnSeqI cur_length = seqI + read_length <= seq.length() ? read_length : seq.length() - seqI + 1;
+		seq.ToString( cur_seq, cur_length, seqI );
+		for( size_t charI = 0; charI < cur_seq.size(); charI++ ){
+			uint8 c = (uint8)cur_seq[ charI ];
+			hash_a = (hash_a ^ c) * 1099511628211ULL;
+			hash_b = (hash_b + c + 1) * 0x9E3779B97F4A7C15ULL;
+			hash_b ^= hash_b >> 29;
+		}
+	}
+	stringstream cache_name;
+	cache_name << hex << setfill('0') << setw(16) << hash_a << setw(16) << hash_b;
+	cache_name << '.' << setw(16) << seed << ".sslist";
+	boost::filesystem::path cache_file( cache_path );
+	cache_file /= cache_name.str();
+	return cache_file.string();
+}
+
+void FileSML::publishCacheFile( const string& tmp_name, const string& cache_name ){
+#ifndef WIN32
+	// temporary files are only readable by their owner
+	chmod( tmp_name.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+#endif
+	if( rename( tmp_name.c_str(), cache_name.c_str() ) == 0 )
+		return;
+	// renaming onto an existing file fails on some systems
+	boost::filesystem::remove( tmp_name );
+	if( !boost::filesystem::exists( cache_name ) )
+		Throw_gnExMsg( FileNotOpened(), "Unable to move sorted mer list into the cache.\n");
+}
+
+/** @return the name of the file that marks a cache entry complete */
+static string cacheMarkerName( const string& cache_name ){
+	return cache_name + ".complete";
+}
+
+void FileSML::publishCacheEntry( const string& tmp_name, const string& cache_name ){
+	string coord_name = tmp_name + ".coords";
+	if( boost::filesystem::exists( coord_name ) )
+		publishCacheFile( coord_name, cache_name + ".coords" );
+	publishCacheFile( tmp_name, cache_name );
+	// the marker comes last, so an entry that has one has all of its files
+	ofstream marker( cacheMarkerName( cache_name ).c_str() );
+	if( !marker.is_open() )
+		Throw_gnExMsg( FileNotOpened(), "Unable to mark sorted mer list complete in the cache.\n");
+}
+
+bool FileSML::isCachePublished( const string& cache_name ){
+	return boost::filesystem::exists( cacheMarkerName( cache_name ) );
+}
+
+uint64 FileSML::CreateMemoryBudget(){
+	uint64 physical_memory = 0;
+#ifdef WIN32
+	MEMORYSTATUS ms;
+	memset( &ms, 0, sizeof( MEMORYSTATUS ) );
+	GlobalMemoryStatus( &ms );
+	physical_memory = ms.dwTotalPhys;
+#else
+	long page_count = sysconf( _SC_PHYS_PAGES );
+	long page_size = sysconf( _SC_PAGESIZE );
+	if( page_count > 0 && page_size > 0 )
+		physical_memory = (uint64)page_count * (uint64)page_size;
+#endif
+	uint64 budget = physical_memory / 2;
+	return budget > MemoryMinimum() ? budget : MemoryMinimum();
+}
+
 
 void maskNNNNN( const gnSequence& in_seq, gnSequence& out_seq, vector< int64 >& seq_coords, int mask_n_length ) {
 	
@@ -275,7 +370,7 @@ void maskNNNNN( const gnSequence& in_seq, gnSequence& out_seq, vector< int64 >&
 
 	// use dmSML to construct the SML
 	// then read it in using LoadFile()
-void FileSML::dmCreate(const gnSequence& seq, const uint64 seed){
+void FileSML::dmCreate(const gnSequence& seq, const uint64 seed, long working_mb){
 	// Filter NNNNNs
 	gnSequence masked_seq;
 	seq_coords.clear();
@@ -304,7 +399,7 @@ void FileSML::dmCreate(const gnSequence& seq, const uint64 seed){
 	// run dmSML
 	const char* const* scratch_paths = (const char* const*)tmp_paths;
 	sarfile.close();
-	int rval = dmSML( rawfile.c_str(), filename.c_str(), scratch_paths, seed );
+	int rval = dmSMLWorkingSet( rawfile.c_str(), filename.c_str(), scratch_paths, seed, working_mb );
 	if( rval != 0 )
 		cerr << "Crap.  It's broke, return value " << rval << endl;
 	
@@ -337,11 +432,10 @@ void FileSML::Create(const gnSequence& seq, const uint64 seed){
 			delete[] sequence;
 		binary_seq_len = 0;
 
-		dmCreate( seq, seed );
+		dmCreate( seq, seed, create_working_mb );
 	}
 
-//	RadixSort(s_array);
-	sort(sml_array.begin(), sml_array.end(), &bmer_lessthan);
+	RadixSort(sml_array);
 	
 	/* now write out the file header */
 	sarfile.write((char*)&header, sizeof(struct SMLHeader));
@@ -356,8 +450,7 @@ void FileSML::Create(const gnSequence& seq, const uint64 seed){
 	sarray_start_offset = sarfile.tellg();
 
 	/* write out the sorted mer list */
-	for(gnSeqI suffixI=0; suffixI < sml_array.size(); suffixI++)
-		sarfile.write((char*)&(sml_array[suffixI].position), sizeof(smlSeqI_t));
+	WritePositions( sml_array );
 	
 	sarfile.flush();
 	if(!sarfile.good()){
@@ -373,10 +466,21 @@ void FileSML::Create(const gnSequence& seq, const uint64 seed){
 	sardata.open(filename);
 }
 
+void FileSML::WritePositions( const vector<bmer>& sml_array ){
+	const gnSeqI POSITION_BUFFER_SIZE = 65536;
+	vector<char> pos_buf( POSITION_BUFFER_SIZE * header.position_bytes );
+	for(gnSeqI suffixI=0; suffixI < sml_array.size(); ){
+		gnSeqI bufI = 0;
+		for( ; bufI < POSITION_BUFFER_SIZE && suffixI < sml_array.size(); bufI++, suffixI++ )
+			SetPackedPosition( &pos_buf[0], header.position_bytes, bufI, sml_array[suffixI].position );
+		sarfile.write( &pos_buf[0], bufI * header.position_bytes );
+	}
+}
+
 bmer FileSML::operator[](gnSeqI index)
 {
 	bmer tmp_mer;
-	tmp_mer.position = base()[index];
+	tmp_mer.position = PositionAt( index );
 	tmp_mer.mer = GetSeedMer(tmp_mer.position);
 	return tmp_mer;
 }
@@ -401,7 +505,7 @@ boolean FileSML::Read(vector<bmer>& readVector, gnSeqI size, const gnSeqI offset
 	//copy data to the vector
 	for(gnSeqI j=0; j < readlen; j++){
 		bmer tmp_mer;
-		tmp_mer.position = base()[offset+j];
+		tmp_mer.position = PositionAt( offset+j );
 		if( tmp_mer.position > header.length ){
 			string errmsg = "Corrupted SML, position ";
 			errmsg += tmp_mer.position + " is out of range\n";
@@ -455,51 +559,7 @@ void FileSML::BigCreate(const gnSequence& seq, const uint32 split_levels, const
 }
 
 void FileSML::RadixSort(vector<bmer>& s_array){
-	vector<bmer> *source_buckets;
-	vector<bmer> *tmp_buckets;
-	vector<bmer> *buckets;
-	uint32 radix_size = 11;
-	uint64 radix_mask = 0xFFFFFFFF;
-	radix_mask <<= 32;
-	radix_mask |= 0xFFFFFFFF;
-	radix_mask >>= 64 - radix_size;
-	
-	uint32 bucket_count = (uint32) pow((double)2, (double)radix_size);
-	uint32 cur_shift_bits = 0;
-	buckets = new vector<bmer>[bucket_count];
-	source_buckets = new vector<bmer>[bucket_count];
-	uint64 cur_bucket;
-	for(uint32 merI = 0; merI < s_array.size(); merI++){
-		cur_bucket = s_array[merI].mer & radix_mask;
-		source_buckets[cur_bucket].push_back(s_array[merI]);
-	}
-	s_array.clear();
-	cur_shift_bits += radix_size;
-	radix_mask <<= radix_size;
-	while(cur_shift_bits < 64){
-		for(uint32 bucketI = 0; bucketI < bucket_count; bucketI++){
-			for(uint32 merI = 0; merI < source_buckets[bucketI].size(); merI++){
-				cur_bucket = source_buckets[bucketI][merI].mer & radix_mask;
-				cur_bucket >>= cur_shift_bits;
-				buckets[cur_bucket].push_back(source_buckets[bucketI][merI]);
-			}
-			source_buckets[bucketI].clear();
-		}
-		cur_shift_bits += radix_size;
-		radix_mask <<= radix_size;
-		tmp_buckets = source_buckets;
-		source_buckets = buckets;
-		buckets = tmp_buckets;
-	}
-	s_array.clear();
-	for(uint32 bucketI = 0; bucketI < bucket_count; bucketI++){
-		for(uint32 merI = 0; merI < source_buckets[bucketI].size(); merI++){
-			s_array.push_back(source_buckets[bucketI][merI]);
-		}
-		source_buckets[bucketI].clear();
-	}
-	delete[] source_buckets;
-	delete[] buckets;
+	RadixSortMers( s_array );
 }
 
 //Merges the supplied sorted mer lists into this one, overwriting the existing sml.
@@ -522,10 +582,11 @@ STACK_TRACE_START
 	}
 	header.unique_mers = NO_UNIQUE_COUNT;
 	header.length += sa_head2.length;
+	header.position_bytes = SMLPositionBytes( header.length );
 
 	//allocate some memory
 	const uint32 SEQ_BUFFER_SIZE = 200000;
-	Array<uint32> seq_buf ( SEQ_BUFFER_SIZE + header.seed_length );
+	Array<char> seq_buf ( (SEQ_BUFFER_SIZE + header.seed_length) * header.position_bytes );
 
 	//do some sanity checks on the sars we're merging.
 	if(sa_head.alphabet_bits != sa_head2.alphabet_bits ||
@@ -607,25 +668,25 @@ STACK_TRACE_START
 		while(m < array1.size() && n < array2.size()){
 			if(array1[m].mer <= array2[n].mer){
 				if(array1[m].mer <= middle_mers[midI].mer){
-					seq_buf.data[bufferI] = array1[m].position;
+					SetPackedPosition( seq_buf.data, header.position_bytes, bufferI, array1[m].position );
 					m++;
 					bufferI++;
 				}else{
-					seq_buf.data[bufferI] = middle_mers[midI].position;
+					SetPackedPosition( seq_buf.data, header.position_bytes, bufferI, middle_mers[midI].position );
 					midI++;
 					bufferI++;
 				}
 			}else if(array2[n].mer <= middle_mers[midI].mer){
-				seq_buf.data[bufferI] = array2[n].position + sa_head.length;
+				SetPackedPosition( seq_buf.data, header.position_bytes, bufferI, array2[n].position + sa_head.length );
 				n++;
 				bufferI++;
 			}else{
-				seq_buf.data[bufferI] = middle_mers[midI].position;
+				SetPackedPosition( seq_buf.data, header.position_bytes, bufferI, middle_mers[midI].position );
 				midI++;
 				bufferI++;
 			}
 			if(bufferI == SEQ_BUFFER_SIZE){
-				sarfile.write((char*)seq_buf.data, bufferI * sizeof(uint32));
+				sarfile.write(seq_buf.data, bufferI * header.position_bytes);
 				bufferI = 0;
 			}
 		}
@@ -641,7 +702,7 @@ STACK_TRACE_START
 		}
 	}while(array1.size() != 0 && array2.size() != 0);
 	if(bufferI > 0)
-		sarfile.write((char*)seq_buf.data, (bufferI)*sizeof(uint32));
+		sarfile.write(seq_buf.data, (bufferI)*header.position_bytes);
 	//consolidate the remaining mers to a known vector
 	vector<bmer> remaining_mers;
 	for(;m < array1.size(); m++)
@@ -656,9 +717,9 @@ STACK_TRACE_START
 	sort(remaining_mers.begin(), remaining_mers.end(), &bmer_lessthan);
 	uint32 remI = 0;
 	for(;remI < remaining_mers.size(); remI++)
-		seq_buf.data[remI] = remaining_mers[remI].position;
+		SetPackedPosition( seq_buf.data, header.position_bytes, remI, remaining_mers[remI].position );
 	if(remI > 0)
-		sarfile.write((char*)seq_buf.data, (remI)*sizeof(uint32));
+		sarfile.write(seq_buf.data, (remI)*header.position_bytes);
 
 	if(!sarfile.good()){
 		sarfile.clear();
@@ -34,7 +34,7 @@ namespace mems {
 class FileSML : public SortedMerList
 {
 public:
-	FileSML() : SortedMerList() {
+	FileSML() : SortedMerList(), create_working_mb(0) {
 //		file_mutex = new wxMutex();
 	};
 	FileSML& operator=(const FileSML& sa);
@@ -72,14 +72,59 @@ public:
 	
 	virtual uint32 FormatVersion();
 	static uint64 MemoryMinimum();
+	/** Sorts s_array by mer, see RadixSortMers() */
 	virtual void RadixSort(std::vector<bmer>& s_array);
 
-	void dmCreate(const genome::gnSequence& seq, const uint64 seed);
+	/**
+	 * Creates the SML with the external dmSML sorter.  Several SMLs may be
+	 * created this way at once, each with its own working_mb memory budget
+	 * @param working_mb	Working set size in megabytes, 0 sizes it from physical memory
+	 */
+	void dmCreate(const genome::gnSequence& seq, const uint64 seed, long working_mb = 0);
+	/**
+	 * Sets the working set that Create() passes to dmCreate() when the SML is too
+	 * large to sort in memory
+	 * @param working_mb	Working set size in megabytes, 0 sizes it from physical memory
+	 */
+	void SetCreateWorkingSet( long working_mb ){ create_working_mb = working_mb; }
 	static void registerTempPath( const std::string& tmp_path );
 
 	static const char* getTempPath( int pathI );
 
 	static int getTempPathCount();
+
+	/**
+	 * Designates a directory of sorted mer lists that may be shared between runs and users.
+	 * SMLs in the cache are named by CacheFileName(), so an SML gets reused for any
+	 * sequence with the same content no matter which file the sequence came from.
+	 * The directory is created if it does not exist.
+	 */
+	static void registerCachePath( const std::string& cache_path );
+	/** @return the SML cache directory, or an empty string if none has been registered */
+	static const std::string& getCachePath();
+	/**
+	 * @return the name of the file in the cache directory that holds the SML for seq and seed.
+	 * The name is made from a 128 bit hash of the sequence content and the seed pattern.
+	 */
+	static std::string CacheFileName( const genome::gnSequence& seq, const uint64 seed );
+	/**
+	 * Moves a newly created SML file into the cache under its final name and makes it
+	 * readable by other users.  If another process published the same SML in the
+	 * meantime its copy is kept.
+	 */
+	static void publishCacheFile( const std::string& tmp_name, const std::string& cache_name );
+	/**
+	 * Publishes a newly created SML and its .coords file, if it has one, with
+	 * publishCacheFile() and then marks the cache entry complete.  The two files can
+	 * not be renamed together, so lookups use an entry only once isCachePublished().
+	 */
+	static void publishCacheEntry( const std::string& tmp_name, const std::string& cache_name );
+	/** @return true if publishCacheEntry() has completed for the SML named cache_name */
+	static bool isCachePublished( const std::string& cache_name );
+	/** @return the amount of memory that concurrent SML creation may use, half of physical memory */
+	static uint64 CreateMemoryBudget();
+	/** @return the amount of memory Create() needs for a sequence of length len */
+	uint64 NeededMemory( gnSeqI len ){ return GetNeededMemory( len ); }
 	
 	const std::vector< int64 >& getUsedCoordinates() const { return seq_coords; };
 
@@ -108,17 +153,24 @@ protected:
 	uint64 sarray_start_offset;
 
 	boost::iostreams::mapped_file_source sardata;
-	smlSeqI_t* base(){ return (smlSeqI_t*)(sardata.data()+sarray_start_offset); }
+	const char* base(){ return sardata.data()+sarray_start_offset; }
+	/** @return entry index of the memory mapped position array */
+	smlSeqI_t PositionAt( gnSeqI index ){ return GetPackedPosition( base(), header.position_bytes, index ); }
+	/** Writes the positions of the mers in sml_array to sarfile, packed header.position_bytes apiece */
+	void WritePositions( const std::vector<bmer>& sml_array );
 	
 	static char** tmp_paths;	/**< paths to scratch disk space that can be used for an external sort */
+	static std::string cache_path;	/**< directory of SMLs shared between runs, empty when there is none */
 	std::vector< int64 > seq_coords;	/**< If Ns are masked, contains coordinates of regions without Ns */
+	long create_working_mb;	/**< working set in megabytes for an external sort started by Create() */
 };
 
 // versions 2 and 5 were previous
 // jump to 100 to avoid confusion with DNAFileSML
+// version 101 added variable width positions
 inline
 uint32 FileSML::FormatVersion(){
-	static uint32 f_version = 100;
+	static uint32 f_version = 101;
 	return f_version;
 }
 
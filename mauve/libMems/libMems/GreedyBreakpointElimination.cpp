@@ -16,6 +16,7 @@
 #include "libMems/PairwiseMatchFinder.h"
 #include "libMems/TreeUtilities.h"
 #include "libMems/PairwiseMatchAdapter.h"
+#include "libMUSCLE/threadstorage.h"
 
 #include <boost/dynamic_bitset.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -28,6 +29,10 @@
 #include <limits>
 #include <iomanip>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 using namespace genome;
 
@@ -47,6 +52,121 @@ void printProgress( uint prev_prog, uint cur_prog, ostream& os )
 	}
 }
 
+/** substitution matrix indices of each residue and of its complement */
+struct PairwiseScoreTables
+{
+	PairwiseScoreTables()
+	{
+		const uint8* table = SortedMerList::BasicDNATable();
+		const gnFilter* comp_filter = gnFilter::DNAComplementFilter();
+		for( uint c = 0; c < 256; c++ )
+		{
+			code[c] = table[c];
+			comp_code[c] = NO_CODE;
+			if( c < 128 && comp_filter->IsValid( (gnSeqC)c ) )
+				comp_code[c] = table[ (uint8)comp_filter->Filter( (gnSeqC)c ) ];
+		}
+	}
+	static const uint8 NO_CODE = 0xFF;	/**< marks residues that have no complement */
+	uint8 code[256];
+	uint8 comp_code[256];
+};
+
+/** per-thread buffers reused by GetPairwiseMatchScore */
+struct PairwiseScoreScratch
+{
+	std::vector< gnSeqC > residues;
+	std::vector< uint8 > codes[2];
+	std::vector< bitset_t > aln_mat;
+};
+
+/** scales a substitution score by the uniqueness of the aligned positions, as GetPairwiseAnchorScore does */
+static inline
+score_t scaleByUniqueness( score_t score, SeedOccurrenceList::frequency_type uni1, SeedOccurrenceList::frequency_type uni2 )
+{
+	SeedOccurrenceList::frequency_type uniprod = uni1*uni2;
+	uniprod = uniprod == 0 ? 1 : uniprod;
+	if( score > 0 )
+	{
+		if(penalize_repeats)
+			score = (score_t)((double)score * (2.0 / uniprod)) - score;
+		else
+			score = (score_t)((SeedOccurrenceList::frequency_type)score / uniprod);
+	}
+	return score;
+}
+
+bool GetPairwiseMatchScore( const AbstractMatch& m, vector< gnSequence* >& seq_table, 
+							const PairwiseScoringScheme& subst_scoring, SeedOccurrenceList& sol_1, 
+							SeedOccurrenceList& sol_2, double& m_score )
+{
+	static const PairwiseScoreTables tables;
+	static TLS< PairwiseScoreScratch > scratch_tls;
+	PairwiseScoreScratch& scratch = scratch_tls.get();
+
+	// read each row's residues straight into matrix indices, in alignment order
+	for( uint seqI = 0; seqI < 2; seqI++ )
+	{
+		if( m.LeftEnd(seqI) == NO_MATCH )
+			return false;
+		const gnSeqI len = m.Length(seqI);
+		scratch.residues.resize( len + 1 );
+		if( !seq_table[seqI]->ToArray( &scratch.residues[0], len, m.LeftEnd(seqI) ) )
+			return false;
+		scratch.codes[seqI].resize( len + 1 );
+		const uint8* residues = (const uint8*)&scratch.residues[0];
+		uint8* codes = &scratch.codes[seqI][0];
+		if( m.Orientation(seqI) == AbstractMatch::forward )
+		{
+			for( gnSeqI k = 0; k < len; k++ )
+				codes[k] = tables.code[ residues[k] ];
+		}else{
+			uint8 missing = 0;
+			for( gnSeqI k = 0; k < len; k++ )
+			{
+				codes[k] = tables.comp_code[ residues[len - k - 1] ];
+				missing |= codes[k] == PairwiseScoreTables::NO_CODE;
+			}
+			// the complement filter would drop such residues and shift the row
+			if( missing )
+				return false;
+		}
+	}
+
+	const uint8* codes_1 = &scratch.codes[0][0];
+	const uint8* codes_2 = &scratch.codes[1][0];
+	// frequencies are indexed by the residue offset from the left end regardless of orientation
+	const gnSeqI uni_1 = m.LeftEnd(0) - 1;
+	const gnSeqI uni_2 = m.LeftEnd(1) - 1;
+	// the scores are integers, so summing them exactly and converting once
+	// gives the same total as accumulating them in a double
+	int64 score = 0;
+	const gnSeqI aln_length = m.AlignmentLength();
+	if( m.Length(0) == aln_length && m.Length(1) == aln_length )
+	{
+		// ungapped: every column pairs consecutive residues
+		for( gnSeqI colI = 0; colI < aln_length; colI++ )
+			score += scaleByUniqueness( subst_scoring.matrix[codes_1[colI]][codes_2[colI]], sol_1.getFrequency( uni_1 + colI ), sol_2.getFrequency( uni_2 + colI ) );
+	}else{
+		m.GetAlignment( scratch.aln_mat );
+		const bitset_t& row_1 = scratch.aln_mat[0];
+		const bitset_t& row_2 = scratch.aln_mat[1];
+		size_t merI = 0;
+		size_t merJ = 0;
+		for( gnSeqI colI = 0; colI < aln_length; colI++ )
+		{
+			const bool res_1 = row_1.test(colI);
+			const bool res_2 = row_2.test(colI);
+			if( res_1 && res_2 )
+				score += scaleByUniqueness( subst_scoring.matrix[codes_1[merI]][codes_2[merJ]], sol_1.getFrequency( uni_1 + merI ), sol_2.getFrequency( uni_2 + merJ ) );
+			merI += res_1;
+			merJ += res_2;
+		}
+	}
+	m_score = (double)score;
+	return true;
+}
+
 
 
 
@@ -352,14 +472,16 @@ EvenFasterSumOfPairsBreakpointScorer::EvenFasterSumOfPairsBreakpointScorer(
   seqI_last(seqI_end),
   seqJ_first(seqJ_begin),
   seqJ_last(seqJ_end),
-  first_time(true)
+  first_time(true),
+  status_out(&std::cout),
+  removal_parallel_pair_min(REMOVAL_PARALLEL_PAIR_MIN)
 {
 	std::sort(tracking_matches.begin(), tracking_matches.end());
 	pairwise_lcb_count.resize( boost::extents[pairwise_adjacencies.shape()[0]][pairwise_adjacencies.shape()[1]] );
 	pairwise_lcb_score.resize( boost::extents[pairwise_adjacencies.shape()[0]][pairwise_adjacencies.shape()[1]] );;
+	pairwise_penalty.resize( boost::extents[pairwise_adjacencies.shape()[0]][pairwise_adjacencies.shape()[1]] );
 	all_id_remaps.resize( boost::extents[pairwise_lcb_count.shape()[0]][pairwise_lcb_count.shape()[1]] );
 	full_impact_list.resize( boost::extents[pairwise_lcb_count.shape()[0]][pairwise_lcb_count.shape()[1]] );
-	my_del_lcbs.resize(100);	// buffer for use during lcb removal score computation
 	for( size_t i = 0; i < 3; ++i )
 	{
 		internal_lcb_score_diff[i].resize( boost::extents[pairwise_adjacencies.shape()[0]][pairwise_adjacencies.shape()[1]] );
@@ -368,11 +490,14 @@ EvenFasterSumOfPairsBreakpointScorer::EvenFasterSumOfPairsBreakpointScorer(
 	lsd_zeros.resize( internal_lcb_score_diff[0].num_elements(), 0 );
 	lrc_zeros.resize( internal_lcb_removed_count[0].num_elements(), 0 );
 	using_lsd = -1;
-	size_t max_pair_adj_size = 0;
+	max_pair_adj_size = 0;
 	for( size_t i = 0; i < seqI_count; ++i )
 	{
 		for( size_t j = 0; j < seqJ_count; ++j )
 		{
+			double cweights = 1 - conservation_weights[i][j];
+			double bweights = 1 - bp_weights[i][j];
+			pairwise_penalty[i][j] = max( bp_penalty * cweights * cweights * cweights * cweights * bweights * bweights, min_breakpoint_penalty );
 			pairwise_lcb_count[i][j] = pairwise_adjacencies[i][j].size();
 			pairwise_lcb_score[i][j] = 0;
 			max_pair_adj_size = (std::max)(max_pair_adj_size, pairwise_adjacencies[i][j].size());
@@ -380,7 +505,7 @@ EvenFasterSumOfPairsBreakpointScorer::EvenFasterSumOfPairsBreakpointScorer(
 				pairwise_lcb_score[i][j] += pairwise_adjacencies[i][j][lcbI].weight;
 		}
 	}
-	bogus_scores.resize(max_pair_adj_size+10);
+	removal_scratch.resize(1);
 };
 
 
@@ -412,11 +537,9 @@ double EvenFasterSumOfPairsBreakpointScorer::score()
 			score += pairwise_lcb_score[seqI][seqJ];
 			// subtract breakpoint penalty
 			// subtract 1 from number of LCBs so that a single circular LCB doesn't get penalized
-			double cweights = 1 - conservation_weights[seqI][seqJ];
-			double bweights = 1 - bp_weights[seqI][seqJ];
-			double penalty = max( bp_penalty * cweights * cweights * cweights * cweights * bweights * bweights, min_breakpoint_penalty );
-			if(first_time)
-				cout << "Scoring with scaled breakpoint penalty: " << penalty << endl;
+			double penalty = pairwise_penalty[seqI][seqJ];
+			if(first_time && status_out != NULL)
+				(*status_out) << "Scoring with scaled breakpoint penalty: " << penalty << endl;
 			first_time = false;
 			score -= ( penalty * (pairwise_lcb_count[seqI][seqJ]-1));
 			if( !(score > -1e200 && score < 1e200) )
@@ -577,116 +700,25 @@ bool EvenFasterSumOfPairsBreakpointScorer::remove( pair< double, size_t >& the_m
 		deleted_tracking_matches.insert( deleted_tracking_matches.end(), matches.begin(), matches.end() );
 	}
 
-	for( size_t i = seqI_first; i < seqI_last; ++i )
+	// the pairwise alignments are independent of each other, so apply the removal to them in parallel
+	const size_t pair_count = (seqI_last - seqI_first) * (seqJ_last - seqJ_first);
+	int thread_count = 1;
+#ifdef _OPENMP
+	if( pair_count >= removal_parallel_pair_min )
+		thread_count = omp_get_max_threads();
+#endif
+	if( removal_scratch.size() < (size_t)thread_count )
+		removal_scratch.resize( thread_count );
+#pragma omp parallel for schedule(dynamic) num_threads(thread_count) if(thread_count > 1)
+	for( int pairI = 0; pairI < (int)pair_count; ++pairI )
 	{
-		for( size_t j = seqJ_first; j < seqJ_last; ++j )
-		{
-			lcb_score_diff[i][j] = 0;
-			vector< TrackingLCB< TrackingMatch* > >& adjs = pairwise_adjacencies[i][j];
-			// create a list of LCBs affected by deletion of this match
-			// check whether any of them will have all of their matches removed
-			if( lcb_ids.size() < matches.size() )
-				lcb_ids.resize( matches.size() + 100 );
-			for( size_t mI = 0; mI < matches.size(); ++mI )
-				lcb_ids[mI] = tm_lcb_id_array[matches[mI]->match_id][i][j];
-			size_t lcb_id_count = matches.size();
-			std::sort(lcb_ids.begin(), lcb_ids.begin()+lcb_id_count);
-			vector< size_t >::iterator last = std::unique(lcb_ids.begin(), lcb_ids.begin()+lcb_id_count);
-			lcb_id_count = last - lcb_ids.begin();
-			// delete the last one if its unassigned
-			if( lcb_ids[lcb_id_count-1] == LCB_UNASSIGNED )
-				lcb_id_count--;
-
-			vector< pair< size_t, vector< TrackingMatch* > > > aff_lcbs(lcb_id_count);
-			for( size_t lI = 0; lI < lcb_id_count; ++lI )
-				aff_lcbs[lI].first = lcb_ids[lI];
-
-			// organize the deleted matches
-			for( size_t mI = 0; mI < matches.size(); ++mI )
-			{
-				size_t id = tm_lcb_id_array[matches[mI]->match_id][i][j];
-				if( id == LCB_UNASSIGNED )
-					continue;
-				vector< pair< size_t, vector< TrackingMatch* > > >::iterator iter = std::lower_bound( aff_lcbs.begin(), aff_lcbs.end(), make_pair(id,vector< TrackingMatch* >() ) );
-				iter->second.push_back( matches[mI] );
-			}
-
-			// actually delete the matches and keep a list of LCBs that get completely deleted
-			size_t my_del_count = 0;
-			for( size_t lI = 0; lI < aff_lcbs.size(); ++lI )
-			{
-				vector< TrackingMatch* >& cur_matches = adjs[lcb_ids[lI]].matches;
-				size_t diff = cur_matches.size() - aff_lcbs[lI].second.size();
-				if( diff == 0 )
-				{
-					if( my_del_count + 1 >= my_del_lcbs.size() )
-						my_del_lcbs.resize(2*my_del_lcbs.size());
-					my_del_lcbs[my_del_count++] = lcb_ids[lI];
-					adjs[lcb_ids[lI]].to_be_deleted = true;
-					lcb_score_diff[i][j] += adjs[lcb_ids[lI]].weight;
-					if( really_remove )
-					{
-						adjs[lcb_ids[lI]].weight = 0;
-						cur_matches.clear();
-					}
-					continue;
-				}
-
-				// update the LCB score
-				double del_score_sum = 0;
-				for( size_t mI = 0; mI < aff_lcbs[lI].second.size(); ++mI )
-					del_score_sum += tm_score_array[aff_lcbs[lI].second[mI]->match_id][i][j];
-				lcb_score_diff[i][j] += del_score_sum;
-				full_impact_list[i][j].push_back( aff_lcbs[lI].first );
-
-				if( really_remove )
-				{
-					adjs[lcb_ids[lI]].weight -= del_score_sum;
-				
-					// remove the deleted matches
-					vector< TrackingMatch* > dest( diff );
-					std::set_difference( cur_matches.begin(), cur_matches.end(), 
-						aff_lcbs[lI].second.begin(), aff_lcbs[lI].second.end(), dest.begin() );
-					swap( dest, cur_matches );
-				}
-			}
-
-			lcb_removed_count[i][j] = 0;
-
-			// now remove each LCB that needs to be deleted
-			std::vector< std::pair< uint, uint > >& fid_remaps = all_id_remaps[i][j];
-			std::vector< uint >& fimp_list = full_impact_list[i][j];
-			for( size_t delI = 0; delI < my_del_count; ++delI )
-			{
-				if( adjs[my_del_lcbs[delI]].lcb_id != my_del_lcbs[delI] )
-					continue;	// skip this one if it's already been deleted
-
-				std::vector< std::pair< uint, uint > > id_remaps;
-				std::vector< uint > impact_list;
-				uint removed_count = RemoveLCBandCoalesce( my_del_lcbs[delI], 2, adjs, bogus_scores, id_remaps, impact_list );
-				fid_remaps.insert( fid_remaps.end(), id_remaps.begin(), id_remaps.end() );
-				fimp_list.insert( fimp_list.end(), impact_list.begin(), impact_list.end() );
-
-				lcb_removed_count[i][j] += removed_count;
-				// only do this part if we're really deleting
-				if( really_remove )
-				{
-					// move all matches to the new LCB
-					for( size_t rI = 0; rI < id_remaps.size(); ++rI )
-					{
-						if( id_remaps[rI].second == -1 )
-							continue;	// deletion
-						vector< TrackingMatch* >& src_matches = adjs[id_remaps[rI].first].matches;
-						vector< TrackingMatch* >& dest_matches = adjs[id_remaps[rI].second].matches;
-						for( size_t mI = 0; mI < src_matches.size(); ++mI )
-							tm_lcb_id_array[src_matches[mI]->match_id][i][j] = id_remaps[rI].second;
-						dest_matches.insert( dest_matches.end(), src_matches.begin(), src_matches.end() );
-						std::sort( dest_matches.begin(), dest_matches.end() );
-						src_matches.clear();
-					}
-				}
-			}
-		}
+		int threadI = 0;
+#ifdef _OPENMP
+		threadI = omp_get_thread_num();
+#endif
+		size_t i = seqI_first + pairI / (seqJ_last - seqJ_first);
+		size_t j = seqJ_first + pairI % (seqJ_last - seqJ_first);
+		removeFromPair( i, j, matches, really_remove, lcb_score_diff, lcb_removed_count, removal_scratch[threadI] );
 	}
 
 	// will be undone later
@@ -742,6 +774,107 @@ bool EvenFasterSumOfPairsBreakpointScorer::remove( pair< double, size_t >& the_m
 	return valid;
 }
 
+void EvenFasterSumOfPairsBreakpointScorer::removeFromPair( size_t i, size_t j, const vector< TrackingMatch* >& matches, bool really_remove, 
+	boost::multi_array< double, 2 >& lcb_score_diff, boost::multi_array< size_t, 2 >& lcb_removed_count, RemovalScratch& rs )
+{
+	lcb_score_diff[i][j] = 0;
+	vector< TrackingLCB< TrackingMatch* > >& adjs = pairwise_adjacencies[i][j];
+	// group the deleted matches by the LCB they belong to in this pair,
+	// keeping their original order within each LCB
+	rs.id_match.resize( matches.size() );
+	for( size_t mI = 0; mI < matches.size(); ++mI )
+		rs.id_match[mI] = make_pair( tm_lcb_id_array[matches[mI]->match_id][i][j], mI );
+	std::sort( rs.id_match.begin(), rs.id_match.end() );
+	if( rs.bogus_scores.size() < max_pair_adj_size + 10 )
+		rs.bogus_scores.resize( max_pair_adj_size + 10 );
+
+	// actually delete the matches and keep a list of LCBs that get completely deleted
+	size_t my_del_count = 0;
+	size_t groupI = 0;
+	while( groupI < rs.id_match.size() && rs.id_match[groupI].first != LCB_UNASSIGNED )
+	{
+		size_t lcb_id = rs.id_match[groupI].first;
+		size_t group_end = groupI + 1;
+		while( group_end < rs.id_match.size() && rs.id_match[group_end].first == lcb_id )
+			++group_end;
+		vector< TrackingMatch* >& cur_matches = adjs[lcb_id].matches;
+		size_t diff = cur_matches.size() - (group_end - groupI);
+		if( diff == 0 )
+		{
+			if( my_del_count + 1 >= rs.del_lcbs.size() )
+				rs.del_lcbs.resize( 2 * rs.del_lcbs.size() + 100 );
+			rs.del_lcbs[my_del_count++] = lcb_id;
+			adjs[lcb_id].to_be_deleted = true;
+			lcb_score_diff[i][j] += adjs[lcb_id].weight;
+			if( really_remove )
+			{
+				adjs[lcb_id].weight = 0;
+				cur_matches.clear();
+			}
+			groupI = group_end;
+			continue;
+		}
+
+		// update the LCB score
+		double del_score_sum = 0;
+		for( size_t gI = groupI; gI < group_end; ++gI )
+			del_score_sum += tm_score_array[matches[rs.id_match[gI].second]->match_id][i][j];
+		lcb_score_diff[i][j] += del_score_sum;
+		full_impact_list[i][j].push_back( lcb_id );
+
+		if( really_remove )
+		{
+			adjs[lcb_id].weight -= del_score_sum;
+
+			// remove the deleted matches
+			rs.lcb_matches.resize( group_end - groupI );
+			for( size_t gI = groupI; gI < group_end; ++gI )
+				rs.lcb_matches[gI - groupI] = matches[rs.id_match[gI].second];
+			vector< TrackingMatch* > dest( diff );
+			std::set_difference( cur_matches.begin(), cur_matches.end(), 
+				rs.lcb_matches.begin(), rs.lcb_matches.end(), dest.begin() );
+			swap( dest, cur_matches );
+		}
+		groupI = group_end;
+	}
+
+	lcb_removed_count[i][j] = 0;
+
+	// now remove each LCB that needs to be deleted
+	std::vector< std::pair< uint, uint > >& fid_remaps = all_id_remaps[i][j];
+	std::vector< uint >& fimp_list = full_impact_list[i][j];
+	for( size_t delI = 0; delI < my_del_count; ++delI )
+	{
+		if( adjs[rs.del_lcbs[delI]].lcb_id != rs.del_lcbs[delI] )
+			continue;	// skip this one if it's already been deleted
+
+		std::vector< std::pair< uint, uint > > id_remaps;
+		std::vector< uint > impact_list;
+		uint removed_count = RemoveLCBandCoalesce( rs.del_lcbs[delI], 2, adjs, rs.bogus_scores, id_remaps, impact_list );
+		fid_remaps.insert( fid_remaps.end(), id_remaps.begin(), id_remaps.end() );
+		fimp_list.insert( fimp_list.end(), impact_list.begin(), impact_list.end() );
+
+		lcb_removed_count[i][j] += removed_count;
+		// only do this part if we're really deleting
+		if( really_remove )
+		{
+			// move all matches to the new LCB
+			for( size_t rI = 0; rI < id_remaps.size(); ++rI )
+			{
+				if( id_remaps[rI].second == -1 )
+					continue;	// deletion
+				vector< TrackingMatch* >& src_matches = adjs[id_remaps[rI].first].matches;
+				vector< TrackingMatch* >& dest_matches = adjs[id_remaps[rI].second].matches;
+				for( size_t mI = 0; mI < src_matches.size(); ++mI )
+					tm_lcb_id_array[src_matches[mI]->match_id][i][j] = id_remaps[rI].second;
+				dest_matches.insert( dest_matches.end(), src_matches.begin(), src_matches.end() );
+				std::sort( dest_matches.begin(), dest_matches.end() );
+				src_matches.clear();
+			}
+		}
+	}
+}
+
 vector< TrackingMatch* > EvenFasterSumOfPairsBreakpointScorer::getResults() 
 {
 	std::sort(deleted_tracking_matches.begin(), deleted_tracking_matches.end());
@@ -73,6 +73,13 @@ const uint LCB_UNASSIGNED = (std::numeric_limits<uint>::max)();
 
 typedef boost::multi_array< std::vector< TrackingLCB< TrackingMatch* > >, 2 > PairwiseLCBMatrix;
 
+/**
+ * default minimum number of pairwise alignments for which a removal is applied
+ * in parallel.  Removals are serial by default because greedyBreakpointBenchmark
+ * has not yet shown the parallel removal to be faster at any number of pairs
+ */
+const size_t REMOVAL_PARALLEL_PAIR_MIN = (std::numeric_limits<size_t>::max)();
+
 
 /**
  * computes an anchoring score for the matches contained inside an LCB
@@ -399,6 +406,18 @@ const score_t INV_SCORE = (std::numeric_limits<score_t>::max)();
 void computeMatchScores( const std::string& seq1, const std::string& seq2, const PairwiseScoringScheme& scoring, std::vector<score_t>& scores );
 void computeGapScores( const std::string& seq1, const std::string& seq2, const PairwiseScoringScheme& scoring, std::vector<score_t>& scores );
 
+/**
+ * Computes the uniqueness scaled substitution score of a single pairwise match
+ * directly from the sequence residues and the match's gap pattern, without
+ * materializing the alignment.  Gap columns contribute nothing to the score.
+ * @param m_score	(output) the score of the match
+ * @return false if the match could not be scored this way, in which case the
+ *         alignment should be materialized and scored column by column
+ */
+bool GetPairwiseMatchScore( const mems::AbstractMatch& m, std::vector< genome::gnSequence* >& seq_table, 
+							const mems::PairwiseScoringScheme& subst_scoring, mems::SeedOccurrenceList& sol_1, 
+							mems::SeedOccurrenceList& sol_2, double& m_score );
+
 
 template< class MatchVector >
 double GetPairwiseAnchorScore( MatchVector& lcb, 
@@ -414,52 +433,54 @@ double GetPairwiseAnchorScore( MatchVector& lcb,
 	{
 		typedef typename MatchVector::value_type MatchPtrType;
 		MatchPtrType m = *match_iter;
-		std::vector< score_t > scores(m->AlignmentLength(), 0);
-		std::vector< std::string > et;
-		mems::GetAlignment(*m, seq_table, et);
-
-		// get substitution/gap score
-		mems::computeMatchScores( et[0], et[1], subst_scoring, scores );
-		if( penalize_gaps )
-			mems::computeGapScores( et[0], et[1], subst_scoring, scores );
-
-		// scale match scores by uniqueness
-		size_t merI = 0;
-		size_t merJ = 0;
-		double uni_count = 0;
-		double uni_score = 0;
-		const size_t m_aln_length = m->AlignmentLength();
-		const int64 m_leftend_0 = m->LeftEnd(0);
-		const int64 m_leftend_1 = m->LeftEnd(1);
-		for( size_t colI = 0; colI < m_aln_length; ++colI )
+		double m_score = 0;
+		if( penalize_gaps || !GetPairwiseMatchScore( *m, seq_table, subst_scoring, sol_1, sol_2, m_score ) )
 		{
-			if(et[0][colI] != '-' && et[1][colI] != '-' )
+			std::vector< score_t > scores(m->AlignmentLength(), 0);
+			std::vector< std::string > et;
+			mems::GetAlignment(*m, seq_table, et);
+
+			// get substitution/gap score
+			mems::computeMatchScores( et[0], et[1], subst_scoring, scores );
+			if( penalize_gaps )
+				mems::computeGapScores( et[0], et[1], subst_scoring, scores );
+
+			// scale match scores by uniqueness
+			size_t merI = 0;
+			size_t merJ = 0;
+			double uni_count = 0;
+			double uni_score = 0;
+			const size_t m_aln_length = m->AlignmentLength();
+			const int64 m_leftend_0 = m->LeftEnd(0);
+			const int64 m_leftend_1 = m->LeftEnd(1);
+			for( size_t colI = 0; colI < m_aln_length; ++colI )
 			{
-				mems::SeedOccurrenceList::frequency_type uni1 = sol_1.getFrequency(m_leftend_0 + merI - 1);
-				mems::SeedOccurrenceList::frequency_type uni2 = sol_2.getFrequency(m_leftend_1 + merJ - 1);
-				mems::SeedOccurrenceList::frequency_type uniprod = uni1*uni2;
-				uniprod = uniprod == 0 ? 1 : uniprod;
-				// scale by the uniqueness product, which approximates the number of ways to match up non-unique k-mers
-				// in the worst case of a very repetitive match, the score becomes the negative of the match score
-				if( scores[colI] > 0 )
+				if(et[0][colI] != '-' && et[1][colI] != '-' )
 				{
-					if(penalize_repeats)
-						scores[colI] = (score_t)((double)scores[colI] * (2.0 / uniprod)) - scores[colI];
-					else
-						scores[colI] = (score_t)((mems::SeedOccurrenceList::frequency_type)scores[colI] / uniprod);
+					mems::SeedOccurrenceList::frequency_type uni1 = sol_1.getFrequency(m_leftend_0 + merI - 1);
+					mems::SeedOccurrenceList::frequency_type uni2 = sol_2.getFrequency(m_leftend_1 + merJ - 1);
+					mems::SeedOccurrenceList::frequency_type uniprod = uni1*uni2;
+					uniprod = uniprod == 0 ? 1 : uniprod;
+					// scale by the uniqueness product, which approximates the number of ways to match up non-unique k-mers
+					// in the worst case of a very repetitive match, the score becomes the negative of the match score
+					if( scores[colI] > 0 )
+					{
+						if(penalize_repeats)
+							scores[colI] = (score_t)((double)scores[colI] * (2.0 / uniprod)) - scores[colI];
+						else
+							scores[colI] = (score_t)((mems::SeedOccurrenceList::frequency_type)scores[colI] / uniprod);
+					}
 				}
+				if(et[0][colI] != '-')
+					merI++;
+				if(et[1][colI] != '-')
+					merJ++;
 			}
-			if(et[0][colI] != '-')
-				merI++;
-			if(et[1][colI] != '-')
-				merJ++;
-		}
-
 
-		double m_score = 0;
-		for( size_t i = 0; i < scores.size(); ++i )
-			if( scores[i] != INV_SCORE )
-				m_score += scores[i];
+			for( size_t i = 0; i < scores.size(); ++i )
+				if( scores[i] != INV_SCORE )
+					m_score += scores[i];
+		}
 
 		if( !( m_score > -1000000000 && m_score < 1000000000 ) )
 		{
@@ -535,7 +556,32 @@ public:
 	/** sanity checks all internal data structures */
 	bool validate();
 
+	/** sets the stream that status messages get written to, NULL for none.  defaults to std::cout */
+	void setStatusOut( std::ostream* status_out ){ this->status_out = status_out; }
+
+	/** sets the minimum number of pairwise alignments for which a removal is applied in parallel */
+	void setRemovalParallelPairMin( size_t pair_min ){ removal_parallel_pair_min = pair_min; }
+
 protected:
+	/**
+	 * Scratch space used by one thread while it applies a removal to some of the
+	 * pairwise alignments
+	 */
+	struct RemovalScratch
+	{
+		std::vector< std::pair< size_t, size_t > > id_match;	/**< pairwise LCB id and index of each deleted match */
+		std::vector< TrackingMatch* > lcb_matches;	/**< deleted matches belonging to a single pairwise LCB */
+		std::vector< size_t > del_lcbs;	/**< pairwise LCBs that lose all of their matches */
+		std::vector< double > bogus_scores;
+	};
+
+	/**
+	 * Applies deletion of a set of matches to the pairwise alignment of seqI and seqJ.
+	 * Touches only data belonging to that pair, so different pairs may be processed concurrently.
+	 */
+	void removeFromPair( size_t seqI, size_t seqJ, const std::vector< TrackingMatch* >& matches, bool really_remove,
+		boost::multi_array< double, 2 >& lcb_score_diff, boost::multi_array< size_t, 2 >& lcb_removed_count, RemovalScratch& rs );
+
 	double bp_penalty;
 	boost::multi_array<double,2> bp_weights;
 	boost::multi_array<double,2> conservation_weights;
@@ -546,6 +592,7 @@ protected:
 
 	boost::multi_array< size_t, 2 > pairwise_lcb_count;
 	boost::multi_array< double, 2 > pairwise_lcb_score;
+	boost::multi_array< double, 2 > pairwise_penalty;	/**< the scaled breakpoint penalty for each pair of sequences */
 
 	std::vector< TrackingMatch* > deleted_tracking_matches;
 
@@ -564,9 +611,8 @@ private:
 	int using_lsd;
 	std::vector< double > lsd_zeros;
 	std::vector< size_t > lrc_zeros;
-	std::vector< double > bogus_scores;
-	std::vector< size_t > my_del_lcbs;
-	std::vector< size_t > lcb_ids;
+	std::vector< RemovalScratch > removal_scratch;	/**< one per thread */
+	size_t max_pair_adj_size;
 
 	boost::multi_array< double, 3 >& tm_score_array;
 	boost::multi_array< size_t, 3 >& tm_lcb_id_array;
@@ -579,6 +625,8 @@ private:
 
 	// for debugging
 	bool first_time;
+	std::ostream* status_out;
+	size_t removal_parallel_pair_min;
 };
 
 
@@ -586,7 +634,7 @@ template< class BreakpointScorerType >
 int64 greedyBreakpointElimination_v4( std::vector< mems::LCB >& adjacencies, std::vector< double >& scores, BreakpointScorerType& bp_scorer, std::ostream* status_out, size_t g1_tag = 0, size_t g2_tag = 0 );
 
 template< class SearchScorer >
-double greedySearch( SearchScorer& spbs );
+double greedySearch( SearchScorer& spbs, std::ostream* status_out = &std::cout );
 
 
 /**
@@ -757,9 +805,12 @@ int64 greedyBreakpointElimination_v4( std::vector< mems::LCB >& adjacencies,
 
 extern bool debug_aligner;
 
-/** finds the best anchoring, returns the anchoring score */
+/**
+ * finds the best anchoring, returns the anchoring score
+ * @param status_out	progress gets written here, or nowhere when NULL
+ */
 template< class SearchScorer >
-double greedySearch( SearchScorer& spbs )
+double greedySearch( SearchScorer& spbs, std::ostream* status_out )
 {
 	double prev_score = spbs.score();
 	uint report_frequency = 10;
@@ -851,7 +902,8 @@ double greedySearch( SearchScorer& spbs )
 		moves_made++;
 		prev_progress = progress;
 		progress = (100 * moves_made) / move_count;
-		printProgress( prev_progress, progress, std::cout );
+		if( status_out != NULL )
+			printProgress( prev_progress, progress, *status_out );
 //		if( moves_made % report_frequency == 0 )
 //			cout << "move: " << moves_made << " alignment score " << cur_score << " success ratio " << successful / invalids << endl;
 	}
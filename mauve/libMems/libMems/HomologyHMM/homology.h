@@ -43,8 +43,24 @@ struct Params;
 
 //void run(std::string& sequence, std::string& prediction, double goHomologous = 0.004, double goUnrelated = 0.004, std::vector<double>* emitHomologous = NULL, std::vector<double>* emitUnrelated = NULL);
 
+/**
+ * Predicts which sites of a sequence of site patterns are homologous, using a
+ * forward-backward kernel specialized to this two state model.
+ */
 void run(std::string& sequence, std::string& prediction, const Params& params );
 
+/**
+ * Predicts homologous sites for many sequences at once.  The recurrences of
+ * several sequences are interleaved, which is much faster than one at a time.
+ */
+void run(std::vector< std::string >& sequences, std::vector< std::string >& predictions, const Params& params );
+
+/**
+ * Reference implementation of run() using the HMMoC generated Forward and
+ * Backward algorithms.  Kept for regression testing of the specialized kernel.
+ */
+void runGeneric(std::string& sequence, std::string& prediction, const Params& params );
+
 // Here go the state memory clique typedefs:
 typedef States<bfloat,2> Statesblock2;
 typedef States<bfloat,1> Statesblock1;
@@ -20,8 +20,172 @@
 #include <cstring>
 #include "homology.h"
 
+// posterior probability of the homologous state above which a site is predicted homologous
+static const double HOMOLOGOUS_POSTERIOR_THRESHOLD = 0.9;
+
+// number of sequences whose recurrences are interleaved by the specialized kernel
+static const int HOMOLOGY_LANES = 4;
+
+/**
+ * Transition probabilities premultiplied with the emission probability of the
+ * destination state, indexed by site pattern ('1'..'8' as 0..7).  These are the
+ * only coefficients the two state recurrences need.
+ */
+struct HomologyCoefficients
+{
+  double aHH[8];  /**< homologous -> homologous, emitting from homologous */
+  double aUH[8];  /**< unrelated -> homologous, emitting from homologous */
+  double aHU[8];  /**< homologous -> unrelated, emitting from unrelated */
+  double aUU[8];  /**< unrelated -> unrelated, emitting from unrelated */
+  double aStartH[8];  /**< start -> homologous, emitting from homologous */
+  double aStartU[8];  /**< start -> unrelated, emitting from unrelated */
+  double iStopH;
+  double iStopU;
+
+  HomologyCoefficients( const Params& iPar )
+  {
+    double iStayH = 1.0 - iPar.iGoUnrelated - iPar.iGoStopFromHomologous;
+    double iStayU = 1.0 - iPar.iGoHomologous - iPar.iGoStopFromUnrelated;
+    for( int i = 0; i < 8; i++ )
+    {
+      aHH[i] = iStayH * iPar.aEmitHomologous[i];
+      aUH[i] = iPar.iGoHomologous * iPar.aEmitHomologous[i];
+      aHU[i] = iPar.iGoUnrelated * iPar.aEmitUnrelated[i];
+      aUU[i] = iStayU * iPar.aEmitUnrelated[i];
+      aStartH[i] = iPar.iStartHomologous * iPar.aEmitHomologous[i];
+      aStartU[i] = (1.0 - iPar.iStartHomologous) * iPar.aEmitUnrelated[i];
+    }
+    iStopH = iPar.iGoStopFromHomologous;
+    iStopU = iPar.iGoStopFromUnrelated;
+  }
+};
+
+/**
+ * Scaled forward-backward over up to HOMOLOGY_LANES sequences at once.
+ * Forward values are normalized to sum to one at every site and the backward
+ * values are scaled by the same factors, so the posterior of a site is simply
+ * the product of its scaled forward and backward values.  The lanes are
+ * independent dependency chains, interleaving them keeps the FP pipeline full.
+ */
+static void posteriorLanes( const HomologyCoefficients& co, const char* const* aSeq, const int* aLen, int iLanes,
+                            double* const* aFwd, double* const* aScale, char* const* aPrediction )
+{
+  int iMaxLen = 0;
+  for (int k=0; k<iLanes; k++)
+    iMaxLen = aLen[k] > iMaxLen ? aLen[k] : iMaxLen;
+
+  double fH[HOMOLOGY_LANES], fU[HOMOLOGY_LANES];
+  for (int k=0; k<iLanes; k++) {
+    if (aLen[k] == 0) continue;
+    int x = aSeq[k][0] - '1';
+    double uH = co.aStartH[x];
+    double uU = co.aStartU[x];
+    double c = 1.0 / (uH + uU);
+    fH[k] = uH * c;
+    fU[k] = uU * c;
+    aFwd[k][0] = fH[k];
+    aScale[k][0] = c;
+  }
+  for (int i=1; i<iMaxLen; i++) {
+    for (int k=0; k<iLanes; k++) {
+      if (i >= aLen[k]) continue;
+      int x = aSeq[k][i] - '1';
+      double uH = co.aHH[x] * fH[k] + co.aUH[x] * fU[k];
+      double uU = co.aHU[x] * fH[k] + co.aUU[x] * fU[k];
+      double c = 1.0 / (uH + uU);
+      fH[k] = uH * c;
+      fU[k] = uU * c;
+      aFwd[k][i] = fH[k];
+      aScale[k][i] = c;
+    }
+  }
+
+  // backward pass, aligned on the last site of each lane
+  double bH[HOMOLOGY_LANES], bU[HOMOLOGY_LANES];
+  for (int k=0; k<iLanes; k++) {
+    if (aLen[k] == 0) continue;
+    int i = aLen[k] - 1;
+    double iEnd = 1.0 / (fH[k] * co.iStopH + fU[k] * co.iStopU);
+    bH[k] = co.iStopH * iEnd;
+    bU[k] = co.iStopU * iEnd;
+    aPrediction[k][i] = aFwd[k][i] * bH[k] >= HOMOLOGOUS_POSTERIOR_THRESHOLD ? 'H' : 'N';
+  }
+  for (int j=1; j<iMaxLen; j++) {
+    for (int k=0; k<iLanes; k++) {
+      int i = aLen[k] - 1 - j;
+      if (i < 0) continue;
+      int x = aSeq[k][i+1] - '1';
+      double c = aScale[k][i+1];
+      double nH = (co.aHH[x] * bH[k] + co.aHU[x] * bU[k]) * c;
+      double nU = (co.aUH[x] * bH[k] + co.aUU[x] * bU[k]) * c;
+      bH[k] = nH;
+      bU[k] = nU;
+      aPrediction[k][i] = aFwd[k][i] * nH >= HOMOLOGOUS_POSTERIOR_THRESHOLD ? 'H' : 'N';
+    }
+  }
+}
+
+struct LengthGreater
+{
+  LengthGreater( const std::vector< std::string >& s ) : seqs(s) {}
+  bool operator()( size_t a, size_t b ) const { return seqs[a].size() > seqs[b].size(); }
+  const std::vector< std::string >& seqs;
+};
+
+void run(std::vector< std::string >& sequences, std::vector< std::string >& predictions, const Params& params )
+{
+  HomologyCoefficients co(params);
+  predictions.resize(sequences.size());
+
+  // group sequences of similar length so that lanes finish together
+  std::vector< size_t > order(sequences.size());
+  for (size_t i=0; i<order.size(); i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), LengthGreater(sequences));
+
+  std::vector< double > fwd[HOMOLOGY_LANES];
+  std::vector< double > scale[HOMOLOGY_LANES];
+  for (size_t oI=0; oI<order.size(); oI+=HOMOLOGY_LANES) {
+    const char* aSeq[HOMOLOGY_LANES];
+    int aLen[HOMOLOGY_LANES];
+    double* aFwd[HOMOLOGY_LANES];
+    double* aScale[HOMOLOGY_LANES];
+    char* aPrediction[HOMOLOGY_LANES];
+    int iLanes = 0;
+    for (; iLanes<HOMOLOGY_LANES && oI+iLanes<order.size(); iLanes++) {
+      size_t sI = order[oI+iLanes];
+      aSeq[iLanes] = sequences[sI].data();
+      aLen[iLanes] = (int)sequences[sI].size();
+      predictions[sI].resize(aLen[iLanes]);
+      if (fwd[iLanes].size() < sequences[sI].size()) {
+        fwd[iLanes].resize(sequences[sI].size());
+        scale[iLanes].resize(sequences[sI].size());
+      }
+      aFwd[iLanes] = aLen[iLanes] > 0 ? &fwd[iLanes][0] : NULL;
+      aScale[iLanes] = aLen[iLanes] > 0 ? &scale[iLanes][0] : NULL;
+      aPrediction[iLanes] = aLen[iLanes] > 0 ? &predictions[sI][0] : NULL;
+    }
+    posteriorLanes(co, aSeq, aLen, iLanes, aFwd, aScale, aPrediction);
+  }
+}
 
 void run(std::string& sequence, std::string& prediction, const Params& params ) 
+{
+  HomologyCoefficients co(params);
+  int iLen = sequence.length();
+  prediction.resize(iLen);
+  if (iLen == 0)
+    return;
+  std::vector< double > fwd(iLen);
+  std::vector< double > scale(iLen);
+  const char* aSeq[1] = { sequence.data() };
+  double* aFwd[1] = { &fwd[0] };
+  double* aScale[1] = { &scale[0] };
+  char* aPrediction[1] = { &prediction[0] };
+  posteriorLanes(co, aSeq, &iLen, 1, aFwd, aScale, aPrediction);
+}
+
+void runGeneric(std::string& sequence, std::string& prediction, const Params& params ) 
 {
 
   // The parameters of the model
@@ -47,7 +211,7 @@ void run(std::string& sequence, std::string& prediction, const Params& params )
 
     double iPosterior = pFWDP->getProb("homologous",i+1)*pBWDP->getProb("homologous",i+1)/iFWProb;
 //    if (iViterbiPath.toState(i) == iVHomologous) {
-    if (iPosterior >= 0.9) {
+    if (iPosterior >= HOMOLOGOUS_POSTERIOR_THRESHOLD) {
       prediction[i] = 'H';
     } else {
       prediction[i] = 'N';
@@ -158,8 +158,11 @@ public:
 	const std::vector<AbstractMatch*>& GetMatches() const{ return matches; }
 	void StealMatches( std::vector<AbstractMatch*>& matches );
 
-	/** marbles the gaps so that no sequence has more than "size" contiguous gaps */
-	void Marble( gnSeqI size );
+	/**
+	 * marbles the gaps so that no sequence has more than "size" contiguous gaps
+	 * @param ts	the random number stream to draw from, or NULL for the shared one
+	 */
+	void Marble( gnSeqI size, TwisterState* ts = NULL );
 
 	void GetColumn( gnSeqI col, std::vector<gnSeqI>& pos, std::vector<bool>& column ) const;
 	
@@ -409,7 +412,7 @@ void AddGapMatches( ListType& the_list, const Iter& first, const Iter& last,
 
 // The best steaks are well marbled
 template<class GappedBaseImpl>
-void GenericInterval<GappedBaseImpl>::Marble( gnSeqI size )
+void GenericInterval<GappedBaseImpl>::Marble( gnSeqI size, TwisterState* ts )
 {
 	if( this->SeqCount() > 2 )
 		throw "I can't handle that many at once\n";
@@ -485,7 +488,7 @@ void GenericInterval<GappedBaseImpl>::Marble( gnSeqI size )
 			break;
 		// sample from a binomial with p(success) = diff1 / diff1+diff2
 //		double samp = ((double)rand())/((double)RAND_MAX);
-		double samp = RandTwisterDouble();
+		double samp = ts == NULL ? RandTwisterDouble() : RandTwisterStateDouble( ts );
 		// add one of the intervals and move on to the next...
 		if( diff2 == 0 || (samp < .5 && diff1 > 0) )
 		{
@@ -22,4 +22,96 @@ using namespace std;
 using namespace genome;
 namespace mems {
 
+static void appendNumber( string& str, int64 number ){
+	char digits[24];
+	int digitI = sizeof(digits);
+	uint64 value = number < 0 ? -(uint64)number : number;
+	do{
+		digits[ --digitI ] = '0' + (char)(value % 10);
+		value /= 10;
+	}while( value > 0 );
+	if( number < 0 )
+		digits[ --digitI ] = '-';
+	str.append( digits + digitI, sizeof(digits) - digitI );
+}
+
+void RenderStandardAlignmentBlock( const AbstractMatch& iv, const vector< gnSequence* >& seq_table, 
+								  const vector< string >& seq_names, bool write_empty, string& block ){
+	vector< bitset_t > aln_mat;
+	iv.GetAlignment( aln_mat );
+	const size_t aln_length = aln_mat[0].size();
+	// without sequences, the residues come from the alignment the interval was read with
+	const vector< string >* stored_aln = NULL;
+	if( seq_table.size() == 0 ){
+		stored_aln = GetStoredAlignment( iv );
+		if( stored_aln == NULL )
+			Throw_gnExMsg( NullPointer(), "Sequences must be loaded to write this alignment.\n" );
+	}
+	string cur_seq;
+	for( uint seqI = 0; seqI < iv.SeqCount(); seqI++ ){
+		int64 startI = iv.Start( seqI );
+		gnSeqI length = iv.Length( seqI );
+		// if this genome doesn't have any sequence in this
+		// interval then skip it...
+		if( startI == 0 && !write_empty )	// kludge: write all seqs into the first interval so java parser can read it
+			continue;
+		block += "> ";
+		appendNumber( block, seqI + 1 );
+		block += ':';
+		if( startI > 0 ){
+			appendNumber( block, absolut( startI ) );
+			block += '-';
+			appendNumber( block, absolut( startI ) + length - 1 );
+			block += " + ";
+		}else if(startI == 0){
+			block += "0-0 + ";
+		}else{
+			appendNumber( block, absolut( startI ) );
+			block += '-';
+			appendNumber( block, absolut( startI ) + length - 1 );
+			block += " - ";
+		}
+		block += seq_names[ seqI ];
+		block += '\n';
+
+		// fill the row in place, breaking lines every 80 columns
+		const bool has_seq = iv.LeftEnd( seqI ) != NO_MATCH;
+		if( has_seq && stored_aln != NULL ){
+			const string& aln_row = (*stored_aln)[ seqI ];
+			cur_seq.clear();
+			for( size_t colI = 0; colI < aln_length; colI++ )
+				if( aln_mat[ seqI ].test( colI ) )
+					cur_seq += aln_row[ colI ];
+		}else if( has_seq && iv.Orientation( seqI ) == AbstractMatch::reverse ){
+			seq_table[ seqI ]->ToReverseComplement( cur_seq, length, iv.LeftEnd( seqI ) );
+		}else if( has_seq ){
+			seq_table[ seqI ]->ToString( cur_seq, length, iv.LeftEnd( seqI ) );
+		}
+		const bitset_t& row = aln_mat[ seqI ];
+		size_t row_start = block.size();
+		block.resize( row_start + aln_length + (aln_length + 79) / 80 );
+		char* row_out = &block[ row_start ];
+		size_t cI = 0;
+		for( size_t colI = 0; colI < aln_length; colI++ ){
+			*row_out++ = has_seq && row.test( colI ) ? cur_seq[ cI++ ] : '-';
+			if( colI % 80 == 79 || colI + 1 == aln_length )
+				*row_out++ = '\n';
+		}
+	}
+	block += "=\n";
+}
+
+const vector< string >* GetStoredAlignment( const AbstractMatch& iv ){
+	const GappedAlignment* ga = dynamic_cast< const GappedAlignment* >( &iv );
+	if( ga != NULL )
+		return &GetAlignment( *ga, vector< gnSequence* >() );
+	const Interval* interval = dynamic_cast< const Interval* >( &iv );
+	if( interval == NULL || interval->GetMatches().size() != 1 )
+		return NULL;
+	ga = dynamic_cast< const GappedAlignment* >( interval->GetMatches()[0] );
+	if( ga == NULL )
+		return NULL;
+	return &GetAlignment( *ga, vector< gnSequence* >() );
+}
+
 }
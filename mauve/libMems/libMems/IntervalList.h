@@ -14,7 +14,9 @@
 #endif
 
 #include <iostream>
+#include <fstream>
 #include <list>
+#include <map>
 #include <sstream>
 
 #include "libMems/SortedMerList.h"
@@ -22,6 +24,8 @@
 #include "libMems/Interval.h"
 #include "libMems/MemHash.h"
 #include "libMems/CompactGappedAlignment.h"
+#include "libMems/XmfaIndex.h"
+#include "libMems/BinaryAlignment.h"
 #include "libGenome/gnSourceFactory.h"
 #include "libGenome/gnFASSource.h"
 #include "libGenome/gnSEQSource.h"
@@ -30,6 +34,28 @@
 
 namespace mems {
 
+/** approximate number of alignment columns times rows that WriteStandardAlignment renders at once */
+const uint64 XMFA_WRITE_BATCH_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Renders one aligned region in the standard (XMFA) format: a defline and 80 column
+ * rows for each sequence followed by the '=' terminator.  Rows are filled straight from
+ * the region's gap pattern without building the alignment strings.
+ * @param iv			The aligned region
+ * @param seq_table		The sequences of each row of iv
+ * @param seq_names		The sequence name written on the defline of each row
+ * @param write_empty	Whether to write rows for sequences that are not part of iv
+ * @param block			(output) The rendered region is appended to this string
+ */
+void RenderStandardAlignmentBlock( const AbstractMatch& iv, const std::vector< genome::gnSequence* >& seq_table, 
+								  const std::vector< std::string >& seq_names, bool write_empty, std::string& block );
+
+/**
+ * @return the rows of a GappedAlignment or of an interval read from an alignment file,
+ * which holds a single GappedAlignment, or NULL for any other kind of interval
+ */
+const std::vector< std::string >* GetStoredAlignment( const AbstractMatch& iv );
+
 /**
  * This class represents a set Intervals, each of which is a collinear aligned region
  * There are functions to read and write an GenericIntervalList.
@@ -70,9 +96,38 @@ public:
 	void WriteAlignedSequences(std::ostream& match_file) const;
 	
 	/**
-	 *	Writes a gapped alignment of sequences in a standard format
+	 *	Writes a gapped alignment of sequences in a standard format.  Aligned regions
+	 *	are rendered concurrently in batches and written in order.  When no sequences
+	 *	are loaded, residues come from the intervals' stored alignments.
+	 *	@param batch_size	approximate number of alignment columns times rows to render at once
+	 *	@return the number of bytes written
+	 *	@see GetStoredAlignment
+	 */
+	uint64 WriteStandardAlignment( std::ostream& out_file, uint64 batch_size = XMFA_WRITE_BATCH_SIZE ) const;
+
+	/**
+	 *	Writes the header of the standard alignment format.  Followed by calls to
+	 *	WriteStandardAlignmentBlock() this writes an alignment one region at a time.
+	 *	@return the number of bytes written
+	 */
+	uint64 WriteStandardAlignmentHeader( std::ostream& out_file ) const;
+
+	/**
+	 *	Writes one aligned region in the standard format
+	 *	@param iv		The aligned region, with rows for the sequences in seq_table
+	 *	@param first	Whether iv is the first region of the alignment, which gets a row for every sequence
+	 *	@return the number of bytes written
+	 */
+	uint64 WriteStandardAlignmentBlock( std::ostream& out_file, const AbstractMatch& iv, bool first ) const;
+
+	/**
+	 *	Writes the alignment in the Mauve binary alignment format.  Residues are taken
+	 *	from seq_table or, when no sequences are loaded, from the intervals' stored alignments.
+	 *	@param write_residues	Whether to store residues along with the gap patterns
+	 *	@return the number of bytes written
+	 *	@see BinaryAlignment
 	 */
-	void WriteStandardAlignment( std::ostream& out_file ) const;
+	uint64 WriteBinaryAlignment( std::ostream& out_file, bool write_residues ) const;
 
     /**
 	 *	Writes a gapped alignment of sequences in xml format
@@ -89,12 +144,51 @@ public:
 	 * and stores them in CompactGappedAlignments<>
 	 */
 	void ReadStandardAlignmentCompact( std::istream& in_stream );
+
+	/**
+	 * Reads an alignment in the Mauve binary alignment format.  Blocks are stored in
+	 * GappedAlignments when the file has residues, as ReadStandardAlignment() does,
+	 * and in CompactGappedAlignments<> otherwise.
+	 * @see BinaryAlignment
+	 */
+	void ReadBinaryAlignment( const std::string& fname );
+
+	/**
+	 * Opens an xmfa file for random access.  The list gets one empty interval per
+	 * block, and LoadInterval() reads blocks on demand.  Block locations come from
+	 * the alignment's index, which is built and saved next to the alignment when it
+	 * is missing or out of date.
+	 * @see XmfaIndex
+	 */
+	void OpenIndexedAlignment( const std::string& xmfa_fname );
+
+	/**
+	 * @return interval ivI, which is first read from the file given to
+	 * OpenIndexedAlignment() if it has not been loaded yet
+	 */
+	MatchType& LoadInterval( size_t ivI );
+
+	/** @return the index of the file given to OpenIndexedAlignment() */
+	const XmfaIndex& GetIndex() const { return xmfa_index; }
 	
 	std::vector<std::string> seq_filename;	/**< The names of files associated with the sequences used by this alignment */
 	std::vector<genome::gnSequence*> seq_table;	/**< The actual sequences used in this alignment */
 
 	std::string backbone_filename;	/**< The name of an associated backbone file, or empty if none exists */
 protected:
+	std::string indexed_filename;	/**< The xmfa file that intervals are loaded from on demand */
+	XmfaIndex xmfa_index;	/**< Block locations in indexed_filename */
+	std::vector< bool > interval_loaded;	/**< Whether each interval has been read from indexed_filename */
+
+	/** @return true if all sequences come from a single file */
+	bool SingleInputFile() const;
+	/** @return the name written on the defline of each of seq_count sequences */
+	std::vector< std::string > StandardAlignmentNames( uint seq_count ) const;
+	/**
+	 * @return a copy of cr with a row for each of seq_count genomes.  Rows that
+	 * cr lacks or leaves empty are filled with gaps.  The caller frees the copy.
+	 */
+	GappedAlignment* PadAlignmentRows( const GappedAlignment& cr, uint seq_count ) const;
 
 };
 
@@ -113,6 +207,9 @@ GenericIntervalList<MatchType>& GenericIntervalList<MatchType>::operator=( const
 	std::vector< MatchType >::operator=( ml );
 	seq_filename = ml.seq_filename;
 	seq_table = ml.seq_table;
+	indexed_filename = ml.indexed_filename;
+	xmfa_index = ml.xmfa_index;
+	interval_loaded = ml.interval_loaded;
 	return *this;
 }
 
@@ -125,6 +222,8 @@ void GenericIntervalList<MatchType>::Clear()
 	}
 	seq_filename.clear();
 	this->clear();
+	indexed_filename.clear();
+	interval_loaded.clear();
 }
 
 template< class MatchType >
@@ -350,96 +449,297 @@ void GenericIntervalList<MatchType>::WriteXMLAlignment( std::ostream& out_file )
 }
 
 template< class MatchType >
-void GenericIntervalList<MatchType>::WriteStandardAlignment( std::ostream& out_file ) const 
+bool GenericIntervalList<MatchType>::SingleInputFile() const 
 {
-	if( this->size() == 0 )
-		return;
+	for( uint seqI = 1; seqI < seq_filename.size(); seqI++ )
+		if( seq_filename[ 0 ] != seq_filename[ seqI ] )
+			return false;
+	return true;
+}
 
+template< class MatchType >
+std::vector< std::string > GenericIntervalList<MatchType>::StandardAlignmentNames( uint seq_count ) const 
+{
+	// the sequence filename is written as the seq name
+	boolean single_input = SingleInputFile();
+	std::vector< std::string > seq_names( seq_count );
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		if( single_input && seq_filename.size() > 0 )
+			seq_names[ seqI ] = seq_filename[ 0 ];
+		else if( seqI < seq_filename.size() )
+			seq_names[ seqI ] = seq_filename[ seqI ];
+	}
+	return seq_names;
+}
+
+template< class MatchType >
+uint64 GenericIntervalList<MatchType>::WriteStandardAlignmentHeader( std::ostream& out_file ) const 
+{
 //	unsigned int seq_count = seq_table.size();
 	uint seqI = 0;
+	std::stringstream header;
 	
 	// write out the format version
-	out_file << "#FormatVersion Mauve1" << std::endl;
+	header << "#FormatVersion Mauve1\n";
 	
 	// write source sequence filenames and formats
 	// to make Paul happy
-	boolean single_input = true;
-	for( seqI = 1; seqI < seq_filename.size(); seqI++ ){
-		if( seq_filename[ 0 ] != seq_filename[ seqI ] ){
-			single_input = false;
-			break;
-		}
-	}
+	boolean single_input = SingleInputFile();
+	std::map< std::string, genome::gnBaseSource* > file_sources;
 	for( seqI = 0; seqI < seq_filename.size(); seqI++ ){
-		out_file << "#Sequence" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
+		header << "#Sequence" << seqI + 1 << "File\t" << seq_filename[ seqI ] << '\n';
 		if( single_input )
-			out_file << "#Sequence" << seqI + 1 << "Entry\t" << seqI + 1 << std::endl;
+			header << "#Sequence" << seqI + 1 << "Entry\t" << seqI + 1 << '\n';
 		
-		genome::gnSourceFactory* sf = genome::gnSourceFactory::GetSourceFactory();
-		genome::gnBaseSource* gnbs = sf->MatchSourceClass( seq_filename[ seqI ] );
+		// the source class only depends on the file name
+		std::map< std::string, genome::gnBaseSource* >::iterator source_iter = file_sources.find( seq_filename[ seqI ] );
+		if( source_iter == file_sources.end() ){
+			genome::gnSourceFactory* sf = genome::gnSourceFactory::GetSourceFactory();
+			source_iter = file_sources.insert( std::make_pair( seq_filename[ seqI ], sf->MatchSourceClass( seq_filename[ seqI ] ) ) ).first;
+		}
+		genome::gnBaseSource* gnbs = source_iter->second;
 		genome::gnFASSource* gnfs = dynamic_cast< genome::gnFASSource* >(gnbs);
 		genome::gnRAWSource* gnrs = dynamic_cast< genome::gnRAWSource* >(gnbs);
 		genome::gnSEQSource* gnss = dynamic_cast< genome::gnSEQSource* >(gnbs);
 		genome::gnGBKSource* gngs = dynamic_cast< genome::gnGBKSource* >(gnbs);
 		if( gnfs != NULL )
-			out_file << "#Sequence" << seqI + 1 << "Format\tFastA" << std::endl;
+			header << "#Sequence" << seqI + 1 << "Format\tFastA\n";
 		else if( gnrs != NULL )
-			out_file << "#Sequence" << seqI + 1 << "Format\traw" << std::endl;
+			header << "#Sequence" << seqI + 1 << "Format\traw\n";
 		else if( gnss != NULL ){
-			out_file << "#Sequence" << seqI + 1 << "Format\tDNAstar" << std::endl;
-			out_file << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
-			out_file << "#Annotation" << seqI + 1 << "Format\tDNAstar" << std::endl;
+			header << "#Sequence" << seqI + 1 << "Format\tDNAstar\n";
+			header << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << '\n';
+			header << "#Annotation" << seqI + 1 << "Format\tDNAstar\n";
 		}else if( gngs != NULL ){
-			out_file << "#Sequence" << seqI + 1 << "Format\tGenBank" << std::endl;
-			out_file << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
-			out_file << "#Annotation" << seqI + 1 << "Format\tGenBank" << std::endl;
+			header << "#Sequence" << seqI + 1 << "Format\tGenBank\n";
+			header << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << '\n';
+			header << "#Annotation" << seqI + 1 << "Format\tGenBank\n";
 		}
 	}
 
 	if( this->backbone_filename != "" )
-		out_file << "#BackboneFile\t" << this->backbone_filename << std::endl;
-	
-	for( uint ivI = 0; ivI < this->size(); ivI++ ){
-		if( (*this)[ ivI ].AlignmentLength() == 0 ){
-			continue;
+		header << "#BackboneFile\t" << this->backbone_filename << '\n';
+	std::string header_str = header.str();
+	out_file.write( header_str.data(), header_str.size() );
+	return header_str.size();
+}
+
+template< class MatchType >
+uint64 GenericIntervalList<MatchType>::WriteStandardAlignmentBlock( std::ostream& out_file, const AbstractMatch& iv, bool first ) const 
+{
+	if( iv.AlignmentLength() == 0 )
+		return 0;
+	std::string block;
+	std::vector< std::string > seq_names = StandardAlignmentNames( iv.SeqCount() );
+	// regions of a single sequence aligned to itself
+	if( seq_table.size() == 1 && seq_table.size() != iv.SeqCount() )
+		RenderStandardAlignmentBlock( iv, std::vector<genome::gnSequence*>( iv.SeqCount(), seq_table[0] ), seq_names, first, block );
+	else
+		RenderStandardAlignmentBlock( iv, seq_table, seq_names, first, block );
+	out_file.write( block.data(), block.size() );
+	return block.size();
+}
+
+template< class MatchType >
+uint64 GenericIntervalList<MatchType>::WriteStandardAlignment( std::ostream& out_file, uint64 batch_size ) const 
+{
+	if( this->size() == 0 )
+		return 0;
+
+	uint64 bytes_written = WriteStandardAlignmentHeader( out_file );
+
+	uint max_seq_count = 0;
+	for( uint ivI = 0; ivI < this->size(); ivI++ )
+		max_seq_count = (std::max)( max_seq_count, (*this)[ ivI ].SeqCount() );
+	std::vector< std::string > seq_names = StandardAlignmentNames( max_seq_count );
+
+	// without sequences every region must supply its own residues
+	if( seq_table.size() == 0 )
+		for( size_t ivI = 0; ivI < this->size(); ivI++ )
+			if( (*this)[ ivI ].AlignmentLength() > 0 && GetStoredAlignment( (*this)[ ivI ] ) == NULL )
+				Throw_gnExMsg( genome::NullPointer(), "Sequences must be loaded to write this alignment.\n" );
+
+	// render batches of regions concurrently, then write them out in order
+	std::vector< std::string > blocks;
+	// reading residues can throw, which must not escape the parallel loop.
+	// the first region that failed gets its exception rethrown after the loop
+	int failed_ivI = -1;
+	std::vector< genome::gnException > failure;
+	for( size_t batch_start = 0; batch_start < this->size(); ){
+		size_t batch_end = batch_start;
+		uint64 batch_cells = 0;
+		for( ; batch_end < this->size() && (batch_end == batch_start || batch_cells < batch_size); batch_end++ )
+			batch_cells += (*this)[ batch_end ].AlignmentLength() * (*this)[ batch_end ].SeqCount();
+		blocks.resize( batch_end - batch_start );
+
+#pragma omp parallel for schedule(dynamic) if( batch_end - batch_start > 1 )
+		for( int ivI = (int)batch_start; ivI < (int)batch_end; ivI++ ){
+			std::string& block = blocks[ ivI - batch_start ];
+			block.clear();
+			const MatchType& iv = (*this)[ ivI ];
+			if( iv.AlignmentLength() == 0 )
+				continue;
+			try{
+				// regions of a single sequence aligned to itself
+				if( seq_table.size() == 1 && seq_table.size() != iv.SeqCount() )
+					RenderStandardAlignmentBlock( iv, std::vector<genome::gnSequence*>( iv.SeqCount(), seq_table[0] ), seq_names, ivI == 0, block );
+				else
+					RenderStandardAlignmentBlock( iv, seq_table, seq_names, ivI == 0, block );
+			}catch( genome::gnException& gne ){
+#pragma omp critical(WriteStandardAlignment_failure)
+				if( failed_ivI == -1 || ivI < failed_ivI ){
+					failed_ivI = ivI;
+					failure.clear();
+					failure.push_back( gne );
+				}
+			}
 		}
-		std::vector<std::string> alignment;
-		if( seq_table.size() == 1 && seq_table.size() != (*this)[ ivI ].SeqCount() )
-		{
-			GetAlignment( (*this)[ ivI ], std::vector<genome::gnSequence*>((*this)[ ivI ].SeqCount(), seq_table[0]), alignment );
-		}else
-			GetAlignment( (*this)[ ivI ], seq_table, alignment );
-		for( seqI = 0; seqI < (*this)[ ivI ].SeqCount(); seqI++ ){
-			int64 startI = (*this)[ ivI ].Start( seqI );
-			gnSeqI length = (*this)[ ivI ].Length( seqI );
-			// if this genome doesn't have any sequence in this
-			// interval then skip it...
-			if( startI == 0 &&ivI > 0)	// kludge: write all seqs into the first interval so java parser can read it
+		if( failure.size() > 0 )
+			throw failure.front();
+
+		for( size_t blockI = 0; blockI < blocks.size(); blockI++ ){
+			out_file.write( blocks[ blockI ].data(), blocks[ blockI ].size() );
+			bytes_written += blocks[ blockI ].size();
+		}
+		out_file.flush();
+		batch_start = batch_end;
+	}
+	return bytes_written;
+}
+
+template< class MatchType >
+uint64 GenericIntervalList<MatchType>::WriteBinaryAlignment( std::ostream& out_file, bool write_residues ) const 
+{
+	uint seq_count = 0;
+	for( size_t ivI = 0; ivI < this->size(); ivI++ )
+		seq_count = (std::max)( seq_count, (*this)[ ivI ].SeqCount() );
+	if( write_residues && seq_table.size() == 0 )
+		for( size_t ivI = 0; ivI < this->size(); ivI++ )
+			if( GetStoredAlignment( (*this)[ ivI ] ) == NULL )
+				Throw_gnExMsg( genome::NullPointer(), "Sequences must be loaded to write residues.\n" );
+
+	BinaryAlignmentWriter writer( out_file, seq_count, seq_filename, backbone_filename, write_residues );
+
+	// encode batches of regions concurrently, then write them out in order
+	std::vector< std::string > blocks;
+	// GetAlignment can throw, which must not escape the parallel loop.  the
+	// first region that failed gets its exception rethrown after the loop
+	int failed_ivI = -1;
+	std::vector< genome::gnException > failure;
+	for( size_t batch_start = 0; batch_start < this->size(); ){
+		size_t batch_end = batch_start;
+		uint64 batch_size = 0;
+		for( ; batch_end < this->size() && (batch_end == batch_start || batch_size < XMFA_WRITE_BATCH_SIZE); batch_end++ )
+			batch_size += (*this)[ batch_end ].AlignmentLength() * (*this)[ batch_end ].SeqCount();
+		blocks.resize( batch_end - batch_start );
+
+#pragma omp parallel for schedule(dynamic) if( batch_end - batch_start > 1 )
+		for( int ivI = (int)batch_start; ivI < (int)batch_end; ivI++ ){
+			const MatchType& iv = (*this)[ ivI ];
+			std::vector< int64 > starts( seq_count, 0 );
+			std::vector< gnSeqI > lengths( seq_count, 0 );
+			std::vector< bitset_t > aln_mat;
+			std::vector< std::string > residues;
+			const std::vector< std::string >* rows = NULL;
+			try{
+				iv.GetAlignment( aln_mat );
+				if( write_residues ){
+					if( seq_table.size() == 0 )
+						rows = GetStoredAlignment( iv );
+					else if( seq_table.size() == 1 && seq_table.size() != iv.SeqCount() )
+						GetAlignment( iv, std::vector<genome::gnSequence*>( iv.SeqCount(), seq_table[0] ), residues );
+					else
+						GetAlignment( iv, seq_table, residues );
+				}
+			}catch( genome::gnException& gne ){
+#pragma omp critical(WriteBinaryAlignment_failure)
+				if( failed_ivI == -1 || ivI < failed_ivI ){
+					failed_ivI = ivI;
+					failure.clear();
+					failure.push_back( gne );
+				}
 				continue;
-			out_file << "> " << seqI + 1 << ":";
-			if( startI > 0 ){
-				out_file << genome::absolut( startI ) << "-" << genome::absolut( startI ) + length - 1 << " + ";
-			}else if(startI == 0){
-				out_file << 0 << "-" << 0 << " + ";
-			}else{
-				out_file << genome::absolut( startI ) << "-" << genome::absolut( startI ) + length - 1 << " - ";
 			}
-			if( single_input )
-				out_file << seq_filename[ 0 ];	// write the sequence filename as the seq name
-			else				
-				out_file << seq_filename[ seqI ];	// write the sequence filename as the seq name
-			out_file << std::endl;
-			gnSeqI cur_pos = 0;
-			for( ; cur_pos < alignment[ seqI ].length(); cur_pos += 80 ){
-				gnSeqI cur_len = cur_pos + 80 < alignment[ seqI ].length() ? 80 : alignment[ seqI ].length() - cur_pos;
-				out_file.write( alignment[ seqI ].data() + cur_pos, cur_len );
-				out_file << std::endl;
+			const gnSeqI aln_length = aln_mat.size() > 0 ? aln_mat[0].size() : 0;
+			aln_mat.resize( seq_count, bitset_t( aln_length, false ) );
+			for( uint seqI = 0; seqI < iv.SeqCount(); seqI++ ){
+				starts[ seqI ] = iv.Start( seqI );
+				lengths[ seqI ] = iv.Start( seqI ) == NO_MATCH ? 0 : iv.Length( seqI );
+			}
+
+			if( write_residues ){
+				if( rows != NULL && rows->size() < seq_count )
+					residues = *rows;
+				if( rows == NULL || rows->size() < seq_count ){
+					residues.resize( seq_count, std::string( aln_length, '-' ) );
+					rows = &residues;
+				}
 			}
+			BinaryAlignmentWriter::EncodeBlock( starts, lengths, aln_mat, rows, blocks[ ivI - batch_start ] );
 		}
-		out_file << "=" << std::endl;
-		out_file.flush();
+		if( failure.size() > 0 )
+			throw failure.front();
+
+		for( size_t blockI = 0; blockI < blocks.size(); blockI++ )
+			writer.WriteBlock( blocks[ blockI ] );
+		batch_start = batch_end;
 	}
-	
+	return writer.Finish();
+}
+
+template< class MatchType >
+void GenericIntervalList<MatchType>::ReadBinaryAlignment( const std::string& fname )
+{
+	BinaryAlignment aln;
+	aln.Open( fname );
+	const uint seq_count = aln.SeqCount();
+
+	// blocks decode independently straight from the mapped file.  they are
+	// only added once all of them decoded so a corrupt file leaves the list as it was
+	std::vector< MatchType > decoded( aln.BlockCount() );
+	bool corrupt = false;
+#pragma omp parallel for schedule(dynamic) if( aln.BlockCount() > 1 ) reduction(||:corrupt)
+	for( int blockI = 0; blockI < (int)aln.BlockCount(); blockI++ ){
+		std::vector< int64 > starts;
+		std::vector< gnSeqI > lengths;
+		std::vector< bitset_t > aln_mat;
+		std::vector< std::string > residues;
+		try{
+			aln.ReadBlock( blockI, starts, lengths, aln_mat, &residues );
+		}catch( genome::gnException& gne ){
+			corrupt = true;
+			continue;
+		}
+		const gnSeqI aln_length = aln_mat.size() > 0 ? aln_mat[0].size() : 0;
+		std::vector< AbstractMatch* > matches;
+		if( aln.HasResidues() ){
+			GappedAlignment* new_cr = new GappedAlignment( seq_count, aln_length );
+			for( uint seqI = 0; seqI < seq_count; seqI++ ){
+				new_cr->SetLength( lengths[ seqI ], seqI );
+				new_cr->SetStart( seqI, starts[ seqI ] );
+			}
+			new_cr->SetAlignment( residues );
+			matches.push_back( new_cr );
+		}else{
+			CompactGappedAlignment<>* new_cr = new CompactGappedAlignment<>( seq_count, aln_length );
+			for( uint seqI = 0; seqI < seq_count; seqI++ ){
+				new_cr->SetLength( lengths[ seqI ], seqI );
+				new_cr->SetStart( seqI, starts[ seqI ] );
+			}
+			new_cr->SetAlignment( aln_mat );
+			matches.push_back( new_cr );
+		}
+		decoded[ blockI ].SetMatches( matches );
+	}
+	if( corrupt )
+		Throw_gnEx( InvalidFileFormat() );
+
+	seq_filename = aln.SeqFilenames();
+	backbone_filename = aln.BackboneFilename();
+	const size_t first_block = this->size();
+	this->resize( first_block + decoded.size() );
+	for( size_t blockI = 0; blockI < decoded.size(); blockI++ )
+		(*this)[ first_block + blockI ].swap( decoded[ blockI ] );
 }
 
 template< class MatchType >
@@ -476,25 +776,13 @@ void GenericIntervalList<MatchType>::ReadStandardAlignment( std::istream& in_str
 		}
 		
 		// read and parse the def. line
-		std::stringstream line_str( cur_line );
-		std::getline( line_str, cur_line, '>' );
-		std::getline( line_str, cur_line, ':' );
-		// take off leading whitespace
-		std::stringstream parse_str( cur_line );
-
-		parse_str >> seqI;	// the sequence number
-				
-		int64 start, stop;
-		std::getline( line_str, cur_line, '-' );
-		parse_str.clear();
-		parse_str.str( cur_line );
-		parse_str >> start;
-		line_str >> stop;
-		std::string strand;
-		line_str >> strand;
-
-		std::string name;	// anything left is the name
-		std::getline( line_str, name );
+		XmfaDefline defline;
+		parseXmfaDefline( cur_line, defline );
+		seqI = defline.seqI;
+		const int64 start = defline.start;
+		const int64 stop = defline.stop;
+		const std::string& strand = defline.strand;
+		cur_line.clear();	// a def. line at the end of the stream leaves no sequence
 
 		// read and parse the sequence
 		while( aln_mat.size() < seqI )
@@ -587,23 +875,7 @@ void GenericIntervalList<MatchType>::ReadStandardAlignment( std::istream& in_str
 	// now process all GappedAlignments into Intervals
 	for( uint ivI = 0; ivI < ga_list.size(); ivI++ ){
 		GappedAlignment* cr = ga_list[ ivI ];
-		GappedAlignment* new_cr = new GappedAlignment( seq_count, cr->AlignmentLength() );
-
-		const std::vector< std::string >& align_matrix = GetAlignment( *cr, seq_table );
-		std::vector< std::string > new_aln_mat(seq_count);
-		for( seqI = 0; seqI < align_matrix.size(); seqI++ ){
-			new_cr->SetLength( cr->Length( seqI ), seqI );
-			new_cr->SetStart( seqI, cr->Start(seqI) );
-			new_aln_mat[ seqI ] = align_matrix[ seqI ];
-			if( new_aln_mat[ seqI ].length() == 0 )
-				new_aln_mat[ seqI ] = std::string( new_cr->AlignmentLength(), '-' );
-		}
-		for( ; seqI < seq_count; seqI++ ){
-			new_cr->SetLength( 0, seqI );
-			new_cr->SetStart( seqI, 0 );
-			new_aln_mat[ seqI ] = std::string( new_cr->AlignmentLength(), '-' );
-		}
-		new_cr->SetAlignment(new_aln_mat);
+		GappedAlignment* new_cr = PadAlignmentRows( *cr, seq_count );
 		delete cr;
 		cr = new_cr;
 		ga_list[ ivI ] = new_cr;
@@ -644,25 +916,13 @@ void GenericIntervalList<MatchType>::ReadStandardAlignmentCompact( std::istream&
 		}
 		
 		// read and parse the def. line
-		std::stringstream line_str( cur_line );
-		std::getline( line_str, cur_line, '>' );
-		std::getline( line_str, cur_line, ':' );
-		// take off leading whitespace
-		std::stringstream parse_str( cur_line );
-
-		parse_str >> seqI;	// the sequence number
-				
-		int64 start, stop;
-		std::getline( line_str, cur_line, '-' );
-		parse_str.clear();
-		parse_str.str( cur_line );
-		parse_str >> start;
-		line_str >> stop;
-		std::string strand;
-		line_str >> strand;
-
-		std::string name;	// anything left is the name
-		std::getline( line_str, name );
+		XmfaDefline defline;
+		parseXmfaDefline( cur_line, defline );
+		seqI = defline.seqI;
+		const int64 start = defline.start;
+		const int64 stop = defline.stop;
+		const std::string& strand = defline.strand;
+		cur_line.clear();	// a def. line at the end of the stream leaves no sequence
 
 		// read and parse the sequence
 		while( aln_mat.size() < seqI )
@@ -790,6 +1050,70 @@ void GenericIntervalList<MatchType>::ReadStandardAlignmentCompact( std::istream&
 }
 
 
+template< class MatchType >
+void GenericIntervalList<MatchType>::OpenIndexedAlignment( const std::string& xmfa_fname )
+{
+	xmfa_index.Open( xmfa_fname );
+	indexed_filename = xmfa_fname;
+	seq_filename = xmfa_index.seq_filename;
+	this->clear();
+	this->resize( xmfa_index.blocks.size() );
+	interval_loaded.clear();
+	interval_loaded.resize( xmfa_index.blocks.size(), false );
+}
+
+template< class MatchType >
+MatchType& GenericIntervalList<MatchType>::LoadInterval( size_t ivI )
+{
+	if( ivI >= interval_loaded.size() || interval_loaded[ ivI ] )
+		return (*this)[ ivI ];
+
+	std::ifstream xmfa_file( indexed_filename.c_str(), std::ios::binary );
+	if( !xmfa_file.is_open() )
+		Throw_gnExMsg( genome::FileNotOpened(), "Unable to open alignment file.\n");
+	std::string block_text;
+	xmfa_index.ReadBlock( xmfa_file, ivI, block_text );
+	std::stringstream block_stream( block_text );
+	GenericIntervalList<MatchType> block_list;
+	block_list.ReadStandardAlignment( block_stream );
+	if( block_list.size() != 1 )
+		Throw_gnEx( InvalidFileFormat() );
+
+	// give the block a row for every genome in the alignment, as ReadStandardAlignment() does
+	const GappedAlignment* cr = dynamic_cast< const GappedAlignment* >( block_list[0].GetMatches()[0] );
+	GappedAlignment* new_cr = PadAlignmentRows( *cr, xmfa_index.seq_count );
+
+	std::vector<AbstractMatch*> asdf( 1, new_cr );
+	Interval iv( asdf.begin(), asdf.end() );
+	delete new_cr;
+	(*this)[ ivI ] = iv;
+	interval_loaded[ ivI ] = true;
+	return (*this)[ ivI ];
+}
+
+template< class MatchType >
+GappedAlignment* GenericIntervalList<MatchType>::PadAlignmentRows( const GappedAlignment& cr, uint seq_count ) const
+{
+	GappedAlignment* new_cr = new GappedAlignment( seq_count, cr.AlignmentLength() );
+	const std::vector< std::string >& align_matrix = GetAlignment( cr, seq_table );
+	std::vector< std::string > new_aln_mat( seq_count );
+	uint seqI = 0;
+	for( ; seqI < align_matrix.size() && seqI < seq_count; seqI++ ){
+		new_cr->SetLength( cr.Length( seqI ), seqI );
+		new_cr->SetStart( seqI, cr.Start( seqI ) );
+		new_aln_mat[ seqI ] = align_matrix[ seqI ];
+		if( new_aln_mat[ seqI ].length() == 0 )
+			new_aln_mat[ seqI ] = std::string( new_cr->AlignmentLength(), '-' );
+	}
+	for( ; seqI < seq_count; seqI++ ){
+		new_cr->SetLength( 0, seqI );
+		new_cr->SetStart( seqI, 0 );
+		new_aln_mat[ seqI ] = std::string( new_cr->AlignmentLength(), '-' );
+	}
+	new_cr->SetAlignment( new_aln_mat );
+	return new_cr;
+}
+
 template< class MatchType >
 void GenericIntervalList<MatchType>::WriteAlignedSequences(std::ostream& match_file) const
 {
@@ -120,15 +120,24 @@ static char colmap[5][5] = {
 };
 
 
+// number of sequence pairs whose homology predictions are computed in one batch
+static const uint HOMOLOGY_HMM_BATCH = 16;
+
+/**
+ * Encodes a pairwise alignment as a sequence of HomologyHMM site patterns
+ * @param column_states	(output) The site patterns, in the order they should be given to the HMM
+ * @param col_reference	(output) The alignment column of each site pattern
+ */
 inline
-void findHssHomologyHMM( std::vector< std::string >& aln_table, hss_list_t& hss_list, uint seqI, uint seqJ, const Params& hmm_params,
-						boolean left_homologous, boolean right_homologous )
+void encodeHomologyColumns( std::vector< std::string >& aln_table, uint seqI, uint seqJ,
+						boolean left_homologous, boolean right_homologous,
+						std::string& column_states, vector< size_t >& col_reference )
 {
 	static char* charmap = getCharmap();
 
 	// encode the alignment as column states
-	std::string column_states(aln_table[0].size(),'q');
-	vector< size_t > col_reference(column_states.size(), (std::numeric_limits<size_t>::max)() );
+	column_states.assign(aln_table[0].size(),'q');
+	col_reference.assign(column_states.size(), (std::numeric_limits<size_t>::max)() );
 	size_t refI = 0;
 	for( size_t colI = 0; colI < column_states.size(); colI++ )
 	{
@@ -153,13 +162,17 @@ void findHssHomologyHMM( std::vector< std::string >& aln_table, hss_list_t& hss_
 		column_states[0] = '8';
 	if( column_states.size() > 1 && column_states[column_states.size()-1] == '7' && (column_states[column_states.size()-2] == '7'|| column_states[column_states.size()-2] == '8') )
 		column_states[column_states.size()-1] = '8';
-	// now feed it to the Homology prediction HMM
-	string prediction;
 	if( right_homologous && !left_homologous )
 		std::reverse(column_states.begin(), column_states.end());
+}
 
-	run(column_states, prediction, hmm_params);
-
+/**
+ * Converts HomologyHMM site predictions back to homologous alignment column ranges
+ */
+inline
+void predictionToHss( std::string& prediction, const vector< size_t >& col_reference, hss_list_t& hss_list, uint seqI, uint seqJ,
+						boolean left_homologous, boolean right_homologous )
+{
 	if( right_homologous && !left_homologous )
 		std::reverse(prediction.begin(), prediction.end());
 	size_t prev_h = 0;
@@ -193,6 +206,19 @@ void findHssHomologyHMM( std::vector< std::string >& aln_table, hss_list_t& hss_
 	}
 }
 
+inline
+void findHssHomologyHMM( std::vector< std::string >& aln_table, hss_list_t& hss_list, uint seqI, uint seqJ, const Params& hmm_params,
+						boolean left_homologous, boolean right_homologous )
+{
+	std::string column_states;
+	vector< size_t > col_reference;
+	encodeHomologyColumns( aln_table, seqI, seqJ, left_homologous, right_homologous, column_states, col_reference );
+	// now feed it to the Homology prediction HMM
+	string prediction;
+	run(column_states, prediction, hmm_params);
+	predictionToHss( prediction, col_reference, hss_list, seqI, seqJ, left_homologous, right_homologous );
+}
+
 
 template< typename MatchVector >
 void findHssHomologyHMM( const MatchVector& iv_list, std::vector< genome::gnSequence* >& seq_table,  hss_array_t& hss_array, const Params& hmm_params, boolean left_homologous, boolean right_homologous )
@@ -206,14 +232,28 @@ void findHssHomologyHMM( const MatchVector& iv_list, std::vector< genome::gnSequ
 		const MatchType& iv = iv_list[ iv_listI ];
 		std::vector< std::string > aln_table;
 		GetAlignment( *iv, seq_table, aln_table );
-		
-		for( uint seqI = 0; seqI < seq_count; seqI++ ){
-			uint seqJ;
-			for( seqJ = seqI + 1; seqJ < seq_count; seqJ++ ){
 
+		// predict the pairs in batches so the HMM can interleave them
+		std::vector< std::pair< uint, uint > > pairs;
+		for( uint seqI = 0; seqI < seq_count; seqI++ )
+			for( uint seqJ = seqI + 1; seqJ < seq_count; seqJ++ )
+				pairs.push_back( std::make_pair( seqI, seqJ ) );
+
+		std::vector< std::string > column_states( HOMOLOGY_HMM_BATCH );
+		std::vector< vector< size_t > > col_reference( HOMOLOGY_HMM_BATCH );
+		std::vector< std::string > predictions;
+		for( size_t pairI = 0; pairI < pairs.size(); pairI += HOMOLOGY_HMM_BATCH ){
+			size_t batch_size = (std::min)( (size_t)HOMOLOGY_HMM_BATCH, pairs.size() - pairI );
+			column_states.resize( batch_size );
+			for( size_t bI = 0; bI < batch_size; bI++ )
+				encodeHomologyColumns( aln_table, pairs[pairI+bI].first, pairs[pairI+bI].second, left_homologous, right_homologous, column_states[bI], col_reference[bI] );
+			run( column_states, predictions, hmm_params );
+			for( size_t bI = 0; bI < batch_size; bI++ ){
+				uint seqI = pairs[pairI+bI].first;
+				uint seqJ = pairs[pairI+bI].second;
 				hss_list_t& hss_list = hss_array[seqI][seqJ][iv_listI];
 				hss_list.clear();
-				findHssHomologyHMM( aln_table, hss_list, seqI, seqJ, hmm_params, left_homologous, right_homologous );
+				predictionToHss( predictions[bI], col_reference[bI], hss_list, seqI, seqJ, left_homologous, right_homologous );
 			}
 		}
 	}
@@ -35,7 +35,7 @@ MaskedMemHash* MaskedMemHash::Clone() const{
 	return new MaskedMemHash(*this);
 }
 
-boolean MaskedMemHash::HashMatch(list<idmer>& match_list){
+boolean MaskedMemHash::HashMatch(IdmerList& match_list){
 	//check that there is at least one forward component
 	match_list.sort(&idmer_id_lessthan);
 	// initialize the hash entry
@@ -43,7 +43,7 @@ boolean MaskedMemHash::HashMatch(list<idmer>& match_list){
 	mhe.SetLength(GetSar(0)->SeedLength());
 	
 	//Fill in the new Match and set direction parity if needed.
-	list<idmer>::iterator iter = match_list.begin();
+	IdmerList::iterator iter = match_list.begin();
 	for(; iter != match_list.end(); iter++)
 		mhe.SetStart(iter->id, iter->position + 1);
 	SetDirection(mhe);
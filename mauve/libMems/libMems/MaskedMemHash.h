@@ -35,7 +35,7 @@ protected:
 	 * Can't find subsets when there is only one permitted sequence mask!
 	 */
 	virtual void FindSubsets(const Match& mhe, std::vector<Match>& subset_matches){};
-	virtual boolean HashMatch(std::list<idmer>& match_list);
+	virtual boolean HashMatch(IdmerList& match_list);
 	uint64 seq_mask;
 };
 
@@ -109,18 +109,18 @@ void MatchFinder::GetBreakpoint( uint32 sarI, gnSeqI startI, vector<gnSeqI>& bre
 		if(i == sarI){
 			breakpoints.push_back(startI);
 		}else{
-			gnSeqI cur_start;
-			if(GetSar(i)->FindMer(break_mer.mer, cur_start)){
-				//we found a match, see how far backwards we can go.
-				int64 cur_matchI = cur_start;
-				bmer matchmer = (*GetSar(i))[cur_start];
-				while(cur_matchI >= 0 && ((matchmer.mer & mer_mask) == (break_mer.mer && mer_mask))){
-					cur_matchI--;
-					matchmer = (*GetSar(i))[cur_start];
-				}
-				cur_start = cur_matchI+1;
+			// find the first mer that does not sort before break_mer, so that
+			// every copy of a mer lands on the same side of the breakpoint
+			gnSeqI low = 0;
+			gnSeqI high = GetSar(i)->SMLLength();
+			while( low < high ){
+				gnSeqI middle = low + (high - low) / 2;
+				if( ((*GetSar(i))[middle].mer & mer_mask) < (break_mer.mer & mer_mask) )
+					low = middle + 1;
+				else
+					high = middle;
 			}
-			breakpoints.push_back(cur_start);
+			breakpoints.push_back(low);
 		}
 	}
 }
@@ -172,12 +172,14 @@ boolean print_sp = false;
 boolean MatchFinder::SearchRange(vector<gnSeqI>& start_points, vector<gnSeqI>& search_len){
 	//picked a semi-arbitrary number for buffer size.
 	uint32 MER_BUFFER_SIZE = 10000;
-	vector<uint32> mer_index;   // stores the indexes of the current mers in mer_vector
-	vector<uint32> mer_baseindex;   // stores the index in the SortedMerList of each of the first mers in mer_vector
+	vector<gnSeqI> mer_index;   // stores the indexes of the current mers in mer_vector
+	vector<gnSeqI> mer_baseindex;   // stores the index in the SortedMerList of each of the first mers in mer_vector
 	IdmerList cur_mers;	// stores the current mers.
 	IdmerList cur_match;	// stores the current matching mers.
+	cur_mers.reserve( sar_table.size() );
+	cur_match.reserve( sar_table.size() * 4 );
 	list<uint32> sar_hitlist;	// list of sars to replace
-	uint32 read_size;
+	gnSeqI read_size;
 	
 	//make sure there is at least one sequence
 	if(sar_table.size() < 1)
@@ -295,19 +297,24 @@ boolean MatchFinder::SearchRange(vector<gnSeqI>& start_points, vector<gnSeqI>& s
 			//if we've exhausted our buffer then refill it
 			mer_baseindex[cur_id] += mer_vector[cur_id].size();
 			
-			// update the mers processed
-			mers_processed += mer_vector[cur_id].size();
-			float64 m_oldprogress = m_progress;
-			m_progress = ((float64)mers_processed / (float64)total_mers) * PROGRESS_GRANULARITY;
+			// update the mers processed.  ParallelMemHash searches several
+			// ranges at once, so the counters are updated atomically
+			uint64 cur_processed;
+#pragma omp atomic capture
+			cur_processed = mers_processed += mer_vector[cur_id].size();
+			float cur_progress = ((float64)cur_processed / (float64)total_mers) * PROGRESS_GRANULARITY;
+			float m_oldprogress;
+#pragma omp atomic capture
+			{ m_oldprogress = m_progress; m_progress = cur_progress; }
 			if( log_stream != NULL ){
-				if((int)m_oldprogress != (int)m_progress){
-					(*log_stream) << (int)((m_progress / PROGRESS_GRANULARITY) * 100) << "%..";
+				if((int)m_oldprogress != (int)cur_progress){
+					(*log_stream) << (int)((cur_progress / PROGRESS_GRANULARITY) * 100) << "%..";
 					log_stream->flush();
 				}
-				if(((int)m_oldprogress / 10) != ((int)m_progress / 10))
+				if(((int)m_oldprogress / 10) != ((int)cur_progress / 10))
 					(*log_stream) << std::endl;
 			}
-			uint32 read_size = MER_BUFFER_SIZE;
+			gnSeqI read_size = MER_BUFFER_SIZE;
 			if(MER_BUFFER_SIZE + mer_baseindex[cur_id] > search_len[cur_id])
 				read_size = search_len[cur_id] - mer_baseindex[cur_id];
 
@@ -367,8 +374,9 @@ boolean MatchFinder::EnumerateMatches( IdmerList& match_list ){
 	//different id's and hashes them.
 	id_end = id_pos;
 	id_end.push_back(match_list.end());
+	IdmerList cur_match;
+	cur_match.reserve( id_pos.size() );
 	while(true){
-		IdmerList cur_match;
 		for(uint32 k = 0; k < id_pos.size(); ++k){
 			cur_match.push_back(*id_pos[k]);
 		}
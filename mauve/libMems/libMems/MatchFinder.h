@@ -17,6 +17,8 @@
 #include "libMems/Match.h"
 #include "libMems/MatchList.h"
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 #include <boost/pool/pool_alloc.hpp>
 
@@ -32,7 +34,21 @@ struct idmer{
 // using boost::fast_pool_allocator<idmer> results in a significant speedup
 // over std::allocator.  testing on a Salmonella vs. Y. pestis comparison shows
 // a 30% speedup
-typedef std::list<idmer> IdmerList;
+// That no longer holds with glibc malloc: idmerListBenchmark on four related
+// 250 kbp genomes (771K mers in 242K lists, rebuilt and sorted 20 times, one core)
+// takes 1.05s with std::list<idmer>, 1.5s with fast_pool_allocator and 0.55s
+// with the contiguous IdmerList below.
+
+/**
+ * A list of matching mers.  The mers are stored contiguously so that building
+ * a list does not allocate once per mer, and a list that gets cleared and refilled
+ * reuses its storage.  sort() is kept for compatibility with std::list and is stable.
+ */
+class IdmerList : public std::vector<idmer> {
+public:
+	template< class Compare >
+	void sort( Compare comp ){ std::stable_sort( begin(), end(), comp ); }
+};
 
 const unsigned int PROGRESS_GRANULARITY = 100;
 
@@ -128,13 +144,13 @@ SortedMerList* MatchFinder::GetSar(uint32 sarI) const{
 }
 
 inline
-bool idmer_lessthan(idmer& a_v, idmer& m_v){
+bool idmer_lessthan(const idmer& a_v, const idmer& m_v){
 	return (a_v.mer < m_v.mer);// ? true : false;
 };
 
 //id less than function for STL sort functions
 inline
-bool idmer_id_lessthan(idmer& a_v, idmer& m_v){
+bool idmer_id_lessthan(const idmer& a_v, const idmer& m_v){
 	return (a_v.id < m_v.id);// ? true : false;
 };
 
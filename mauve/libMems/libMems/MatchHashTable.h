@@ -0,0 +1,253 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * This file is licensed under the GPL.
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifndef _MatchHashTable_h_
+#define _MatchHashTable_h_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "libMems/MatchHashEntry.h"
+
+namespace mems {
+
+/**
+ * MatchHashTable stores pointers to MatchHashEntry objects, grouped by diagonal.
+ * A flat array with open addressing and linear probing maps the generalized offset
+ * and a signature of the genomes hit by a match to its group, so a lookup only
+ * runs MheCompare on matches on the same diagonal in the same genomes.  A group
+ * holds a few runs sorted with MheCompare: new entries get appended as runs of
+ * one and runs of equal length get merged, so each entry is moved O(log n) times
+ * and a lookup needs one binary search per run.  The entries themselves are owned
+ * by the caller, which normally allocates them with a SlotAllocator.  The slot and
+ * group arrays are not, since SlotAllocator hands out one fixed size object at a
+ * time while groups are variable length arrays that get merged in place.
+ */
+class MatchHashTable {
+public:
+	MatchHashTable() : group_count(0), entry_count(0) {}
+
+	/**
+	 * Finds an entry that MheCompare considers equivalent to mhe, i.e. one on the
+	 * same diagonal that contains or is contained by mhe.
+	 * @return the equivalent entry or NULL if there is none
+	 */
+	MatchHashEntry* Find( const MatchHashEntry& mhe ) const;
+	/**
+	 * Adds mhe to the table.  No check for an equivalent entry is made.
+	 */
+	void Insert( MatchHashEntry* mhe );
+	/** Removes all entries from the table and releases its memory */
+	void Clear();
+	/**
+	 * Removes all entries from the table but keeps its memory for the next set of
+	 * entries.  Only the slots that are in use get reset.
+	 */
+	void Reset();
+	/** @return the number of entries in the table */
+	size_t Size() const{ return entry_count; }
+	/** Appends every entry in the table to entries, in no particular order */
+	void GetEntries( std::vector< MatchHashEntry* >& entries ) const;
+
+protected:
+	static const size_t NO_GROUP = (size_t)-1;
+	struct Slot {
+		int64 offset;
+		uint64 genome_key;
+		size_t group;	/**< index into groups, NO_GROUP for an empty slot */
+	};
+	struct Group {
+		std::vector< MatchHashEntry* > entries;
+		std::vector< size_t > run_ends;	/**< the end of each sorted run in entries, runs get shorter towards the back */
+	};
+	static uint64 GenomeKey( const MatchHashEntry& mhe );
+	static size_t SlotHash( int64 offset, uint64 genome_key );
+	/** @return the slot holding the given key, or the empty slot where it belongs */
+	size_t FindSlot( int64 offset, uint64 genome_key ) const;
+	void Grow();
+
+	std::vector< Slot > slots;	/**< the table, its size is always zero or a power of two */
+	std::deque< Group > groups;	/**< the entries of each diagonal */
+	std::vector< size_t > group_slots;	/**< the slot that refers to each group */
+	size_t group_count;	/**< the number of groups in use, groups past this are empty and kept for reuse */
+	size_t entry_count;
+	MheCompare mhecomp;
+};
+
+/** MheCompare only considers matches equivalent if they hit the same set of genomes */
+inline
+uint64 MatchHashTable::GenomeKey( const MatchHashEntry& mhe ){
+	uint64 key = 14695981039346656037ULL;
+	uint seqI = mhe.FirstStart();
+	key = (key ^ seqI) * 1099511628211ULL;
+	for( ; seqI < mhe.SeqCount(); seqI++ )
+		if( mhe.LeftEnd(seqI) != NO_MATCH )
+			key = (key ^ (seqI + 1)) * 1099511628211ULL;
+	return key;
+}
+
+inline
+size_t MatchHashTable::SlotHash( int64 offset, uint64 genome_key ){
+	uint64 h = ((uint64)offset * 0x9E3779B97F4A7C15ULL) ^ genome_key;
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 32;
+	return (size_t)h;
+}
+
+inline
+size_t MatchHashTable::FindSlot( int64 offset, uint64 genome_key ) const{
+	const size_t mask = slots.size() - 1;
+	size_t slotI = SlotHash( offset, genome_key ) & mask;
+	while( slots[slotI].group != NO_GROUP &&
+		( slots[slotI].offset != offset || slots[slotI].genome_key != genome_key ) )
+		slotI = (slotI + 1) & mask;
+	return slotI;
+}
+
+inline
+MatchHashEntry* MatchHashTable::Find( const MatchHashEntry& mhe ) const{
+	if( slots.size() == 0 )
+		return NULL;
+	const Slot& s = slots[ FindSlot( mhe.Offset(), GenomeKey( mhe ) ) ];
+	if( s.group == NO_GROUP )
+		return NULL;
+	const Group& group = groups[ s.group ];
+	std::vector< MatchHashEntry* >::const_iterator run_begin = group.entries.begin();
+	for( size_t runI = 0; runI < group.run_ends.size(); runI++ ){
+		std::vector< MatchHashEntry* >::const_iterator run_end = group.entries.begin() + group.run_ends[runI];
+		std::vector< MatchHashEntry* >::const_iterator mhe_iter;
+		mhe_iter = std::lower_bound( run_begin, run_end, &mhe, mhecomp );
+		if( mhe_iter != run_end && !mhecomp( *mhe_iter, &mhe ) && !mhecomp( &mhe, *mhe_iter ) )
+			return *mhe_iter;
+		run_begin = run_end;
+	}
+	return NULL;
+}
+
+inline
+void MatchHashTable::Insert( MatchHashEntry* mhe ){
+	// keep the load factor at or below one half
+	if( (group_count + 1) * 2 > slots.size() )
+		Grow();
+	const int64 offset = mhe->Offset();
+	const uint64 genome_key = GenomeKey( *mhe );
+	const size_t slotI = FindSlot( offset, genome_key );
+	Slot& s = slots[ slotI ];
+	if( s.group == NO_GROUP ){
+		s.offset = offset;
+		s.genome_key = genome_key;
+		s.group = group_count++;
+		if( s.group == groups.size() ){
+			groups.push_back( Group() );
+			group_slots.push_back( slotI );
+		}else
+			group_slots[ s.group ] = slotI;
+	}
+	// append mhe as a run of one, then merge runs of equal length like a binary counter
+	Group& group = groups[ s.group ];
+	std::vector< MatchHashEntry* >& entries = group.entries;
+	std::vector< size_t >& run_ends = group.run_ends;
+	entries.push_back( mhe );
+	run_ends.push_back( entries.size() );
+	while( run_ends.size() > 1 ){
+		const size_t last_begin = run_ends[ run_ends.size() - 2 ];
+		const size_t prev_begin = run_ends.size() > 2 ? run_ends[ run_ends.size() - 3 ] : 0;
+		if( run_ends.back() - last_begin < last_begin - prev_begin )
+			break;
+		std::inplace_merge( entries.begin() + prev_begin, entries.begin() + last_begin, entries.end(), mhecomp );
+		run_ends.pop_back();
+		run_ends.back() = entries.size();
+	}
+	entry_count++;
+}
+
+inline
+void MatchHashTable::Grow(){
+	std::vector< Slot > old_slots;
+	old_slots.swap( slots );
+	Slot empty;
+	empty.offset = 0;
+	empty.genome_key = 0;
+	empty.group = NO_GROUP;
+	slots.resize( old_slots.size() == 0 ? 64 : old_slots.size() * 2, empty );
+	for( size_t oldI = 0; oldI < old_slots.size(); oldI++ ){
+		if( old_slots[oldI].group == NO_GROUP )
+			continue;
+		const size_t slotI = FindSlot( old_slots[oldI].offset, old_slots[oldI].genome_key );
+		slots[ slotI ] = old_slots[oldI];
+		group_slots[ old_slots[oldI].group ] = slotI;
+	}
+}
+
+inline
+void MatchHashTable::Clear(){
+	// release the memory, a table can grow quite large during a whole genome search
+	std::vector< Slot >().swap( slots );
+	std::deque< Group >().swap( groups );
+	std::vector< size_t >().swap( group_slots );
+	group_count = 0;
+	entry_count = 0;
+}
+
+inline
+void MatchHashTable::Reset(){
+	for( size_t groupI = 0; groupI < group_count; groupI++ ){
+		slots[ group_slots[groupI] ].group = NO_GROUP;
+		groups[groupI].entries.clear();
+		groups[groupI].run_ends.clear();
+	}
+	group_count = 0;
+	entry_count = 0;
+}
+
+inline
+void MatchHashTable::GetEntries( std::vector< MatchHashEntry* >& entries ) const{
+	entries.reserve( entries.size() + entry_count );
+	for( size_t groupI = 0; groupI < group_count; groupI++ )
+		entries.insert( entries.end(), groups[groupI].entries.begin(), groups[groupI].entries.end() );
+}
+
+/**
+ * Orders the entries of a match table by hash bucket and then as MheCompare would
+ * within a bucket.  Entries stored in a table never contain one another, so this
+ * reduces to comparing which genomes they hit and then their start coordinates.
+ */
+class MheBucketCompare {
+public:
+	MheBucketCompare( uint32 table_size ) : table_size( table_size ) {}
+	uint32 Bucket( const MatchHashEntry* mhe ) const{
+		int64 offset = mhe->Offset();
+		return ((offset % table_size) + table_size) % table_size;
+	}
+	bool operator()( const MatchHashEntry* a, const MatchHashEntry* b ) const{
+		uint32 a_bucket = Bucket( a );
+		uint32 b_bucket = Bucket( b );
+		if( a_bucket != b_bucket )
+			return a_bucket < b_bucket;
+		if( a->FirstStart() != b->FirstStart() )
+			return a->FirstStart() > b->FirstStart();
+		for( size_t i = a->FirstStart(); i < a->SeqCount(); i++ )
+		{
+			if( a->LeftEnd(i) == NO_MATCH && b->LeftEnd(i) != NO_MATCH )
+				return true;
+			else if( a->LeftEnd(i) != NO_MATCH && b->LeftEnd(i) == NO_MATCH )
+				return false;
+		}
+		return MatchHashEntry::strict_start_lessthan_ptr( a, b );
+	}
+protected:
+	int64 table_size;
+};
+
+}
+
+#endif // _MatchHashTable_h_
@@ -21,6 +21,7 @@
 #include "libGenome/gnSequence.h"
 #include "libMems/Match.h"
 #include "libMems/gnRAWSequence.h"
+#include "libGenome/gnPackedSequence.h"
 #include "libGenome/gnRAWSource.h"
 #include "libMems/Files.h"
 #include <sstream>
@@ -257,6 +258,25 @@ void LoadAndCreateRawSequences( MatchListType& mlist, std::ostream* log_stream )
 	}
 }
 
+/**
+ * Loads the sequences designated by the elements of the seq_filename vector and
+ * keeps each whole genome in memory at two bits per base.  The resulting
+ * gnSequences are gnPackedSequences, which can be read from many threads without
+ * going back to the sequence files.
+ * The genome::gnPackedSequence objects are created on the heap
+ * and are not deallocated when this class is destroyed.  They should
+ * be manually destroyed when no longer in use.
+ */
+template< typename MatchListType >
+void LoadPackedSequences( MatchListType& mlist, std::ostream* log_stream ){
+	LoadSequences( mlist, log_stream );
+	for( uint seqI = 0; seqI < mlist.seq_table.size(); seqI++ ){
+		genome::gnPackedSequence* packed_seq = new genome::gnPackedSequence( *mlist.seq_table[ seqI ] );
+		delete mlist.seq_table[ seqI ];
+		mlist.seq_table[ seqI ] = packed_seq;
+	}
+}
+
 
 template< typename MatchPtrType >
 void GenericMatchList< MatchPtrType >::LoadSMLs( uint mer_size, std::ostream* log_stream, int seed_rank, bool solid, bool force_create ){
@@ -275,18 +295,39 @@ void GenericMatchList< MatchPtrType >::LoadSMLs( uint mer_size, std::ostream* lo
 		uint64 default_seed = getSolidSeed( mer_size );
 	std::vector< uint > create_list;
 	uint seqI = 0;
+
+	// SMLs in the cache directory are named after the content of each sequence
+	const std::string& cache_path = FileSML::getCachePath();
+	if( cache_path.size() > 0 ){
+		sml_filename.resize( seq_table.size() );
+#pragma omp parallel for
+		for( int cacheI = 0; cacheI < (int)seq_table.size(); cacheI++ )
+			sml_filename[ cacheI ] = FileSML::CacheFileName( *seq_table[ cacheI ], default_seed );
+		if( log_stream != NULL )
+			for( seqI = 0; seqI < seq_table.size(); seqI++ ){
+				if( FileSML::isCachePublished( sml_filename[ seqI ] ) )
+					(*log_stream) << "Using cached sorted mer list " << sml_filename[ seqI ] << std::endl;
+				else
+					(*log_stream) << "Sorted mer list will be cached as " << sml_filename[ seqI ] << std::endl;
+			}
+	}
+
 	for( seqI = 0; seqI < seq_table.size(); seqI++ ){
 		// define a DNAFileSML to store a sorted mer list
 		DNAFileSML* file_sml = new DNAFileSML();
 		sml_table.push_back( file_sml );
 
-		boolean success = true;
-		try{
-			file_sml->LoadFile( sml_filename[ seqI ] );
-		}catch( genome::gnException& gne ){
-			success = false;
-			create_list.push_back( seqI );
+		// cached SMLs are only used once they have been completely published
+		boolean success = cache_path.size() == 0 || FileSML::isCachePublished( sml_filename[ seqI ] );
+		if( success ){
+			try{
+				file_sml->LoadFile( sml_filename[ seqI ] );
+			}catch( genome::gnException& gne ){
+				success = false;
+			}
 		}
+		if( !success )
+			create_list.push_back( seqI );
 		boolean recreate = false;
 		if(success && force_create){
 			if( log_stream != NULL )
@@ -313,22 +354,71 @@ void GenericMatchList< MatchPtrType >::LoadSMLs( uint mer_size, std::ostream* lo
 			sml_table[ seqI ] = NULL;
 		}
 	
-	// create any SMLs that need to be created
+	// create any SMLs that need to be created.  cached SMLs get created under a
+	// temporary name so that other processes never see a partially written one
+	std::vector< std::string > create_filename( create_list.size() );
 	for( uint createI = 0; createI < create_list.size(); createI++ ){
-		if( log_stream != NULL )
-			(*log_stream) << "Creating sorted mer list\n";
-		try{
+		create_filename[ createI ] = sml_filename[ create_list[ createI ] ];
+		if( cache_path.size() > 0 ){
+			create_filename[ createI ] = CreateTempFileName( create_filename[ createI ] + "." );
+			registerFileToDelete( create_filename[ createI ] );
+			registerFileToDelete( create_filename[ createI ] + ".coords" );
+		}
+		sml_table[ create_list[ createI ] ] = new DNAFileSML( create_filename[ createI ] );
+	}
 
-		time_t start_time = time(NULL);
-		sml_table[ create_list[ createI ] ] = new DNAFileSML( sml_filename[ create_list[ createI ] ] );
-		sml_table[ create_list[ createI ] ]->Create( *seq_table[ create_list[ createI ] ], default_seed );
-		time_t end_time = time(NULL);
-	 	if( log_stream != NULL )
-			(*log_stream) << "Create time was: " << end_time - start_time << " seconds.\n";
-		
-		}catch(...){
-			std::cerr << "Error creating sorted mer list\n";
-			throw;
+	// SMLs are created concurrently in batches whose combined memory needs fit the budget
+	const uint64 memory_budget = FileSML::CreateMemoryBudget();
+	for( uint batch_start = 0; batch_start < create_list.size(); ){
+		uint batch_end = batch_start;
+		uint64 batch_memory = 0;
+		for( ; batch_end < create_list.size(); batch_end++ ){
+			uint64 needed_memory = ((DNAFileSML*)sml_table[ create_list[ batch_end ] ])->NeededMemory( seq_table[ create_list[ batch_end ] ]->length() );
+			if( batch_end > batch_start && batch_memory + needed_memory > memory_budget )
+				break;
+			batch_memory += needed_memory;
+			if( log_stream != NULL )
+				(*log_stream) << "Creating sorted mer list\n";
+		}
+
+		// an SML too large to sort in memory falls back to an external sort, which
+		// gets an equal share of the budget
+		long working_mb = (long)(memory_budget / (batch_end - batch_start) / (1024 * 1024));
+		for( uint createI = batch_start; createI < batch_end; createI++ )
+			((DNAFileSML*)sml_table[ create_list[ createI ] ])->SetCreateWorkingSet( working_mb > 0 ? working_mb : 1 );
+
+		bool create_failed = false;
+#pragma omp parallel for schedule(dynamic) if( batch_end - batch_start > 1 )
+		for( int createI = batch_start; createI < (int)batch_end; createI++ ){
+			try{
+
+			time_t start_time = time(NULL);
+			sml_table[ create_list[ createI ] ]->Create( *seq_table[ create_list[ createI ] ], default_seed );
+			time_t end_time = time(NULL);
+#pragma omp critical(LoadSMLs_log)
+{
+			if( log_stream != NULL )
+				(*log_stream) << "Create time was: " << end_time - start_time << " seconds.\n";
+}
+			}catch(...){
+#pragma omp critical(LoadSMLs_log)
+{
+				std::cerr << "Error creating sorted mer list\n";
+				create_failed = true;
+}
+			}
+		}
+		if( create_failed )
+			Throw_gnExMsg( SMLCreateError(), "Error creating sorted mer list" );
+		batch_start = batch_end;
+	}
+
+	// move new SMLs into the cache, they get loaded from there below
+	if( cache_path.size() > 0 ){
+		for( uint createI = 0; createI < create_list.size(); createI++ ){
+			delete sml_table[ create_list[ createI ] ];
+			sml_table[ create_list[ createI ] ] = NULL;
+			FileSML::publishCacheEntry( create_filename[ createI ], sml_filename[ create_list[ createI ] ] );
 		}
 	}
 	
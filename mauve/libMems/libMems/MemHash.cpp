@@ -12,6 +12,7 @@
 
 #include "libMems/MemHash.h"
 #include "libGenome/gnFilter.h"
+#include <algorithm>
 #include <list>
 #include <map>
 #include <sstream>
@@ -30,7 +31,7 @@ namespace mems {
 	m_repeat_tolerance = DEFAULT_REPEAT_TOLERANCE;
 	m_enumeration_tolerance = DEFAULT_ENUMERATION_TOLERANCE;
 	//allocate the hash table
-	mem_table.resize(table_size);
+	mem_table.resize(1);
 	mem_table_count.reserve( table_size );
 	for(uint32 i=0; i < table_size; ++i)
 		mem_table_count.push_back(0);
@@ -55,11 +56,8 @@ MemHash& MemHash::operator=( const MemHash& mh ){
 	m_collision_count = mh.m_collision_count;
 	m_repeat_tolerance = mh.m_repeat_tolerance;
 	m_enumeration_tolerance = mh.m_enumeration_tolerance;
-	mem_table.resize(table_size);
-	for(uint32 i=0; i < table_size; ++i){
-		mem_table_count.push_back(mh.mem_table_count[i]);
-		mem_table[i] = mh.mem_table[i];
-	}
+	mem_table = mh.mem_table;
+	mem_table_count = mh.mem_table_count;
 	match_log = mh.match_log;
 	return *this;
 }
@@ -81,10 +79,10 @@ void MemHash::Clear()
 	m_repeat_tolerance = DEFAULT_REPEAT_TOLERANCE;
 	m_enumeration_tolerance = DEFAULT_ENUMERATION_TOLERANCE;
 	//clear the hash table
-	for(uint32 listI = 0; listI < table_size; ++listI){
-		mem_table[listI].clear();
+	for(uint32 shardI = 0; shardI < mem_table.size(); ++shardI)
+		mem_table[shardI].Clear();
+	for(uint32 listI = 0; listI < table_size; ++listI)
 		mem_table_count[ listI ] = 0;
-	}
 	match_log = NULL;
 
 	allocator.Free(allocated);
@@ -95,8 +93,8 @@ void MemHash::Clear()
 void MemHash::SetTableSize(uint32 new_table_size){
 	//allocate the hash table
 	table_size = new_table_size;
-	mem_table.clear();
-	mem_table.resize(table_size);
+	for(uint32 shardI = 0; shardI < mem_table.size(); ++shardI)
+		mem_table[shardI].Clear();
 	mem_table_count.clear();
 	mem_table_count.resize(table_size,0);
 }
@@ -141,6 +139,7 @@ boolean MemHash::EnumerateMatches( IdmerList& match_list )
 	vector< uint > enum_tally(seq_count, 0);
 	IdmerList::iterator iter = match_list.begin();
 	IdmerList hash_list;
+	hash_list.reserve( match_list.size() );
 	for(; iter != match_list.end(); ++iter)
 	{
 		if( enum_tally[iter->id] < m_enumeration_tolerance )
@@ -211,12 +210,11 @@ MatchHashEntry* MemHash::AddHashEntry(MatchHashEntry& mhe){
 	int64 offset = mhe.Offset();
 
 	uint32 bucketI = ((offset % table_size) + table_size) % table_size;
-	vector<MatchHashEntry*>::iterator insert_he;
-	insert_he = std::lower_bound(mem_table[bucketI].begin(), mem_table[bucketI].end(), &mhe, mhecomp);
-//	insert_he = mem_table[bucketI].find(&mhe);
-	if( insert_he != mem_table[bucketI].end() && (!mhecomp(*insert_he, &mhe) && !mhecomp(&mhe, *insert_he)) ){
+	MatchHashTable& shard = MemTableShard( bucketI );
+	MatchHashEntry* existing = shard.Find( mhe );
+	if( existing != NULL ){
 		++m_collision_count;
-		return *insert_he;
+		return existing;
 	}
 	
 	//if we made it this far there were no collisions
@@ -231,8 +229,7 @@ MatchHashEntry* MemHash::AddHashEntry(MatchHashEntry& mhe){
 	allocated.push_back(new_mhe);
 	
 	// can't insert until after the extend!!
-	insert_he = std::lower_bound(mem_table[bucketI].begin(), mem_table[bucketI].end(), new_mhe, mhecomp);
-	mem_table[bucketI].insert(insert_he, new_mhe);
+	shard.Insert( new_mhe );
 
 	// log it.
 	if( match_log != NULL ){
@@ -250,13 +247,39 @@ MatchHashEntry* MemHash::AddHashEntry(MatchHashEntry& mhe){
 	return new_mhe;
 }
 
+void MemHash::GetTableEntries( vector<MatchHashEntry*>& entries ) const{
+	entries.clear();
+	// the table itself is unordered, put matches back in bucket order.  each
+	// shard gets ordered on its own, then the shards are merged by taking each
+	// bucket from the shard that holds it
+	MheBucketCompare bucket_comp( table_size );
+	vector< vector< MatchHashEntry* > > shard_entries( mem_table.size() );
+	size_t entry_count = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:entry_count)
+	for( int shardI = 0; shardI < (int)mem_table.size(); ++shardI ){
+		mem_table[shardI].GetEntries( shard_entries[shardI] );
+		std::sort( shard_entries[shardI].begin(), shard_entries[shardI].end(), bucket_comp );
+		entry_count += shard_entries[shardI].size();
+	}
+	entries.reserve( entry_count );
+	vector< size_t > shard_pos( mem_table.size(), 0 );
+	for( uint32 bucketI = 0; bucketI < table_size && entries.size() < entry_count; ++bucketI ){
+		const vector< MatchHashEntry* >& shard = shard_entries[ bucketI % mem_table.size() ];
+		size_t& posI = shard_pos[ bucketI % mem_table.size() ];
+		for( ; posI < shard.size() && bucket_comp.Bucket( shard[posI] ) == bucketI; ++posI )
+			entries.push_back( shard[posI] );
+	}
+}
+
 void MemHash::PrintDistribution(ostream& os) const{
-    vector<MatchHashEntry*>::const_iterator mem_iter;
+	vector<MatchHashEntry*> entries;
+	GetTableEntries( entries );
+	MheBucketCompare bucket_comp( table_size );
+	vector<MatchHashEntry*>::const_iterator mem_iter = entries.begin();
 	gnSeqI base_count;
 	for(uint32 i=0; i < mem_table_count.size(); ++i){
-		mem_iter = mem_table[i].begin();
 		base_count = 0;
-		for(; mem_iter != mem_table[i].end(); ++mem_iter){
+		for(; mem_iter != entries.end() && bucket_comp.Bucket( *mem_iter ) == i; ++mem_iter){
 			base_count += (*mem_iter)->Length();
 		}
 		os << i << '\t' << mem_table_count[i] << '\t' << base_count << '\n';
@@ -318,12 +341,11 @@ void MemHash::WriteFile(ostream& mem_file) const{
 	}
 	mem_file << "MatchCount" << '\t' << m_mem_count << endl;
 	//get all the mems out of the hash table and write them out
-    vector<MatchHashEntry*>::const_iterator mem_table_iter;
-	for(uint32 i=0; i < table_size; i++){
-		mem_table_iter = mem_table[i].begin();
-		for(; mem_table_iter != mem_table[i].end(); mem_table_iter++)
-			mem_file << **mem_table_iter << "\n";
-	}
+	vector<MatchHashEntry*> entries;
+	GetTableEntries( entries );
+    vector<MatchHashEntry*>::const_iterator mem_table_iter = entries.begin();
+	for(; mem_table_iter != entries.end(); mem_table_iter++)
+		mem_file << **mem_table_iter << "\n";
 }
 
 
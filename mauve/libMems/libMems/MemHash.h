@@ -23,6 +23,7 @@
 #include "libMems/MatchList.h"
 #include "libMems/MatchHashEntry.h"
 #include "libMems/SlotAllocator.h"
+#include "libMems/MatchHashTable.h"
 #include "boost/pool/object_pool.hpp"
 
 namespace mems {
@@ -158,9 +159,13 @@ protected:
 	virtual void SetDirection(MatchHashEntry& mhe);
 	virtual MatchHashEntry* AddHashEntry(MatchHashEntry& mhe);
 	virtual uint32 quadratic_li(uint32 listI){return (listI*(listI+1))/2;}
+	/** @return the table shard that holds matches hashed to bucketI */
+	MatchHashTable& MemTableShard( uint32 bucketI ){ return mem_table[ bucketI % mem_table.size() ]; }
+	/** Places pointers to every match in the table into entries, ordered by bucket and then by MheCompare */
+	void GetTableEntries( std::vector<MatchHashEntry*>& entries ) const;
 		
 	uint32 table_size;
-	std::vector< std::vector<MatchHashEntry*> > mem_table;
+	std::vector< MatchHashTable > mem_table;	/**< the match table, split into one or more shards by bucket */
 	uint32 m_repeat_tolerance;
 	uint32 m_enumeration_tolerance;
 	uint64 m_mem_count;
@@ -189,15 +194,14 @@ void MemHash::GetMatchList( MatchListType& mem_list ) const {
 	typedef typename boost::remove_pointer<MatchType>::type SinPtrMatchType;
 	SinPtrMatchType mm;
 
-	for(uint32 i=0; i < table_size; ++i)
+	std::vector<MatchHashEntry*> entries;
+	GetTableEntries( entries );
+	std::vector<MatchHashEntry*>::const_iterator iter = entries.begin();
+	for(; iter != entries.end(); iter++ )
 	{
-		std::vector<MatchHashEntry*>::const_iterator iter = mem_table[i].begin();
-		for(; iter != mem_table[i].end(); iter++ )
-		{
-			MatchType m = mm.Copy();
-			*m = **iter;
-			mem_list.push_back( m );
-		}
+		MatchType m = mm.Copy();
+		*m = **iter;
+		mem_list.push_back( m );
 	}
 
 }
@@ -51,10 +51,10 @@ void MemorySML::Create(const gnSequence& seq, const uint64 seed ){
 		FillDnaSeedSML( seq, sml_array );
 	else
 		FillSML( seq, sml_array );
-	sort( sml_array.begin(), sml_array.end(), &bmer_lessthan );
-	positions.reserve( sml_array.size() );
+	RadixSortMers( sml_array );
+	positions.resize( sml_array.size() * header.position_bytes );
 	for(gnSeqI merI = 0; merI < sml_array.size(); merI++ ){
-		positions.push_back( sml_array[merI].position );
+		SetPackedPosition( &positions[0], header.position_bytes, merI, sml_array[merI].position );
 	}
 
 }
@@ -62,19 +62,19 @@ void MemorySML::Create(const gnSequence& seq, const uint64 seed ){
 boolean MemorySML::Read(vector<bmer>& readVector, gnSeqI size, gnSeqI offset )
 {
 	readVector.clear();
-	if( offset > positions.size() )
+	if( offset > PositionCount() )
 		return false;
 
 	gnSeqI last_mer = offset + size;
 	boolean success = true;
-	if( last_mer > positions.size() ){
-		last_mer = positions.size();
+	if( last_mer > PositionCount() ){
+		last_mer = PositionCount();
 		success = false;
 	}
 
 	bmer cur_mer;
 	for(gnSeqI merI = offset; merI < last_mer; merI++){
-		cur_mer.position = positions[merI];
+		cur_mer.position = PositionAt( merI );
 		cur_mer.mer = GetSeedMer( cur_mer.position );
 		readVector.push_back( cur_mer );
 	}
@@ -88,7 +88,7 @@ void MemorySML::Merge(SortedMerList& sa, SortedMerList& sa2){
 bmer MemorySML::operator[](gnSeqI index)
 {
 	bmer cur_mer;
-	cur_mer.position = positions[index];
+	cur_mer.position = PositionAt( index );
 	cur_mer.mer = GetSeedMer( cur_mer.position );
 	return cur_mer;
 }
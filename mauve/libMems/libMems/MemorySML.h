@@ -49,7 +49,15 @@ public:
 protected:
 
 //	virtual void FillSML(const gnSeqI seq_len, vector<gnSeqI>& sml_array);
-	std::vector<smlSeqI_t> positions;
+	/** @return the number of entries in the position array */
+	gnSeqI PositionCount() const{ return positions.size() / header.position_bytes; }
+	/** @return entry index of the position array, which may be empty */
+	smlSeqI_t PositionAt( gnSeqI index ) const{
+		if( (index + 1) * header.position_bytes > positions.size() )
+			Throw_gnEx( genome::IndexOutOfBounds() );
+		return GetPackedPosition( &positions[0], header.position_bytes, index );
+	}
+	std::vector<char> positions;	/**< sorted positions, packed header.position_bytes apiece */
 
 };
 
@@ -441,7 +441,6 @@ try{
 	vector< string > seq_data;
 	vector< int64 > starts;
 	vector< uint > seqs;
-	const gnFilter* rc_filter = gnFilter::DNAComplementFilter();
 	
 	for( seqI = 0; seqI < seq_count; seqI++ ){
 
@@ -471,8 +470,8 @@ try{
 		}else{
 			// reverse complement the sequence data.
 			starts.push_back( -gap_start );
-			string cur_seq_data = seq_table[ seqI ]->ToString( diff , gap_start );
-			rc_filter->ReverseFilter( cur_seq_data );
+			string cur_seq_data;
+			seq_table[ seqI ]->ToReverseComplement( cur_seq_data, diff, gap_start );
 			seq_data.push_back( cur_seq_data );
 		}
 	}
@@ -541,7 +540,6 @@ try{
 	vector< string > seq_data;
 	vector< int64 > starts;
 	vector< uint > seqs;
-	const gnFilter* rc_filter = gnFilter::DNAComplementFilter();
 	
 	//std::cout << "getting regions between match components to align" << std::endl;
 	for( seqI = 0; seqI < seq_count; seqI++ ){
@@ -599,8 +597,8 @@ try{
 			starts.push_back( -gap_start );
 			//tjt: all sequences are concatenated together into 1 seq_table entry
 			//     
-			string cur_seq_data = seq_table[ 0 ]->ToString( diff , gap_start );
-			rc_filter->ReverseFilter( cur_seq_data );
+			string cur_seq_data;
+			seq_table[ 0 ]->ToReverseComplement( cur_seq_data, diff, gap_start );
 			seq_data.push_back( cur_seq_data );
 			//std::cout << cur_seq_data << std::endl;
 		}
@@ -24,7 +24,7 @@ PairwiseMatchFinder::PairwiseMatchFinder(){
 PairwiseMatchFinder::~PairwiseMatchFinder(){
 }
 
-PairwiseMatchFinder::PairwiseMatchFinder(const PairwiseMatchFinder& mh) : MemHash(mh){
+PairwiseMatchFinder::PairwiseMatchFinder(const PairwiseMatchFinder& mh) : ParallelMemHash(mh){
 
 }
 
@@ -55,13 +55,14 @@ boolean PairwiseMatchFinder::EnumerateMatches( IdmerList& match_list ){
 	}
 	// hash each pair of unique seeds
 	boolean success = true;
+	IdmerList hash_list;
 	for( iter = unique_list.begin(); iter != unique_list.end(); ++iter )
 	{
 		for( iter2 = iter; iter2 != unique_list.end(); ++iter2 )
 		{
 			if( iter == iter2 )
 				continue;
-			IdmerList hash_list;
+			hash_list.clear();
 			hash_list.push_back( *iter );
 			hash_list.push_back( *iter2 );
 			success = success && HashMatch(hash_list);
@@ -13,14 +13,15 @@
 #include "config.h"
 #endif
 
-#include "libMems/MemHash.h"
+#include "libMems/ParallelMemHash.h"
 
 namespace mems {
 
 /**
- * Finds all pairwise matches with unique seeds among a group of sequences
+ * Finds all pairwise matches with unique seeds among a group of sequences.
+ * The search runs in parallel, see ParallelMemHash.
  */
-class PairwiseMatchFinder : public mems::MemHash
+class PairwiseMatchFinder : public mems::ParallelMemHash
 {
 public:
 	PairwiseMatchFinder();
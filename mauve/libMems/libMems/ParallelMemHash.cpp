@@ -11,6 +11,7 @@
 #endif
 
 #include "libMems/ParallelMemHash.h"
+#include "libGenome/OmpGuard.h"
 #include <vector>
 
 #ifdef _OPENMP
@@ -20,18 +21,30 @@ using namespace std;
 using namespace genome;
 namespace mems {
 
-	ParallelMemHash::ParallelMemHash() : MemHash()
+ParallelMemHash::ParallelMemHash() : MemHash()
+{
+	mem_table.resize( DEFAULT_MEM_TABLE_SHARDS );
+	InitShardLocks( DEFAULT_MEM_TABLE_SHARDS );
+}
 
+ParallelMemHash::~ParallelMemHash()
 {
+	DestroyShardLocks();
 }
 
 ParallelMemHash::ParallelMemHash(const ParallelMemHash& mh) : MemHash(mh)
 {
-	*this = mh;
+	InitShardLocks( (uint32)mem_table.size() );
 }
 
 ParallelMemHash& ParallelMemHash::operator=( const ParallelMemHash& mh ){
-	thread_mem_table = mh.thread_mem_table;
+	MemHash::operator=(mh);
+	// each instance keeps its own locks
+	if( shard_locks.size() != mem_table.size() )
+	{
+		DestroyShardLocks();
+		InitShardLocks( (uint32)mem_table.size() );
+	}
 	return *this;
 }
 
@@ -39,19 +52,32 @@ ParallelMemHash* ParallelMemHash::Clone() const{
 	return new ParallelMemHash(*this);
 }
 
+void ParallelMemHash::InitShardLocks( uint32 shard_count )
+{
+	shard_locks.resize( shard_count );
+	for( size_t lockI = 0; lockI < shard_locks.size(); lockI++ )
+		omp_init_lock( &shard_locks[lockI] );
+}
+
+void ParallelMemHash::DestroyShardLocks()
+{
+	for( size_t lockI = 0; lockI < shard_locks.size(); lockI++ )
+		omp_destroy_lock( &shard_locks[lockI] );
+	shard_locks.clear();
+}
+
 void ParallelMemHash::FindMatches( MatchList& ml ) 
 {
 	for( uint32 seqI = 0; seqI < ml.seq_table.size(); ++seqI ){
-                if( !AddSequence( ml.sml_table[ seqI ], ml.seq_table[ seqI ] ) ){
-                        ErrorMsg( "Error adding " + ml.seq_filename[seqI] + "\n");
-                        return;
-                }
-        }
+		if( !AddSequence( ml.sml_table[ seqI ], ml.seq_table[ seqI ] ) ){
+			ErrorMsg( "Error adding " + ml.seq_filename[seqI] + "\n");
+			return;
+		}
+	}
 
 	size_t CHUNK_SIZE = 200000;
 	// break up the SMLs into nice small chunks
 	vector< vector< gnSeqI > > chunk_starts;
-	vector< gnSeqI > chunk_lengths;
 
 	// set the progress counter data
 	mers_processed = 0;
@@ -81,50 +107,131 @@ void ParallelMemHash::FindMatches( MatchList& ml )
 		chunk_starts.push_back(tmp);
 	}
 
-	
-	// now that it's all chunky, search in parallel
-#pragma omp parallel for schedule(dynamic)
-	for( int i = 0; i < chunk_starts.size(); i++ )
+	// SearchRange's own progress reporting isn't meaningful when several
+	// chunks are searched at once, so report completed chunks instead
+	std::ostream* chunk_log = log_stream;
+	log_stream = NULL;
+	int chunks_done = 0;
+	// OpenMP 2.0 needs a signed loop index
+	const int chunk_count = chunk_starts.size();
+
+	// now that it's all chunky, search in parallel.  each thread keeps its
+	// allocator and match list in TLS slots, so stay within their number
+	int search_threads = omp_get_max_threads() < TLSThreadCount() ? omp_get_max_threads() : TLSThreadCount();
+#pragma omp parallel for schedule(dynamic) num_threads(search_threads)
+	for( int i = 0; i < chunk_count; i++ )
 	{
-		if(thread_mem_table.get().size() != mem_table.size())
-			thread_mem_table.get().resize( mem_table.size() );
-
-		vector< gnSeqI > chunk_lens(seq_count);
-		if( i + 1 < chunk_starts.size() )
+		vector< gnSeqI > starts = chunk_starts[i];
+		vector< gnSeqI > chunk_lens(seq_count, GNSEQI_END);
+		if( i + 1 < chunk_count )
 		{
 			for( size_t j = 0; j < seq_count; j++ )
-				chunk_lens[j] = chunk_starts[i+1][j] - chunk_starts[i][j];
-		}else
-			chunk_lens = vector< gnSeqI >( seq_count, GNSEQI_END );
-		SearchRange( chunk_starts[i], chunk_lens );
-		MergeTable();
-	}
-	GetMatchList( ml );	
-}
+				chunk_lens[j] = chunk_starts[i+1][j] - starts[j];
+		}
+		// SearchRange returns false after skipping a highly repetitive mer,
+		// in which case the search resumes from the updated start points as
+		// MatchFinder::FindMatchSeeds does.  stopping there would drop every
+		// match in the rest of the chunk
+		while( !SearchRange( starts, chunk_lens ) )
+		{
+			if( i + 1 < chunk_count )
+			{
+				for( size_t j = 0; j < seq_count; j++ )
+					chunk_lens[j] = starts[j] < chunk_starts[i+1][j] ? chunk_starts[i+1][j] - starts[j] : 0;
+			}
+		}
 
-void ParallelMemHash::MergeTable()
-{
-#pragma omp critical
-	{
-		size_t buckets = thread_mem_table.get().size();
-		for( size_t bI = 0; bI < buckets; bI++ )
+#pragma omp critical(ParallelMemHash_progress)
 		{
-			vector< MatchHashEntry* >& bucket = thread_mem_table.get()[bI];
-			for( size_t mI = 0; mI < bucket.size(); mI++ )
+			// hand this thread's new matches over so that Clear() can free them
+			vector< MatchHashEntry* >& my_allocated = thread_allocated.get();
+			allocated.insert( allocated.end(), my_allocated.begin(), my_allocated.end() );
+			my_allocated.clear();
+
+			chunks_done++;
+			if( chunk_log != NULL )
 			{
-				MemHash::AddHashEntry((*(bucket[mI])), mem_table);
-//				bucket[mI]->Free();
+				int prev_pct = ((chunks_done - 1) * 100) / chunk_count;
+				int cur_pct = (chunks_done * 100) / chunk_count;
+				if( prev_pct != cur_pct )
+				{
+					(*chunk_log) << cur_pct << "%..";
+					chunk_log->flush();
+					if( prev_pct / 10 != cur_pct / 10 )
+						(*chunk_log) << std::endl;
+				}
 			}
 		}
-		thread_mem_table.get() = mem_table;
 	}
+	log_stream = chunk_log;
+	GetMatchList( ml );	
 }
 
 
-
+// Same as MemHash::AddHashEntry, but safe to call from several threads.
+// Matches are extended without holding a lock, so two threads may extend
+// the same match concurrently.  The second one to finish finds the first
+// one's entry when it goes to insert and treats it as a collision.
 MatchHashEntry* ParallelMemHash::AddHashEntry(MatchHashEntry& mhe){
-	// do the normal procedure, but use the thread-local mem table.
-	return MemHash::AddHashEntry(mhe, thread_mem_table.get());
+	//first compute which hash table bucket this is going into
+	int64 offset = mhe.Offset();
+
+	uint32 bucketI = ((offset % table_size) + table_size) % table_size;
+	uint32 shardI = bucketI % mem_table.size();
+	MatchHashTable& shard = mem_table[ shardI ];
+	omp_lock_t& shard_lock = shard_locks[ shardI ];
+	{
+		omp_guard shard_guard( shard_lock );
+		MatchHashEntry* existing = shard.Find( mhe );
+		if( existing != NULL ){
+#pragma omp atomic
+			++m_collision_count;
+			return existing;
+		}
+	}
+
+	//if we made it this far there were no collisions
+	//extend the mem into the surrounding region.
+	vector<MatchHashEntry> subset_matches;
+	if( !mhe.Extended() )
+		ExtendMatch(mhe, subset_matches);
+
+	MatchHashEntry* new_mhe = allocator.Allocate();
+	new_mhe = new(new_mhe) MatchHashEntry(mhe); 
+
+	{
+		omp_guard shard_guard( shard_lock );
+		// can't insert until after the extend!!
+		MatchHashEntry* existing = shard.Find( *new_mhe );
+		if( existing != NULL ){
+			// another thread extended this match while we were working on it
+			shard_guard.release();
+			allocator.Free(new_mhe);
+#pragma omp atomic
+			++m_collision_count;
+			return existing;
+		}
+		shard.Insert( new_mhe );
+		++mem_table_count[bucketI];
+	}
+	thread_allocated.get().push_back(new_mhe);
+#pragma omp atomic
+	++m_mem_count;
+
+	// log it.
+	if( match_log != NULL ){
+#pragma omp critical(ParallelMemHash_log)
+		{
+			(*match_log) << *new_mhe << endl;
+			match_log->flush();
+		}
+	}
+	
+	// link up the subset matches
+	for(uint32 subsetI = 0; subsetI < subset_matches.size(); ++subsetI)
+		AddHashEntry( subset_matches[ subsetI ] );
+
+	return new_mhe;
 }
 
 
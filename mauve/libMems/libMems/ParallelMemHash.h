@@ -21,14 +21,20 @@
 
 namespace mems {
 
+/** number of independently locked shards in a ParallelMemHash match table */
+static const uint32 DEFAULT_MEM_TABLE_SHARDS = 1024;
 
 /**
  * ParallelMemHash implements an algorithm for finding exact matches of a certain minimal
  * length in several sequences.
+ * The sorted mer lists are split into chunks that are searched concurrently.  Every
+ * thread inserts matches directly into the shared match table, which is split by
+ * diagonal offset into shards that each have their own lock.
  */
 class ParallelMemHash : public MemHash {
 public:
 	ParallelMemHash();
+	~ParallelMemHash();
 	ParallelMemHash(const ParallelMemHash& mh);
 	ParallelMemHash& operator=( const ParallelMemHash& mh );
 	virtual ParallelMemHash* Clone() const;
@@ -42,9 +48,11 @@ public:
 
 protected:
 	virtual MatchHashEntry* AddHashEntry(MatchHashEntry& mhe);
-	virtual void MergeTable();
+	void InitShardLocks( uint32 shard_count );
+	void DestroyShardLocks();
 
-	TLS< std::vector< std::vector<MatchHashEntry*> > > thread_mem_table;
+	std::vector< omp_lock_t > shard_locks;	/**< shard_locks[shardI] guards mem_table[shardI] */
+	TLS< std::vector<MatchHashEntry*> > thread_allocated;	/**< matches allocated by each thread during a search */
 };
 
 
@@ -52,6 +60,8 @@ protected:
 
 #else // _OPENMP
 
+#include "libMems/MemHash.h"
+
 namespace mems {
 
 
@@ -60,9 +70,9 @@ namespace mems {
  */
 class ParallelMemHash : public MemHash {
 public:
-	ParallelMemHash() : MemHash();
-	ParallelMemHash(const ParallelMemHash& mh) : MemHash(mh);
-	ParallelMemHash& operator=( const ParallelMemHash& mh ) : MemHash::operator=(mh){ return *this; }
+	ParallelMemHash() : MemHash() {}
+	ParallelMemHash(const ParallelMemHash& mh) : MemHash(mh) {}
+	ParallelMemHash& operator=( const ParallelMemHash& mh ){ MemHash::operator=(mh); return *this; }
 	virtual ParallelMemHash* Clone() const{ return new ParallelMemHash(*this); }
 };
 
@@ -39,6 +39,12 @@
 #include <algorithm>
 #include <limits>
 #include <iomanip>
+#include <new>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "stdlib.h"
 
@@ -51,7 +57,16 @@ namespace mems {
 bool progress_msgs = false;
 
 bool debug_me = false;
-static int dbg_count = 0; 	 
+static int dbg_count = 0;
+
+/** returns a unique number for a debug dump file, alignments at several nodes may dump at once */
+static int nextDebugDumpId()
+{
+	int dump_id;
+#pragma omp atomic capture
+	dump_id = dbg_count++;
+	return dump_id;
+}
 
 
 double min_window_size = 200;
@@ -145,7 +160,9 @@ bp_dist_scale(.9),
 max_gapped_alignment_length(20000),
 bp_dist_estimate_score(-1),
 use_seed_families(false),
-using_cache_db(true)
+using_cache_db(true),
+parallel_refinement(false),
+parallel_tree_alignment(true)
 {
 	gapped_alignment = true;
 	max_window_size = max_gapped_alignment_length;
@@ -590,9 +607,10 @@ void ProgressiveAligner::pairwiseAnchorSearch( MatchList& r_list, Match* r_begin
 {
 	uint seqI = 0;
 	MatchList gap_list;
-	vector< int64 > starts;
+	int64 gap_starts[2];
+	gnSeqI gap_lens[2];
 // 
-//	Get the sequence in the intervening gaps between these two matches
+//	Locate the intervening gaps between these two matches
 //
 	for( seqI = 0; seqI < 2; seqI++ )
 	{
@@ -602,55 +620,70 @@ void ProgressiveAligner::pairwiseAnchorSearch( MatchList& r_list, Match* r_begin
 		int64 diff = gap_end - gap_start;
 		diff = diff > 0 ? diff - 1 : 0;
 
-		starts.push_back( gap_start );
-		gnSequence* new_seq = NULL;
+		gap_starts[ seqI ] = gap_start;
+		gap_lens[ seqI ] = 0;
 		if(diff > 0 && gap_start + diff - 1 <= r_list.seq_table[ seqI ]->length())
-			new_seq = new gnSequence( r_list.seq_table[ seqI ]->ToString( diff, gap_start ) );
-		else
-			new_seq = new gnSequence();
-		gap_list.seq_table.push_back( new_seq );
-		gap_list.sml_table.push_back( new DNAMemorySML() );
+			gap_lens[ seqI ] = diff;
 	}
 
-	gnSeqI avg_len = (gap_list.seq_table[0]->length() + gap_list.seq_table[1]->length())/2;
+	gnSeqI avg_len = (gap_lens[0] + gap_lens[1])/2;
 	uint search_seed_size = getDefaultSeedWeight( avg_len );
-	gap_mh.get().Clear();
+	if( search_seed_size < MIN_DNA_SEED_WEIGHT )
+		return;
 	
 	uint seed_count = use_seed_families ? 3 : 1;
-	for( size_t seedI = 0; seedI < seed_count; seedI++ )
+	if( gap_lens[0] <= SMALL_REGION_MAX_LENGTH && gap_lens[1] <= SMALL_REGION_MAX_LENGTH )
 	{
 		//
-		//	Create sorted mer lists for the intervening gap region
+		//	Small gaps are searched directly in this thread's reusable buffers
 		//
-		uint64 default_seed = getSeed( search_seed_size, seedI );
-		if( search_seed_size < MIN_DNA_SEED_WEIGHT )
+		SmallRegionMatchFinder& region_finder = gap_region_finder.get();
+		region_finder.Clear();
+		for( seqI = 0; seqI < 2; seqI++ )
+			region_finder.SetRegion( seqI, *r_list.seq_table[ seqI ], gap_starts[ seqI ], gap_lens[ seqI ] );
+		for( size_t seedI = 0; seedI < seed_count; seedI++ )
+			region_finder.FindRegionMatches( getSeed( search_seed_size, seedI ) );
+		region_finder.GetMatchList( gap_list );
+	}else{
+		for( seqI = 0; seqI < 2; seqI++ )
 		{
-			for( uint seqI = 0; seqI < gap_list.seq_table.size(); seqI++ )
-				delete gap_list.seq_table[ seqI ];
-			for( uint seqI = 0; seqI < gap_list.sml_table.size(); seqI++ )
-				delete gap_list.sml_table[ seqI ];
-			return;
-		}
-		for( uint seqI = 0; seqI < gap_list.seq_table.size(); seqI++ ){
-			gap_list.sml_table[ seqI ]->Clear();
-			gap_list.sml_table[ seqI ]->Create( *(gap_list.seq_table[ seqI ]), default_seed );
+			gnSequence* new_seq = NULL;
+			if( gap_lens[ seqI ] > 0 )
+				new_seq = new gnSequence( r_list.seq_table[ seqI ]->ToString( gap_lens[ seqI ], gap_starts[ seqI ] ) );
+			else
+				new_seq = new gnSequence();
+			gap_list.seq_table.push_back( new_seq );
+			gap_list.sml_table.push_back( new DNAMemorySML() );
 		}
 
-		//
-		//	Find all matches in the gap region
-		//
-		gap_mh.get().ClearSequences();
-		if(seed_count>1)
+		gap_mh.get().Clear();
+		for( size_t seedI = 0; seedI < seed_count; seedI++ )
 		{
-			MatchList cur_list = gap_list;
-			gap_mh.get().FindMatches( cur_list );
-			for( size_t mI = 0; mI < cur_list.size(); mI++ )
-				cur_list[mI]->Free();
-		}else
-			gap_mh.get().FindMatches( gap_list );
+			//
+			//	Create sorted mer lists for the intervening gap region
+			//
+			uint64 default_seed = getSeed( search_seed_size, seedI );
+			for( uint seqI = 0; seqI < gap_list.seq_table.size(); seqI++ ){
+				gap_list.sml_table[ seqI ]->Clear();
+				gap_list.sml_table[ seqI ]->Create( *(gap_list.seq_table[ seqI ]), default_seed );
+			}
+
+			//
+			//	Find all matches in the gap region
+			//
+			gap_mh.get().ClearSequences();
+			if(seed_count>1)
+			{
+				MatchList cur_list = gap_list;
+				gap_mh.get().FindMatches( cur_list );
+				for( size_t mI = 0; mI < cur_list.size(); mI++ )
+					cur_list[mI]->Free();
+			}else
+				gap_mh.get().FindMatches( gap_list );
+		}
+		if(seed_count>1)
+			gap_mh.get().GetMatchList(gap_list);
 	}
-	if(seed_count>1)
-		gap_mh.get().GetMatchList(gap_list);
 
 	EliminateOverlaps_v2( gap_list );
 
@@ -678,7 +711,7 @@ void ProgressiveAligner::pairwiseAnchorSearch( MatchList& r_list, Match* r_begin
 }
 
 template<class GappedAlignmentType>
-void ProgressiveAligner::recurseOnPairs( const vector<node_id_t>& node1_seqs, const vector<node_id_t>& node2_seqs, const GappedAlignmentType& iv, Matrix<MatchList>& matches, Matrix< std::vector< search_cache_t > >& search_cache_db, Matrix< std::vector< search_cache_t > >& new_cache_db, boost::multi_array< vector< vector< int64 > >, 2 >& iv_regions )
+void ProgressiveAligner::recurseOnPairs( const vector<node_id_t>& node1_seqs, const vector<node_id_t>& node2_seqs, const GappedAlignmentType& iv, Matrix<MatchList>& matches, Matrix< std::vector< search_cache_t > >& search_cache_db, Matrix< std::vector< search_cache_t > >& new_cache_db, boost::multi_array< vector< vector< int64 > >, 2 >& iv_regions, ostream& log_out )
 {
 	matches = Matrix<MatchList>(node1_seqs.size(),node2_seqs.size());
 
@@ -797,10 +830,11 @@ void ProgressiveAligner::recurseOnPairs( const vector<node_id_t>& node1_seqs, co
 				iv_regions[n1][n2][0].push_back(pair_1r.first);
 				iv_regions[n1][n2][0].push_back(pair_1r.second);
 				if( pair_1r.first <= pair_1l.second && pair_1r.second >= pair_1l.first )
+#pragma omp critical(ProgressiveAligner_log)
 				{
-					cout << "Ohno.  Overlap in outside LCB search intervals\n";
-					cout << "Left: " << pair_1l.first << '\t' << pair_1l.second << " right:  " << pair_1r.first << '\t' << pair_1r.second << endl;
-					cout << "0 iv.Start(" << seqI << "): " << iv.Start(seqI) << '\t' << "iv.RightEnd(" << seqI << "): " << iv.RightEnd(seqI) << endl;
+					log_out << "Ohno.  Overlap in outside LCB search intervals\n";
+					log_out << "Left: " << pair_1l.first << '\t' << pair_1l.second << " right:  " << pair_1r.first << '\t' << pair_1r.second << endl;
+					log_out << "0 iv.Start(" << seqI << "): " << iv.Start(seqI) << '\t' << "iv.RightEnd(" << seqI << "): " << iv.RightEnd(seqI) << endl;
 					if( pair_1l.first == 0 )
 						genome::breakHere();
 				}
@@ -822,11 +856,12 @@ void ProgressiveAligner::recurseOnPairs( const vector<node_id_t>& node1_seqs, co
 				iv_regions[n1][n2][1].push_back(pair_2r.first);
 				iv_regions[n1][n2][1].push_back(pair_2r.second);
 				if( pair_2r.first <= pair_2l.second && pair_2r.second >= pair_2l.first )
+#pragma omp critical(ProgressiveAligner_log)
 				{
-					cout << "Ohno.  Overlap in outside LCB search intervals\n";
-					cout << "Left: " << pair_2l.first << '\t' << pair_2l.second << " right:  " << pair_2r.first << '\t' << pair_2r.second << endl;
-					cout << "1 iv.Start(" << seqJ << "): " << iv.Start(seqJ) << '\t' << "iv.RightEnd(" << seqJ << "): " << iv.RightEnd(seqJ) << endl;
-					cout << "charI " << charI << "\tcharJ" << charJ << endl;
+					log_out << "Ohno.  Overlap in outside LCB search intervals\n";
+					log_out << "Left: " << pair_2l.first << '\t' << pair_2l.second << " right:  " << pair_2r.first << '\t' << pair_2r.second << endl;
+					log_out << "1 iv.Start(" << seqJ << "): " << iv.Start(seqJ) << '\t' << "iv.RightEnd(" << seqJ << "): " << iv.RightEnd(seqJ) << endl;
+					log_out << "charI " << charI << "\tcharJ" << charJ << endl;
 					if( pair_2l.first == 0 )
 						genome::breakHere();
 				}
@@ -1115,7 +1150,76 @@ void removeLargeGapsPP( GappedAlignment& gal, list< GappedAlignment* >& gal_list
 	gal_list.push_back( galp );
 }
 
-void ProgressiveAligner::refineAlignment( GappedAlignment& gal, node_id_t ancestor, bool profile_aln, AlnProgressTracker& apt )
+/** refines a single window of a gapped alignment with MUSCLE */
+void refineWindow( MuscleInterface& mi, GappedAlignment& window, bool is_gap, bool profile_aln, std::vector<size_t>& seqs1, std::vector<size_t>& seqs2 )
+{
+	if( is_gap )
+		return;	// large gaps between the two profiles are left unaligned
+	if( profile_aln )
+	{
+		GappedAlignment ga1;
+		GappedAlignment ga2;
+		splitGappedAlignment( window, ga1, ga2, seqs1, seqs2 );
+		if( ga1.Multiplicity() > 0 && ga2.Multiplicity() > 0 )
+			mi.ProfileAlignFast( ga1, ga2, window, true );
+	}else{
+		int density = IsDenseEnough( &window );
+		if( density == 0 )
+			mi.RefineFast( window );
+		else if( density == 1 )
+			mi.RefineFast( window, 500 );
+		else
+			mi.RefineFast( window, 200 );
+	}
+}
+
+void refineWindows( vector< GappedAlignment* >& windows, const vector< bool >& is_gap, bool profile_aln, std::vector<size_t>& seqs1, std::vector<size_t>& seqs2, bool parallel, AlnProgressTracker& apt, std::ostream& progress_out )
+{
+	MuscleInterface& mi = MuscleInterface::getMuscleInterface();
+	const int window_count = windows.size();
+	if( parallel )
+	{
+		// each window is an independent MUSCLE problem and MUSCLE keeps its
+		// working state in per-thread storage, so windows can be refined
+		// concurrently.  the result is identical to the serial path because
+		// each window is refined in place and keeps its position
+#ifdef _OPENMP
+		int refine_threads = omp_get_max_threads() < TLSThreadCount() ? omp_get_max_threads() : TLSThreadCount();
+#endif
+#pragma omp parallel for schedule(dynamic) num_threads(refine_threads)
+		for( int galI = 0; galI < window_count; galI++ )
+		{
+			gnSeqI window_len = windows[galI]->AlignmentLength();
+			refineWindow( mi, *windows[galI], is_gap[galI], profile_aln, seqs1, seqs2 );
+			// print a progress message as each window finishes
+#pragma omp critical(refine_progress)
+{
+			apt.cur_leftend += window_len;
+			double cur_progress = ((double)apt.cur_leftend / (double)apt.total_len)*100.0;
+			printProgress((uint)apt.prev_progress, (uint)cur_progress, progress_out);
+			apt.prev_progress = cur_progress;
+}
+		}
+		return;
+	}
+
+// the serial path keeps all calls to muscle inside a single critical section
+#pragma omp critical
+{
+	for( int galI = 0; galI < window_count; galI++ )
+	{
+		apt.cur_leftend += windows[galI]->AlignmentLength();
+		refineWindow( mi, *windows[galI], is_gap[galI], profile_aln, seqs1, seqs2 );
+
+		// print a progress message
+		double cur_progress = ((double)apt.cur_leftend / (double)apt.total_len)*100.0;
+		printProgress((uint)apt.prev_progress, (uint)cur_progress, progress_out);
+		apt.prev_progress = cur_progress;
+	}
+}
+}
+
+void ProgressiveAligner::refineAlignment( GappedAlignment& gal, node_id_t ancestor, bool profile_aln, AlnProgressTracker& apt, ostream& log_out )
 {
 	// divide the gapped alignment up into windows of a given size and have
 	// muscle refine the alignments
@@ -1170,54 +1274,13 @@ void ProgressiveAligner::refineAlignment( GappedAlignment& gal, node_id_t ancest
 		++gal_iter;
 		++gap_iter;
 	}
-	MuscleInterface& mi = MuscleInterface::getMuscleInterface();
 	// now that the alignment is all split up use muscle to refine it
-	gnSeqI new_len = 0;
-
-	gap_iter = gap_iv.begin();
-
-	const size_t gal_count = gal_list.size();
-// this section can not be paralellized b/c it makes calls to muscle
-#pragma omp critical
-{
-	for( int galI = 0; galI < gal_count; galI++ )
-	{
-		list<GappedAlignment*>::iterator my_g_iter = gal_list.begin();
-		vector<bool>::iterator my_b_iter = gap_iv.begin();
-		for(uint a = 0; a < galI; a++)
-		{
-			++my_g_iter;
-			++my_b_iter;
-		}
-		apt.cur_leftend += (*my_g_iter)->AlignmentLength();
-		if( profile_aln && !(*my_b_iter) )
-		{
-			GappedAlignment ga1;
-			GappedAlignment ga2;
-			splitGappedAlignment( **my_g_iter, ga1, ga2, seqs1, seqs2 );
-			if( ga1.Multiplicity() > 0 && ga2.Multiplicity() > 0 )
-			{
-				mi.ProfileAlignFast( ga1, ga2, **my_g_iter, true );
-			}
-		}else if(!(*my_b_iter))
-		{
-			int density = IsDenseEnough( *my_g_iter );
-			if( density == 0 )
-				mi.RefineFast( **my_g_iter );
-			else if( density == 1 )
-				mi.RefineFast( **my_g_iter, 500 );
-			else
-				mi.RefineFast( **my_g_iter, 200 );
-		}
+	vector< GappedAlignment* > gal_vec( gal_list.begin(), gal_list.end() );
+	refineWindows( gal_vec, gap_iv, profile_aln, seqs1, seqs2, parallel_refinement, apt, log_out );
 
-		new_len += (*my_g_iter)->AlignmentLength();
-		// print a progress message
-		double cur_progress = ((double)apt.cur_leftend / (double)apt.total_len)*100.0;
-		printProgress((uint)apt.prev_progress, (uint)cur_progress, cout);
-		apt.prev_progress = cur_progress;
-	}
-	gal_iter = gal_list.end();
-}
+	gnSeqI new_len = 0;
+	for( size_t galI = 0; galI < gal_vec.size(); galI++ )
+		new_len += gal_vec[galI]->AlignmentLength();
 
 	// put humpty dumpty back together
 	vector< string > aln_matrix( gal.SeqCount(), string( new_len, '-' ) );
@@ -1238,7 +1301,7 @@ void ProgressiveAligner::refineAlignment( GappedAlignment& gal, node_id_t ancest
 	gal.SetAlignment(aln_matrix);
 }
 
-void ProgressiveAligner::doGappedAlignment( node_id_t ancestor, bool profile_aln )
+void ProgressiveAligner::doGappedAlignment( node_id_t ancestor, bool profile_aln, ostream& log_out )
 {
 	AlnProgressTracker apt;
 	gnSeqI total_len = 0;
@@ -1247,7 +1310,7 @@ void ProgressiveAligner::doGappedAlignment( node_id_t ancestor, bool profile_aln
 	apt.total_len = total_len;
 	apt.prev_progress = 0;
 
-	printProgress(-1, 0, cout);
+	printProgress(-1, 0, log_out);
 	apt.cur_leftend = 1;
 
 	for( size_t aI = 0; aI < alignment_tree[ancestor].ordering.size(); aI++ )
@@ -1259,33 +1322,33 @@ void ProgressiveAligner::doGappedAlignment( node_id_t ancestor, bool profile_aln
 		}
 
 //		printMemUsage();
-//		cout << "extract aln\n";
+//		log_out << "extract aln\n";
 		GappedAlignment gal;
 		extractAlignment(ancestor, aI, gal);
 //		printMemUsage();
-//		cout << "refine aln\n";
+//		log_out << "refine aln\n";
 		if( gal.Multiplicity() > 1 )	// no point in refining intervals that are unaligned anyways
-			refineAlignment( gal, ancestor, profile_aln, apt );
+			refineAlignment( gal, ancestor, profile_aln, apt, log_out );
 		else
 			apt.cur_leftend += gal.AlignmentLength();
 //		printMemUsage();
-//		cout << "construct siv\n";
+//		log_out << "construct siv\n";
 		ConstructSuperIntervalFromMSA(ancestor, aI, gal);
 //		printMemUsage();
 
 		// print a progress message
 		double cur_progress = ((double)apt.cur_leftend / (double)apt.total_len)*100.0;
-		printProgress((uint)apt.prev_progress, (uint)cur_progress, cout);
+		printProgress((uint)apt.prev_progress, (uint)cur_progress, log_out);
 		apt.prev_progress = cur_progress;
 	}
 	printMemUsage();
-	cout << "Fix left ends\n";
+	log_out << "Fix left ends\n";
 	FixLeftEnds(ancestor);
 	printMemUsage();
 
 	if( debug_aligner )
 		validateSuperIntervals(alignment_tree[ancestor].children[0], alignment_tree[ancestor].children[1], ancestor);
-	cout << "\ndone.\n";
+	log_out << "\ndone.\n";
 }
 
 void ProgressiveAligner::FixLeftEnds( node_id_t ancestor )
@@ -2027,8 +2090,13 @@ int cachecomp( const void* e1, const void* e2 )
 	return a ? -1 : 1;
 }
 
-void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2, node_id_t ancestor )
+void ProgressiveAligner::alignProfileToProfile( NodeAlignmentContext& context )
 {
+	const node_id_t node1 = context.node1;
+	const node_id_t node2 = context.node2;
+	const node_id_t ancestor = context.ancestor;
+	ostream& log_out = *context.log;
+
 	// 1) find all pairwise matches
 	// 2) convert to pairwise matches among the ancestral sequences
 	//    - delete inconsistently aligned regions?
@@ -2048,7 +2116,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 	gnSeqI prev_ancestral_seq_len = (std::numeric_limits<gnSeqI>::max)();
 
 	printMemUsage();
-	cout << "get ancestral matches\n";
+	log_out << "get ancestral matches\n";
 
 	Matrix<MatchList> pairwise_matches( node1_seqs.size(), node2_seqs.size() );
 //	getPairwiseMatches( node1_seqs, node2_seqs, pairwise_matches );
@@ -2056,7 +2124,13 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 	getRepresentativeAncestralMatches( node1_seqs, node2_seqs, node1, node2, ancestor, anc_pairwise_matches );
 	printMemUsage();
 	
-	PhyloTree< AlignmentTreeNode > aln_tree_backup;
+	// only the orderings at and below the ancestor change while searching for
+	// anchors, so back up those instead of the whole tree.  other subtrees of
+	// the alignment tree may be under alignment at the same time
+	const vector< node_id_t >& subtree_nodes = context.subtree;
+	vector< vector< SuperInterval > > aln_tree_backup( subtree_nodes.size() );
+	for( size_t nI = 0; nI < subtree_nodes.size(); nI++ )
+		aln_tree_backup[nI] = alignment_tree[subtree_nodes[nI]].ordering;
 
 	/** A cache of regions that were searched in the previous round of recursion */
 	Matrix< std::vector< search_cache_t > > search_cache_db(node1_seqs.size(), node2_seqs.size());
@@ -2083,8 +2157,8 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 			{
 				for( seqJ = 0; seqJ < node2_seqs.size(); seqJ++ )
 				{
-					cout << node_sequence_map[node1_seqs[seqI]] << "," << node_sequence_map[node2_seqs[seqJ]] << " has " << pairwise_matches(seqI,seqJ).size() << " pairwise matches\n";
-					cout.flush();
+					log_out << node_sequence_map[node1_seqs[seqI]] << "," << node_sequence_map[node2_seqs[seqJ]] << " has " << pairwise_matches(seqI,seqJ).size() << " pairwise matches\n";
+					log_out.flush();
 
 					vector< AbstractMatch* > am_list( pairwise_matches(seqI, seqJ).begin(), pairwise_matches(seqI, seqJ).end() );
 					pairwise_matches(seqI, seqJ).clear();
@@ -2121,8 +2195,8 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 
 		if( !collinear_genomes )
 		{
-			cout << "Performing Sum-of-pairs Greedy Breakpoint Elimination\n";
-			cout.flush();
+			log_out << "Performing Sum-of-pairs Greedy Breakpoint Elimination\n";
+			log_out.flush();
 			// project the pairwise matches at this node to all-possible pairs matches at descendant nodes
 			// keep a mapping of ancestral to extant matches so that when an ancestral match gets removed
 			// the match among extant nodes also gets removed
@@ -2134,13 +2208,13 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 			//
 			// translate the matches into LcbTrackingMatches
 			printMemUsage();
-			cout << "construct LCB tracking matches\n";
+			log_out << "construct LCB tracking matches\n";
 			vector< TrackingMatch > tracking_matches;
 			boost::multi_array< size_t, 3 > tm_lcb_id_array;
 			boost::multi_array< double, 3 > tm_score_array;
 			constructLcbTrackingMatches( ancestor, ancestral_matches, tracking_matches );
 
-			cout << "There are " << tracking_matches.size() << " tracking matches\n";
+			log_out << "There are " << tracking_matches.size() << " tracking matches\n";
 			size_t used_components = 0;
 			for( size_t tmI = 0; tmI < tracking_matches.size(); ++tmI )
 			{
@@ -2149,7 +2223,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 						used_components++;
 			}
 			size_t total_components = tracking_matches.size() == 0 ? 0 : tracking_matches.size() * tracking_matches[0].node_match->SeqCount();
-			cout << "There are " << used_components << " / " << total_components << " components used\n";
+			log_out << "There are " << used_components << " / " << total_components << " components used\n";
 
 			vector<node_id_t> node1_descendants;
 			vector<node_id_t> node2_descendants;
@@ -2166,10 +2240,10 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 			// score the matches
 			//
 			printMemUsage();
-			cout << "init tracking match LCB tracking\n";
+			log_out << "init tracking match LCB tracking\n";
 			initTrackingMatchLCBTracking( tracking_matches, node1_descendants.size(), node2_descendants.size(), tm_lcb_id_array );
 			printMemUsage();
-			cout << "pairwise score tracking matches\n";
+			log_out << "pairwise score tracking matches\n";
 			pairwiseScoreTrackingMatches( tracking_matches, node1_descendants, node2_descendants, tm_score_array );
 			printMemUsage();
 
@@ -2184,7 +2258,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 				t_matches[mI] = &tracking_matches[mI];
 
 			// now sort these out into pairwise LCBs
-			cout << "get pairwise LCBs\n";
+			log_out << "get pairwise LCBs\n";
 			size_t pair_lcb_count = 0;
 			PairwiseLCBMatrix pairwise_adj_mat(boost::extents[node1_descendants.size()][node2_descendants.size()]);
 			for( uint nodeI = 0; nodeI < node1_descendants.size(); nodeI++ )
@@ -2193,7 +2267,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 					getPairwiseLCBs( node1_descendants[nodeI], node2_descendants[nodeJ], nodeI, nodeJ, t_matches, pairwise_adj_mat[nodeI][nodeJ], tm_score_array, tm_lcb_id_array );
 					pair_lcb_count += pairwise_adj_mat[nodeI][nodeJ].size();
 				}
-			cout << "there are " << pair_lcb_count << " pairwise LCBs\n";
+			log_out << "there are " << pair_lcb_count << " pairwise LCBs\n";
 			printMemUsage();
 
 			sort( t_matches.begin(), t_matches.end() );
@@ -2223,11 +2297,11 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 			// are penalized as the sum of /participating/ descendants.  a descendant is participating
 			// if it has some matching region defined within the LCB and if removal of that matching region
 			// eliminates a breakpoint in the pairwise comparison
-			cout << "scaling bp penalty by conservation weight:\n";
-			print2d_matrix(cons_dist_mat, cout);
-			cout << "\n\nscaling bp penalty by bp weight: \n";
-			print2d_matrix(bp_dist_mat, cout);
-			cout << "\nGreedy BPE\n";
+			log_out << "scaling bp penalty by conservation weight:\n";
+			print2d_matrix(cons_dist_mat, log_out);
+			log_out << "\n\nscaling bp penalty by bp weight: \n";
+			print2d_matrix(bp_dist_mat, log_out);
+			log_out << "\nGreedy BPE\n";
 			vector< TrackingMatch* > final;
 			if(scoring_scheme == AncestralScoring)
 			{
@@ -2238,16 +2312,18 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 				EvenFasterSumOfPairsBreakpointScorer spbs( breakpoint_penalty, min_breakpoint_penalty, bp_dist_mat, cons_dist_mat, 
 					t_matches, pairwise_adj_mat, node1_descendants, node2_descendants, 
 					tm_score_array, tm_lcb_id_array, d1_index, d1_index+1, d2_index, d2_index+1 );
-				cur_anchoring_score = greedySearch( spbs );
+				spbs.setStatusOut( &log_out );
+				cur_anchoring_score = greedySearch( spbs, &log_out );
 				final = spbs.getResults();
 			}else{
 				EvenFasterSumOfPairsBreakpointScorer spbs( breakpoint_penalty, min_breakpoint_penalty, bp_dist_mat, cons_dist_mat, 
 					t_matches, pairwise_adj_mat, node1_descendants, node2_descendants, 
 					tm_score_array, tm_lcb_id_array, 0, node1_descendants.size(), 0, node2_descendants.size() );
-				cur_anchoring_score = greedySearch( spbs );
+				spbs.setStatusOut( &log_out );
+				cur_anchoring_score = greedySearch( spbs, &log_out );
 				final = spbs.getResults();
 			}
-			cout << "done\n";
+			log_out << "done\n";
 
 			// free memory used by pairwise projections
 			for( size_t mI = 0; mI < tracking_matches.size(); ++mI )
@@ -2294,7 +2370,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 
 			// want to eliminate all breakpoints
 			SimpleBreakpointScorer wbs( adjacencies, score_sum, true );
-			cur_min_coverage = greedyBreakpointElimination_v4( adjacencies, lcb_scores, wbs, NULL, false );
+			greedyBreakpointElimination_v4( adjacencies, lcb_scores, wbs, NULL, false );
 			vector<AbstractMatch*> deleted_matches;
 			filterMatches_v2( adjacencies, LCB_list, lcb_scores, deleted_matches );
 			for( size_t delI = 0; delI < deleted_matches.size(); ++delI )
@@ -2304,7 +2380,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 
 		ancestral_matches.clear();
 
-		cout << "Arrived at " << LCB_list.size() << " intervals\n";
+		log_out << "Arrived at " << LCB_list.size() << " intervals\n";
 		// create an ancestral ordering
 		vector< Interval* > pairwise_intervals;
 		Interval tmp_iv;
@@ -2321,40 +2397,40 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 		for( size_t aI = 0; aI < alignment_tree[node2].ordering.size(); ++aI )
 			seq_lengths[1] += alignment_tree[node2].ordering[aI].Length();
 
-		cout << "Adding unaligned intervals\n";
+		log_out << "Adding unaligned intervals\n";
 		addUnalignedIntervals_v2(pairwise_intervals, set<uint>(), seq_lengths);
 
-		cout << "addUnalignedIntervals yields " << pairwise_intervals.size() << " intervals\n";
+		log_out << "addUnalignedIntervals yields " << pairwise_intervals.size() << " intervals\n";
 
 		bool borked = false;
 		if(debug_aligner)
 			borked = validatePairwiseIntervals(node1, node2, pairwise_intervals);
 
 		// merge unaligned intervals
-		cout << "Merging unaligned intervals\n";
-		cout.flush();
+		log_out << "Merging unaligned intervals\n";
+		log_out.flush();
 		vector<Interval*> new_list1;
 		vector<Interval*> merged_intervals;
 		mergeUnalignedIntervals( 1, pairwise_intervals, new_list1 );
 		mergeUnalignedIntervals( 0, new_list1, merged_intervals );
-		cout << "Marbling gaps\n";
-		cout.flush();
+		log_out << "Marbling gaps\n";
+		log_out.flush();
 		for( size_t ivI = 0; ivI < merged_intervals.size(); ivI++ )
-			merged_intervals[ivI]->Marble(50);
+			merged_intervals[ivI]->Marble(50, &context.random);
 
-		cout << "Propagating descendant breakpoints\n";
+		log_out << "Propagating descendant breakpoints\n";
 
 		// split up intervals at descendant's breakpoints
 		propagateDescendantBreakpoints( node1, 0, merged_intervals );
 		propagateDescendantBreakpoints( node2, 1, merged_intervals );
 
-		cout << "descendant 0(" << node1 << ") has " << alignment_tree[node1].ordering.size() << " intervals\n";
-		cout << "descendant 1(" << node2 << ") has " << alignment_tree[node2].ordering.size() << " intervals\n";
-		cout << "propagateDescendantBreakpoints yields " << merged_intervals.size() << " intervals\n";
+		log_out << "descendant 0(" << node1 << ") has " << alignment_tree[node1].ordering.size() << " intervals\n";
+		log_out << "descendant 1(" << node2 << ") has " << alignment_tree[node2].ordering.size() << " intervals\n";
+		log_out << "propagateDescendantBreakpoints yields " << merged_intervals.size() << " intervals\n";
 
 		if(debug_aligner)
 			borked = validatePairwiseIntervals(node1, node2, merged_intervals);
-		cout << "Creating ancestral ordering\n";
+		log_out << "Creating ancestral ordering\n";
 		alignment_tree[ancestor].ordering.clear();
 		createAncestralOrdering( merged_intervals, alignment_tree[ancestor].ordering );
 		for( size_t ivI = 0; ivI < merged_intervals.size(); ivI++ )
@@ -2370,9 +2446,9 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 			cur_ancestral_seq_len += alignment_tree[ancestor].ordering[aI].Length();
 
 		if( !collinear_genomes )
-			cout << "Previous anchoring score: " << prev_anchoring_score << ", new anchor score: " << cur_anchoring_score << endl;
+			log_out << "Previous anchoring score: " << prev_anchoring_score << ", new anchor score: " << cur_anchoring_score << endl;
 		else
-			cout << "Prev alignment len: " << prev_ancestral_seq_len << ", new alignment length: " << cur_ancestral_seq_len << endl;
+			log_out << "Prev alignment len: " << prev_ancestral_seq_len << ", new alignment length: " << cur_ancestral_seq_len << endl;
 		// if cur_seq_len has decreased then we're improving
 		// if not, then we're done finding matches
 		if( collinear_genomes && cur_ancestral_seq_len >= prev_ancestral_seq_len )
@@ -2387,12 +2463,13 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 		prev_ancestral_seq_len = cur_ancestral_seq_len;
 
 		// accept the new alignment tree...
-		cout << "Backing up alignment tree...\n";
-		cout.flush();
-		aln_tree_backup = alignment_tree;
+		log_out << "Backing up alignment tree...\n";
+		log_out.flush();
+		for( size_t nI = 0; nI < subtree_nodes.size(); nI++ )
+			aln_tree_backup[nI] = alignment_tree[subtree_nodes[nI]].ordering;
 
-		cout << "propagating ancestral breakpoints\n";
-		cout.flush();
+		log_out << "propagating ancestral breakpoints\n";
+		log_out.flush();
 		recursiveApplyAncestralBreakpoints(ancestor);
 
 
@@ -2415,10 +2492,10 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 						check = check || computeID( gal, ii, jj ) < .5;
 					}
 				}
-				if( check )
-					cerr << "check iv " << aI << " dbg_count " << dbg_count << endl;
-				else
+				if( !check )
 					continue;
+				int dump_id = nextDebugDumpId();
+				cerr << "check iv " << aI << " dbg_count " << dump_id << endl;
 
 				const vector< string >& aln_mat = GetAlignment(gal, this->original_ml.seq_table); 	 
 				gnSequence seq; 	 
@@ -2427,7 +2504,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 						seq += aln_mat[seqI]; 	 
 
 				stringstream dbg_fname; 	 
-				dbg_fname << "prof_dbg_iv_" << aI << ".dbg." << dbg_count++ << ".fas"; 	 
+				dbg_fname << "prof_dbg_iv_" << aI << ".dbg." << dump_id << ".fas"; 	 
 				ofstream debug_file( dbg_fname.str().c_str() ); 	 
 				gnFASSource::Write( seq, debug_file, false ); 	 
 				debug_file.close(); 	 
@@ -2440,8 +2517,8 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 		if(recursive)
 		{
 		// search for additional alignment anchors
-		cout << "recursive anchor search\n";
-		cout.flush();
+		log_out << "recursive anchor search\n";
+		log_out.flush();
 		Matrix<MatchList> matches;
 		Matrix< std::vector< search_cache_t > > new_cache_db(node1_seqs.size(), node2_seqs.size());
 		// initialize storage for intervening regions
@@ -2454,7 +2531,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 		{
 			CompactGappedAlignment<> cga;
 			extractAlignment(ancestor, aI, cga);
-			recurseOnPairs(node1_seqs, node2_seqs, cga, matches, search_cache_db, new_cache_db, iv_regions);
+			recurseOnPairs(node1_seqs, node2_seqs, cga, matches, search_cache_db, new_cache_db, iv_regions, log_out);
 
 			// add any new matches to the pairwise_matches matrix
 			for( seqI = 0; seqI < node1_seqs.size(); seqI++ )
@@ -2481,7 +2558,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 				new_matches.seq_table[0] = bseqs[seqI];
 				new_matches.seq_table[1] = bseqs[node1_seqs.size() + seqJ];
 				SearchLCBGaps( new_matches, iv_regions[seqI][seqJ], nway_mh );
-				cout << seqI << "," << seqJ << " have " << new_matches.size() << " new matches outside LCBs\n";
+				log_out << seqI << "," << seqJ << " have " << new_matches.size() << " new matches outside LCBs\n";
 				pairwise_matches(seqI, seqJ).insert( pairwise_matches(seqI, seqJ).end(), new_matches.begin(), new_matches.end() );
 			}
 
@@ -2516,7 +2593,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 					new_cache_db(seqI, seqJ).clear();
 				}
 				if( pairwise_matches(seqI,seqJ).size() > 0 )
-					cout << seqI << "," << seqJ << " has an additional " << pairwise_matches(seqI,seqJ).size() << " matches\n";
+					log_out << seqI << "," << seqJ << " has an additional " << pairwise_matches(seqI,seqJ).size() << " matches\n";
 			}
 		}
 		
@@ -2525,9 +2602,10 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 
 		// restore backed up tree since we only want the final set of ancestral
 		// breakpoints applied to the descendants
-		cout << "Restoring backed up alignment tree...\n";
-		cout.flush();
-		swap( alignment_tree, aln_tree_backup );
+		log_out << "Restoring backed up alignment tree...\n";
+		log_out.flush();
+		for( size_t nI = 0; nI < subtree_nodes.size(); nI++ )
+			alignment_tree[subtree_nodes[nI]].ordering.swap( aln_tree_backup[nI] );
 
 	}	// end while(true)
 
@@ -2548,8 +2626,9 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 	printMemUsage();
 
 	// aln_tree_backup has the highest scoring alignment_tree
-	swap( alignment_tree, aln_tree_backup );
-	cout << "propagating ancestral breakpoints\n";
+	for( size_t nI = 0; nI < subtree_nodes.size(); nI++ )
+		alignment_tree[subtree_nodes[nI]].ordering.swap( aln_tree_backup[nI] );
+	log_out << "propagating ancestral breakpoints\n";
 	recursiveApplyAncestralBreakpoints(ancestor);
 
 	printMemUsage();
@@ -2557,17 +2636,17 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 	// step 8) construct a muscle alignment in each intervening region
 	if( gapped_alignment )
 	{
-		cout << "performing a gapped alignment\n";
-		doGappedAlignment(ancestor, true);
+		log_out << "performing a gapped alignment\n";
+		doGappedAlignment(ancestor, true, log_out);
 	}else
-		cout << "skipping gapped alignment\n";
+		log_out << "skipping gapped alignment\n";
 	if( refine )
 	{
 		size_t unrefined = countUnrefined( alignment_tree, ancestor );
 		if( unrefined > 5 && ancestor != alignment_tree.root )
 		{
-			cout << "performing iterative refinement\n";
-			doGappedAlignment(ancestor, false);
+			log_out << "performing iterative refinement\n";
+			doGappedAlignment(ancestor, false, log_out);
 			markAsRefined( alignment_tree, ancestor );
 		}
 	}
@@ -2579,7 +2658,6 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 		for( size_t aI = 0; aI < alignment_tree[ancestor].ordering.size(); aI++ ) 	 
 		{ 	 
 
-			static int dbg_count = 0; 	 
 			GappedAlignment gal; 	 
 			extractAlignment(ancestor, aI, gal); 	 
 
@@ -2595,10 +2673,10 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 					check = check || computeID( gal, ii, jj ) < .5;
 				}
 			}
-			if( check )
-				cerr << "check iv " << aI << " dbg_count " << dbg_count << endl;
-			else
+			if( !check )
 				continue;
+			int dump_id = nextDebugDumpId();
+			cerr << "check iv " << aI << " dbg_count " << dump_id << endl;
 
 			const vector< string >& aln_mat = GetAlignment(gal, this->original_ml.seq_table); 	 
 			gnSequence seq; 	 
@@ -2607,7 +2685,7 @@ void ProgressiveAligner::alignProfileToProfile( node_id_t node1, node_id_t node2
 					seq += aln_mat[seqI]; 	 
 
 			stringstream dbg_fname; 	 
-			dbg_fname << "prof_dbg_iv_" << aI << ".dbg." << dbg_count++ << ".fas"; 	 
+			dbg_fname << "prof_dbg_iv_" << aI << ".dbg." << dump_id << ".fas"; 	 
 			ofstream debug_file( dbg_fname.str().c_str() ); 	 
 			gnFASSource::Write( seq, debug_file, false ); 	 
 			debug_file.close(); 	 
@@ -2941,7 +3019,17 @@ bool ProgressiveAligner::validatePairwiseIntervals(node_id_t node1, node_id_t no
 
 void ProgressiveAligner::alignNodes( node_id_t node1, node_id_t node2, node_id_t ancestor )
 {
-	cout << "Aligning node " << node1 << " to " << node2 << " via " << ancestor << "!\n";
+	NodeAlignmentContext context( node1, node2, ancestor, false );
+	getDescendants( alignment_tree, ancestor, context.subtree );
+	alignNodes( context );
+}
+
+void ProgressiveAligner::alignNodes( NodeAlignmentContext& context )
+{
+	const node_id_t node1 = context.node1;
+	const node_id_t node2 = context.node2;
+	const node_id_t ancestor = context.ancestor;
+	*context.log << "Aligning node " << node1 << " to " << node2 << " via " << ancestor << "!\n";
 	// if node1 and node2 are not already children of ancestor then make it so...
 	if( alignment_tree[node1].parents[0] != ancestor || 
 		alignment_tree[node2].parents[0] != ancestor )
@@ -2950,7 +3038,7 @@ void ProgressiveAligner::alignNodes( node_id_t node1, node_id_t node2, node_id_t
 		cerr << "rotten\n";
 	}
 	
-	alignProfileToProfile(node1, node2, ancestor);
+	alignProfileToProfile( context );
 
 	// mark edges as aligned
 	markAligned( alignment_tree, node1, node2 );
@@ -3724,31 +3812,211 @@ void ProgressiveAligner::alignPP(IntervalList& prof1, IntervalList& prof2, Inter
 
 }
 
+const node_id_t AlignmentSchedule::NO_OWNER;
+
+void AlignmentSchedule::recordError()
+{
+	// C++98 has no exception_ptr, so keep a copy of each kind we can throw again
+	ErrorType type;
+	std::vector< gnException > gne_copy;
+	std::string what;
+	const char* message = NULL;
+	try{
+		throw;
+	}catch( gnException& gne ){
+		type = GN_ERROR;
+		gne_copy.push_back( gne );
+	}catch( std::bad_alloc& ){
+		type = BAD_ALLOC_ERROR;
+	}catch( std::exception& e ){
+		type = STD_ERROR;
+		what = e.what();
+	}catch( const char* m ){
+		type = MESSAGE_ERROR;
+		message = m;
+	}catch( ... ){
+		type = UNKNOWN_ERROR;
+	}
+#pragma omp critical(ProgressiveAligner_schedule)
+{
+	if( error == NO_ERROR )
+	{
+		error = type;
+		gn_error.swap( gne_copy );
+		error_what = what;
+		error_message = message;
+	}
+}
+}
+
+void AlignmentSchedule::rethrowError() const
+{
+	switch( error )
+	{
+		case NO_ERROR:
+			return;
+		case GN_ERROR:
+			throw gn_error.front();
+		case BAD_ALLOC_ERROR:
+			throw std::bad_alloc();
+		case STD_ERROR:
+			throw std::runtime_error( error_what );
+		case MESSAGE_ERROR:
+			throw error_message;
+		default:
+			throw "Unknown exception while aligning a guide tree subtree";
+	}
+}
+
+void ProgressiveAligner::alignReadyNode( node_id_t ancestor, AlignmentSchedule* schedule )
+{
+	// when other tasks may be running, hold this alignment's messages back
+	// so they don't interleave with theirs
+	bool concurrent = false;
+#ifdef _OPENMP
+	concurrent = omp_in_parallel() != 0;
+#endif
+	NodeAlignmentContext context( alignment_tree[ancestor].children[0], alignment_tree[ancestor].children[1], ancestor, concurrent );
+	getDescendants( alignment_tree, ancestor, context.subtree );
+
+	// claim the subtree.  an ancestor only becomes ready once both of its
+	// children are done, so no running task may own any node below it
+	bool claimed = true;
+	bool aborted = false;
+#pragma omp critical(ProgressiveAligner_schedule)
+{
+	aborted = schedule->error != AlignmentSchedule::NO_ERROR;
+	for( size_t nI = 0; nI < context.subtree.size(); nI++ )
+		if( schedule->owner[ context.subtree[nI] ] != AlignmentSchedule::NO_OWNER )
+			claimed = false;
+	if( claimed )
+		for( size_t nI = 0; nI < context.subtree.size(); nI++ )
+			schedule->owner[ context.subtree[nI] ] = ancestor;
+}
+	// exceptions can not leave a task, so getAlignment() throws once all tasks are done
+	if( !claimed )
+	{
+		breakHere();
+		cerr << "Node " << ancestor << " overlaps a subtree that is still being aligned\n";
+#pragma omp critical(ProgressiveAligner_schedule)
+		schedule->failed = true;
+		return;
+	}
+
+	// another alignment already failed, so the root can never be reached
+	bool failed = aborted;
+	if( !aborted )
+	{
+		try{
+			alignNodes( context );
+		}catch( ... ){
+			schedule->recordError();
+			failed = true;
+		}
+	}
+
+	if( context.log == &context.buffer )
+	{
+#pragma omp critical(ProgressiveAligner_log)
+{
+		cout << context.buffer.str();
+		cout.flush();
+}
+	}
+
+	// release the subtree.  the parent becomes ready once its last child has
+	// been aligned.  the root is left for getAlignment()
+	node_id_t parent = alignment_tree[ancestor].parents[0];
+	uint remaining;
+#pragma omp critical(ProgressiveAligner_schedule)
+{
+	for( size_t nI = 0; nI < context.subtree.size(); nI++ )
+		schedule->owner[ context.subtree[nI] ] = AlignmentSchedule::NO_OWNER;
+	remaining = --schedule->unaligned_children[parent];
+	failed = failed || schedule->error != AlignmentSchedule::NO_ERROR;
+}
+	if( remaining == 0 && parent != alignment_tree.root && !failed )
+	{
+#pragma omp task firstprivate(parent)
+		alignReadyNode( parent, schedule );
+	}
+}
+
+void ProgressiveAligner::alignTreeConcurrently()
+{
+	// an ancestor can be aligned as soon as both of its children have been.
+	// an alignment changes only the nodes in its own subtree, which
+	// alignReadyNode() claims in the schedule, and keeps its log in its own
+	// context, so every ancestor whose children are ready is aligned
+	// concurrently as its own task
+	AlignmentSchedule schedule;
+	schedule.unaligned_children.resize( alignment_tree.size(), 0 );
+	schedule.owner.resize( alignment_tree.size(), AlignmentSchedule::NO_OWNER );
+	vector< uint >& unaligned_children = schedule.unaligned_children;
+	vector< node_id_t > ready_nodes;
+	for( node_id_t nodeI = 0; nodeI < alignment_tree.size(); nodeI++ )
+	{
+		if( alignment_tree[nodeI].sequence != NULL )
+			continue;
+		for( size_t childI = 0; childI < alignment_tree[nodeI].children.size(); childI++ )
+			if( alignment_tree[ alignment_tree[nodeI].children[childI] ].sequence == NULL )
+				unaligned_children[nodeI]++;
+		if( unaligned_children[nodeI] == 0 && nodeI != alignment_tree.root )
+			ready_nodes.push_back( nodeI );
+	}
+	AlignmentSchedule* pending = &schedule;
+#pragma omp parallel
+{
+#pragma omp single
+{
+	for( size_t readyI = 0; readyI < ready_nodes.size(); readyI++ )
+	{
+		node_id_t ancestor = ready_nodes[readyI];
+#pragma omp task firstprivate(ancestor)
+		alignReadyNode( ancestor, pending );
+	}
+}
+}
+	if( schedule.failed )
+		throw "Concurrent alignment tasks claimed overlapping guide tree subtrees";
+	schedule.rethrowError();
+
+	// nothing else can run alongside the root, so align it outside the task
+	// region where its own parallel loops get the whole team
+	if( alignment_tree[alignment_tree.root].sequence == NULL )
+		alignNodes( alignment_tree[alignment_tree.root].children[0], alignment_tree[alignment_tree.root].children[1], alignment_tree.root );
+}
+
 void ProgressiveAligner::getAlignment( IntervalList& interval_list )
 {
 	cout << "Aligning...\n";
-	// pick each pair of sequences and align until none are left
-	while(true)
+	if( parallel_tree_alignment )
+		alignTreeConcurrently();
+	else
 	{
-		node_id_t node1;
-		node_id_t node2;
-		node_id_t ancestor;
-		chooseNextAlignmentPair( alignment_tree, node1, node2, ancestor );
-		if( node1 == node2 )
-			break;	// all pairs have been aligned
-
-		// this is the last alignable pair in the unrooted tree
-		// create a root from which the complete alignment can be extracted
-		alignNodes( node1, node2, ancestor );
-		if( ancestor == alignment_tree.root )
-			break;  // all done
+		// pick each pair of sequences and align until none are left
+		while(true)
+		{
+			node_id_t node1;
+			node_id_t node2;
+			node_id_t ancestor;
+			chooseNextAlignmentPair( alignment_tree, node1, node2, ancestor );
+			if( node1 == node2 )
+				break;	// all pairs have been aligned
+
+			// this is the last alignable pair in the unrooted tree
+			// create a root from which the complete alignment can be extracted
+			alignNodes( node1, node2, ancestor );
+			if( ancestor == alignment_tree.root )
+				break;  // all done
+		}
 	}
 
 	if( refine )
 	{
 		// perform iterative refinement
 		cout << "Performing final pass iterative refinement\n";
-		doGappedAlignment(alignment_tree.root, false);
+		doGappedAlignment(alignment_tree.root, false, cout);
 	}
 
 	// peel off the alignment from the root node
@@ -3899,7 +4167,11 @@ void ProgressiveAligner::align( vector< gnSequence* >& seq_table, IntervalList&
 #pragma omp parallel for
 		for( int seqI = 0; seqI < seq_count; seqI++ )
 		{
-			sol_list[seqI].construct(*(mlist.sml_table[seqI]));
+			// lists of file based SMLs get cached next to the SML
+			if( (size_t)seqI < mlist.sml_filename.size() && mlist.sml_filename[seqI].size() > 0 )
+				sol_list[seqI].construct(*(mlist.sml_table[seqI]), mlist.sml_filename[seqI]);
+			else
+				sol_list[seqI].construct(*(mlist.sml_table[seqI]));
 //			delete w11_mlist.sml_table[seqI];
 		}
 //		w11_mlist.sml_table.clear();
@@ -21,9 +21,11 @@
 #include "libMems/Islands.h"
 #include <boost/type_traits/remove_pointer.hpp>
 #include <boost/multi_array.hpp>
+#include <sstream>
 #include "libMems/SeedOccurrenceList.h"
 #include "libMems/SubstitutionMatrix.h"
 #include "libMems/MatchProjectionAdapter.h"
+#include "libMems/SmallRegionMatchFinder.h"
 
 namespace mems
 {
@@ -47,6 +49,68 @@ public:
 
 double getDefaultBreakpointPenalty( std::vector< genome::gnSequence* >& sequences );
 
+/**
+ * Refines each window of a gapped alignment in place with MUSCLE.  Windows
+ * flagged in is_gap are left unaligned.  When parallel is true the windows are
+ * refined concurrently, otherwise one at a time.  Either way progress is
+ * tracked through apt and written to progress_out as each window finishes.
+ */
+void refineWindows( std::vector< mems::GappedAlignment* >& windows, const std::vector< bool >& is_gap, bool profile_aln, std::vector<size_t>& seqs1, std::vector<size_t>& seqs2, bool parallel, AlnProgressTracker& apt, std::ostream& progress_out );
+
+/**
+ * The working state of one profile-profile alignment at an ancestor.
+ * Ancestors in disjoint subtrees get aligned at the same time, so each keeps
+ * the set of nodes it may change, its own log and its own random number
+ * stream here
+ */
+class NodeAlignmentContext
+{
+public:
+	/**
+	 * @param buffered	keep messages in buffer until the alignment finishes
+	 *					instead of writing them straight to std::cout
+	 */
+	NodeAlignmentContext( node_id_t node1, node_id_t node2, node_id_t ancestor, bool buffered ) :
+		node1(node1), node2(node2), ancestor(ancestor), log( buffered ? &buffer : &std::cout )
+	{
+		SetTwisterStateSeed( &random, ancestor );
+	};
+	node_id_t node1;
+	node_id_t node2;
+	node_id_t ancestor;
+	std::vector< node_id_t > subtree;	/**< the ancestor and its descendants, the only nodes whose orderings the alignment changes */
+	std::ostringstream buffer;	/**< messages held back while other alignments write theirs */
+	std::ostream* log;	/**< where progress messages go, either std::cout or buffer */
+	TwisterState random;	/**< seeded by the ancestor so the alignment draws the same numbers whichever thread runs it */
+private:
+	NodeAlignmentContext( const NodeAlignmentContext& nac );
+	NodeAlignmentContext& operator=( const NodeAlignmentContext& nac );
+};
+
+/** Tracks which ancestors of the alignment tree are ready to be aligned, shared by all alignment tasks */
+class AlignmentSchedule
+{
+public:
+	AlignmentSchedule() : failed(false), error(NO_ERROR), error_message(NULL) {}
+	/**
+	 * Keeps a copy of the exception currently being handled unless an earlier
+	 * one was kept.  Must be called from within a catch block
+	 */
+	void recordError();
+	/** throws the recorded exception again, if there is one */
+	void rethrowError() const;
+	std::vector< uint > unaligned_children;	/**< the number of unaligned children of each node */
+	std::vector< node_id_t > owner;	/**< the ancestor being aligned over each node, or NO_OWNER */
+	bool failed;	/**< set when a task found its subtree owned by another task */
+	/** the kinds of exception that recordError() can keep */
+	enum ErrorType { NO_ERROR, GN_ERROR, BAD_ALLOC_ERROR, STD_ERROR, MESSAGE_ERROR, UNKNOWN_ERROR };
+	ErrorType error;	/**< the kind of the first exception thrown by an alignment task */
+	std::vector< genome::gnException > gn_error;	/**< holds the exception if it was a gnException */
+	std::string error_what;	/**< what() of the exception if it was a std::exception */
+	const char* error_message;	/**< the exception if it was a message */
+	static const node_id_t NO_OWNER = (node_id_t)-1;
+};
+
 /**
  * Computes multiple genome alignments using a progressive alignment algorithm
  */
@@ -83,6 +147,15 @@ public:
 	void setRefinement( bool refine ){ this->refine = refine; }
 	/** Set whether iterative refinement using MUSCLE should be performed (true/false) */
 	void setGappedAlignment( bool do_gapped_alignment ){ this->gapped_alignment = do_gapped_alignment; }
+	/** Set whether windows of a gapped alignment should be refined concurrently by MUSCLE (true/false) */
+	void setParallelRefinement( bool parallel_refinement ){ this->parallel_refinement = parallel_refinement; }
+	bool getParallelRefinement(void){ return this->parallel_refinement; }
+	/**
+	 * Set whether guide tree subtrees should be aligned concurrently (true) or
+	 * one pair at a time in the order chosen by chooseNextAlignmentPair (false)
+	 */
+	void setParallelTreeAlignment( bool parallel_tree_alignment ){ this->parallel_tree_alignment = parallel_tree_alignment; }
+	bool getParallelTreeAlignment(void){ return this->parallel_tree_alignment; }
 
 	void setPairwiseScoringScheme( const mems::PairwiseScoringScheme& pss ){ this->subst_scoring = pss; }
 
@@ -118,11 +191,31 @@ public:
 	/** chooses an ordering for aligned intervals at an ancestor node */
 	void createAncestralOrdering( std::vector< mems::Interval* >& interval_list, std::vector< SuperInterval >& ancestral_sequence );
 
-	/** constructs an alignment of node1 and node2 at their ancestor */
-	void alignProfileToProfile( node_id_t node1, node_id_t node2, node_id_t ancestor );
+	/**
+	 * constructs an alignment of context.node1 and context.node2 at context.ancestor,
+	 * changing only the nodes in context.subtree and writing messages to context.log
+	 */
+	void alignProfileToProfile( NodeAlignmentContext& context );
 
 	/** align the sequences at the designated pair of alignment tree nodes */
 	void alignNodes( node_id_t node1, node_id_t node2, node_id_t ancestor );
+	/** virtual so that tests can make a single alignment fail */
+	virtual void alignNodes( NodeAlignmentContext& context );
+
+	/**
+	 * aligns the children of an ancestor whose children have both been aligned,
+	 * then starts a task for its parent if that was the parent's last unaligned child.
+	 * marks the schedule failed and returns without aligning if another task is
+	 * aligning over any node below the ancestor.  an exception thrown by the
+	 * alignment is recorded in the schedule and the parent is not started
+	 * @param schedule	The alignment state of each node, shared by all tasks
+	 */
+	void alignReadyNode( node_id_t ancestor, AlignmentSchedule* schedule );
+	/**
+	 * aligns every ancestor of the alignment tree, starting a task for each one
+	 * as soon as both of its children have been aligned, then aligns the root
+	 */
+	void alignTreeConcurrently();
 
 
 	/** Given a set of sequences, construct and output an alignment as an IntervalList */
@@ -147,13 +240,14 @@ public:
 		const std::vector<node_id_t>& node2_seqs, const GappedAlignmentType& iv, 
 		Matrix<mems::MatchList>& matches, Matrix< std::vector< mems::search_cache_t > >& search_cache_db, 
 		Matrix< std::vector< mems::search_cache_t > >& new_cache_db,
-		boost::multi_array< std::vector< std::vector< int64 > >, 2 >& iv_regions);
+		boost::multi_array< std::vector< std::vector< int64 > >, 2 >& iv_regions,
+		std::ostream& log_out );
 	void pairwiseAnchorSearch( mems::MatchList& r_list, mems::Match* r_begin, mems::Match* r_end, const mems::AbstractMatch* iv, uint oseqI, uint oseqJ );
 
 	void translateGappedCoordinates( std::vector<mems::AbstractMatch*>& ml, uint seqI, node_id_t extant, node_id_t ancestor );
 
-	void doGappedAlignment( node_id_t ancestor, bool profile_aln );
-	void refineAlignment( mems::GappedAlignment& gal, node_id_t ancestor, bool profile_aln, AlnProgressTracker& apt );
+	void doGappedAlignment( node_id_t ancestor, bool profile_aln, std::ostream& log_out );
+	void refineAlignment( mems::GappedAlignment& gal, node_id_t ancestor, bool profile_aln, AlnProgressTracker& apt, std::ostream& log_out );
 	void FixLeftEnds( node_id_t ancestor );
 	void ConstructSuperIntervalFromMSA( node_id_t ancestor, size_t ans_siv, mems::GappedAlignment& gal );
 
@@ -202,6 +296,8 @@ protected:
 	boolean debug;
 	boolean refine;
 	bool using_cache_db;
+	bool parallel_refinement;	/**< refine gapped alignment windows concurrently when true */
+	bool parallel_tree_alignment;	/**< align independent guide tree subtrees concurrently when true */
 
 	std::vector< SeedOccurrenceList > sol_list;
 	boost::multi_array<double, 2> bp_distance;	/**< pairwise breakpoint distances.  dims will be [seq_count][seq_count] */
@@ -219,6 +315,8 @@ protected:
 	size_t max_gapped_alignment_length;
 
 	mems::PairwiseScoringScheme subst_scoring;
+
+	TLS< mems::SmallRegionMatchFinder > gap_region_finder;	/**< Used to anchor small gaps during recursive alignment */
 };
 
 extern bool debug_aligner;
@@ -45,7 +45,7 @@ bool idmer_greaterthan(idmer& a_v, idmer& m_v){
 };
 
 inline
-bool idmer_position_lessthan(idmer& a_v, idmer& m_v){
+bool idmer_position_lessthan(const idmer& a_v, const idmer& m_v){
 	return (a_v.position < m_v.position);// ? true : false;
 };
 
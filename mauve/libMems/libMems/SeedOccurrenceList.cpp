@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * Please see the file called COPYING for licensing, copying, and modification
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/SeedOccurrenceList.h"
+#include "libMems/FileSML.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace genome;
+namespace mems {
+
+static const char SOL_MAGIC[8] = { 'M', 'A', 'U', 'V', 'E', 'S', 'O', 'L' };
+static const uint32 SOL_VERSION = 2;
+
+SeedOccurrenceList::SeedOccurrenceList() : 
+	sums( NULL ),
+	wide_sums( NULL ),
+	overflow( NULL ),
+	overflow_count( 0 ),
+	sum_width( 1 ),
+	length( 0 ),
+	seed( 0 )
+{
+	setSeedLength( 1 );
+}
+
+SeedOccurrenceList::SeedOccurrenceList( const SeedOccurrenceList& sol )
+{
+	*this = sol;
+}
+
+SeedOccurrenceList& SeedOccurrenceList::operator=( const SeedOccurrenceList& sol )
+{
+	overflow_count = sol.overflow_count;
+	sum_width = sol.sum_width;
+	length = sol.length;
+	seed = sol.seed;
+	seed_length = sol.seed_length;
+	memcpy( frequency_table, sol.frequency_table, sizeof(frequency_table) );
+	sum_data = sol.sum_data;
+	wide_sum_data = sol.wide_sum_data;
+	overflow_data = sol.overflow_data;
+	mapped_data = sol.mapped_data;
+	bind();
+	return *this;
+}
+
+void SeedOccurrenceList::setSeedLength( uint seed_length ){
+	this->seed_length = seed_length;
+	// the frequency is the average count of the seeds containing a position,
+	// positions without any seed count as unique
+	frequency_table[0] = 1;
+	for( uint sumI = 1; sumI < 256; sumI++ )
+		frequency_table[sumI] = (frequency_type)((double)sumI / seed_length);
+}
+
+void SeedOccurrenceList::setCount( gnSeqI position, uint64 count, vector< OverflowEntry >& count_overflow ){
+	if( count < SUM_OVERFLOW ){
+		sum_data[position] = (uint8)count;
+		return;
+	}
+	sum_data[position] = SUM_OVERFLOW;
+	OverflowEntry entry;
+	entry.position = position;
+	entry.sum = count;
+	count_overflow.push_back( entry );
+}
+
+uint64 SeedOccurrenceList::overflowCount( const vector< OverflowEntry >& count_overflow, size_t& overflowI, gnSeqI position ){
+	// positions are looked up in increasing order, the last entry for a position is its current count
+	while( overflowI < count_overflow.size() && count_overflow[overflowI].position <= position )
+		overflowI++;
+	return count_overflow[overflowI - 1].sum;
+}
+
+void SeedOccurrenceList::setSum( gnSeqI position, uint64 sum ){
+	if( sum < SUM_OVERFLOW ){
+		sum_data[position] = (uint8)sum;
+		return;
+	}
+	// sums are set in position order, which keeps the overflow table sorted
+	sum_data[position] = SUM_OVERFLOW;
+	OverflowEntry entry;
+	entry.position = position;
+	entry.sum = sum;
+	overflow_data.push_back( entry );
+}
+
+void SeedOccurrenceList::chooseSumWidth(){
+	size_t wide_overflow_count = 0;
+	for( size_t overflowI = 0; overflowI < overflow_data.size(); overflowI++ )
+		if( overflow_data[overflowI].sum >= WIDE_SUM_OVERFLOW )
+			wide_overflow_count++;
+	if( length + overflow_data.size() * sizeof(OverflowEntry) <= 2 * length + wide_overflow_count * sizeof(OverflowEntry) )
+		return;
+
+	// move the sums that fit in two bytes out of the overflow table
+	vector< uint16 >( length ).swap( wide_sum_data );
+	size_t overflowI = 0;
+	size_t keptI = 0;
+	for( gnSeqI posI = 0; posI < length; posI++ )
+	{
+		if( sum_data[posI] != SUM_OVERFLOW ){
+			wide_sum_data[posI] = sum_data[posI];
+			continue;
+		}
+		const OverflowEntry& entry = overflow_data[overflowI++];
+		if( entry.sum < WIDE_SUM_OVERFLOW ){
+			wide_sum_data[posI] = (uint16)entry.sum;
+			continue;
+		}
+		wide_sum_data[posI] = WIDE_SUM_OVERFLOW;
+		overflow_data[keptI++] = entry;
+	}
+	overflow_data.resize( keptI );
+	vector< uint8 >().swap( sum_data );
+	sum_width = 2;
+}
+
+bool SeedOccurrenceList::overflowPositionLess( const OverflowEntry& entry, gnSeqI position ){
+	return entry.position < position;
+}
+
+bool SeedOccurrenceList::overflowEntryLess( const OverflowEntry& a, const OverflowEntry& b ){
+	return a.position < b.position;
+}
+
+SeedOccurrenceList::frequency_type SeedOccurrenceList::overflowFrequency( gnSeqI position ) const{
+	const OverflowEntry* entry = lower_bound( overflow, overflow + overflow_count, position, &SeedOccurrenceList::overflowPositionLess );
+	if( entry == overflow + overflow_count || entry->position != position )
+		return 1;
+	return (frequency_type)((double)entry->sum / seed_length);
+}
+
+void SeedOccurrenceList::bind(){
+	if( mapped_data.is_open() ){
+		const char* sum_start = mapped_data.data() + sizeof(FileHeader);
+		sums = sum_width == 1 ? (const uint8*)sum_start : NULL;
+		wide_sums = sum_width == 2 ? (const uint16*)sum_start : NULL;
+		overflow = (const OverflowEntry*)(mapped_data.data() + overflowOffset( length, sum_width ));
+		return;
+	}
+	sums = sum_data.size() > 0 ? &sum_data[0] : NULL;
+	wide_sums = wide_sum_data.size() > 0 ? &wide_sum_data[0] : NULL;
+	overflow = overflow_data.size() > 0 ? &overflow_data[0] : NULL;
+	overflow_count = overflow_data.size();
+}
+
+size_t SeedOccurrenceList::overflowOffset( gnSeqI length, uint sum_width ){
+	// the overflow table starts on an 8 byte boundary
+	return ((sizeof(FileHeader) + length * sum_width + 7) / 8) * 8;
+}
+
+string SeedOccurrenceList::CacheFileName( const string& sml_fname ){
+	return sml_fname + ".sol";
+}
+
+void SeedOccurrenceList::save( const string& fname ) const{
+	string tmp_fname = CreateTempFileName( fname + "." );
+	registerFileToDelete( tmp_fname );
+	ofstream sol_file( tmp_fname.c_str(), ios::binary | ios::trunc );
+	if( !sol_file.is_open() )
+		Throw_gnExMsg( FileNotOpened(), "Unable to open seed occurrence list file.\n");
+
+	FileHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, SOL_MAGIC, sizeof(header.magic) );
+	header.version = SOL_VERSION;
+	header.seed_length = seed_length;
+	header.sum_width = sum_width;
+	header.length = length;
+	header.seed = seed;
+	header.overflow_count = overflow_count;
+	sol_file.write( (const char*)&header, sizeof(header) );
+	if( length > 0 )
+		sol_file.write( sum_width == 1 ? (const char*)sums : (const char*)wide_sums, length * sum_width );
+	char padding[8] = { 0 };
+	sol_file.write( padding, overflowOffset( length, sum_width ) - sizeof(header) - length * sum_width );
+	if( overflow_count > 0 )
+		sol_file.write( (const char*)overflow, overflow_count * sizeof(OverflowEntry) );
+	sol_file.close();
+	if( !sol_file.good() ){
+		boost::filesystem::remove( tmp_fname );
+		Throw_gnExMsg( FileUnreadable(), "Error writing seed occurrence list file.\n");
+	}
+	FileSML::publishCacheFile( tmp_fname, fname );
+}
+
+bool SeedOccurrenceList::load( const string& fname, gnSeqI length, uint64 seed ){
+	boost::iostreams::mapped_file_source sol_file;
+	try{
+		sol_file.open( fname );
+	}catch( exception& e ){
+		return false;
+	}
+	if( !sol_file.is_open() || sol_file.size() < sizeof(FileHeader) )
+		return false;
+	FileHeader header;
+	memcpy( &header, sol_file.data(), sizeof(header) );
+	if( memcmp( header.magic, SOL_MAGIC, sizeof(header.magic) ) != 0 ||
+		header.version != SOL_VERSION ||
+		header.seed_length == 0 ||
+		(header.sum_width != 1 && header.sum_width != 2) ||
+		header.length != length ||
+		header.seed != seed ||
+		sol_file.size() != overflowOffset( length, header.sum_width ) + header.overflow_count * sizeof(OverflowEntry) )
+		return false;
+
+	mapped_data = sol_file;
+	this->length = length;
+	this->seed = seed;
+	overflow_count = header.overflow_count;
+	sum_width = header.sum_width;
+	setSeedLength( header.seed_length );
+	vector< uint8 >().swap( sum_data );
+	vector< uint16 >().swap( wide_sum_data );
+	vector< OverflowEntry >().swap( overflow_data );
+	bind();
+	return true;
+}
+
+}
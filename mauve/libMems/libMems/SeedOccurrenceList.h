@@ -2,6 +2,7 @@
 #define __SeedOccurrenceList_h__
 
 #include <vector>
+#include <algorithm>
 #include "libMems/SortedMerList.h"
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/filesystem.hpp>
@@ -11,90 +12,229 @@
 namespace mems
 {
 
+/**
+ * Records how often the seeds that contain each sequence position occur in the genome.
+ * The frequency of a position is the average occurrence count of the seeds containing it,
+ * which is stored as the integer sum of those counts in a single byte per position, or in
+ * two bytes per position when enough sums overflow a byte that this takes less space.
+ * Sums too large for either go to a sorted overflow table.  Nearly every seed in a
+ * typical genome is unique, so the list takes about one byte per base.  A list can be
+ * cached next to the sorted mer list it was made from and memory mapped in later runs.
+ */
 class SeedOccurrenceList
 {
 public:
 	typedef float32 frequency_type;
 
-	SeedOccurrenceList(){}
+	SeedOccurrenceList();
+	SeedOccurrenceList( const SeedOccurrenceList& sol );
+	SeedOccurrenceList& operator=( const SeedOccurrenceList& sol );
 
 	template< typename SMLType >
-	void construct( SMLType& sml )
+	void construct( SMLType& sml );
+
+	/**
+	 * Memory maps the list cached next to the SML file sml_fname.  The list is
+	 * constructed and cached first if the cache is missing, older than the SML,
+	 * or was made for a different sequence length or seed.
+	 */
+	template< typename SMLType >
+	void construct( SMLType& sml, const std::string& sml_fname );
+
+	frequency_type getFrequency( gnSeqI position ) const
 	{
-		const size_t total_len = sml.Length();
-		count.resize(total_len);
-		size_t seed_start = 0;
-		size_t cur_seed_count = 1;
-		uint64 mer_mask = sml.GetSeedMask();
-		size_t seedI = 1;
-		bmer prevmer;
-		bmer merI; 
-		const size_t sml_length = sml.SMLLength();
-		if( sml_length > 0 )
-			merI = sml[0];
-		for( seedI = 1; seedI < sml_length; seedI++ )
+		if( sum_width == 1 )
 		{
-			prevmer = merI;
-			merI = sml[seedI];
-			if( (merI.mer & mer_mask) == (prevmer.mer & mer_mask) )
-			{
-				++cur_seed_count;
-				continue;
-			}
-			// set seed frequencies
-			for( size_t i = seed_start; i < seedI; ++i )
-				count[sml[i].position] = (frequency_type)cur_seed_count;
-			seed_start = seedI;
-			cur_seed_count = 1;
+			uint8 sum = sums[position];
+			if( sum != SUM_OVERFLOW )
+				return frequency_table[sum];
+		}else{
+			uint16 sum = wide_sums[position];
+			if( sum != WIDE_SUM_OVERFLOW )
+				return sum == 0 ? 1 : (frequency_type)((double)sum / seed_length);
 		}
-		// set seed frequencies for the last few
-		for( size_t i = seed_start; i < seedI && i < sml_length; ++i )
-			count[sml[i].position] = (frequency_type)cur_seed_count;
-		// hack: fudge the last few values on the end of the sequence, necessary when sequence isn't circular
-		for( ; seedI < total_len; ++seedI )
-			count[seedI]=1;
-
-		smoothFrequencies( sml );
-
-		// wipe out any stray zeros
-		for( size_t i = 0; i < total_len; ++i )
-			if( count[i]== 0 )
-				count[i] = 1;
+		return overflowFrequency( position );
 	}
 
+	/** @return the name of the file that caches the list for the SML file sml_fname */
+	static std::string CacheFileName( const std::string& sml_fname );
 
-	frequency_type getFrequency( gnSeqI position )
-	{
-		return count[position];
-	}
+	/**
+	 * Writes the list to a file that load() can map.  The file is written under a
+	 * temporary name and renamed, so concurrent readers never see a partial list.
+	 */
+	void save( const std::string& fname ) const;
+
+	/**
+	 * Memory maps a list written by save()
+	 * @return false if the file can not be read or was made for a different sequence length or seed
+	 */
+	bool load( const std::string& fname, gnSeqI length, uint64 seed );
 
 protected:
+	static const uint8 SUM_OVERFLOW = 0xFF;	/**< marks positions whose sum is in the overflow table */
+	static const uint16 WIDE_SUM_OVERFLOW = 0xFFFF;	/**< marks positions whose two byte sum is in the overflow table */
+
+	/** a sum of seed counts too large for the sum of its position, or a count while the list is constructed */
+	struct OverflowEntry
+	{
+		uint64 position;
+		uint64 sum;
+	};
+
+	/** starts a saved list, followed by the sum of each position and the overflow table */
+	struct FileHeader
+	{
+		char magic[8];
+		uint32 version;
+		uint32 seed_length;
+		uint32 sum_width;
+		uint32 unused;
+		uint64 length;
+		uint64 seed;
+		uint64 overflow_count;
+	};
+
+	void setSeedLength( uint seed_length );
+	void setCount( gnSeqI position, uint64 count, std::vector< OverflowEntry >& count_overflow );
+	static uint64 overflowCount( const std::vector< OverflowEntry >& count_overflow, size_t& overflowI, gnSeqI position );
+	void setSum( gnSeqI position, uint64 sum );
+	/** switches to two byte sums if that takes less space than one byte sums and their overflow */
+	void chooseSumWidth();
+	frequency_type overflowFrequency( gnSeqI position ) const;
+	static bool overflowPositionLess( const OverflowEntry& entry, gnSeqI position );
+	static bool overflowEntryLess( const OverflowEntry& a, const OverflowEntry& b );
+	/** points the sums and overflow at the mapped file or at the lists owned by this object */
+	void bind();
+	static size_t overflowOffset( gnSeqI length, uint sum_width );
+
 	/**
-	 * converts position freqs to the average freq of all k-mers containing that position
+	 * converts position counts to sums of the counts of all k-mers containing that position
+	 * @param count_overflow	counts too large for a byte, sorted by position
 	 */
 	template< typename SMLType >
-	void smoothFrequencies( const SMLType& sml )
+	void smoothFrequencies( const SMLType& sml, const std::vector< OverflowEntry >& count_overflow );
+
+	const uint8* sums;	/**< sum of the counts of the seeds containing each position when sum_width is 1 */
+	const uint16* wide_sums;	/**< sum of the counts of the seeds containing each position when sum_width is 2 */
+	const OverflowEntry* overflow;	/**< sums too large for sums or wide_sums, ordered by position */
+	size_t overflow_count;	/**< number of entries in overflow */
+	uint sum_width;	/**< bytes per position sum, either 1 or 2 */
+	gnSeqI length;
+	uint64 seed;
+	uint seed_length;
+	frequency_type frequency_table[256];	/**< the frequency of each sum that fits in a byte */
+	std::vector< uint8 > sum_data;	/**< storage for sums when the list is not mapped from a file */
+	std::vector< uint16 > wide_sum_data;	/**< storage for wide_sums when the list is not mapped from a file */
+	std::vector< OverflowEntry > overflow_data;	/**< storage for overflow when the list is not mapped from a file */
+	boost::iostreams::mapped_file_source mapped_data;
+};
+
+template< typename SMLType >
+void SeedOccurrenceList::construct( SMLType& sml )
+{
+	if( mapped_data.is_open() )
+		mapped_data.close();
+	const size_t total_len = sml.Length();
+	length = total_len;
+	seed = sml.Seed();
+	setSeedLength( sml.SeedLength() );
+	// counts start out in the sum bytes and are replaced by sums during smoothing
+	sum_width = 1;
+	std::vector< uint8 >( total_len, 0 ).swap( sum_data );
+	std::vector< uint16 >().swap( wide_sum_data );
+	overflow_data.clear();
+	std::vector< OverflowEntry > count_overflow;
+	size_t seed_start = 0;
+	size_t cur_seed_count = 1;
+	uint64 mer_mask = sml.GetSeedMask();
+	size_t seedI = 1;
+	bmer prevmer;
+	bmer merI; 
+	const size_t sml_length = sml.SMLLength();
+	if( sml_length > 0 )
+		merI = sml[0];
+	for( seedI = 1; seedI < sml_length; seedI++ )
 	{
-		size_t seed_length = sml.SeedLength();
-		// hack: for beginning (seed_length) positions assume that previous
-		// containing seeds were unique
-		double sum = seed_length - 1 + count[0];
-		std::vector<frequency_type> buf(seed_length, 1);
-		buf[0] = count[0];
-		for( size_t i = 1; i < sml.Length(); i++ )
+		prevmer = merI;
+		merI = sml[seedI];
+		if( (merI.mer & mer_mask) == (prevmer.mer & mer_mask) )
 		{
-			count[i-1] = sum / seed_length;
-			sum += count[i];
-			size_t bufI = i % seed_length;
-			sum -= buf[bufI];
-			buf[bufI] = count[i];
+			++cur_seed_count;
+			continue;
 		}
+		// set seed frequencies
+		for( size_t i = seed_start; i < seedI; ++i )
+			setCount( sml[i].position, cur_seed_count, count_overflow );
+		seed_start = seedI;
+		cur_seed_count = 1;
 	}
-	
-	std::vector<frequency_type> count;
-};
+	// set seed frequencies for the last few
+	for( size_t i = seed_start; i < seedI && i < sml_length; ++i )
+		setCount( sml[i].position, cur_seed_count, count_overflow );
+	// hack: fudge the last few values on the end of the sequence, necessary when sequence isn't circular
+	for( ; seedI < total_len; ++seedI )
+		setCount( seedI, 1, count_overflow );
 
+	// a stable sort keeps the last count set for a position after any earlier ones
+	std::stable_sort( count_overflow.begin(), count_overflow.end(), &SeedOccurrenceList::overflowEntryLess );
+	smoothFrequencies( sml, count_overflow );
+	std::vector< OverflowEntry >().swap( count_overflow );
+	chooseSumWidth();
+	bind();
 }
 
-#endif	// __SeedOccurrenceList_h__
+template< typename SMLType >
+void SeedOccurrenceList::construct( SMLType& sml, const std::string& sml_fname )
+{
+	std::string cache_fname = CacheFileName( sml_fname );
+	try{
+		if( boost::filesystem::exists( cache_fname ) && 
+			boost::filesystem::last_write_time( cache_fname ) >= boost::filesystem::last_write_time( sml_fname ) &&
+			load( cache_fname, sml.Length(), sml.Seed() ) )
+			return;
+	}catch( boost::filesystem::filesystem_error& fse ){
+	}
+
+	construct( sml );
+	try{
+		save( cache_fname );
+		// map the saved copy so that the list does not stay resident
+		load( cache_fname, sml.Length(), sml.Seed() );
+	}catch( genome::gnException& gne ){
+		std::cerr << "Unable to cache seed occurrence list in " << cache_fname << std::endl;
+	}
+}
 
+template< typename SMLType >
+void SeedOccurrenceList::smoothFrequencies( const SMLType& sml, const std::vector< OverflowEntry >& count_overflow )
+{
+	if( length == 0 )
+		return;
+	const size_t seed_length = sml.SeedLength();
+	// hack: for beginning (seed_length) positions assume that previous
+	// containing seeds were unique
+	std::vector< uint64 > buf( seed_length, 1 );
+	size_t overflowI = 0;
+	buf[0] = sum_data[0] != SUM_OVERFLOW ? sum_data[0] : overflowCount( count_overflow, overflowI, 0 );
+	uint64 sum = seed_length - 1 + buf[0];
+	uint64 cur_count = buf[0];
+	for( size_t i = 1; i < length; i++ )
+	{
+		// read the count of position i before the sum of position i-1 replaces anything
+		cur_count = sum_data[i];
+		if( cur_count == SUM_OVERFLOW )
+			cur_count = overflowCount( count_overflow, overflowI, i );
+		setSum( i - 1, sum );
+		sum += cur_count;
+		size_t bufI = i % seed_length;
+		sum -= buf[bufI];
+		buf[bufI] = cur_count;
+	}
+	// the last position keeps its unsmoothed count
+	setSum( length - 1, cur_count * seed_length );
+}
+
+}
+
+#endif	// __SeedOccurrenceList_h__
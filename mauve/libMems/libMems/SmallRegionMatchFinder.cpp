@@ -0,0 +1,241 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * Please see the file called COPYING for licensing, copying, and modification
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/SmallRegionMatchFinder.h"
+#include <algorithm>
+
+using namespace std;
+using namespace genome;
+namespace mems {
+
+RegionMerList::RegionMerList(){
+}
+
+RegionMerList* RegionMerList::Clone() const{
+	return new RegionMerList(*this);
+}
+
+void RegionMerList::SetRegion( const gnSeqC* seq_buf, gnSeqI len, uint64 seed ){
+	// set header information the way Create() would
+	header.length = len;
+	header.seed_length = getSeedLength( seed );
+	header.seed_weight = getSeedWeight( seed );
+	header.seed = seed;
+	header.circular = false;
+	SetMerMaskSize( header.seed_weight );
+	seed_mask = mer_mask;
+	SetMerMaskSize( header.seed_length );
+
+	seed_offsets.clear();
+	for( uint patternI = 0; patternI < header.seed_length; patternI++ )
+		if( (seed >> (header.seed_length - patternI - 1)) & 0x1 )
+			seed_offsets.push_back( patternI );
+
+	// the zeros at the end stand in for the padding of a binary encoded sequence
+	codes.resize( len + header.seed_length );
+	for( gnSeqI charI = 0; charI < len; charI++ )
+		codes[ charI ] = header.translation_table[ (uint8)seq_buf[ charI ] ];
+	fill( codes.begin() + len, codes.end(), 0 );
+
+	// compute the forward and reverse complement seed mers directly from the codes
+	// rather than extracting them from a binary encoded sequence
+	const uint weight = header.seed_weight;
+	const uint shift_amt = 64 - DNA_ALPHA_BITS * weight;
+	seed_mers.resize( len );
+	for( gnSeqI merI = 0; merI < len; merI++ ){
+		const uint8* cur_codes = &codes[ merI ];
+		uint64 fwd_mer = 0;
+		uint64 rev_mer = 0;
+		for( uint charI = 0; charI < weight; charI++ ){
+			fwd_mer <<= DNA_ALPHA_BITS;
+			fwd_mer |= cur_codes[ seed_offsets[ charI ] ];
+			rev_mer <<= DNA_ALPHA_BITS;
+			rev_mer |= 3 - cur_codes[ seed_offsets[ weight - charI - 1 ] ];
+		}
+		fwd_mer <<= shift_amt;
+		rev_mer <<= shift_amt;
+		rev_mer |= 1;
+		seed_mers[ merI ] = fwd_mer < rev_mer ? fwd_mer : rev_mer;
+	}
+}
+
+uint64 RegionMerList::CanonicalSeedMer( gnSeqI offset ) const{
+	const uint weight = header.seed_weight;
+	uint64 fwd_mer = 0;
+	uint64 rev_mer = 0;
+	for( uint charI = 0; charI < weight; charI++ ){
+		fwd_mer <<= DNA_ALPHA_BITS;
+		fwd_mer |= Code( offset + seed_offsets[ charI ] );
+		rev_mer <<= DNA_ALPHA_BITS;
+		rev_mer |= 3 - Code( offset + seed_offsets[ weight - charI - 1 ] );
+	}
+	fwd_mer <<= 64 - DNA_ALPHA_BITS * weight;
+	rev_mer <<= 64 - DNA_ALPHA_BITS * weight;
+	rev_mer |= 1;
+	return fwd_mer < rev_mer ? fwd_mer : rev_mer;
+}
+
+boolean RegionMerList::Read(vector<bmer>& readVector, gnSeqI size, gnSeqI offset){
+	readVector.clear();
+	return false;
+}
+
+void RegionMerList::Merge(SortedMerList& sa, SortedMerList& sa2){
+	Throw_gnExMsg(SMLMergeError(), "Region mer lists can not be merged.");
+}
+
+bmer RegionMerList::operator[](gnSeqI index){
+	bmer cur_mer;
+	cur_mer.position = index;
+	cur_mer.mer = GetSeedMer( index );
+	return cur_mer;
+}
+
+uint64 RegionMerList::GetMer( gnSeqI position ) const{
+	uint64 mer = 0;
+	for( uint charI = 0; charI < header.seed_length; charI++ ){
+		mer <<= DNA_ALPHA_BITS;
+		mer |= Code( position + charI );
+	}
+	mer <<= 64 - DNA_ALPHA_BITS * header.seed_length;
+	return mer & mer_mask;
+}
+
+uint64 RegionMerList::GetSeedMer( gnSeqI offset ) const{
+	return offset < seed_mers.size() ? seed_mers[ offset ] : CanonicalSeedMer( offset );
+}
+
+uint64 RegionMerList::GetDnaSeedMer( gnSeqI offset ) const{
+	return GetSeedMer( offset );
+}
+
+
+SmallRegionMatchFinder::SmallRegionMatchFinder(){
+	seed_pair.resize(2);
+	region_len[0] = 0;
+	region_len[1] = 0;
+}
+
+SmallRegionMatchFinder::SmallRegionMatchFinder(const SmallRegionMatchFinder& mh) : MemHash(mh){
+	seed_pair.resize(2);
+	region_len[0] = 0;
+	region_len[1] = 0;
+}
+
+// the region buffers are scratch space, only the MemHash state gets copied
+SmallRegionMatchFinder& SmallRegionMatchFinder::operator=( const SmallRegionMatchFinder& mh ){
+	MemHash::operator=( mh );
+	return *this;
+}
+
+SmallRegionMatchFinder* SmallRegionMatchFinder::Clone() const{
+	return new SmallRegionMatchFinder(*this);
+}
+
+void SmallRegionMatchFinder::Clear()
+{
+	MatchFinder::Clear();
+	m_mem_count = 0;
+	m_collision_count = 0;
+	m_repeat_tolerance = DEFAULT_REPEAT_TOLERANCE;
+	m_enumeration_tolerance = DEFAULT_ENUMERATION_TOLERANCE;
+	// only the buckets that received a match need their counts reset
+	MheBucketCompare bucket_comp( table_size );
+	for( size_t mheI = 0; mheI < allocated.size(); mheI++ )
+		mem_table_count[ bucket_comp.Bucket( allocated[ mheI ] ) ] = 0;
+	// keep the table's memory for the next region, only its used slots get reset
+	for(uint32 shardI = 0; shardI < mem_table.size(); ++shardI)
+		mem_table[shardI].Reset();
+	match_log = NULL;
+
+	allocator.Free(allocated);
+}
+
+void SmallRegionMatchFinder::SetRegion( uint regionI, const gnSequence& seq, gnSeqI offset, gnSeqI len ){
+	region_len[ regionI ] = len;
+	if( len == 0 )
+		return;
+	if( region_buf[ regionI ].size() < len )
+		region_buf[ regionI ].resize( len );
+	seq.ToArray( &region_buf[ regionI ][0], len, offset );
+}
+
+static inline
+size_t SeedHash( uint64 key ){
+	// seed mers only use their high order bits, so mix them into the low ones
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+void SmallRegionMatchFinder::FindRegionMatches( uint64 seed ){
+	ClearSequences();
+	gnSeqI mer_count[2];
+	for( uint regionI = 0; regionI < 2; regionI++ ){
+		const gnSeqC* seq_buf = region_len[ regionI ] > 0 ? &region_buf[ regionI ][0] : NULL;
+		region_sml[ regionI ].SetRegion( seq_buf, region_len[ regionI ], seed );
+		AddSequence( &region_sml[ regionI ] );
+		mer_count[ regionI ] = region_sml[ regionI ].SMLLength();
+	}
+	if( mer_count[0] == 0 || mer_count[1] == 0 )
+		return;
+
+	// count each seed's occurrences in both regions, keeping the load factor at or below one half.
+	// seeds absent from the first region can't match so they are never added
+	size_t index_size = 64;
+	while( index_size < 2 * mer_count[0] )
+		index_size *= 2;
+	SeedSlot empty;
+	empty.key = 0;
+	empty.positions[0] = 0;
+	empty.positions[1] = 0;
+	empty.counts[0] = 0;
+	empty.counts[1] = 0;
+	seed_index.assign( index_size, empty );
+	const size_t index_mask = index_size - 1;
+	const uint64 key_mask = GetSar(0)->GetSeedMask();
+	for( uint regionI = 0; regionI < 2; regionI++ ){
+		const vector< uint64 >& seed_mers = region_sml[ regionI ].SeedMers();
+		for( gnSeqI merI = 0; merI < mer_count[ regionI ]; merI++ ){
+			const uint64 key = seed_mers[ merI ] & key_mask;
+			size_t slotI = SeedHash( key ) & index_mask;
+			while( seed_index[ slotI ].counts[0] != 0 && seed_index[ slotI ].key != key )
+				slotI = (slotI + 1) & index_mask;
+			SeedSlot& slot = seed_index[ slotI ];
+			if( slot.counts[0] == 0 ){
+				if( regionI != 0 )
+					continue;
+				slot.key = key;
+			}
+			slot.positions[ regionI ] = merI;
+			slot.counts[ regionI ]++;
+		}
+	}
+
+	// hash the seeds that are unique in both regions in the order a
+	// sorted mer list search would, since earlier matches absorb later seeds
+	unique_seeds.clear();
+	for( size_t slotI = 0; slotI < index_size; slotI++ )
+		if( seed_index[ slotI ].counts[0] == 1 && seed_index[ slotI ].counts[1] == 1 )
+			unique_seeds.push_back( seed_index[ slotI ] );
+	sort( unique_seeds.begin(), unique_seeds.end(), SeedSlotLessThan );
+	for( size_t seedI = 0; seedI < unique_seeds.size(); seedI++ ){
+		for( uint regionI = 0; regionI < 2; regionI++ ){
+			seed_pair[ regionI ].position = unique_seeds[ seedI ].positions[ regionI ];
+			seed_pair[ regionI ].mer = unique_seeds[ seedI ].key;
+			seed_pair[ regionI ].id = regionI;
+		}
+		HashMatch( seed_pair );
+	}
+}
+
+} // namespace mems
@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * This file is licensed under the GPL.
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifndef _SmallRegionMatchFinder_h_
+#define _SmallRegionMatchFinder_h_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include <vector>
+
+namespace mems {
+
+/** Regions longer than this are better served by a MemHash over sorted mer lists */
+static const gnSeqI SMALL_REGION_MAX_LENGTH = 1 << 18;
+
+/**
+ * A RegionMerList holds the canonical seed mer at every position of a short
+ * sequence region, in buffers that are reused from one region to the next.
+ * It supports what MatchFinder needs to extend seed matches, but no sorted
+ * list is ever built: operator[] returns mers in position order and Read()
+ * and Merge() are not supported.
+ */
+class RegionMerList : public SortedMerList {
+public:
+	RegionMerList();
+	RegionMerList* Clone() const;
+	/**
+	 * Loads a region and computes the seed mer at each position as a
+	 * DNAMemorySML created from the region would.
+	 * @param seq_buf	the characters in the region
+	 * @param len		the length of the region
+	 * @param seed		the seed pattern to use
+	 */
+	void SetRegion( const gnSeqC* seq_buf, gnSeqI len, uint64 seed );
+	/** @return the canonical seed mer at every position, including the final seed length - 1 positions */
+	const std::vector< uint64 >& SeedMers() const{ return seed_mers; }
+
+	virtual boolean Read(std::vector<bmer>& readVector, gnSeqI size, gnSeqI offset);
+	virtual void Merge(SortedMerList& sa, SortedMerList& sa2);
+	virtual bmer operator[](gnSeqI index);
+	virtual uint64 GetMer( gnSeqI position ) const;
+	virtual uint64 GetSeedMer( gnSeqI offset ) const;
+	virtual uint64 GetDnaSeedMer( gnSeqI offset ) const;
+protected:
+	uint64 CanonicalSeedMer( gnSeqI offset ) const;
+	uint64 Code( gnSeqI position ) const{ return position < codes.size() ? codes[position] : 0; }
+
+	std::vector< uint8 > codes;	/**< the region translated to 2 bit character codes */
+	std::vector< uint64 > seed_mers;	/**< the canonical seed mer at each position */
+	std::vector< uint > seed_offsets;	/**< offsets of the characters a seed covers */
+};
+
+/**
+ * SmallRegionMatchFinder finds anchors between two short regions of sequence,
+ * such as the gaps between anchors in a recursive anchor search.  It finds the
+ * same matches that a MemHash with the default repeat and enumeration tolerances
+ * finds given DNAMemorySMLs of the two regions, but seeds that are unique in both
+ * regions are found with an open addressing index instead of sorted mer lists.
+ * The region, seed and index buffers and the match table are kept between
+ * searches, so searching one small region after another does not need new
+ * buffers for each one.
+ */
+class SmallRegionMatchFinder : public MemHash {
+public:
+	SmallRegionMatchFinder();
+	SmallRegionMatchFinder(const SmallRegionMatchFinder& mh);
+	SmallRegionMatchFinder& operator=( const SmallRegionMatchFinder& mh );
+	virtual SmallRegionMatchFinder* Clone() const;
+	/** Removes all matches, keeping the region, seed and index buffers for reuse */
+	virtual void Clear();
+
+	/**
+	 * Reads one of the two regions to search
+	 * @param regionI	0 for the first region, 1 for the second
+	 * @param seq		the sequence containing the region
+	 * @param offset	the 1-based start of the region in seq
+	 * @param len		the length of the region, may be 0
+	 */
+	void SetRegion( uint regionI, const genome::gnSequence& seq, gnSeqI offset, gnSeqI len );
+	/**
+	 * Finds matches between the two regions using the given seed pattern.  Matches
+	 * accumulate across calls until Clear() is called, so a family of seeds can be
+	 * searched by calling this once per seed.  Use GetMatchList() to retrieve them.
+	 */
+	void FindRegionMatches( uint64 seed );
+
+protected:
+	/** an entry in the seed index, keyed on the canonical seed mer without its direction bit */
+	struct SeedSlot {
+		uint64 key;
+		gnSeqI positions[2];	/**< the last position of the key in each region */
+		uint counts[2];	/**< the number of occurrences of the key in each region, 0 for an empty slot */
+	};
+	static bool SeedSlotLessThan( const SeedSlot& a, const SeedSlot& b ){ return a.key < b.key; }
+
+	std::vector< gnSeqC > region_buf[2];
+	gnSeqI region_len[2];
+	RegionMerList region_sml[2];
+	std::vector< SeedSlot > seed_index;
+	std::vector< SeedSlot > unique_seeds;
+	IdmerList seed_pair;
+};
+
+}
+
+#endif // _SmallRegionMatchFinder_h_
@@ -11,6 +11,11 @@
 #endif
 
 #include "libMems/SortedMerList.h"
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace genome;
@@ -103,6 +108,7 @@ SortedMerList::SortedMerList(){
 	header.seed_length = DNA_MER_SIZE;
 	header.id = 0;
 	header.circular = false;
+	header.position_bytes = SMLPositionBytes( 0 );
 	mask_size = DNA_MER_SIZE;
 	mer_mask = 0;
 	seed_mask = 0;
@@ -151,6 +157,7 @@ void SortedMerList::Clear(){
 	header.seed_length = DNA_MER_SIZE;
 	header.id = 0;
 	header.circular = false;
+	header.position_bytes = SMLPositionBytes( 0 );
 	mask_size = DNA_MER_SIZE;
 	mer_mask = 0;
 	seed_mask = 0;
@@ -815,6 +822,7 @@ void SortedMerList::Create(const gnSequence& seq, const uint64 seed){
 	header.seed_length = seed_length;
 	header.seed_weight = seed_weight;
 	header.seed = seed;
+	header.position_bytes = SMLPositionBytes( buf_len );
 
 	SetMerMaskSize( seed_weight );
 	seed_mask = mer_mask;
@@ -823,4 +831,85 @@ void SortedMerList::Create(const gnSequence& seq, const uint64 seed){
 	SetSequence( seq_buf.data, buf_len );
 }
 
+/** radix sorting doesn't pay off below this many mers */
+static const size_t RADIX_SORT_MIN = 4096;
+/** each thread should get at least this many mers to count and scatter */
+static const size_t RADIX_SORT_THREAD_MIN = 65536;
+
+void RadixSortMers( vector<bmer>& mers ){
+	const size_t mer_count = mers.size();
+	if( mer_count < RADIX_SORT_MIN ){
+		stable_sort( mers.begin(), mers.end(), &bmer_lessthan );
+		return;
+	}
+
+	int thread_count = 1;
+#ifdef _OPENMP
+	thread_count = omp_get_max_threads();
+	if( (size_t)thread_count > mer_count / RADIX_SORT_THREAD_MIN )
+		thread_count = (int)(mer_count / RADIX_SORT_THREAD_MIN);
+	if( thread_count < 1 )
+		thread_count = 1;
+#endif
+
+	// find the key bytes that actually differ between mers
+	uint64 mer_or = 0;
+	uint64 mer_and = 0;
+	mer_and = ~mer_and;
+#pragma omp parallel for num_threads(thread_count) reduction(|:mer_or) reduction(&:mer_and)
+	for( int64 merI = 0; merI < (int64)mer_count; merI++ ){
+		mer_or |= mers[merI].mer;
+		mer_and &= mers[merI].mer;
+	}
+	const uint64 varying_bits = mer_or ^ mer_and;
+
+	vector<bmer> mer_buf( mer_count );
+	bmer* src = &mers[0];
+	bmer* dest = &mer_buf[0];
+	// one row of 256 digit counts per thread, later turned into scatter offsets
+	vector<size_t> digit_counts( thread_count * 256 );
+
+	for( uint shift = 0; shift < 64; shift += 8 ){
+		if( ((varying_bits >> shift) & 0xFF) == 0 )
+			continue;	// every mer has the same value in this byte
+
+#pragma omp parallel num_threads(thread_count)
+		{
+			int threadI = 0;
+			int active_threads = 1;
+#ifdef _OPENMP
+			threadI = omp_get_thread_num();
+			active_threads = omp_get_num_threads();
+#endif
+			// each thread owns a contiguous block of the input, which keeps the sort stable
+			const size_t block_start = (mer_count * threadI) / active_threads;
+			const size_t block_end = (mer_count * (threadI + 1)) / active_threads;
+			size_t* my_counts = &digit_counts[threadI * 256];
+			std::fill( my_counts, my_counts + 256, 0 );
+			for( size_t merI = block_start; merI < block_end; merI++ )
+				my_counts[ (src[merI].mer >> shift) & 0xFF ]++;
+
+#pragma omp barrier
+#pragma omp single
+			{
+				size_t offset = 0;
+				for( uint digitI = 0; digitI < 256; digitI++ ){
+					for( int tI = 0; tI < active_threads; tI++ ){
+						size_t count = digit_counts[tI * 256 + digitI];
+						digit_counts[tI * 256 + digitI] = offset;
+						offset += count;
+					}
+				}
+			}
+
+			for( size_t merI = block_start; merI < block_end; merI++ )
+				dest[ my_counts[ (src[merI].mer >> shift) & 0xFF ]++ ] = src[merI];
+		}
+		std::swap( src, dest );
+	}
+
+	if( src != &mers[0] )
+		mers.swap( mer_buf );
+}
+
 } // namespace mems
@@ -21,6 +21,7 @@
 #include "stdlib.h"
 #include <string>
 #include <vector>
+#include <cstring>
 #include "libMems/SeedMasks.h"
 
 namespace mems {
@@ -37,9 +38,9 @@ namespace mems {
 
 typedef int16 sarID_t;
 
-typedef uint32 smlSeqI_t;
+typedef uint64 smlSeqI_t;
 
-//4 + 8 = 16 (blame C alignment rules.)
+//8 + 8 = 16, the same size it was with 32 bit positions (blame C alignment rules.)
 struct bmer{
 	smlSeqI_t position;	/**< starting position of this mer in the sequence */
 	uint64 mer; 		/**< the actual binary encoded mer */
@@ -60,6 +61,7 @@ struct SMLHeader{
 	boolean circular;					/**< Circularity of sequence - 1 byte */
 	uint8 translation_table[UINT8_MAX];	/**< Translation table for ascii characters to binary values -- 256 bytes */
 	char description[DESCRIPTION_SIZE]; /**< Freeform text description of sequence data -- 2048 bytes */
+	uint32 position_bytes;				/**< Bytes used to store each entry in the position array, see SMLPositionBytes() - 4 bytes */
 };
 
 
@@ -307,6 +309,56 @@ bool bmer_id_lessthan(const bmer& a_v, const bmer& m_v);
 int bmer_compare(const void* a_v, const void* m_v);
 bool bmer_id_lessthan(const bmer& a_v, const bmer& m_v);
 
+/**
+ * Returns the number of bytes used to store each position in the sorted mer list of
+ * a sequence.  Sequences that fit in 32 bit coordinates use 4 bytes, as earlier SML
+ * formats did, while longer ones use 5 bytes (40 bits, up to 1 Tbp).
+ * @param seq_len The sequence length, including any circular wrap-around
+ */
+inline
+uint32 SMLPositionBytes( uint64 seq_len ){
+	return seq_len < 0xFFFFFFFFULL ? 4 : 5;
+}
+
+/**
+ * Reads entry index from an array of positions packed position_bytes apiece.
+ * The low 32 bits of each entry are stored as a native uint32, which keeps 4 byte
+ * position arrays identical to those of earlier SML formats, and any higher order
+ * bytes follow least significant first.
+ */
+inline
+smlSeqI_t GetPackedPosition( const char* positions, uint32 position_bytes, gnSeqI index ){
+	const char* entry = positions + index * position_bytes;
+	uint32 low_word;
+	memcpy( &low_word, entry, sizeof(uint32) );
+	smlSeqI_t position = low_word;
+	for( uint32 byteI = sizeof(uint32); byteI < position_bytes; byteI++ )
+		position |= (smlSeqI_t)(uint8)entry[byteI] << (8 * byteI);
+	return position;
+}
+
+/** Writes position to entry index of a packed position array, see GetPackedPosition() */
+inline
+void SetPackedPosition( char* positions, uint32 position_bytes, gnSeqI index, smlSeqI_t position ){
+	char* entry = positions + index * position_bytes;
+	uint32 low_word = (uint32)position;
+	memcpy( entry, &low_word, sizeof(uint32) );
+	for( uint32 byteI = sizeof(uint32); byteI < position_bytes; byteI++ )
+		entry[byteI] = (char)(position >> (8 * byteI));
+}
+
+/**
+ * Sorts a vector of bmers by mer using a parallel least significant digit radix sort.
+ * The sort is stable, so bmers that share a mer stay in their original (position) order,
+ * the order std::stable_sort gives.  This is not the order SMLs had when they were
+ * sorted with std::sort, which leaves equal mers in an unspecified order, so an SML
+ * built now can list the positions of a repeated mer differently than an older one.
+ * Key bytes that are the same in every mer, such as the unused low bits of a short
+ * seed, are skipped.
+ * @param mers The bmers to sort
+ */
+void RadixSortMers( std::vector<bmer>& mers );
+
 //less than function for STL sort functions
 inline
 bool bmer_lessthan(const bmer& a_v, const bmer& m_v){
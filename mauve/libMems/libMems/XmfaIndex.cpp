@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * Please see the file called COPYING for licensing, copying, and modification
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/XmfaIndex.h"
+#include "libGenome/gnException.h"
+#include "boost/filesystem/operations.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace genome;
+namespace mems {
+
+static const char* XMFA_INDEX_VERSION = "#FormatVersion Mauve1 xmfai 1";
+
+XmfaIndex::XmfaIndex() : 
+	seq_count( 0 ),
+	alignment_size( 0 )
+{}
+
+void parseXmfaDefline( const string& line, XmfaDefline& defline ){
+	defline.seqI = 0;
+	defline.start = 0;
+	defline.stop = 0;
+	defline.strand.clear();
+	defline.name.clear();
+	stringstream line_str( line );
+	string token;
+	getline( line_str, token, '>' );
+	getline( line_str, token, ':' );
+	// take off leading whitespace
+	stringstream parse_str( token );
+	parse_str >> defline.seqI;	// the sequence number
+	getline( line_str, token, '-' );
+	parse_str.clear();
+	parse_str.str( token );
+	parse_str >> defline.start;
+	line_str >> defline.stop;
+	line_str >> defline.strand;
+	getline( line_str, defline.name );	// anything left is the name
+}
+
+string XmfaIndex::IndexFileName( const string& xmfa_fname ){
+	return xmfa_fname + "i";
+}
+
+void XmfaIndex::Open( const string& xmfa_fname ){
+	string index_fname = IndexFileName( xmfa_fname );
+	uint64 xmfa_size = 0;
+	try{
+		xmfa_size = boost::filesystem::file_size( xmfa_fname );
+		if( boost::filesystem::exists( index_fname ) &&
+			boost::filesystem::last_write_time( index_fname ) >= boost::filesystem::last_write_time( xmfa_fname ) ){
+			ifstream index_file( index_fname.c_str() );
+			if( Read( index_file ) && alignment_size == xmfa_size )
+				return;
+		}
+	}catch( boost::filesystem::filesystem_error& fse ){
+		Throw_gnExMsg( FileNotOpened(), "Unable to open alignment file.\n");
+	}
+
+	ifstream xmfa_file( xmfa_fname.c_str(), ios::binary );
+	if( !xmfa_file.is_open() )
+		Throw_gnExMsg( FileNotOpened(), "Unable to open alignment file.\n");
+	Build( xmfa_file );
+	alignment_size = xmfa_size;
+
+	ofstream index_file( index_fname.c_str() );
+	if( index_file.is_open() )
+		Write( index_file );
+	if( !index_file.is_open() || !index_file.good() ){
+		cerr << "Unable to save the alignment index " << index_fname << endl;
+		index_file.close();
+		boost::filesystem::remove( index_fname );
+	}
+}
+
+void XmfaIndex::Build( istream& xmfa_stream ){
+	seq_filename.clear();
+	blocks.clear();
+	seq_count = 0;
+	alignment_size = 0;
+
+	string cur_line;
+	uint64 line_offset = 0;	// offset of cur_line
+	uint64 next_offset = 0;	// offset of the line after cur_line
+	Block cur_block;
+	bool in_block = false;
+	gnSeqI cur_chars = 0;
+	gnSeqI cur_columns = 0;
+	uint cur_seq = 0;
+	bool cur_reverse = false;
+	while( true ){
+		line_offset = next_offset;
+		bool have_line = !getline( xmfa_stream, cur_line ).fail();
+		if( have_line )
+			next_offset += cur_line.size() + (xmfa_stream.eof() ? 0 : 1);
+
+		bool end_row = !have_line || (cur_line.size() > 0 && (cur_line[0] == '>' || cur_line[0] == '='));
+		if( end_row && cur_seq > 0 ){
+			// finish the previous row
+			cur_block.lengths[ cur_seq - 1 ] = cur_chars;
+			if( cur_chars == 0 && cur_reverse )
+				cur_block.starts[ cur_seq - 1 ] = 0;
+			if( cur_columns > cur_block.columns )
+				cur_block.columns = cur_columns;
+			cur_seq = 0;
+		}
+		if( !have_line || (cur_line.size() > 0 && cur_line[0] == '=') ){
+			// finish the block
+			if( in_block ){
+				cur_block.size = (have_line ? next_offset : line_offset) - cur_block.offset;
+				blocks.push_back( cur_block );
+				in_block = false;
+			}
+			if( !have_line )
+				break;
+			continue;
+		}
+		if( cur_line.size() == 0 )
+			continue;
+		if( cur_line[0] == '#' ){
+			if( blocks.size() > 0 || in_block )
+				continue;
+			// metadata before the first block.  parse it if it's a filename
+			stringstream ss( cur_line );
+			string token;
+			getline( ss, token, '\t' );
+			if( token.substr(1, 8) != "Sequence" || token.find( "File" ) == string::npos )
+				continue;
+			getline( ss, token );
+			seq_filename.push_back( token );
+			continue;
+		}
+		if( cur_line[0] == '>' ){
+			if( !in_block ){
+				cur_block = Block();
+				cur_block.offset = line_offset;
+				cur_block.columns = 0;
+				in_block = true;
+			}
+			XmfaDefline defline;
+			parseXmfaDefline( cur_line, defline );
+			const uint seqI = defline.seqI;
+			const int64 start = defline.start;
+			const int64 stop = defline.stop;
+			if( seqI == 0 )
+				Throw_gnExMsg( FileUnreadable(), "Invalid XMFA defline.\n");
+			if( seqI > seq_count )
+				seq_count = seqI;
+			if( cur_block.starts.size() < seqI ){
+				cur_block.starts.resize( seqI, 0 );
+				cur_block.lengths.resize( seqI, 0 );
+			}
+			cur_reverse = defline.strand != "+";
+			if( !cur_reverse )
+				cur_block.starts[ seqI - 1 ] = start;
+			else
+				cur_block.starts[ seqI - 1 ] = start < stop ? -start : -stop;
+			cur_seq = seqI;
+			cur_chars = 0;
+			cur_columns = 0;
+			continue;
+		}
+		if( cur_seq == 0 )
+			continue;	// stray text between blocks
+		// a line of aligned sequence
+		for( size_t charI = 0; charI < cur_line.size(); charI++ )
+			if( cur_line[ charI ] != '-' )
+				cur_chars++;
+		cur_columns += cur_line.size();
+	}
+	// every block gets an entry for each genome
+	for( size_t blockI = 0; blockI < blocks.size(); blockI++ ){
+		blocks[ blockI ].starts.resize( seq_count, 0 );
+		blocks[ blockI ].lengths.resize( seq_count, 0 );
+	}
+	alignment_size = next_offset;
+	sortBlocks();
+}
+
+bool XmfaIndex::Read( istream& index_stream ){
+	string cur_line;
+	if( !getline( index_stream, cur_line ) || cur_line != XMFA_INDEX_VERSION )
+		return false;
+	string tag;
+	size_t file_count = 0;
+	size_t block_count = 0;
+	index_stream >> tag >> alignment_size;
+	index_stream >> tag >> seq_count;
+	index_stream >> tag >> file_count;
+	if( !index_stream.good() )
+		return false;
+	getline( index_stream, cur_line );
+	seq_filename.resize( file_count );
+	for( size_t fileI = 0; fileI < file_count; fileI++ ){
+		getline( index_stream, cur_line );
+		size_t tab = cur_line.find( '\t' );
+		if( tab == string::npos )
+			return false;
+		seq_filename[ fileI ] = cur_line.substr( tab + 1 );
+	}
+	index_stream >> tag >> block_count;
+	blocks.resize( block_count );
+	for( size_t blockI = 0; blockI < block_count; blockI++ ){
+		Block& block = blocks[ blockI ];
+		index_stream >> block.offset >> block.size >> block.columns;
+		block.starts.resize( seq_count );
+		block.lengths.resize( seq_count );
+		for( uint seqI = 0; seqI < seq_count; seqI++ )
+			index_stream >> block.starts[ seqI ] >> block.lengths[ seqI ];
+	}
+	if( index_stream.fail() )
+		return false;
+	sortBlocks();
+	return true;
+}
+
+void XmfaIndex::Write( ostream& index_stream ) const{
+	index_stream << XMFA_INDEX_VERSION << '\n';
+	index_stream << "#AlignmentSize\t" << alignment_size << '\n';
+	index_stream << "#SequenceCount\t" << seq_count << '\n';
+	index_stream << "#FileCount\t" << seq_filename.size() << '\n';
+	for( size_t fileI = 0; fileI < seq_filename.size(); fileI++ )
+		index_stream << "#Sequence" << fileI + 1 << "File\t" << seq_filename[ fileI ] << '\n';
+	index_stream << "#BlockCount\t" << blocks.size() << '\n';
+	for( size_t blockI = 0; blockI < blocks.size(); blockI++ ){
+		const Block& block = blocks[ blockI ];
+		index_stream << block.offset << '\t' << block.size << '\t' << block.columns;
+		for( uint seqI = 0; seqI < seq_count; seqI++ )
+			index_stream << '\t' << block.starts[ seqI ] << '\t' << block.lengths[ seqI ];
+		index_stream << '\n';
+	}
+	index_stream.flush();
+}
+
+void XmfaIndex::ReadBlock( istream& xmfa_stream, size_t blockI, string& block_text ) const{
+	const Block& block = blocks[ blockI ];
+	block_text.resize( block.size );
+	xmfa_stream.clear();
+	xmfa_stream.seekg( block.offset );
+	if( block.size > 0 )
+		xmfa_stream.read( &block_text[0], block.size );
+	if( (uint64)xmfa_stream.gcount() != block.size )
+		Throw_gnExMsg( FileUnreadable(), "Alignment file is shorter than its index.\n");
+}
+
+void XmfaIndex::sortBlocks(){
+	left_ends.assign( seq_count, vector< gnSeqI >() );
+	left_blocks.assign( seq_count, vector< size_t >() );
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		vector< pair< gnSeqI, size_t > > lefts;
+		for( size_t blockI = 0; blockI < blocks.size(); blockI++ ){
+			int64 start = blocks[ blockI ].starts[ seqI ];
+			if( start == 0 || blocks[ blockI ].lengths[ seqI ] == 0 )
+				continue;
+			lefts.push_back( make_pair( (gnSeqI)(start < 0 ? -start : start), blockI ) );
+		}
+		sort( lefts.begin(), lefts.end() );
+		left_ends[ seqI ].resize( lefts.size() );
+		left_blocks[ seqI ].resize( lefts.size() );
+		for( size_t leftI = 0; leftI < lefts.size(); leftI++ ){
+			left_ends[ seqI ][ leftI ] = lefts[ leftI ].first;
+			left_blocks[ seqI ][ leftI ] = lefts[ leftI ].second;
+		}
+	}
+}
+
+size_t XmfaIndex::FindBlock( uint seqI, gnSeqI position ) const{
+	if( seqI >= left_ends.size() )
+		return blocks.size();
+	// the last block that starts at or before position is the only one that can contain it
+	const vector< gnSeqI >& lefts = left_ends[ seqI ];
+	vector< gnSeqI >::const_iterator next = upper_bound( lefts.begin(), lefts.end(), position );
+	if( next == lefts.begin() )
+		return blocks.size();
+	size_t blockI = left_blocks[ seqI ][ (next - lefts.begin()) - 1 ];
+	if( position < *(next - 1) + blocks[ blockI ].lengths[ seqI ] )
+		return blockI;
+	return blocks.size();
+}
+
+}
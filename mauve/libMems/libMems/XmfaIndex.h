@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * This file is licensed under the GPL.
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifndef _XmfaIndex_h_
+#define _XmfaIndex_h_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnDefs.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mems {
+
+/** The fields of an XMFA def. line, which reads ">seq:start-stop strand name" */
+struct XmfaDefline {
+	uint seqI;	/**< the sequence number, which starts at 1, or 0 if the line has none */
+	int64 start;
+	int64 stop;
+	std::string strand;	/**< "+" for the forward strand */
+	std::string name;	/**< anything following the strand */
+};
+
+/**
+ * Parses an XMFA def. line.  All of the XMFA readers in libMems use this, so they
+ * agree on what a def. line holds.
+ */
+void parseXmfaDefline( const std::string& line, XmfaDefline& defline );
+
+/**
+ * An XmfaIndex locates the aligned blocks of an XMFA file so that single blocks can be
+ * read without parsing the rest of the alignment.  For each block it records the byte
+ * range in the file, the number of alignment columns, and the coordinates of every
+ * genome.  Indexes are stored as tab-delimited text in a file named by IndexFileName().
+ */
+class XmfaIndex {
+public:
+	/** The location and extent of one aligned block */
+	struct Block {
+		uint64 offset;	/**< byte offset of the block's first defline */
+		uint64 size;	/**< number of bytes from the first defline through the '=' line */
+		gnSeqI columns;	/**< number of alignment columns */
+		std::vector< int64 > starts;	/**< start of each genome, negative on the reverse strand and 0 when the genome is absent */
+		std::vector< gnSeqI > lengths;	/**< number of residues of each genome */
+	};
+
+	XmfaIndex();
+
+	/** @return the index file name for an XMFA file, the alignment's name with an 'i' appended */
+	static std::string IndexFileName( const std::string& xmfa_fname );
+
+	/**
+	 * Reads the index of an XMFA file.  If the index is missing or older than the
+	 * alignment it is built and, when possible, saved next to the alignment.
+	 */
+	void Open( const std::string& xmfa_fname );
+
+	/** Scans an XMFA alignment and records the location of each block */
+	void Build( std::istream& xmfa_stream );
+
+	/**
+	 * Reads an index written by Write()
+	 * @return false if the stream does not contain a complete index
+	 */
+	bool Read( std::istream& index_stream );
+
+	/** Writes the index in tab-delimited text */
+	void Write( std::ostream& index_stream ) const;
+
+	/** Reads the text of a single block from the indexed XMFA file */
+	void ReadBlock( std::istream& xmfa_stream, size_t blockI, std::string& block_text ) const;
+
+	/**
+	 * @return the block containing a position of genome seqI, or blocks.size()
+	 * if the position is not aligned.  The blocks of a genome are binary searched
+	 * by their left ends, since no two of them overlap in an XMFA alignment.
+	 */
+	size_t FindBlock( uint seqI, gnSeqI position ) const;
+
+	std::vector< std::string > seq_filename;	/**< The sequence file names given in the alignment's header */
+	std::vector< Block > blocks;	/**< The blocks in file order */
+	uint seq_count;	/**< The number of genomes, the largest sequence number on any defline */
+	uint64 alignment_size;	/**< The size of the indexed XMFA file in bytes */
+protected:
+	/** fills left_ends and left_blocks from blocks */
+	void sortBlocks();
+
+	std::vector< std::vector< gnSeqI > > left_ends;	/**< for each genome, the sorted left ends of the blocks that contain it */
+	std::vector< std::vector< size_t > > left_blocks;	/**< for each genome, the block with each of left_ends */
+};
+
+}
+
+#endif	// _XmfaIndex_h_
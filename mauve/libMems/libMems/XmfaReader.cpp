@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * Please see the file called COPYING for licensing, copying, and modification
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/XmfaReader.h"
+#include "libMems/XmfaIndex.h"
+#include "libMems/MatchList.h"
+#include <sstream>
+
+using namespace std;
+using namespace genome;
+namespace mems {
+
+XmfaReader::XmfaReader( istream& xmfa_stream ) : 
+	xmfa_stream( xmfa_stream ),
+	line_count( 0 ),
+	blocks_read( 0 )
+{
+	// parse the sequence file names from the metadata ahead of the first block
+	while( readLine() && (cur_line.size() == 0 || cur_line[0] == '#') ){
+		stringstream ss( cur_line );
+		string token;
+		getline( ss, token, '\t' );
+		if( token.substr(1, 8) != "Sequence" || token.find( "File" ) == string::npos )
+			continue;
+		getline( ss, token );
+		seq_filename.push_back( token );
+	}
+}
+
+bool XmfaReader::readLine(){
+	if( !getline( xmfa_stream, cur_line ) ){
+		cur_line.clear();
+		return false;
+	}
+	line_count++;
+	return true;
+}
+
+bool XmfaReader::Next( CompactGappedAlignment<>& cga, vector< string >* residues )
+{
+	// skip ahead to the next def. line
+	while( cur_line.size() == 0 || cur_line[0] != '>' )
+		if( !readLine() )
+			return false;
+
+	vector< int64 > starts;
+	vector< gnSeqI > lengths;
+	if( residues != NULL )
+		residues->clear();
+	row_columns.clear();
+	const size_t bits_per_block = bitset_t::bits_per_block;
+	while( true ){
+		// read and parse the def. line
+		XmfaDefline defline;
+		parseXmfaDefline( cur_line, defline );
+		const uint seqI = defline.seqI;
+		const int64 start = defline.start;
+		const int64 stop = defline.stop;
+		if( seqI == 0 ){
+			cerr << "Invalid XMFA def. line " << line_count << endl;
+			Throw_gnEx(InvalidFileFormat());
+		}
+		if( starts.size() < seqI ){
+			if( row_blocks.size() < seqI )
+				row_blocks.resize( seqI );
+			for( size_t rowI = starts.size(); rowI < seqI; rowI++ )
+				row_blocks[ rowI ].clear();	// rows missing from the block are all gaps
+			starts.resize( seqI, 0 );
+			lengths.resize( seqI, 0 );
+			row_columns.resize( seqI, 0 );
+			if( residues != NULL )
+				residues->resize( seqI );
+		}
+
+		// read the sequence, setting a bit for each residue
+		vector< bitset_t::block_type >& blocks = row_blocks[ seqI - 1 ];
+		blocks.clear();
+		gnSeqI columns = 0;
+		gnSeqI chars = 0;
+		while( true ){
+			if( !readLine() ){
+				cerr << "Error in XMFA file format\n";
+				cerr << "The alignment ends after line " << line_count << " without terminating its last block\n";
+				Throw_gnEx(InvalidFileFormat());
+			}
+			if( cur_line.size() > 0 && (cur_line[0] == '>' || cur_line[0] == '=') )
+				break;
+			blocks.resize( (columns + cur_line.size() + bits_per_block - 1) / bits_per_block, 0 );
+			for( size_t charI = 0; charI < cur_line.size(); charI++, columns++ ){
+				if( cur_line[ charI ] != '-' ){
+					blocks[ columns / bits_per_block ] |= (bitset_t::block_type)1 << (columns % bits_per_block);
+					chars++;
+				}
+			}
+			if( residues != NULL )
+				(*residues)[ seqI - 1 ] += cur_line;
+		}
+		row_columns[ seqI - 1 ] = columns;
+		lengths[ seqI - 1 ] = chars;
+
+		if( defline.strand == "+" )
+			starts[ seqI - 1 ] = start;
+		else{
+			int64 left = start < stop ? start : stop;
+			int64 right = start < stop ? stop : start;
+			starts[ seqI - 1 ] = chars == 0 ? 0 : -left;
+			if( (int64)chars != right - left + 1 && !(chars == 0 && stop - start == 1) ){
+				cerr << "Error in XMFA file format\n";
+				cerr << "Before line " << line_count << endl;
+				cerr << "Expecting " << right - left + 1 << " characters based on defline\n";
+				cerr << "Actually read " << chars << " characters of sequence\n";
+				Throw_gnEx(InvalidFileFormat());
+			}
+		}
+		if( cur_line[0] == '=' )
+			break;
+	}
+	blocks_read++;
+
+	// give the block a row for every genome
+	const uint seq_count = (uint)(max)( seq_filename.size(), starts.size() );
+	gnSeqI aln_length = 0;
+	for( size_t seqI = 0; seqI < row_columns.size(); seqI++ )
+		aln_length = (max)( aln_length, row_columns[ seqI ] );
+	vector< bitset_t > aln_mat( seq_count );
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		if( seqI < starts.size() )
+			aln_mat[ seqI ] = bitset_t( row_blocks[ seqI ].begin(), row_blocks[ seqI ].end() );
+		aln_mat[ seqI ].resize( aln_length );
+	}
+	cga = CompactGappedAlignment<>( seq_count, aln_length );
+	for( uint seqI = 0; seqI < seq_count; seqI++ ){
+		cga.SetLength( seqI < lengths.size() ? lengths[ seqI ] : 0, seqI );
+		cga.SetStart( seqI, seqI < starts.size() ? starts[ seqI ] : 0 );
+	}
+	cga.SetAlignment( aln_mat );
+	if( residues != NULL ){
+		residues->resize( seq_count );
+		for( uint seqI = 0; seqI < seq_count; seqI++ )
+			(*residues)[ seqI ].resize( aln_length, '-' );
+	}
+	return true;
+}
+
+}
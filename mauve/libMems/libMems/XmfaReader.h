@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * This file is copyright 2002-2007 Aaron Darling and authors listed in the AUTHORS file.
+ * This file is licensed under the GPL.
+ * Please see the file called COPYING for licensing details.
+ * **************
+ ******************************************************************************/
+
+#ifndef _XmfaReader_h_
+#define _XmfaReader_h_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libGenome/gnDefs.h"
+#include "libMems/CompactGappedAlignment.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mems {
+
+/**
+ * An XmfaReader reads an XMFA alignment one block at a time.  Each block is parsed
+ * straight into the gap pattern of a CompactGappedAlignment<>, so memory use is bounded
+ * by the largest block rather than the whole alignment.  Blocks are read the way
+ * GenericIntervalList::ReadStandardAlignment() reads them.
+ */
+class XmfaReader {
+public:
+	/** Reads the alignment's header from xmfa_stream, which must stay open while blocks are read */
+	XmfaReader( std::istream& xmfa_stream );
+
+	/**
+	 * Reads the next block of the alignment
+	 * @param cga		(output) The block's coordinates and gap pattern, with a row for each sequence
+	 *					file named in the header or more if the block names more sequences
+	 * @param residues	(output) If not NULL, each row of the block, padded with gaps
+	 * @return false when no blocks remain
+	 * @throws InvalidFileFormat if the block is malformed or the alignment ends before its '=' line
+	 */
+	bool Next( CompactGappedAlignment<>& cga, std::vector< std::string >* residues = NULL );
+
+	/** @return the number of blocks read so far */
+	size_t BlocksRead() const { return blocks_read; }
+
+	std::vector< std::string > seq_filename;	/**< The sequence file names given in the alignment's header */
+
+protected:
+	/** reads the next line into cur_line, @return false at the end of the stream */
+	bool readLine();
+
+	std::istream& xmfa_stream;
+	std::string cur_line;
+	uint64 line_count;
+	size_t blocks_read;
+	std::vector< std::vector< bitset_t::block_type > > row_blocks;	/**< gap pattern of each row of the current block */
+	std::vector< gnSeqI > row_columns;	/**< number of columns in each row of the current block */
+};
+
+}
+
+#endif	// _XmfaReader_h_
@@ -18,8 +18,6 @@
 #include <sys/stat.h>
 #endif
 
-static int OperationNumber = 0;
-
 int QueueEmpty( aFILE * file );
 void RemoveOperation( aFILE * file );
 void FreeQueue( aFILE * file );
@@ -166,7 +164,7 @@ int EnqueueOperation( char * buffer, offset_t size, offset_t count, aFILE * file
 	file->queuehead->size = size;
 	file->queuehead->count = count;
 	file->queuehead->pos = pos;
-	file->queuehead->operation = ++OperationNumber;        
+	file->queuehead->operation = ++file->opnum;        
 	file->queuehead->next = NULL;
     return( file->queuehead->operation );
 }
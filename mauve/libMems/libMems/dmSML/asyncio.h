@@ -106,6 +106,8 @@ typedef struct _aFILE {
     int busy;
     // operation serial number (to ensure serial operation).
     int op;
+    // id of the last operation queued on this file
+    int opnum;
     // are we to be closed?
     int toclose;
     // queue of io operations
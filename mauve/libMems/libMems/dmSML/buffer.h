@@ -83,10 +83,11 @@ enum {
 
 
 // this is the record as in the files to be sorted
+// it overlays sml_t, a 64-bit key followed by a 64-bit position
 typedef struct record_s {
     unsigned char key[10];
     unsigned char num[1];
-    unsigned char payload[1];
+    unsigned char payload[5];
 } record_t;
 
 
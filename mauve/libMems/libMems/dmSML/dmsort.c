@@ -13,6 +13,10 @@
 #include "libMems/dmSML/sml.h"
 #include "libMems/dmSML/dmsort.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 // define this if you're using the ASCII sortgen data.
 // don't define if you're using random data (dmsortgen)
 //#define ASCII_KEYBYTES
@@ -65,105 +69,11 @@ typedef struct device_s {
 } device_t;
 */
 
-device_t *Devices;
-int NumDevices;
-
-
-
-// ugly hack
-//#define BIN_SPECIAL     (-10000)
-
-int NSortBufs;
-sort_buf_t *SortBufs;
-
-
-// how the working set is allocated originally.
-offset_t BufferSizeMin;
-offset_t BufferSizeMax;
-
-
-
-/*
-// what we use to represent a bin.
-typedef struct bin_s {
-    aFILE               *file;      // File we write/read on.
-    int                 dev;        // This is an index into the Devices table.
-    offset_t            nrecs;      // Number of records written to bin.
-    buffer_list_t       bufs;       // Our list of buffers that holds our data.
-} bin_t;
-
-*/
-
-// number specified by a cmdline param at runtime.
-bin_t   *Bins;
-int     NumBins;
-int     NumBinDevs;  // number of binning devices
-
-/*
-typedef struct seqbuf_s {
-	aFILE				*file;		// Output file
-	int					dev;		// device table index for output file
-	offset_t			bufpos;		// position in current buffer
-	uint64				seq_pos;	// position in sequence that is next to translate
-	buffer_list_t		bufs;		// list of buffers for data
-} seqbuf_t;
-*/
-
-seqbuf_t Seqbuf;
-    
-aFILE   *Data;       // the data to sort
-int     DataDev;     // the device the data file is on.
-
-
-const char *OutFileName = "unset";     // the output file name.
-aFILE   *Output;     // the output file (sorted data goes here)
-int     OutputDev;   // the device the output goes on.
-
-
-
-int BinToRead, BinToWrite, BinToSort;
-
-
-
-working_set_t   WS;      // the Working Set we use to do our sorting.
 
-offset_t NumRecs;        // the total number of blocks to process
-offset_t RecsProcessed;  // number of blocks processed (put in bins to write out)
-offset_t RecsRead;       // number of records fully read in.
-offset_t RecsUnread;     // number of blocks on disk (not yet had 'read' called)
-offset_t RecsCommitted;  // number of records committed to be written.
-offset_t RecsWritten;    // number of records actually written on disk.
-
-
-// timers
-double RunningTime;
-dmtimer_t *RunningTimer;
-double BinningTime;
-dmtimer_t *BinningTimer;
-double SortingTime;
-dmtimer_t *SortingTimer;
-
-double QSortTime;
-dmtimer_t *QSortTimer;
-
-double ReadIdleTime;
-dmtimer_t *ReadIdleTimer;
-double SortIdleTime;
-dmtimer_t *SortIdleTimer;
-double WriteIdleTime;
-dmtimer_t *WriteIdleTimer;
-
-// buffer lists
-buffer_list_t   Free;           // the free list
-buffer_list_t   ToProcess;      // list read and to be processed
-buffer_list_t   Reading;        // the list that's waiting on stuff to read.
-buffer_list_t   Restructure;	// buffers that need post-read and pre-binning processing
-
-
-static buffer_t * AllocateFree( void ) {
+static buffer_t * AllocateFree( dmsort_t* dm ) {
     buffer_t * ret;
-    if( Free.nitems ) {
-        ret = PopHead( &Free );
+    if( dm->Free.nitems ) {
+        ret = PopHead( &dm->Free );
     } else {
         printf( "error: called AllocateFree but free list is empty\n" );
         return( NULL );
@@ -177,9 +87,7 @@ static buffer_t * AllocateFree( void ) {
 }
 
 
-static unsigned int divisor = 0;
-
-static int ComputeBinNumber( const unsigned char key[10] ) {
+static int ComputeBinNumber( dmsort_t* dm, const unsigned char key[10] ) {
     int i;
     unsigned int keyval = 0;
     // how many bits can we use for the binning number?
@@ -188,11 +96,11 @@ static int ComputeBinNumber( const unsigned char key[10] ) {
     // strange constant is 256^3, because we're dealing
     // with effectively a base 256 number here, and we can
     // only handle 3 places without overflowing.
-    if( divisor == 0 ) {
-        divisor = (unsigned)16777216 / (unsigned)NumBins;
+    if( dm->divisor == 0 ) {
+        dm->divisor = (unsigned)16777216 / (unsigned)dm->NumBins;
         // need ceiling of this
-        divisor += (unsigned)16777216 % (unsigned)NumBins ? 1 : 0;
-        printf( "Divisor is: %u\n", divisor );
+        dm->divisor += (unsigned)16777216 % (unsigned)dm->NumBins ? 1 : 0;
+        printf( "Divisor is: %u\n", dm->divisor );
     }
     // now we compute the number represented by the first 3
     // characters of the key, and divide it by divisor, the
@@ -205,18 +113,18 @@ static int ComputeBinNumber( const unsigned char key[10] ) {
     
 //    printf( "Keyval is: %u\n", keyval );
 //    printf( "Bin is: %u\n", keyval / divisor );
-    return( keyval / divisor );
+    return( keyval / dm->divisor );
 }
 
 // just like ComputeBinNumber except we reserve one bin for zero keys.
-static int ComputeNNNNNBinNumber( const unsigned char key[10] ) {
+static int ComputeNNNNNBinNumber( dmsort_t* dm, const unsigned char key[10] ) {
     int i;
     unsigned int keyval = 0;
-    if( divisor == 0 ) {
-        divisor = (unsigned)16777216 / ((unsigned)NumBins - 1);
+    if( dm->divisor == 0 ) {
+        dm->divisor = (unsigned)16777216 / ((unsigned)dm->NumBins - 1);
         // need ceiling of this
-        divisor += (unsigned)16777216 % ((unsigned)NumBins - 1) ? 1 : 0;
-        printf( "Divisor is: %u\n", divisor );
+        dm->divisor += (unsigned)16777216 % ((unsigned)dm->NumBins - 1) ? 1 : 0;
+        printf( "Divisor is: %u\n", dm->divisor );
     }
     // now we compute the number represented by the first 3
     // characters of the key, and divide it by divisor, the
@@ -231,22 +139,22 @@ static int ComputeNNNNNBinNumber( const unsigned char key[10] ) {
 //    printf( "Bin is: %u\n", keyval / divisor );
 	if( keyval == 0 )
 		return 0;
-    return ( keyval / divisor ) + 1;
+    return ( keyval / dm->divisor ) + 1;
 }
 
 
 
-static int ComputeAsciiBinNumber( const unsigned char key[10] ) {
+static int ComputeAsciiBinNumber( dmsort_t* dm, const unsigned char key[10] ) {
     int i;
     unsigned int keyval = 0;
     // how many bits can we use for the binning number?
     // first time through, compute divisor
-    if( divisor == 0 ) {
+    if( dm->divisor == 0 ) {
         // strange constant is 95^4 -- the max possible value
         // of the first five key characters + 1.
-        divisor = 81450625 / NumBins;
+        dm->divisor = 81450625 / dm->NumBins;
         // need ceiling of this
-        divisor += 81450625 % NumBins ? 1 : 0;
+        dm->divisor += 81450625 % dm->NumBins ? 1 : 0;
     }
     // now we compute the number represented by the first 4
     // characters of the key, and divide it by divisor, the
@@ -256,26 +164,23 @@ static int ComputeAsciiBinNumber( const unsigned char key[10] ) {
         keyval *= 95;
         keyval += key[i] - ' ';
     }
-    return( keyval / divisor );
+    return( keyval / dm->divisor );
 }
 
 
 
-static offset_t         consumed_recs = 0;
-static buffer_t         *toprocess = NULL;
-
-static void DoBinning( void ) {
+static void DoBinning( dmsort_t* dm ) {
     //printf( "---------------  do binning -------------\n" );
     while( 1 ) {
         int bin = -1;
         // if we don't already have a buffer to process, see if we
         // can get one.
-        if( toprocess == NULL ) {
+        if( dm->toprocess == NULL ) {
             //printf( "toprocess == null -- no currently processing buffer\n" );
-            if( ToProcess.nitems ) {
+            if( dm->ToProcess.nitems ) {
                 //printf( "getting one off ToProcess list\n" );
-                toprocess = PopHead( &(ToProcess) );
-                consumed_recs = 0;
+                dm->toprocess = PopHead( &(dm->ToProcess) );
+                dm->consumed_recs = 0;
             } else {
                 // we can't get anything to process
                 //printf( "nothing to process\n" );
@@ -285,22 +190,22 @@ static void DoBinning( void ) {
         //printf( "processing records in current toprocess buffer\n" );
         // try to process all the records in the toprocess buffer.
         //printf( "for( ; consumed_recs (%d) < toprocess->numrecs (%d); ... ) {\n", consumed_recs, toprocess->numrecs );
-        for( ; consumed_recs < toprocess->numrecs; consumed_recs++, RecsProcessed++ ) {
+        for( ; dm->consumed_recs < dm->toprocess->numrecs; dm->consumed_recs++, dm->RecsProcessed++ ) {
             
             buffer_t *headbuf;
-            record_t *rec = &(toprocess->recs[consumed_recs]);
+            record_t *rec = &(dm->toprocess->recs[dm->consumed_recs]);
             
             // find what bin this next record belongs in.
 #ifdef ASCII_KEYBYTES
-            bin = ComputeAsciiBinNumber( rec->key );
+            bin = ComputeAsciiBinNumber( dm, rec->key );
 #else
 #ifdef NNNNN_KEYBYTES
-			bin = ComputeNNNNNBinNumber( rec->key );
+			bin = ComputeNNNNNBinNumber( dm, rec->key );
 #else
-            bin = ComputeBinNumber( rec->key );
+            bin = ComputeBinNumber( dm, rec->key );
 #endif
 #endif
-            if( (bin >= NumBins) || (bin < 0) ) {
+            if( (bin >= dm->NumBins) || (bin < 0) ) {
                 printf( "error: invalid bin from ComputeBinNumber: %d\n", bin );
             }
 
@@ -308,7 +213,7 @@ static void DoBinning( void ) {
 
             // now, let's see what the situation is with that bin and its
             // buffers.  In particular, do we have a spot to put this record?
-            headbuf = Bins[bin].bufs.head;
+            headbuf = dm->Bins[bin].bufs.head;
             // if we have a buffer, and the buffer is full or executing or
             // if there's no buffer at all, let's try to get one
             if( !headbuf || 
@@ -323,10 +228,10 @@ static void DoBinning( void ) {
                     headbuf->operation = OP_NONE;
                 } else {
                     //printf( "trying to get buffer from free list\n" );
-                    if( Free.nitems ) {
+                    if( dm->Free.nitems ) {
                         //printf( "got one from freelist\n" );
-                        PushHead( &(Bins[bin].bufs), AllocateFree() );
-                        headbuf = Bins[bin].bufs.head;
+                        PushHead( &(dm->Bins[bin].bufs), AllocateFree( dm ) );
+                        headbuf = dm->Bins[bin].bufs.head;
                     } else {
 //                        printf( "no free buffers to use for bin -- binning BLOCKS!\n" );
                         return;
@@ -336,14 +241,14 @@ static void DoBinning( void ) {
             // now headbuf must exist, and it must be non-full so we can
             // add our item.
             headbuf->recs[headbuf->numrecs++] = *rec;
-            Bins[bin].nrecs++;
+            dm->Bins[bin].nrecs++;
             //printf( "added rec to bin\n" );
             // if we made it full, write the thing
             if( headbuf->numrecs >= headbuf->totalrecs ) {
                 //printf( "writing bin buffer because full\n" );
-                headbuf->file = Bins[bin].file;
-                headbuf->device = &(Devices[Bins[bin].dev].dev);
-                RecsCommitted += headbuf->numrecs;
+                headbuf->file = dm->Bins[bin].file;
+                headbuf->device = &(dm->Devices[dm->Bins[bin].dev].dev);
+                dm->RecsCommitted += headbuf->numrecs;
 #ifdef NO_BIN_WRITE_PERF_TEST
 				// just put it in the finished state
 				headbuf->operation = OP_FINISHED;
@@ -357,10 +262,10 @@ static void DoBinning( void ) {
         
         // if we hit the end of this buffer,
         // put it back on the free list, and start the loop over
-        if( consumed_recs >= toprocess->numrecs ) {
+        if( dm->consumed_recs >= dm->toprocess->numrecs ) {
             //printf( "finished with this block\n" );
-            PushTail( &Free, toprocess );
-            toprocess = NULL;
+            PushTail( &dm->Free, dm->toprocess );
+            dm->toprocess = NULL;
         }
 
         //printf( "going back for more\n" );
@@ -372,21 +277,21 @@ static void DoBinning( void ) {
 
 
 
-void FinishBinning() {
+void FinishBinning( dmsort_t* dm ) {
     int i;
     buffer_t *b;
     offset_t recs = 0;
     // be sure to finish off the write operations.
-    for( i = 0; i < NumBins; i++ ) {
+    for( i = 0; i < dm->NumBins; i++ ) {
         //printf( "bin: %d, nrecs: %d, operation: %d\n", i, Bins[i].nrecs, Bins[i].operation );
-        while( Bins[i].bufs.nitems ) {
+        while( dm->Bins[i].bufs.nitems ) {
             // walk through the buffers, and if they haven't been executed,
             // execute them.
-            b = PopHead( &(Bins[i].bufs) );
+            b = PopHead( &(dm->Bins[i].bufs) );
             if( b->operation == OP_NONE && b->numrecs ) {
                 recs += b->numrecs;
-                b->file = Bins[i].file;
-                b->device = &(Devices[Bins[i].dev].dev);
+                b->file = dm->Bins[i].file;
+                b->device = &(dm->Devices[dm->Bins[i].dev].dev);
 #ifdef NO_BIN_WRITE_PERF_TEST
 				// just put it in the finished state
 				b->operation = OP_FINISHED;
@@ -396,41 +301,41 @@ void FinishBinning() {
             }
         }
     }
-    RecsCommitted += recs;
+    dm->RecsCommitted += recs;
 }
 
 
 
-offset_t CalculateDataReadSize( buffer_t* b ){
+offset_t CalculateDataReadSize( dmsort_t* dm, buffer_t* b ){
 // commented version is for traditional dmsort
 //	return MIN(b->totalrecs, RecsUnread) * sizeof( record_t );
-	return MIN(b->totalrecs + mask_length - 1, RecsUnread + mask_length - 1 );
+	return MIN(b->totalrecs + dm->mask_length - 1, dm->RecsUnread + dm->mask_length - 1 );
 }
 
-static void DoReading( void ) {
+static void DoReading( dmsort_t* dm ) {
     buffer_t * b;
     //printf( "do reading\n" );
-    if( RecsUnread && Free.nitems ) {
+    if( dm->RecsUnread && dm->Free.nitems ) {
         // allocate a buffer
-        b = AllocateFree();
+        b = AllocateFree( dm );
         
         // start reading into it.
-        b->file = Data;
-        ReadBuffer( b, MIN(b->totalrecs, RecsUnread), &(Devices[DataDev].dev) );
+        b->file = dm->Data;
+        ReadBuffer( b, MIN(b->totalrecs, dm->RecsUnread), &(dm->Devices[dm->DataDev].dev) );
 
-        b->input_pos = NumRecs - RecsUnread;
+        b->input_pos = dm->NumRecs - dm->RecsUnread;
        	// need to step back mask_length - 1 characters to get the complete sequence!!
 //		if( b->input_pos >= mask_length - 1 )
 //			b->input_pos -= mask_length - 1;
         b->io_pos = b->input_pos;
 //		printf( "Reading offset %llu\n", b->io_pos );
-        b->io_size = CalculateDataReadSize( b );
+        b->io_size = CalculateDataReadSize( dm, b );
         // decrement recsunread appropriately
-        RecsUnread -= MIN(MIN(b->totalrecs,RecsUnread),RecsUnread);
+        dm->RecsUnread -= MIN(MIN(b->totalrecs,dm->RecsUnread),dm->RecsUnread);
         
         // put the thing on the Reading list.
         //printf( "new buffer on reading list\n" );
-        PushTail( &Reading, b );
+        PushTail( &dm->Reading, b );
     }
 }
 
@@ -438,53 +343,53 @@ static void DoReading( void ) {
 
 
 
-static void HandleBinWriteCompletions( void ) {
+static void HandleBinWriteCompletions( dmsort_t* dm ) {
     int i;
     buffer_t *b, *tmpnext;
     //printf( "handle bin write completions\n" );
-    for( i = 0; i < NumBins; i++ ) {
-        b = Bins[i].bufs.head;
+    for( i = 0; i < dm->NumBins; i++ ) {
+        b = dm->Bins[i].bufs.head;
         do {
             if( !b ) {
                 break;
             }
             tmpnext = b->next;
             if( b->operation == OP_FINISHED ) {
-                RecsWritten += b->numrecs;
-                if( Bins[i].bufs.nitems > 1 ) {
+                dm->RecsWritten += b->numrecs;
+                if( dm->Bins[i].bufs.nitems > 1 ) {
                     b->operation = OP_NONE;
-                    PushHead( &Free, RemoveItem( &(Bins[i].bufs), b ) );
+                    PushHead( &dm->Free, RemoveItem( &(dm->Bins[i].bufs), b ) );
                 } else {
                     b->operation = BIN_SPECIAL;
                 }
             }
             b = tmpnext;
-        } while( b != Bins[i].bufs.head && Bins[i].bufs.nitems > 1 );
+        } while( b != dm->Bins[i].bufs.head && dm->Bins[i].bufs.nitems > 1 );
     }
 }
 
-static void HandleSeqbufWriteCompletions( void ) {
+static void HandleSeqbufWriteCompletions( dmsort_t* dm ) {
     buffer_t *b, *tmpnext;
     //printf( "handle bin write completions\n" );
-    b = Seqbuf.bufs.head;
+    b = dm->Seqbuf.bufs.head;
     do {
         if( !b ) {
             break;
         }
         tmpnext = b->next;
         if( b->operation == OP_FINISHED ) {
-            if( Seqbuf.bufs.nitems > 1 ) {
+            if( dm->Seqbuf.bufs.nitems > 1 ) {
                 b->operation = OP_NONE;
-                PushHead( &Free, RemoveItem( &(Seqbuf.bufs), b ) );
+                PushHead( &dm->Free, RemoveItem( &(dm->Seqbuf.bufs), b ) );
             } 
         }
         b = tmpnext;
-    } while( b != Seqbuf.bufs.head && Seqbuf.bufs.nitems > 1 );
+    } while( b != dm->Seqbuf.bufs.head && dm->Seqbuf.bufs.nitems > 1 );
 }
 
 #define ALPHA_BITS 2
 
-static void Translate32(uint32* dest, const char* src, const unsigned len){
+static void Translate32( dmsort_t* dm, uint32* dest, const char* src, const unsigned len){
 	uint8 start_bit = 0;
 	unsigned cur_word = 0;
 	uint32 word_mer = 0;
@@ -495,7 +400,7 @@ static void Translate32(uint32* dest, const char* src, const unsigned len){
 //		uint32 tmp = DNA_TABLE[src[i]];
 		if(start_bit + ALPHA_BITS <= 32){
 			word_mer <<= ALPHA_BITS;
-			word_mer |= DNA_TABLE[src[i]];
+			word_mer |= dm->DNA_TABLE[src[i]];
 			dest[cur_word] = word_mer;
 			start_bit += ALPHA_BITS;
 			if(start_bit >= 32 && i < len - 1){
@@ -522,16 +427,73 @@ static void Translate32(uint32* dest, const char* src, const unsigned len){
 }
 
 
-void RestructureReadSMLBins( void ) {
-	char little_endian = 1;
-	mask_t bit;
-	mask_t mer, rc_mer;
-	record_t forward, reverse;
-	record_t begin[6];	// the first six records could potentially overwrite the sequence
-	int i;
-	offset_t seqI, extras, weight;
+/**
+ * Stores the lesser of the forward and reverse complement seed at each of
+ * the mer_count positions of sequence into recs.  Every position is
+ * independent so the positions are divided among the OpenMP threads.
+ */
+static void ExtractMers( dmsort_t* dm, const char* sequence, record_t* recs, offset_t mer_count, offset_t input_pos ) {
+	sml_t *sml = (sml_t*)recs;
+	long merI;
+#pragma omp parallel for schedule(static) if( mer_count >= PARALLEL_MERS_MIN )
+	for( merI = 0; merI < (long)mer_count; merI++ ){
+		char little_endian = 1;
+		mask_t bit;
+		mask_t mer, rc_mer = 0;
+		record_t forward, reverse;
+		int i;
+		bit = 1;
+		bit <<= dm->mask_length - 1;
+		mer = 0;
+		for( i = 0; i < dm->mask_length; i++ ){
+			if( bit & dm->seed_mask ){
+				mer <<= 2;
+				mer |= dm->DNA_TABLE[ sequence[ merI + i ] ];
+			}
+			bit >>= 1;
+		}
+		// copy the mer from the 64-bit integer based on the endian-ness of the system
+		// copy mer to forward key
+		mer <<= 64 - (2 * dm->mask_weight);
+		if( little_endian ){
+			for( i = 0; i < MASK_T_BYTES; i++ )
+				forward.key[i] = ((char*)(&mer))[ sizeof( mer ) - i - 1 ];
+
+		}else{
+			for( i = 0; i < MASK_T_BYTES; i++ )
+				forward.key[i] = ((char*)(&mer))[ i ];
+		}
+
+		// reverse complement the mer
+		mer = ~mer;
+		for( i = 0; i < 64; i += 2 ){
+			rc_mer <<= 2;
+			rc_mer |= mer & 3;
+			mer >>= 2;
+		}
+		rc_mer <<= 64 - (2 * dm->mask_weight);
+		// copy mer to reverse key
+		if( little_endian ){
+			for( i = 0; i < MASK_T_BYTES; i++ )
+				reverse.key[i] = ((char*)(&rc_mer))[ sizeof( mer ) - i - 1 ];
+		}else{
+			for( i = 0; i < MASK_T_BYTES; i++ )
+				reverse.key[i] = (((char*)(&rc_mer))[i]);
+		}
+		// put the lesser key in forward
+		if( COMPARE_KEYS( forward, reverse ) > 0)
+			forward = reverse;
+
+		recs[ merI ] = forward;
+		// set the position
+		sml[ merI ].pos = input_pos + merI;
+	}
+}
+
+void RestructureReadSMLBins( dmsort_t* dm ) {
+	offset_t seqI;
 	char* sequence;
-	sml_t *sml;
+	dmtimer_t *extract_timer;
 
     buffer_t *b, *tmpnext;
 	
@@ -544,23 +506,22 @@ void RestructureReadSMLBins( void ) {
 	int config_value = 4554307;
 //	int seq_offset;
     // go through and see if any have completed.
-    b = Restructure.head;
+    b = dm->Restructure.head;
     do {
         if( !b ) {
             break;
         }
 		// is this the buffer we need to translate next?
-		if( b->input_pos != Seqbuf.seq_pos ){
+		if( b->input_pos != dm->Seqbuf.seq_pos ){
 			b = b->next;
 			continue;
 		}
 		
         tmpnext = b->next;
 		sequence = (char *)b->recs;
-		sml = (sml_t*)b->recs;
 
 		// translate the sequence that was just read and write it out
-        headbuf = Seqbuf.bufs.head;
+        headbuf = dm->Seqbuf.bufs.head;
         // if we have a buffer, and the buffer is full or executing or
         // if there's no buffer at all, let's try to get one
         if( !headbuf || 
@@ -572,14 +533,14 @@ void RestructureReadSMLBins( void ) {
                 //printf( "headbuf is only one left and finished so reclaiming for use\n" );
                 headbuf->numrecs = 0;
                 headbuf->operation = OP_NONE;
-	            Seqbuf.bufpos = 0;
+	            dm->Seqbuf.bufpos = 0;
             } else {
                 //printf( "trying to get buffer from free list\n" );
-                if( Free.nitems ) {
+                if( dm->Free.nitems ) {
 //                    printf( "got one from freelist\n" );
-                    PushHead( &(Seqbuf.bufs), AllocateFree() );
-                    headbuf = Seqbuf.bufs.head;
-		            Seqbuf.bufpos = 0;
+                    PushHead( &(dm->Seqbuf.bufs), AllocateFree( dm ) );
+                    headbuf = dm->Seqbuf.bufs.head;
+		            dm->Seqbuf.bufpos = 0;
                 } else {
 //                    printf( "no free buffers to use for Seqbuf -- restructuring BLOCKS!\n" );
                     return;
@@ -587,7 +548,7 @@ void RestructureReadSMLBins( void ) {
             }
         }
 
-		seq_bit = Seqbuf.bufpos * 2;
+		seq_bit = dm->Seqbuf.bufpos * 2;
 		seq_word = seq_bit / 32;
 		word_remainder = seq_bit % 32;
 		if( word_remainder != 0 ){
@@ -596,17 +557,18 @@ void RestructureReadSMLBins( void ) {
 		
 //			int end_bit = 2 * (Seqbuf->bufpos + b->io_size - mask_length + 1);
 //			int end_remainder = end_bit % 32;
-		translate_length = b->io_size - mask_length + 1 - (word_remainder / 2);
-		if( b->io_size + b->input_pos >= NumRecs ){
+		translate_length = b->io_size - dm->mask_length + 1 - (word_remainder / 2);
+		// reads overlap by mask_length - 1 characters, so only the record count tells which one is last
+		if( b->input_pos + b->numrecs >= dm->NumRecs ){
 			// this is the last I/O, translate the whole thing
-			translate_length += mask_length - 1;
+			translate_length += dm->mask_length - 1;
 		}
 //			translate_length -= end_remainder / 2;
 		
 		// The number of bytes in headbuf->recs must ALWAYS be divisible by 4 when using
 		// Translate32, otherwise corruption will result
 #ifndef NO_RESTRUCTURE_PERF_TEST
-		Translate32( (uint32*)(headbuf->recs) + seq_word, ((char*)b->recs) + (word_remainder / 2), translate_length );
+		Translate32( dm, (uint32*)(headbuf->recs) + seq_word, ((char*)b->recs) + (word_remainder / 2), translate_length );
 #endif
 		
 		// need to fill in beginning
@@ -614,28 +576,31 @@ void RestructureReadSMLBins( void ) {
 			int begin_mer = 0;
 			for( seqI = 0; seqI < word_remainder / 2; seqI++ ){
 				begin_mer <<= 2;
-				begin_mer |= DNA_TABLE[ sequence[ seqI ] ];
+				begin_mer |= dm->DNA_TABLE[ sequence[ seqI ] ];
 			}
 //			((uint32*)headbuf->recs)[ seq_word - 1 ] <<= 32 - word_remainder;
 			((uint32*)headbuf->recs)[ seq_word - 1 ] |= begin_mer;
 		}
 		
-		Seqbuf.bufpos += translate_length + (word_remainder / 2);
-		Seqbuf.seq_pos += translate_length + (word_remainder / 2);
+		dm->Seqbuf.bufpos += translate_length + (word_remainder / 2);
+		dm->Seqbuf.seq_pos += translate_length + (word_remainder / 2);
 
         // if we made it full, write the thing
         // each buf will consume headbuf->totalrecs / 4 bytes.
         // there are headbuf->totalrecs * sizeof( record_t ) bytes available in the Seqbuf.
         // thus we can fit 4 * sizeof( record_t ) bufs in each Seqbuf
-        if( Seqbuf.bufpos == headbuf->totalrecs * sizeof( record_t ) * 4 ||
-			b->io_size + b->input_pos >= NumRecs ) {
+        if( dm->Seqbuf.bufpos == headbuf->totalrecs * sizeof( record_t ) * 4 ||
+			b->input_pos + b->numrecs >= dm->NumRecs ) {
             //printf( "writing bin buffer because full\n" );
-            headbuf->file = Seqbuf.file;
-            headbuf->device = &(Devices[Seqbuf.dev].dev);
+            headbuf->file = dm->Seqbuf.file;
+            headbuf->device = &(dm->Devices[dm->Seqbuf.dev].dev);
             WriteBuffer( headbuf, headbuf->totalrecs, headbuf->device );
-            headbuf->io_size = Seqbuf.bufpos / 4;
-            if( b->io_size + b->input_pos >= NumRecs ){
+            headbuf->io_size = dm->Seqbuf.bufpos / 4;
+            if( b->input_pos + b->numrecs >= dm->NumRecs ){
             	offset_t offI = 0;
+            	// keep the partly filled byte holding the last few characters
+            	if( dm->Seqbuf.bufpos % 4 != 0 )
+            		headbuf->io_size++;
             	offI = headbuf->io_size % 4;
             	if( offI != 0 )
 	            	headbuf->io_size += 4 - offI;
@@ -644,88 +609,35 @@ void RestructureReadSMLBins( void ) {
             	headbuf->io_size += 8;
             }
             headbuf = NULL;
-        }else if( Seqbuf.bufpos > headbuf->totalrecs * sizeof( record_t ) * 4 ){
+        }else if( dm->Seqbuf.bufpos > headbuf->totalrecs * sizeof( record_t ) * 4 ){
         	printf( "Error.  Over filled Seqbuf\n" );
         }
 
 
 		// translate the sequence according to the current sequence mask
 #ifndef NO_RESTRUCTURE_PERF_TEST
-		for( seqI = b->io_size - mask_length + 1; seqI > 0; seqI-- ){
-			bit = 1;
-			bit <<= mask_length - 1;
-			mer = 0;
-			weight = 0;
-			for( i = 0; i < mask_length; i++ ){
-				if( bit & seed_mask ){
-					mer <<= 2;
-					mer |= DNA_TABLE[ sequence[ seqI + i - 1 ] ];
-				}
-				bit >>= 1;
-			}
-			// copy the mer from the 64-bit integer based on the endian-ness of the system
-			// copy mer to forward key
-			mer <<= 64 - (2 * mask_weight);
-//			if( seqI + b->input_pos == config_value )
-//				__asm( nop );
-			if( little_endian ){
-				for( i = 0; i < MASK_T_BYTES; i++ )
-					forward.key[i] = ((char*)(&mer))[ sizeof( mer ) - i - 1 ];
-
-			}else{
-				for( i = 0; i < MASK_T_BYTES; i++ )
-					forward.key[i] = ((char*)(&mer))[ i ];
-			}
-
-			// reverse complement the mer
-			mer = ~mer;
-			for( i = 0; i < 64; i += 2 ){
-				rc_mer <<= 2;
-				rc_mer |= mer & 3;
-				mer >>= 2;
-			}
-			rc_mer <<= 64 - (2 * mask_weight);
-			// copy mer to reverse key
-			if( little_endian ){
-				for( i = 0; i < MASK_T_BYTES; i++ )
-					reverse.key[i] = ((char*)(&rc_mer))[ sizeof( mer ) - i - 1 ];
-			}else{
-				for( i = 0; i < MASK_T_BYTES; i++ )
-					reverse.key[i] = (((char*)(&rc_mer))[i]);
-			}
-			// put the lesser key in forward
-			if( COMPARE_KEYS( forward, reverse ) > 0)
-				forward = reverse;
-			
-			// watch out for the last 6 records
-			if( seqI <= 6 ){
-				begin[ seqI - 1] = forward;
-			}else{
-				b->recs[ seqI - 1 ] = forward;
-				// set the position
-				sml[ seqI - 1 ].pos = b->input_pos + seqI - 1;
-			}
-		}
-
-		extras = b->io_size - mask_length + 1 < 6 ? b->io_size - mask_length + 1 : 6;
-		
-		// fill in the first six records
-		for(; seqI < extras; seqI++ ){
-			b->recs[ seqI ] = begin[ seqI ];
-			// set the position
-			sml[ seqI ].pos = b->input_pos + seqI;
+		// the records overwrite the sequence they are made from, so
+		// extract them from a copy of the sequence
+		extract_timer = StartTimer();
+		if( dm->SeqScratchSize < b->io_size ){
+			dm->SeqScratch = realloc( dm->SeqScratch, b->io_size );
+			dm->SeqScratchSize = b->io_size;
 		}
+		memcpy( dm->SeqScratch, sequence, b->io_size );
+		ExtractMers( dm, dm->SeqScratch, b->recs, b->io_size - dm->mask_length + 1, b->input_pos );
+		dm->RestructureTime += ReadTimer( extract_timer ) / 1000.0;
+		StopTimer( extract_timer );
 #else
 	if(1){	// define a new scope so the variables can be local
 	// simulate random data in each bin
     int i;
     unsigned int keyval = 0;
 	unsigned int tmpval = 0;
-    if( divisor == 0 ) {
-        divisor = (unsigned)16777216 / (unsigned)NumBins;
+    if( dm->divisor == 0 ) {
+        dm->divisor = (unsigned)16777216 / (unsigned)dm->NumBins;
         // need ceiling of this
-        divisor += (unsigned)16777216 % (unsigned)NumBins ? 1 : 0;
-        printf( "Divisor is: %u\n", divisor );
+        dm->divisor += (unsigned)16777216 % (unsigned)dm->NumBins ? 1 : 0;
+        printf( "Divisor is: %u\n", dm->divisor );
     }
 	for( seqI = 0; seqI < b->numrecs; seqI++ ){
 		tmpval = keyval;
@@ -734,23 +646,23 @@ void RestructureReadSMLBins( void ) {
 			b->recs[ seqI ].key[ i - 1 ] = 0;
 			tmpval >>= 8;
 		}
-		keyval += divisor;
+		keyval += dm->divisor;
 	}
 	}
 #endif
 		
 		// b has been restructured, add it to the ToProcess list
-        PushTail( &ToProcess, RemoveItem( &Restructure, b ) );
+        PushTail( &dm->ToProcess, RemoveItem( &dm->Restructure, b ) );
 
 		
         b = tmpnext;
-    } while( b != Restructure.head && Restructure.nitems );
+    } while( b != dm->Restructure.head && dm->Restructure.nitems );
 }
 
-static void HandleReadingCompletions( void ) {
+static void HandleReadingCompletions( dmsort_t* dm ) {
     buffer_t *b, *tmpnext;
     // just go through and see if any have completed.
-    b = Reading.head;
+    b = dm->Reading.head;
     do {
         if( !b ) {
             break;
@@ -759,12 +671,12 @@ static void HandleReadingCompletions( void ) {
         if( b->operation == OP_FINISHED ) {
             // migrate this to the toprocess list
             b->operation = OP_NONE;
-            PushTail( &Restructure, RemoveItem( &Reading, b ) );
+            PushTail( &dm->Restructure, RemoveItem( &dm->Reading, b ) );
             // bookkeeping
-            RecsRead += b->numrecs;
+            dm->RecsRead += b->numrecs;
         }
         b = tmpnext;
-    } while( b != Reading.head && Reading.nitems );
+    } while( b != dm->Reading.head && dm->Reading.nitems );
 }
 
 
@@ -773,7 +685,7 @@ void print_usage( const char* pname ){
 	printf( "Usage: %s <-m Working set size in MB> <-b buffer size> <-i input file> <-o output file> [-n number of records] <bin directory> <num bins> ... [bin directory] [num bins]\n", pname );
 }
 
-int InitdmSML( long working_mb, long buffer_size, const char* input_filename, const char* output_filename, const char* const* scratch_paths, uint64 seed ) {
+int InitdmSML( dmsort_t* dm, long working_mb, long buffer_size, const char* input_filename, const char* output_filename, const char* const* scratch_paths, uint64 seed ) {
     int i, j;
     offset_t desired_ws_size, actual_ws_size;
     SMLHeader_t header;
@@ -785,13 +697,14 @@ int InitdmSML( long working_mb, long buffer_size, const char* input_filename, co
 
 	char *bin_name;
 	int scratchI = 0;
+	const char *out_base;
 
     // initialize the timing stuff
     InitTime();
 
     // start the running timer now.
-    RunningTime = 0;
-    RunningTimer = StartTimer();
+    dm->RunningTime = 0;
+    dm->RunningTimer = StartTimer();
 
 	if( working_mb != 0 ){
 
@@ -850,8 +763,15 @@ int InitdmSML( long working_mb, long buffer_size, const char* input_filename, co
 		}
 	}
 
-	BufferSizeMin = BufferSizeMax = buffer_size;
-	OutFileName = output_filename;
+	dm->BufferSizeMin = dm->BufferSizeMax = buffer_size;
+	dm->OutFileName = output_filename;
+	// bin files are named after the output so that concurrent sorts
+	// sharing a scratch path don't clobber each other's bins
+	out_base = output_filename;
+	for( i = 0; output_filename[ i ] != 0; i++ ){
+		if( output_filename[ i ] == '/' || output_filename[ i ] == '\\' )
+			out_base = output_filename + i + 1;
+	}
 	
 	// find out how many scratch paths were given before the null terminator
 	for( ; ; scratchI++ ){
@@ -861,57 +781,57 @@ int InitdmSML( long working_mb, long buffer_size, const char* input_filename, co
 	
     
 
-	NumBinDevs = scratchI;
-	NumDevices = 2 + NumBinDevs;
-	Devices = (device_t*)malloc( NumDevices * sizeof(device_t) );
-	DataDev = 0;
-	OutputDev = 1;
-	Devices[DataDev].devname = "Input device";
-	Devices[DataDev].path = input_filename;
-	Devices[DataDev].dev.buf = NULL;
-	Devices[OutputDev].devname = "Output device";
-	Devices[OutputDev].path = OutFileName;
-	Devices[OutputDev].dev.buf = NULL;
+	dm->NumBinDevs = scratchI;
+	dm->NumDevices = 2 + dm->NumBinDevs;
+	dm->Devices = (device_t*)malloc( dm->NumDevices * sizeof(device_t) );
+	dm->DataDev = 0;
+	dm->OutputDev = 1;
+	dm->Devices[dm->DataDev].devname = "Input device";
+	dm->Devices[dm->DataDev].path = input_filename;
+	dm->Devices[dm->DataDev].dev.buf = NULL;
+	dm->Devices[dm->OutputDev].devname = "Output device";
+	dm->Devices[dm->OutputDev].path = dm->OutFileName;
+	dm->Devices[dm->OutputDev].dev.buf = NULL;
     
     
-    if( NumBinDevs == 0 ) {
+    if( dm->NumBinDevs == 0 ) {
     	return TOO_FEW_BINS;
-    } else if( NumBinDevs > 8 ) {
+    } else if( dm->NumBinDevs > 8 ) {
     	return TOO_MANY_BINS;
     }
 	
-	NumRecs = aStatFileSize( input_filename );
+	dm->NumRecs = aStatFileSize( input_filename );
 
 	// calculate number of bins using nrecs and ws_size
-	NumBins = desired_ws_size / (200 * NumBinDevs);
-	NumBins = NumRecs / NumBins;
-	NumBins = NumBins < 5 * NumBinDevs ? 5 * NumBinDevs : NumBins;	// don't allow fewer than 5 bins per dev
+	dm->NumBins = desired_ws_size / (200 * dm->NumBinDevs);
+	dm->NumBins = dm->NumRecs / dm->NumBins;
+	dm->NumBins = dm->NumBins < 5 * dm->NumBinDevs ? 5 * dm->NumBinDevs : dm->NumBins;	// don't allow fewer than 5 bins per dev
 	// round for equal number of bins per dev
-	if( NumBins % NumBinDevs != 0 )
-		NumBins = ( (NumBins / NumBinDevs) + 1 ) * NumBinDevs;
-	printf( "Creating %d bin files\n", NumBins );
-	for( i = 2; i < NumDevices; i++ ){
+	if( dm->NumBins % dm->NumBinDevs != 0 )
+		dm->NumBins = ( (dm->NumBins / dm->NumBinDevs) + 1 ) * dm->NumBinDevs;
+	printf( "Creating %d bin files\n", dm->NumBins );
+	for( i = 2; i < dm->NumDevices; i++ ){
 		bin_name = (char*)malloc( 10 );
 		strcpy( bin_name, "bin dev__" );
 		bin_name[8] = 0x40 + i - 2;
-		Devices[i].devname = bin_name;
-		Devices[i].path = scratch_paths[ i - 2 ];
-		Devices[i].dev.buf = NULL;
+		dm->Devices[i].devname = bin_name;
+		dm->Devices[i].path = scratch_paths[ i - 2 ];
+		dm->Devices[i].dev.buf = NULL;
 		bins[i - 2].bin_dev = bin_name;
-		bins[i - 2].nbins = NumBins / NumBinDevs;	// allocate even an portion of bins per device
+		bins[i - 2].nbins = dm->NumBins / dm->NumBinDevs;	// allocate even an portion of bins per device
 		bins[i - 2].devnum = i;
 	}
 	
     // get buffer size.
-    if( BufferSizeMin == 0 ) {
-        BufferSizeMin = MINRECS;
-        BufferSizeMax = MAXRECS;
+    if( dm->BufferSizeMin == 0 ) {
+        dm->BufferSizeMin = MINRECS;
+        dm->BufferSizeMax = MAXRECS;
     }
 
 
     // open the input file
-    Data = aOpen( input_filename, A_READ );
-	if( Data == NULL ) {
+    dm->Data = aOpen( input_filename, A_READ );
+	if( dm->Data == NULL ) {
 	        printf( "couldn't open data file\n" );
 		return INPUT_NOT_OPENED;
 	}
@@ -923,103 +843,105 @@ int InitdmSML( long working_mb, long buffer_size, const char* input_filename, co
     }
 	
 	// init translation table
-	DNA_TABLE = CreateBasicDNATable();
+	dm->DNA_TABLE = CreateBasicDNATable();
 
     // open the output file
-    Output = aOpen( OutFileName, A_WRITE );
-    if( !Output ) {
+    dm->Output = aOpen( dm->OutFileName, A_WRITE );
+    if( !dm->Output ) {
         printf( "couldn't open output file!\n" );
     	return OUTPUT_NOT_OPENED;
     }
 	
-	header = InitSML( Output, NumRecs, seed );
-	seed_mask = header.seed;
-	mask_length = header.seed_length;
-	mask_weight = header.seed_weight;
+	header = InitSML( dm->Output, dm->NumRecs, seed );
+	dm->seed_mask = header.seed;
+	dm->mask_length = header.seed_length;
+	dm->mask_weight = header.seed_weight;
+	dm->PositionBytes = header.position_bytes;
 	
-	if( NumRecs <= mask_length - 1 ){
-	        printf( "Sequence must be at least %d characters in length\n", mask_length );
+	if( dm->NumRecs <= dm->mask_length - 1 ){
+	        printf( "Sequence must be at least %d characters in length\n", dm->mask_length );
 		return SEQUENCE_TOO_SHORT;
 	}
 
-	NumRecs -= mask_length - 1;
-	printf( "NumRecs is: %llu \n", NumRecs );
+	dm->NumRecs -= dm->mask_length - 1;
+	printf( "NumRecs is: %llu \n", dm->NumRecs );
     // get the number of records we should process
-    RecsProcessed = 0;
-    RecsUnread = NumRecs;
-    if( NumRecs <= 0 ) {
+    dm->RecsProcessed = 0;
+    dm->RecsUnread = dm->NumRecs;
+    if( dm->NumRecs <= 0 ) {
     	return INVALID_NUMRECS;
-        printf( "invalid NumRecs: %llu\n", NumRecs );
+        printf( "invalid NumRecs: %llu\n", dm->NumRecs );
     }
     
     
     
     // go ahead and create the working set.
-    actual_ws_size = MakeWorkingSet( &WS, desired_ws_size, BufferSizeMin, BufferSizeMax );
+    actual_ws_size = MakeWorkingSet( &dm->WS, desired_ws_size, dm->BufferSizeMin, dm->BufferSizeMax );
     printf( "desired working set: %llu, actual working set: %llu\n", 
         desired_ws_size, actual_ws_size );
 
     // initialize the Free list -- just put all the buffers on it.
-    for( i = 0; i < WS.nbufs; i++ ) {
-        PushHead( &Free, &(WS.bufs[i]) );
+    for( i = 0; i < dm->WS.nbufs; i++ ) {
+        PushHead( &dm->Free, &(dm->WS.bufs[i]) );
     }
 
     printf( "working set size        : %llu\n", actual_ws_size );
-    printf( "total buffers           : %d\n", WS.nbufs );
+    printf( "total buffers           : %d\n", dm->WS.nbufs );
     // FIXME: can any touching of the memory here help us?
     // toprocess and reading list empty to start
-    ToProcess.nitems = Reading.nitems = 0;
-    ToProcess.head = Reading.head = NULL;
-	Restructure.nitems = 0;
-	Restructure.head = NULL;
+    dm->ToProcess.nitems = dm->Reading.nitems = 0;
+    dm->ToProcess.head = dm->Reading.head = NULL;
+	dm->Restructure.nitems = 0;
+	dm->Restructure.head = NULL;
 		
 	// allocate Seqbuf
-	Seqbuf.file = Output;
-	Seqbuf.dev = OutputDev;
-	Seqbuf.bufpos = 0;
-	Seqbuf.seq_pos = 0;
-    if( Free.nitems ) {
-        PushHead( &(Seqbuf.bufs), AllocateFree() );
+	dm->Seqbuf.file = dm->Output;
+	dm->Seqbuf.dev = dm->OutputDev;
+	dm->Seqbuf.bufpos = 0;
+	dm->Seqbuf.seq_pos = 0;
+    if( dm->Free.nitems ) {
+        PushHead( &(dm->Seqbuf.bufs), AllocateFree( dm ) );
     } else {
         printf( "error: could not give a buffer to Seqbuf\n" );
         return NO_FREE_BUFFERS;
     }
 
     // allocate the bins.
-    Bins = malloc( sizeof( *Bins ) * NumBins );
-    memset( Bins, 0, sizeof( *Bins ) * NumBins );
+    dm->Bins = malloc( sizeof( *dm->Bins ) * dm->NumBins );
+    memset( dm->Bins, 0, sizeof( *dm->Bins ) * dm->NumBins );
 
     // allocate the bins in a round-robin fashion, so when we read
     // things back for sorting, we're not swamping one device at a time --
     // instead, things are spread out.
-    printf( "opening %d bins\n", NumBins );
+    printf( "opening %d bins\n", dm->NumBins );
     j = -1;
-    for( i = 0; i < NumBins; i++ ) {
+    for( i = 0; i < dm->NumBins; i++ ) {
         // find a bin on the next device.
         while( 1 ) {
-            j = (j+1) % NumBinDevs;
+            j = (j+1) % dm->NumBinDevs;
             if( bins[j].nbins ) {
                 // make this bin on that device, and
                 // round-robin switch to the next device.
-                const char *fname = Fmt("%sout%05d.binned",Devices[bins[j].devnum].path,i);
-                Bins[i].dev = bins[j].devnum;
-                Bins[i].fname = malloc( strlen( fname ) + 1 );
-                strcpy( Bins[i].fname, fname );
+                const char *fname;
+                dm->Bins[i].dev = bins[j].devnum;
+                dm->Bins[i].fname = malloc( strlen( dm->Devices[bins[j].devnum].path ) + strlen( out_base ) + 32 );
+                sprintf( dm->Bins[i].fname, "%s%s.out%05d.binned", dm->Devices[bins[j].devnum].path, out_base, i );
+                fname = dm->Bins[i].fname;
 
 #ifndef NO_BINNING_PERF_TEST
-                Bins[i].file = aOpen( fname, A_WRITE );
+                dm->Bins[i].file = aOpen( fname, A_WRITE );
                 //printf( "opened '%s' on device '%s'\n", fname, Devices[bins[j].devnum].devname );
-                if( Bins[i].file == NULL ) {
+                if( dm->Bins[i].file == NULL ) {
                     printf( "couldn't open output bin file '%s'\n", fname );
 					return BIN_NOT_OPENED;
                 }
 #else
-                Bins[i].nrecs = aStatSize( fname );
-		if( Bins[i].nrecs == 0 ){
+                dm->Bins[i].nrecs = aStatSize( fname );
+		if( dm->Bins[i].nrecs == 0 ){
 			// just make sure the file exists
-	                Bins[i].file = aOpen( fname, A_WRITE );
-			aClose( Bins[i].file );
-			Bins[i].file = NULL;
+	                dm->Bins[i].file = aOpen( fname, A_WRITE );
+			aClose( dm->Bins[i].file );
+			dm->Bins[i].file = NULL;
 		}
 #endif // NO_BINNING_PERF_TEST
                 bins[j].nbins--;
@@ -1031,9 +953,9 @@ int InitdmSML( long working_mb, long buffer_size, const char* input_filename, co
     // now we allocate one buffer for each bin
     // and each bin will hold onto at least one buffer
     // so that we can guarantee no locking cases
-    for( i = 0; i < NumBins; i++ ) {
-        if( Free.nitems ) {
-            PushHead( &(Bins[i].bufs), AllocateFree() );
+    for( i = 0; i < dm->NumBins; i++ ) {
+        if( dm->Free.nitems ) {
+            PushHead( &(dm->Bins[i].bufs), AllocateFree( dm ) );
         } else {
             printf( "error: could not give one buffer to each bin\n" );
 	        return NO_FREE_BUFFERS;
@@ -1051,12 +973,12 @@ void DisplayStatusHeader( void ) {
 }
 
 
-void DisplayStatus( void ) {
+void DisplayStatus( dmsort_t* dm ) {
 
     printf( "%f %llu %llu %llu %llu %f %d %d %d %d %d\n",
-        RunningTime, RecsRead, RecsProcessed, RecsCommitted, RecsWritten, 
-        RecsProcessed/RunningTime, Free.nitems, Reading.nitems, ToProcess.nitems, 
-        WS.nbufs - Free.nitems - Reading.nitems - ToProcess.nitems - Restructure.nitems, Restructure.nitems );
+        dm->RunningTime, dm->RecsRead, dm->RecsProcessed, dm->RecsCommitted, dm->RecsWritten, 
+        dm->RecsProcessed/dm->RunningTime, dm->Free.nitems, dm->Reading.nitems, dm->ToProcess.nitems, 
+        dm->WS.nbufs - dm->Free.nitems - dm->Reading.nitems - dm->ToProcess.nitems - dm->Restructure.nitems, dm->Restructure.nitems );
 
     /*
     int i;
@@ -1084,41 +1006,41 @@ void DisplayStatus( void ) {
 }
 
 
-void UpdateIOState( void ) {
+void UpdateIOState( dmsort_t* dm ) {
     int i;
     //printf( "update io state\n" );
     
     // first update aio ops on the data file
-    aUpdateOperations( Data );
+    aUpdateOperations( dm->Data );
     // next update aio ops on the bin files
-    for( i = 0; i < NumBins; i++ ) {
-        aUpdateOperations( Bins[i].file );
+    for( i = 0; i < dm->NumBins; i++ ) {
+        aUpdateOperations( dm->Bins[i].file );
     }
     // update aio ops on the output file
-    aUpdateOperations( Output );
+    aUpdateOperations( dm->Output );
     // next, let the working set adjust operation states and such
-    UpdateWSIOFinishedState( &WS );
+    UpdateWSIOFinishedState( &dm->WS );
     // finally, let the devices start new operations if possible.
-    for( i = 0; i < NumDevices; i++ ) {
-        UpdateDeviceIOExecuteState( &WS, &(Devices[i].dev) );
+    for( i = 0; i < dm->NumDevices; i++ ) {
+        UpdateDeviceIOExecuteState( &dm->WS, &(dm->Devices[i].dev) );
     }
     
 }
 
 
-void EnsureAllOperationsComplete( void ) {
+void EnsureAllOperationsComplete( dmsort_t* dm ) {
     int i;
     int not_complete = 1;
     dmtimer_t *wait;
     wait = StartTimer();
     while( not_complete ) {
-        UpdateIOState();
+        UpdateIOState( dm );
         // see if we're done
         not_complete = 0;
-        for( i = 0; i < WS.nbufs; i++ ) {
-            if( WS.bufs[i].device &&
-                WS.bufs[i].file &&
-                (WS.bufs[i].operation == OP_PENDING || WS.bufs[i].operation > OP_NONE) ) {
+        for( i = 0; i < dm->WS.nbufs; i++ ) {
+            if( dm->WS.bufs[i].device &&
+                dm->WS.bufs[i].file &&
+                (dm->WS.bufs[i].operation == OP_PENDING || dm->WS.bufs[i].operation > OP_NONE) ) {
                 not_complete = 1;
                 break;
             }
@@ -1132,9 +1054,7 @@ void EnsureAllOperationsComplete( void ) {
 
 
 
-static double lasttime = 0;
-
-void BinningPhase( void ) {
+void BinningPhase( dmsort_t* dm ) {
 
     int i;
     // for progress output
@@ -1143,40 +1063,40 @@ void BinningPhase( void ) {
 
     // the main loop.
     printf( "----------------- Starting -----------------\n" );
-    printf( "working set buffers : %d\n", WS.nbufs );
-    printf( "number of bins      : %d\n", NumBins );
+    printf( "working set buffers : %d\n", dm->WS.nbufs );
+    printf( "number of bins      : %d\n", dm->NumBins );
     timeaccum = 0;
     iter = 0;
     DisplayStatusHeader();
-    while( RecsProcessed < NumRecs ) {
+    while( dm->RecsProcessed < dm->NumRecs ) {
 
         // print status every few seconds or so.
         // not until timing gets fixed
         //if( RunningTime - lasttime >= 5.0f ) {
-        if( (RunningTime - lasttime) >= 2.0f ) {
-            DisplayStatus();
-            lasttime = RunningTime;
+        if( (dm->RunningTime - dm->lasttime) >= 2.0f ) {
+            DisplayStatus( dm );
+            dm->lasttime = dm->RunningTime;
         }
         
         // keep the async io running
         // first update the operations on all our files.
-        UpdateIOState();
+        UpdateIOState( dm );
         
         // Handle read and write completions
         // (transition reads to ToProcess, writes to Free)
-        HandleReadingCompletions();
-		HandleSeqbufWriteCompletions();
-		RestructureReadSMLBins();
-        HandleBinWriteCompletions();
+        HandleReadingCompletions( dm );
+		HandleSeqbufWriteCompletions( dm );
+		RestructureReadSMLBins( dm );
+        HandleBinWriteCompletions( dm );
 
         // do reading and binning
-        DoReading();
-        DoBinning();
+        DoReading( dm );
+        DoBinning( dm );
         
         // finish up the loop.
         iter++;
 
-        RunningTime = (double)ReadTimer( RunningTimer ) / 1000.0;
+        dm->RunningTime = (double)ReadTimer( dm->RunningTimer ) / 1000.0;
 
     }
     
@@ -1192,20 +1112,21 @@ void BinningPhase( void ) {
     // pending, unless DeviceClose could know about more than one device
     // at a time, we would get effectively synchronous IO here, so we
     // have the ugly hack for now.
-    FinishBinning();
-    EnsureAllOperationsComplete();
+    FinishBinning( dm );
+    EnsureAllOperationsComplete( dm );
 
     // close the input file.
-    aClose( Data );
-    Data = NULL;
+    aClose( dm->Data );
+    dm->Data = NULL;
     // Finally, close all the bin files
-    for( i = 0; i < NumBins; i++ ) {
-        aClose( Bins[i].file );
-        Bins[i].file = NULL;
+    for( i = 0; i < dm->NumBins; i++ ) {
+        aClose( dm->Bins[i].file );
+        dm->Bins[i].file = NULL;
     }
-    printf( "Finally, RecsCommitted: %llu\n", RecsCommitted );
+    printf( "Finally, RecsCommitted: %llu\n", dm->RecsCommitted );
+    printf( "Mer extraction took %f seconds\n", dm->RestructureTime );
 
-    DisplayStatus();
+    DisplayStatus( dm );
 
 }
 
@@ -1213,35 +1134,35 @@ void BinningPhase( void ) {
 
 
 
-void SortReading( void ) {
+void SortReading( dmsort_t* dm ) {
 
     int i;
 
     // if anything is in WAIT_READ, and we have crap to read yet,
     // start reading it in.
 
-    for( i = 0; i < NSortBufs; i++ ) {
+    for( i = 0; i < dm->NSortBufs; i++ ) {
         // quick out if we're done reading.
-        if( BinToRead >= NumBins ) {
+        if( dm->BinToRead >= dm->NumBins ) {
             return;
         }
-        if( SortBufs[i].state == WAIT_READ ) {
+        if( dm->SortBufs[i].state == WAIT_READ ) {
             // schedule a read here.
-            const char *fname = Fmt("%sout%05d.binned",Devices[Bins[BinToRead].dev].path,BinToRead);
+            const char *fname = dm->Bins[dm->BinToRead].fname;
             aFILE *in = aOpen( fname, A_READ );
             if( !in ) {
                 printf( "couldn't open '%s' to read!\n", fname );
             }
-            if( Bins[BinToRead].nrecs > SortBufs[i].buf->totalrecs ) {
+            if( dm->Bins[dm->BinToRead].nrecs > dm->SortBufs[i].buf->totalrecs ) {
                 printf( "buffer not big enough to hold bin!\n" );
             }
-            SortBufs[i].bin = BinToRead;
-            SortBufs[i].dev = &(Devices[Bins[BinToRead].dev].dev);
-            SortBufs[i].state = BUSY_READ;
-            SortBufs[i].buf->file = in;
-            ReadBuffer( SortBufs[i].buf, Bins[BinToRead].nrecs, SortBufs[i].dev );
-            printf( "scheduled read of bin %d\n", BinToRead );
-            BinToRead++;
+            dm->SortBufs[i].bin = dm->BinToRead;
+            dm->SortBufs[i].dev = &(dm->Devices[dm->Bins[dm->BinToRead].dev].dev);
+            dm->SortBufs[i].state = BUSY_READ;
+            dm->SortBufs[i].buf->file = in;
+            ReadBuffer( dm->SortBufs[i].buf, dm->Bins[dm->BinToRead].nrecs, dm->SortBufs[i].dev );
+            printf( "scheduled read of bin %d\n", dm->BinToRead );
+            dm->BinToRead++;
             return;
         }
     }
@@ -1250,6 +1171,7 @@ void SortReading( void ) {
 
 
 
+// sorting.h defines USE_QSORT_ONLY, so this is the sort that normally gets built
 #ifdef USE_QSORT_ONLY
 
 int comp_keys( record_t a, record_t b ){
@@ -1361,9 +1283,15 @@ void QSort( record_t a[], int lo0, int hi0 ) {
     //
     // Recursive calls, elements a[lo0] to a[lo-1] are less than or
     // equal to pivot, elements a[hi+1] to a[hi0] are greater than
-    // pivot.
+    // pivot.  The halves are disjoint so large ones are sorted as
+    // separate tasks when RecSort has threads to spare.
     //
-    QSort( a, lo0, lo-1 );
+    if( hi0 - lo0 >= PARALLEL_SORT_MIN ) {
+#pragma omp task
+        QSort( a, lo0, lo-1 );
+    } else {
+        QSort( a, lo0, lo-1 );
+    }
     QSort( a, hi+1, hi0 );
 }
 
@@ -1373,7 +1301,12 @@ void QSort( record_t a[], int lo0, int hi0 ) {
 
 void RecSort( record_t a[], int nelems ) {
 
-    QSort( a, 0, nelems-1 );
+    // the tasks created by QSort all complete at the end of the parallel region
+#pragma omp parallel if( nelems >= PARALLEL_SORT_MIN )
+    {
+#pragma omp single nowait
+        QSort( a, 0, nelems-1 );
+    }
 
 }
 
@@ -1386,31 +1319,33 @@ int SortBuffer( buffer_t * buf ) {
 }
 
 
-void SortSorting( void ) {
+void SortSorting( dmsort_t* dm ) {
 
-    int i, finished;
-    int lowest = -1;
-    QSortTimer = StartTimer();
+    int i, sortI;
+    int nsort = 0;
+    dm->QSortTimer = StartTimer();
 
-    for( i = 0; i < NSortBufs; i++ ) {
-        if( SortBufs[i].state == SORTING ) {
-            if( lowest == -1 || SortBufs[i].bin < SortBufs[lowest].bin ) {
-                lowest = i;
-            }
+    // bins are independent, so every bin that has been read is sorted at once
+    for( i = 0; i < dm->NSortBufs; i++ ) {
+        if( dm->SortBufs[i].state == SORTING ) {
+            printf( "sorting bin %d\n", dm->SortBufs[i].bin );
+            dm->SortList[ nsort++ ] = i;
         }
     }
 
-    if( lowest != -1 ) {
-        printf( "sorting bin %d\n", SortBufs[lowest].bin );
-        finished = SortBuffer( SortBufs[lowest].buf );
-        if( finished ) {
-            SortBufs[lowest].state = WRITE_RESTRUCTURE;
-//            SortBufs[lowest].state = WAIT_WRITE;
-        }
+    // a lone bin gets all the threads through RecSort instead
+#pragma omp parallel for schedule(dynamic) if( nsort > 1 )
+    for( sortI = 0; sortI < nsort; sortI++ ) {
+        SortBuffer( dm->SortBufs[ dm->SortList[ sortI ] ].buf );
+    }
+
+    for( sortI = 0; sortI < nsort; sortI++ ) {
+        dm->SortBufs[ dm->SortList[ sortI ] ].state = WRITE_RESTRUCTURE;
+//        SortBufs[lowest].state = WAIT_WRITE;
     }
 
-    QSortTime += ReadTimer( QSortTimer ) / 1000.0;
-    StopTimer( QSortTimer );
+    dm->QSortTime += ReadTimer( dm->QSortTimer ) / 1000.0;
+    StopTimer( dm->QSortTimer );
 
 }
 
@@ -1418,20 +1353,20 @@ void SortSorting( void ) {
 
 
 
-void SortSorting( void ) {
+void SortSorting( dmsort_t* dm ) {
     
     int i;
 
-    QSortTimer = StartTimer();
+    dm->QSortTimer = StartTimer();
 
-    for( i = 0; i < NSortBufs; i++ ) {
-        if( SortBufs[i].state == SORTING ) {
-            SortBufs[i].state = WAIT_WRITE;
+    for( i = 0; i < dm->NSortBufs; i++ ) {
+        if( dm->SortBufs[i].state == SORTING ) {
+            dm->SortBufs[i].state = WAIT_WRITE;
         }
     }
 
-    QSortTime += ReadTimer( QSortTimer ) / 1000.0;
-    StopTimer( QSortTimer );
+    dm->QSortTime += ReadTimer( dm->QSortTimer ) / 1000.0;
+    StopTimer( dm->QSortTimer );
 
 }
 
@@ -1439,69 +1374,67 @@ void SortSorting( void ) {
 
 #else 
 
-sort_buf_t* CurrentSortBuf;
-buffer_t* SortScratchBuffer;
-
-void SortSorting( void ) {
+void SortSorting( dmsort_t* dm ) {
 
     int i;
 
-    QSortTimer = StartTimer();
+    dm->QSortTimer = StartTimer();
 
     // SortData -- sort everything in SORTING -- if it finishes, transition
     // to WAIT_WRITE.
-	if( CurrentSortBuf == NULL ){
-	    for( i = 0; i < NSortBufs; i++ ) {
+	if( dm->CurrentSortBuf == NULL ){
+	    for( i = 0; i < dm->NSortBufs; i++ ) {
 	        // if this one is ready to sort, and it's the bin we're looking for...
-	        if( SortBufs[i].state == SORTING && SortBufs[i].bin == BinToSort ) {
-	        	CurrentSortBuf = &SortBufs[i];
-	        	InitRadixSort( CurrentSortBuf, SortScratchBuffer );
-	            printf( "scheduling sort of bin %d\n", BinToSort );
+	        if( dm->SortBufs[i].state == SORTING && dm->SortBufs[i].bin == dm->BinToSort ) {
+	        	dm->CurrentSortBuf = &dm->SortBufs[i];
+	        	InitRadixSort( dm->CurrentSortBuf, dm->SortScratchBuffer, dm->NumBins );
+	            printf( "scheduling sort of bin %d\n", dm->BinToSort );
 	            break;
 	        }
 	    }
 	}
 	
 	// if there is something to sort right now then try to sort it.
-	if( CurrentSortBuf != NULL ){
-		if( CurrentSortBuf->state != WRITE_RESTRUCTURE ){
+	if( dm->CurrentSortBuf != NULL ){
+		if( dm->CurrentSortBuf->state != WRITE_RESTRUCTURE ){
 
 			// automatically transitions to WAIT_WRITE when done.
-			RadixSort( CurrentSortBuf );
+			RadixSort( dm->CurrentSortBuf );
 
 			// prepare this bin for writing and setup to sort the next
-			if( CurrentSortBuf->state == WRITE_RESTRUCTURE ){
-				CurrentSortBuf = NULL;
-	            BinToSort++;
+			if( dm->CurrentSortBuf->state == WRITE_RESTRUCTURE ){
+				dm->CurrentSortBuf = NULL;
+	            dm->BinToSort++;
 	        }
 		}
     }
 
-    QSortTime += ReadTimer( QSortTimer ) / 1000.0;
-    StopTimer( QSortTimer );
+    dm->QSortTime += ReadTimer( dm->QSortTimer ) / 1000.0;
+    StopTimer( dm->QSortTimer );
 
 }
 
 #endif
 
-void RestructureSMLBinsForWrite( void ) {
+void RestructureSMLBinsForWrite( dmsort_t* dm ) {
     int i;
     offset_t j;
-	position_t* positions;
+	char* positions;
 	sml_t *sml;
 
-    for( i = 0; i < NSortBufs; i++ ) {
+    for( i = 0; i < dm->NSortBufs; i++ ) {
         // if this one is ready to be restructured...
-        if( SortBufs[i].state == WRITE_RESTRUCTURE ) {
-            printf( "restructuring bin %d\n", SortBufs[i].bin );
-            positions = (position_t*)SortBufs[i].buf->recs;
-            sml = (sml_t*)SortBufs[i].buf->recs;
-            for( j = 0; j < Bins[SortBufs[i].bin].nrecs; j++ ){
-            	positions[ j ] = sml[ j ].pos;
+        if( dm->SortBufs[i].state == WRITE_RESTRUCTURE ) {
+            printf( "restructuring bin %d\n", dm->SortBufs[i].bin );
+            positions = (char*)dm->SortBufs[i].buf->recs;
+            sml = (sml_t*)dm->SortBufs[i].buf->recs;
+            // packing in place is safe, entry j never overlaps a record that has yet to be read
+            for( j = 0; j < dm->Bins[dm->SortBufs[i].bin].nrecs; j++ ){
+            	PackPosition( positions + j * dm->PositionBytes, dm->PositionBytes, sml[ j ].pos );
             }
             
             // set its state for writing
-            SortBufs[i].state = WAIT_WRITE;
+            dm->SortBufs[i].state = WAIT_WRITE;
         }
     }
 }
@@ -1521,30 +1454,30 @@ void RestructureSMLBinsForWrite( void ) {
 }
 */
 
-int CalculateSortWriteSize( int sortI ){
-     return Bins[SortBufs[sortI].bin].nrecs * sizeof( position_t );
+int CalculateSortWriteSize( dmsort_t* dm, int sortI ){
+     return dm->Bins[dm->SortBufs[sortI].bin].nrecs * dm->PositionBytes;
 }
 
-void SortWriting( void ) {
+void SortWriting( dmsort_t* dm ) {
 
     int i;
 
-    for( i = 0; i < NSortBufs; i++ ) {
+    for( i = 0; i < dm->NSortBufs; i++ ) {
         // if this one is ready to write, and it's the bin we're looking for...
-        if( SortBufs[i].state == WAIT_WRITE && SortBufs[i].bin == BinToWrite ) {
+        if( dm->SortBufs[i].state == WAIT_WRITE && dm->SortBufs[i].bin == dm->BinToWrite ) {
 #ifdef NO_WRITE_PERF_TEST
 			// skip writing by setting the state to wait_read
-            SortBufs[i].state = WAIT_READ;
+            dm->SortBufs[i].state = WAIT_READ;
 #else
-            printf( "scheduling write of bin %d\n", BinToWrite );
+            printf( "scheduling write of bin %d\n", dm->BinToWrite );
             // write it out.
-            SortBufs[i].dev = &(Devices[OutputDev].dev);
-            SortBufs[i].state = BUSY_WRITE;
-            SortBufs[i].buf->file = Output;
-            WriteBuffer( SortBufs[i].buf, Bins[SortBufs[i].bin].nrecs, &(Devices[OutputDev].dev) );
-			SortBufs[i].buf->io_size = CalculateSortWriteSize( i );
+            dm->SortBufs[i].dev = &(dm->Devices[dm->OutputDev].dev);
+            dm->SortBufs[i].state = BUSY_WRITE;
+            dm->SortBufs[i].buf->file = dm->Output;
+            WriteBuffer( dm->SortBufs[i].buf, dm->Bins[dm->SortBufs[i].bin].nrecs, &(dm->Devices[dm->OutputDev].dev) );
+			dm->SortBufs[i].buf->io_size = CalculateSortWriteSize( dm, i );
 #endif // NO_WRITE_PERF_TEST
-            BinToWrite++;
+            dm->BinToWrite++;
         }
     }
 
@@ -1554,21 +1487,21 @@ void SortWriting( void ) {
 
 
 
-void SortHandleCompletions( void ) {
+void SortHandleCompletions( dmsort_t* dm ) {
 
     int i;
 
     // transition states of those that finished.
-    for( i = 0; i < NSortBufs; i++ ) {
-        if( SortBufs[i].state == BUSY_READ || SortBufs[i].state == BUSY_WRITE ) {
-            if( SortBufs[i].buf->operation == OP_FINISHED ) {
+    for( i = 0; i < dm->NSortBufs; i++ ) {
+        if( dm->SortBufs[i].state == BUSY_READ || dm->SortBufs[i].state == BUSY_WRITE ) {
+            if( dm->SortBufs[i].buf->operation == OP_FINISHED ) {
                 //printf( "operation finished on buf %d\n", i );
-                SortBufs[i].buf->operation = OP_NONE;
-                SortBufs[i].state = SortBufs[i].state == BUSY_READ ? SORTING : WAIT_READ;
+                dm->SortBufs[i].buf->operation = OP_NONE;
+                dm->SortBufs[i].state = dm->SortBufs[i].state == BUSY_READ ? SORTING : WAIT_READ;
 #ifdef NNNNN_KEYBYTES
 				// bin 0 doesn't need to be sorted
-				if( SortBufs[i].bin == 0 && SortBufs[i].state == SORTING )
-					SortBufs[i].state = WAIT_WRITE;
+				if( dm->SortBufs[i].bin == 0 && dm->SortBufs[i].state == SORTING )
+					dm->SortBufs[i].state = WAIT_WRITE;
 #endif
             }
         }
@@ -1580,24 +1513,24 @@ void SortHandleCompletions( void ) {
 
 
 
-void SortUpdateIOState() {
+void SortUpdateIOState( dmsort_t* dm ) {
 
     int i;
     //printf( "update io state\n" );
     
     // first update aio ops on the data file
-    aUpdateOperations( Output );
+    aUpdateOperations( dm->Output );
     // next update aio ops on the sortbuf files
-    for( i = 0; i < NSortBufs; i++ ) {
-        if( SortBufs[i].buf->file ) {
-            aUpdateOperations( SortBufs[i].buf->file );
+    for( i = 0; i < dm->NSortBufs; i++ ) {
+        if( dm->SortBufs[i].buf->file ) {
+            aUpdateOperations( dm->SortBufs[i].buf->file );
         }
     }
     // next, let the working set adjust operation states and such
-    UpdateWSIOFinishedState( &WS );
+    UpdateWSIOFinishedState( &dm->WS );
     // finally, let the devices start new operations if possible.
-    for( i = 0; i < NumDevices; i++ ) {
-        UpdateDeviceIOExecuteState( &WS, &(Devices[i].dev) );
+    for( i = 0; i < dm->NumDevices; i++ ) {
+        UpdateDeviceIOExecuteState( &dm->WS, &(dm->Devices[i].dev) );
     }
 
 }
@@ -1607,19 +1540,19 @@ void SortUpdateIOState() {
 
 
 
-void SortingEnsureAllOperationsComplete() {
+void SortingEnsureAllOperationsComplete( dmsort_t* dm ) {
     int i;
     int not_complete = 1;
     dmtimer_t *wait;
     wait = StartTimer();
     while( not_complete ) {
-        SortUpdateIOState();
+        SortUpdateIOState( dm );
         // see if we're done
         not_complete = 0;
-        for( i = 0; i < WS.nbufs; i++ ) {
-            if( WS.bufs[i].device &&
-                WS.bufs[i].file &&
-                (WS.bufs[i].operation == OP_PENDING || WS.bufs[i].operation > OP_NONE) ) {
+        for( i = 0; i < dm->WS.nbufs; i++ ) {
+            if( dm->WS.bufs[i].device &&
+                dm->WS.bufs[i].file &&
+                (dm->WS.bufs[i].operation == OP_PENDING || dm->WS.bufs[i].operation > OP_NONE) ) {
                 not_complete = 1;
                 break;
             }
@@ -1627,7 +1560,7 @@ void SortingEnsureAllOperationsComplete() {
     }
 
     // flush the output file to disk.
-    aFlush( Output );
+    aFlush( dm->Output );
 
     printf( "Sort Ensure All Operations Complete: %d msec\n", ReadTimer( wait ) );
     StopTimer( wait );
@@ -1639,7 +1572,7 @@ void SortingEnsureAllOperationsComplete() {
 
 
 
-void SortingPhase( void ) {
+void SortingPhase( dmsort_t* dm ) {
 
     // now reorganize the working set, and start up the sort procedure.
 
@@ -1658,11 +1591,11 @@ void SortingPhase( void ) {
     offset_t biggest_bin = 0;
     offset_t biggest_nrecs = 0;
     
-    NSortBufs = NumBinDevs;
+    dm->NSortBufs = dm->NumBinDevs;
 
-    for( i = 0; i < NumBins; i++ ) {
-        if( Bins[i].nrecs > biggest_nrecs ) {
-            biggest_nrecs = Bins[i].nrecs;
+    for( i = 0; i < dm->NumBins; i++ ) {
+        if( dm->Bins[i].nrecs > biggest_nrecs ) {
+            biggest_nrecs = dm->Bins[i].nrecs;
             biggest_bin = i;
         }
     }
@@ -1671,136 +1604,138 @@ void SortingPhase( void ) {
 
     recs_per_buffer = biggest_nrecs;
 
-    if( (WS.size / sizeof( record_t )) < (unsigned)recs_per_buffer ) {
+    if( (dm->WS.size / sizeof( record_t )) < (unsigned)recs_per_buffer ) {
         printf( "working set holds %llu recs, but we need %llu\n", 
-            (WS.size / sizeof( record_t )), recs_per_buffer );
+            (dm->WS.size / sizeof( record_t )), recs_per_buffer );
     }
 
-    NSortBufs = (WS.size / sizeof( record_t )) / recs_per_buffer;
+    dm->NSortBufs = (dm->WS.size / sizeof( record_t )) / recs_per_buffer;
 
-    printf( "NSortBufs = %d\n", NSortBufs );
+    printf( "NSortBufs = %d\n", dm->NSortBufs );
 
     // this goes from 0 to NumBins-1 as we read stuff.
-    BinToRead = 0;
-    BinToWrite = 0;
-	BinToSort = 0;
+    dm->BinToRead = 0;
+    dm->BinToWrite = 0;
+	dm->BinToSort = 0;
 	
-    printf( "reorganizing working set: %llu recs per buffer, %d sort bufs\n", recs_per_buffer, NSortBufs );
-    ReorganizeWorkingSet( &WS, recs_per_buffer, recs_per_buffer );
+    printf( "reorganizing working set: %llu recs per buffer, %d sort bufs\n", recs_per_buffer, dm->NSortBufs );
+    ReorganizeWorkingSet( &dm->WS, recs_per_buffer, recs_per_buffer );
 
 #if !defined USE_QSORT_ONLY && !defined NO_SORT_PERF_TEST
 	// steal the last buffer for scratch space
-    NSortBufs--;
-	SortScratchBuffer = &(WS.bufs[NSortBufs]);
-	SortScratchBuffer->operation = SORTING_SCRATCH;
+    dm->NSortBufs--;
+	dm->SortScratchBuffer = &(dm->WS.bufs[dm->NSortBufs]);
+	dm->SortScratchBuffer->operation = SORTING_SCRATCH;
 #endif
     
     // nbufs should be same as NumBinDevs
-    printf( "reorganized working set has %d buffers of %llu bytes\n", WS.nbufs, recs_per_buffer * sizeof(record_t) );
-    SortBufs = malloc( sizeof( *SortBufs ) * NSortBufs );
-    memset( SortBufs, 0, sizeof( *SortBufs ) * NSortBufs );
+    printf( "reorganized working set has %d buffers of %llu bytes\n", dm->WS.nbufs, recs_per_buffer * sizeof(record_t) );
+    dm->SortBufs = malloc( sizeof( *dm->SortBufs ) * dm->NSortBufs );
+    memset( dm->SortBufs, 0, sizeof( *dm->SortBufs ) * dm->NSortBufs );
+    dm->SortList = realloc( dm->SortList, sizeof( *dm->SortList ) * dm->NSortBufs );
 
     // put everything in WAIT_READ;
     
-    for( i = 0; i < NSortBufs; i++ ) {
+    for( i = 0; i < dm->NSortBufs; i++ ) {
 
-        SortBufs[i].state = WAIT_READ;
-        SortBufs[i].buf = &(WS.bufs[i]);
-        SortBufs[i].dev = NULL;
+        dm->SortBufs[i].state = WAIT_READ;
+        dm->SortBufs[i].buf = &(dm->WS.bufs[i]);
+        dm->SortBufs[i].dev = NULL;
 
     }
 #ifdef NNNNN_KEYBYTES
 	// process the first bin then restructure the working set again
 	
-    while( BinToWrite < 1 ) {
-        SortReading();
-        SortSorting();
-        RestructureSMLBinsForWrite();
-        SortWriting();
-        SortUpdateIOState();
-        SortHandleCompletions();
+    while( dm->BinToWrite < 1 ) {
+        SortReading( dm );
+        SortSorting( dm );
+        RestructureSMLBinsForWrite( dm );
+        SortWriting( dm );
+        SortUpdateIOState( dm );
+        SortHandleCompletions( dm );
     }
-    SortingEnsureAllOperationsComplete();
+    SortingEnsureAllOperationsComplete( dm );
 
-    for( i = 1; i < NumBins; i++ ) {
-        if( Bins[i].nrecs > biggest_nrecs ) {
-            biggest_nrecs = Bins[i].nrecs;
+    for( i = 1; i < dm->NumBins; i++ ) {
+        if( dm->Bins[i].nrecs > biggest_nrecs ) {
+            biggest_nrecs = dm->Bins[i].nrecs;
             biggest_bin = i;
         }
     }
     recs_per_buffer = biggest_nrecs;
-    if( (WS.size / sizeof( record_t )) < (unsigned)recs_per_buffer ) {
+    if( (dm->WS.size / sizeof( record_t )) < (unsigned)recs_per_buffer ) {
         printf( "working set holds %llu recs, but we need %llu\n", 
-            (WS.size / sizeof( record_t )), recs_per_buffer );
+            (dm->WS.size / sizeof( record_t )), recs_per_buffer );
     }
-    NSortBufs = (WS.size / sizeof( record_t )) / recs_per_buffer;
-    printf( "NSortBufs = %d\n", NSortBufs );
+    dm->NSortBufs = (dm->WS.size / sizeof( record_t )) / recs_per_buffer;
+    printf( "NSortBufs = %d\n", dm->NSortBufs );
     // this goes from 0 to NumBins-1 as we read stuff.
-    BinToRead = 1;
-    BinToWrite = 1;
-	BinToSort = 1;
+    dm->BinToRead = 1;
+    dm->BinToWrite = 1;
+	dm->BinToSort = 1;
 	
-    printf( "reorganizing working set: %llu recs per buffer, %d sort bufs\n", recs_per_buffer, NSortBufs );
-    ReorganizeWorkingSet( &WS, recs_per_buffer, recs_per_buffer );
+    printf( "reorganizing working set: %llu recs per buffer, %d sort bufs\n", recs_per_buffer, dm->NSortBufs );
+    ReorganizeWorkingSet( &dm->WS, recs_per_buffer, recs_per_buffer );
 
 #if !defined USE_QSORT_ONLY && !defined NO_SORT_PERF_TEST
 	// steal the last buffer for scratch space
-    NSortBufs--;
-	SortScratchBuffer = &(WS.bufs[NSortBufs]);
-	SortScratchBuffer->operation = SORTING_SCRATCH;
+    dm->NSortBufs--;
+	dm->SortScratchBuffer = &(dm->WS.bufs[dm->NSortBufs]);
+	dm->SortScratchBuffer->operation = SORTING_SCRATCH;
 #endif
     
     // nbufs should be same as NumBinDevs
-    printf( "reorganized working set has %d buffers of %llu bytes\n", WS.nbufs, recs_per_buffer * sizeof(record_t) );
-    SortBufs = malloc( sizeof( *SortBufs ) * NSortBufs );
-    memset( SortBufs, 0, sizeof( *SortBufs ) * NSortBufs );
+    printf( "reorganized working set has %d buffers of %llu bytes\n", dm->WS.nbufs, recs_per_buffer * sizeof(record_t) );
+    dm->SortBufs = malloc( sizeof( *dm->SortBufs ) * dm->NSortBufs );
+    memset( dm->SortBufs, 0, sizeof( *dm->SortBufs ) * dm->NSortBufs );
+    dm->SortList = realloc( dm->SortList, sizeof( *dm->SortList ) * dm->NSortBufs );
 
     // put everything in WAIT_READ;
-    for( i = 0; i < NSortBufs; i++ ) {
-        SortBufs[i].state = WAIT_READ;
-        SortBufs[i].buf = &(WS.bufs[i]);
-        SortBufs[i].dev = NULL;
+    for( i = 0; i < dm->NSortBufs; i++ ) {
+        dm->SortBufs[i].state = WAIT_READ;
+        dm->SortBufs[i].buf = &(dm->WS.bufs[i]);
+        dm->SortBufs[i].dev = NULL;
     }
 #endif    
     
 
-    while( BinToWrite < NumBins ) {
+    while( dm->BinToWrite < dm->NumBins ) {
         
         // ReadFiles -- schedule reading operations if we can (are any buffers
         // in WAIT_READ?)
         //printf( "sortreading\n" );
-        SortReading();
+        SortReading( dm );
         
         // SortData -- sort everything in SORTING -- if it finishes, transition
         // to WAIT_WRITE.
         //printf( "sortsorting\n" );
-        SortSorting();
+        SortSorting( dm );
         
         // Perform any necessary post-sort processing on the data to prepare it for
         // writing out to the sorted file
-        RestructureSMLBinsForWrite();
+        RestructureSMLBinsForWrite( dm );
         // WriteFiles -- schedule writing operations for everything in WAIT_WRITE, if
         // it is the next file we need to write (make sure to schedule in order).
         //printf( "sortwriting\n" );
-        SortWriting();
+        SortWriting( dm );
         
         // update io state
         //printf( "sortupdateiostate\n" );
-        SortUpdateIOState();
+        SortUpdateIOState( dm );
 
 
         // HandleCompletions -- if something finishes,
         // if it was reading, transition to SORTING
         // if it was writing, transition to WAIT_READ.
         //printf( "sorthandlecompletions\n" );
-        SortHandleCompletions();
+        SortHandleCompletions( dm );
         
         
     }
 
-    SortingEnsureAllOperationsComplete();
+    SortingEnsureAllOperationsComplete( dm );
 
-    printf( "QSort took %f seconds\n", QSortTime );
+    printf( "QSort took %f seconds\n", dm->QSortTime );
 
 }
 
@@ -1810,132 +1745,91 @@ void SortingPhase( void ) {
 
 
 
-int dmsort() {
+int dmsort( dmsort_t* dm ) {
 
 
     // Do the first pass binning stuff
-    BinningTimer = StartTimer();
+    dm->BinningTimer = StartTimer();
 #ifndef NO_BINNING_PERF_TEST
-    BinningPhase();
-    BinningTime = ReadTimer( BinningTimer ) / 1000.0;
+    BinningPhase( dm );
+    dm->BinningTime = ReadTimer( dm->BinningTimer ) / 1000.0;
 #endif // NO_BINNING_PERF_TEST
-    StopTimer( BinningTimer );
+    StopTimer( dm->BinningTimer );
 
 
     // Do the second pass sort
-    SortingTimer = StartTimer();
-    SortingPhase();
-    SortingTime = ReadTimer( SortingTimer ) / 1000.0;
-    StopTimer( SortingTimer );
+    dm->SortingTimer = StartTimer();
+    SortingPhase( dm );
+    dm->SortingTime = ReadTimer( dm->SortingTimer ) / 1000.0;
+    StopTimer( dm->SortingTimer );
 
 
-    RunningTime = ReadTimer( RunningTimer ) / 1000.0;
-    StopTimer( RunningTimer );
+    dm->RunningTime = ReadTimer( dm->RunningTimer ) / 1000.0;
+    StopTimer( dm->RunningTimer );
 
-    printf( "total time      : %f sec\n", RunningTime );
-    printf( "binning time    : %f sec (%f%%)\n", BinningTime, BinningTime/RunningTime * sizeof(record_t) );
-    printf( "sorting time    : %f sec (%f%%)\n", SortingTime, SortingTime/RunningTime * sizeof(record_t) );
+    printf( "total time      : %f sec\n", dm->RunningTime );
+    printf( "binning time    : %f sec (%f%%)\n", dm->BinningTime, dm->BinningTime/dm->RunningTime * sizeof(record_t) );
+    printf( "sorting time    : %f sec (%f%%)\n", dm->SortingTime, dm->SortingTime/dm->RunningTime * sizeof(record_t) );
     
-    printf( "total rate      : %f MB/sec\n", (((double)NumRecs)/10485.760)/RunningTime );
-    printf( "total bin rate  : %f MB/sec\n", (((double)NumRecs)/10485.760)/BinningTime );
-    printf( "total sort rate : %f MB/sec\n", (((double)NumRecs)/10485.760)/SortingTime );
+    printf( "total rate      : %f MB/sec\n", (((double)dm->NumRecs)/10485.760)/dm->RunningTime );
+    printf( "total bin rate  : %f MB/sec\n", (((double)dm->NumRecs)/10485.760)/dm->BinningTime );
+    printf( "total sort rate : %f MB/sec\n", (((double)dm->NumRecs)/10485.760)/dm->SortingTime );
 
     return 0;
 }
 
 
 int dmSML( const char* input_file, const char* output_file, const char* const* scratch_paths, uint64 seed ) {
-	long working_mb = 300;
-	long buffer_size = 1000;
+	return dmSMLWorkingSet( input_file, output_file, scratch_paths, seed, 0 );
+}
+
+
+int dmSMLWorkingSet( const char* input_file, const char* output_file, const char* const* scratch_paths, uint64 seed, long working_mb ) {
 	int rval = 0;
 	int i = 0;
-	rval = InitdmSML( 0, 0, input_file, output_file, scratch_paths, seed );
-	if( rval != 0 )
-		return rval;
-	rval = dmsort();
+	dmsort_t* dm = malloc( sizeof( *dm ) );
+	memset( dm, 0, sizeof( *dm ) );
+	dm->OutFileName = "unset";
+
+	rval = InitdmSML( dm, working_mb, 0, input_file, output_file, scratch_paths, seed );
+	if( rval == 0 )
+		rval = dmsort( dm );
+	else if( dm->RunningTimer )
+		StopTimer( dm->RunningTimer );
 	
 	// Hey slob!  cleanup after yourself!
-	for( i = 0; i < NumBins; i++ ){
-		removeFile( Bins[ i ].fname, FALSE );
-		free( Bins[ i ].fname );
+	for( i = 0; dm->Bins && i < dm->NumBins; i++ ){
+		if( dm->Bins[ i ].file )
+			aClose( dm->Bins[ i ].file );
+		if( dm->Bins[ i ].fname ){
+			removeFile( dm->Bins[ i ].fname, FALSE );
+			free( dm->Bins[ i ].fname );
+		}
 	}
-	if( Bins )
-		free( Bins );
-	Bins = NULL;
-	NumBins = 0;
+	if( dm->Bins )
+		free( dm->Bins );
 //	for( i = 0; i < NumDevices; i++ )
 //		free( Devices[i].devname );
-	NumDevices = 0;
-	if( Devices )
-		free( Devices );
-	Devices = NULL;
-	if( SortBufs )
-		free( SortBufs );
-	SortBufs = NULL;
-
-	NSortBufs = 0;
-
-	BufferSizeMin = 0;
-	BufferSizeMax = 0;
-	
-    memset( &Seqbuf, 0, sizeof( seqbuf_t ) );
-
-	DataDev = 0;
-
-	OutFileName = "unset";
-
-	// close the sorted file
-    aClose( Output );
-    Output = NULL;
-	OutputDev = 0;
-
-	BinToRead = 0;
-	BinToWrite = 0;
-	BinToSort = 0;
-
-	free( WS.bufs );
-	memset( &WS, 0, sizeof( working_set_t ) );
-
-	NumRecs = 0;
-	RecsProcessed = 0;
-	RecsRead = 0;
-	RecsUnread = 0;
-	RecsCommitted = 0;
-	RecsWritten = 0;
-	
-
-// timers
-	RunningTime = 0;
-	RunningTimer= NULL;
-	BinningTime = 0;
-	BinningTimer= NULL;
-	SortingTime = 0;
-	SortingTimer = NULL;
-
-	QSortTime = 0;
-	QSortTimer = NULL;
-
-	ReadIdleTime = 0;
-	ReadIdleTimer = NULL;
-	SortIdleTime = 0;
-	SortIdleTimer = NULL;
-	WriteIdleTime = 0;
-	WriteIdleTimer = NULL;
-	
-	
-	memset( &Free, 0, sizeof( buffer_list_t ) );
-	memset( &ToProcess, 0, sizeof( buffer_list_t ) );
-	memset( &Reading, 0, sizeof( buffer_list_t ) );
-	memset( &Restructure, 0, sizeof( buffer_list_t ) );
-
-	// static variables
-	divisor = 0;
-	consumed_recs = 0;
-	toprocess = NULL;
-	lasttime = 0;
-	
-	// from asyncio.c
-//	OperationNumber = 0;
+	if( dm->Devices )
+		free( dm->Devices );
+	if( dm->SortBufs )
+		free( dm->SortBufs );
+
+	// close the input file if binning never finished, and the sorted file
+	if( dm->Data )
+		aClose( dm->Data );
+	if( dm->Output )
+		aClose( dm->Output );
+
+	if( dm->WS.bufs )
+		free( dm->WS.bufs );
+	if( dm->DNA_TABLE )
+		free( dm->DNA_TABLE );
+	if( dm->SeqScratch )
+		free( dm->SeqScratch );
+	if( dm->SortList )
+		free( dm->SortList );
+	free( dm );
 	
 	return rval;
 }
@@ -54,6 +54,10 @@
 #define MINRECS     (1311)
 #define MAXRECS     (1311)
 
+// fewest mers to extract or records to sort before using more than one thread
+#define PARALLEL_MERS_MIN   (65536)
+#define PARALLEL_SORT_MIN   (65536)
+
 
 // this is somewhat less appealing than a config file,
 // but speed is critical and parsing a config file at
@@ -102,51 +106,135 @@ enum dm_errors {
 };
 
 
+/**
+ * All of the state used while building one SML.  Each concurrent sort
+ * needs its own dmsort_t.
+ */
+typedef struct dmsort_s {
+    device_t        *Devices;
+    int             NumDevices;
+
+    int             NSortBufs;
+    sort_buf_t      *SortBufs;
+    int             *SortList;      // indices of the SortBufs being sorted
+
+    // how the working set is allocated originally.
+    offset_t        BufferSizeMin;
+    offset_t        BufferSizeMax;
+
+    bin_t           *Bins;
+    int             NumBins;
+    int             NumBinDevs;     // number of binning devices
+
+    seqbuf_t        Seqbuf;
+
+    aFILE           *Data;          // the data to sort
+    int             DataDev;        // the device the data file is on.
+
+    const char      *OutFileName;   // the output file name.
+    aFILE           *Output;        // the output file (sorted data goes here)
+    int             OutputDev;      // the device the output goes on.
+
+    int             BinToRead, BinToWrite, BinToSort;
+
+    working_set_t   WS;             // the Working Set we use to do our sorting.
+
+    offset_t        NumRecs;        // the total number of blocks to process
+    uint32          PositionBytes;  // bytes per entry in the output position array
+    offset_t        RecsProcessed;  // number of blocks processed (put in bins to write out)
+    offset_t        RecsRead;       // number of records fully read in.
+    offset_t        RecsUnread;     // number of blocks on disk (not yet had 'read' called)
+    offset_t        RecsCommitted;  // number of records committed to be written.
+    offset_t        RecsWritten;    // number of records actually written on disk.
+
+    // timers
+    double          RunningTime;
+    dmtimer_t       *RunningTimer;
+    double          BinningTime;
+    dmtimer_t       *BinningTimer;
+    double          SortingTime;
+    dmtimer_t       *SortingTimer;
+    double          QSortTime;
+    dmtimer_t       *QSortTimer;
+    double          ReadIdleTime;
+    dmtimer_t       *ReadIdleTimer;
+    double          SortIdleTime;
+    dmtimer_t       *SortIdleTimer;
+    double          WriteIdleTime;
+    dmtimer_t       *WriteIdleTimer;
+    double          RestructureTime;    // time spent extracting mers from the sequence
+    double          lasttime;       // time of the last status line
+
+    // buffer lists
+    buffer_list_t   Free;           // the free list
+    buffer_list_t   ToProcess;      // list read and to be processed
+    buffer_list_t   Reading;        // the list that's waiting on stuff to read.
+    buffer_list_t   Restructure;    // buffers that need post-read and pre-binning processing
+
+    // binning state
+    char            *SeqScratch;    // copy of the sequence that mers are extracted from
+    offset_t        SeqScratchSize;
+    unsigned int    divisor;        // key range covered by each bin
+    offset_t        consumed_recs;  // records of toprocess already binned
+    buffer_t        *toprocess;     // buffer currently being binned
+
+    // radix sort state
+    sort_buf_t      *CurrentSortBuf;
+    buffer_t        *SortScratchBuffer;
+
+    // seed pattern and translation table
+    uint8           *DNA_TABLE;
+    mask_t          seed_mask;
+    int             mask_length;
+    int             mask_weight;
+} dmsort_t;
+
+
 void print_usage( const char* pname );
 
 
-static buffer_t * AllocateFree( void );
+static buffer_t * AllocateFree( dmsort_t* dm );
 
-static int ComputeBinNumber( const unsigned char key[10] );
+static int ComputeBinNumber( dmsort_t* dm, const unsigned char key[10] );
 
 // just like ComputeBinNumber except we reserve one bin for zero keys.
-static int ComputeNNNNNBinNumber( const unsigned char key[10] );
+static int ComputeNNNNNBinNumber( dmsort_t* dm, const unsigned char key[10] );
 
-static int ComputeAsciiBinNumber( const unsigned char key[10] );
+static int ComputeAsciiBinNumber( dmsort_t* dm, const unsigned char key[10] );
 
-static void DoBinning( void );
+static void DoBinning( dmsort_t* dm );
 
-void FinishBinning();
+void FinishBinning( dmsort_t* dm );
 
-offset_t CalculateDataReadSize( buffer_t* b );
+offset_t CalculateDataReadSize( dmsort_t* dm, buffer_t* b );
 
-static void DoReading( void );
+static void DoReading( dmsort_t* dm );
 
-static void HandleBinWriteCompletions( void );
+static void HandleBinWriteCompletions( dmsort_t* dm );
 
-static void HandleSeqbufWriteCompletions( void );
+static void HandleSeqbufWriteCompletions( dmsort_t* dm );
 
 #define ALPHA_BITS 2
 
-static void Translate32(uint32* dest, const char* src, const unsigned len);
+static void Translate32( dmsort_t* dm, uint32* dest, const char* src, const unsigned len);
 
-void RestructureReadSMLBins( void );
+void RestructureReadSMLBins( dmsort_t* dm );
 
-static void HandleReadingCompletions( void );
+static void HandleReadingCompletions( dmsort_t* dm );
 
-int InitdmSML( long working_mb, long buffer_size, const char* input_filename, const char* output_filename, const char* const* scratch_paths, uint64 seed );
+int InitdmSML( dmsort_t* dm, long working_mb, long buffer_size, const char* input_filename, const char* output_filename, const char* const* scratch_paths, uint64 seed );
 
 void DisplayStatusHeader( void );
 
-void DisplayStatus( void );
+void DisplayStatus( dmsort_t* dm );
 
-void UpdateIOState( void );
+void UpdateIOState( dmsort_t* dm );
 
-void EnsureAllOperationsComplete( void );
+void EnsureAllOperationsComplete( dmsort_t* dm );
 
-void BinningPhase( void );
+void BinningPhase( dmsort_t* dm );
 
-void SortReading( void );
+void SortReading( dmsort_t* dm );
 
 #ifdef USE_QSORT_ONLY
 
@@ -160,38 +248,50 @@ void RecSort( record_t a[], int nelems );
 
 int SortBuffer( buffer_t * buf );
 
-void SortSorting( void );
+void SortSorting( dmsort_t* dm );
 
 #elif defined NO_SORT_PERF_TEST
 
-void SortSorting( void );
+void SortSorting( dmsort_t* dm );
 
 #else 
 
-sort_buf_t* CurrentSortBuf;
-buffer_t* SortScratchBuffer;
-
-void SortSorting( void );
+void SortSorting( dmsort_t* dm );
 
 #endif
 
-void RestructureSMLBinsForWrite( void );
+void RestructureSMLBinsForWrite( dmsort_t* dm );
 
-int CalculateSortWriteSize( int sortI );
+int CalculateSortWriteSize( dmsort_t* dm, int sortI );
 
-void SortWriting( void );
+void SortWriting( dmsort_t* dm );
 
-void SortHandleCompletions( void );
+void SortHandleCompletions( dmsort_t* dm );
 
-void SortUpdateIOState();
+void SortUpdateIOState( dmsort_t* dm );
 
-void SortingEnsureAllOperationsComplete();
+void SortingEnsureAllOperationsComplete( dmsort_t* dm );
 
-void SortingPhase( void );
+void SortingPhase( dmsort_t* dm );
 
-int dmsort( void );
+int dmsort( dmsort_t* dm );
 
+/**
+ * Builds a sorted mer list for the raw sequence in input_file and writes it to output_file.
+ * scratch_paths is a NULL terminated list of directories for the temporary bin files.
+ * The working set is sized from the amount of physical memory.
+ * @return 0 on success or one of dm_errors
+ */
 int dmSML( const char* input_file, const char* output_file, const char* const* scratch_paths, uint64 seed );
 
+/**
+ * Like dmSML(), but limits the working set to working_mb megabytes so that
+ * several sorts may share the available memory.  Each call uses its own
+ * dmsort_t, so this may be called concurrently from multiple threads as long
+ * as each call writes a different output_file.
+ * @param working_mb	The working set size in megabytes, or 0 to size it from physical memory
+ */
+int dmSMLWorkingSet( const char* input_file, const char* output_file, const char* const* scratch_paths, uint64 seed, long working_mb );
+
 
 #endif // __DMSORT_H__
@@ -10,7 +10,7 @@ SMLHeader_t InitSML( aFILE* file, uint64 file_size, uint64 seed ){
 	SMLHeader_t header;
 	int retcode;
 	
-	header.version = 5;
+	header.version = 6;
 	header.alphabet_bits = 2;
 	header.seed = seed;
 	header.seed_length = getSeedLength( seed );
@@ -23,6 +23,8 @@ SMLHeader_t InitSML( aFILE* file, uint64 file_size, uint64 seed ){
 	header.circular = 0;
 	memcpy(header.translation_table, CreateBasicDNATable(), UINT8_MAX);
 	header.description[ 0 ] = 0;
+	// same rule as SMLPositionBytes() in SortedMerList.h
+	header.position_bytes = file_size < 0xFFFFFFFFULL ? 4 : 5;
 	
 	retcode = aWrite( (void*)&header, sizeof( header ), 1, file, 0 );
 	if( retcode == 0 )
@@ -31,6 +33,14 @@ SMLHeader_t InitSML( aFILE* file, uint64 file_size, uint64 seed ){
 	return header;
 }
 
+void PackPosition( char* dest, uint32 position_bytes, uint64 position ){
+	uint32 low_word = (uint32)position;
+	uint32 byteI;
+	memcpy( dest, &low_word, sizeof(uint32) );
+	for( byteI = sizeof(uint32); byteI < position_bytes; byteI++ )
+		dest[ byteI ] = (char)(position >> (8 * byteI));
+}
+
 /*
 // use this version of RestructureReadSMLBins when no restructuring is necessary
 void RestructureReadSMLBins( void ) {
@@ -38,13 +38,9 @@ static uint8* CreateBasicDNATable(){
 	return bdt;
 }
 
-static uint8* DNA_TABLE;
-typedef unsigned position_t;
+typedef unsigned long long position_t;
 typedef unsigned long long mask_t;
 #define MASK_T_BYTES 8
-static mask_t seed_mask = 0x7FFFFFFF;
-static int mask_length = 31;
-static int mask_weight = 31;
 
 #define DESCRIPTION_SIZE 2048	/**< Number of bytes for the freeform text description of an SML */
 
@@ -65,14 +61,22 @@ typedef struct SMLHeader_s{
 	boolean circular;					/**< Circularity of sequence - 1 byte */
 	uint8 translation_table[UINT8_MAX];	/**< Translation table for ascii characters to binary values -- 256 bytes */
 	char description[DESCRIPTION_SIZE]; /**< Freeform text description of sequence data -- 2048 bytes */
+	uint32 position_bytes;				/**< Bytes used to store each entry in the position array - 4 bytes */
 } SMLHeader_t;
 
 
+/* must be the same size as record_t */
 typedef struct sml_s {
 		char key[8];
 		position_t pos;
 } sml_t;
 
+/**
+ * Stores position in the first position_bytes bytes of dest using the same
+ * layout as SetPackedPosition() in SortedMerList.h
+ */
+void PackPosition( char* dest, uint32 position_bytes, uint64 position );
+
 SMLHeader_t InitSML( aFILE* file, uint64 file_size, uint64 seed );
 
 
@@ -18,7 +18,7 @@ void QSort( record_t* a[], int lo0, int hi0 );
 void CopySortedData ( sort_buf_t* sortbuf );
 
 
-void InitRadixSort( sort_buf_t* sortbuf, buffer_t* scratch_buffer )
+void InitRadixSort( sort_buf_t* sortbuf, buffer_t* scratch_buffer, int num_bins )
 {
 	// allocate the sortbuf struct
 	unsigned int bin_divisor;
@@ -34,9 +34,9 @@ void InitRadixSort( sort_buf_t* sortbuf, buffer_t* scratch_buffer )
 	
 	// calculate the base number and divisor
 
-    bin_divisor = (unsigned)16777216 / (unsigned)NumBins;
+    bin_divisor = (unsigned)16777216 / (unsigned)num_bins;
     // need ceiling of this
-    bin_divisor += (unsigned)16777216 % (unsigned)NumBins ? 1 : 0;
+    bin_divisor += (unsigned)16777216 % (unsigned)num_bins ? 1 : 0;
 
     for( i = 0; i < 3; i++ ) {
         keyval <<= 8;
@@ -62,15 +62,12 @@ typedef struct sort_buf_s {
 	int sort_state;			// current state of the sort algorithm
 } sort_buf_t;
 
-// Need NumBins so that we can compute the amount already sorted
-extern int NumBins;
-
 //typedef unsigned long long uint64;
 
 /* Fills and returns a new sort_buf_t with the appropriate
- * data.
+ * data.  num_bins is needed to compute the amount already sorted.
  */
-void InitRadixSort( sort_buf_t* sortbuf, buffer_t* scratch_buffer );
+void InitRadixSort( sort_buf_t* sortbuf, buffer_t* scratch_buffer, int num_bins );
 
 /* Checks the current state of the radix sort and performs a fixed
  * amount of sorting computation before returning.
@@ -3,6 +3,7 @@
 #endif
 
 #include <stdio.h>
+#include <errno.h>
 #include "libMems/dmSML/util.h"
 
 #define FMT_BUFFER_SIZE     (32)
@@ -114,19 +115,13 @@ void AddTo64( unsigned int amt, unsigned int *hi, unsigned int *lo ) {
 
 }
 
-/** Utility function to delete a file */
+/** Utility function to delete a file, a file that does not exist is not an error */
 int removeFile( const char* filename, int verbose )
 {
-#ifdef WIN32
-		return remove( filename );
-//        return !DeleteFile( filename );
-#else
-        char* rm_cmd;
+        if( remove( filename ) != 0 )
+                return errno == ENOENT ? 0 : -1;
         if( verbose )
-                rm_cmd = Fmt( "/bin/rm -fv %s", filename );
-        else
-                rm_cmd = Fmt( "/bin/rm -f %s", filename );
-        return system( rm_cmd );
-#endif
+                printf( "removed `%s'\n", filename );
+        return 0;
 }
 
@@ -48,18 +48,29 @@
 
 
 /* Period parameters */  
-#define N 624
+#define N TWISTER_STATE_SIZE
 #define M 397
 #define MATRIX_A 0x9908b0dfUL   /* constant vector a */
 #define UPPER_MASK 0x80000000UL /* most significant w-r bits */
 #define LOWER_MASK 0x7fffffffUL /* least significant r bits */
 
-static unsigned long mt[N]; /* the array for the state vector  */
-static int mti=N+1; /* mti==N+1 means mt[N] is not initialized */
+/* the stream used by the functions without a state argument.  mti==N+1 means mt[N] is not initialized */
+static TwisterState default_state = { {0}, N+1 };
+
+static void init_state(TwisterState* ts, unsigned long s);
+static unsigned long state_int32(TwisterState* ts);
 
 /* initializes mt[N] with a seed */
 void init_genrand(unsigned long s)
 {
+    init_state(&default_state, s);
+}
+
+/* initializes a stream's mt[N] with a seed */
+static void init_state(TwisterState* ts, unsigned long s)
+{
+    unsigned long* mt = ts->mt;
+    int mti;
     mt[0]= s & 0xffffffffUL;
     for (mti=1; mti<N; mti++) {
         mt[mti] = 
@@ -71,6 +82,7 @@ void init_genrand(unsigned long s)
         mt[mti] &= 0xffffffffUL;
         /* for >32 bit machines */
     }
+    ts->mti = mti;
 }
 
 /* initialize by an array with array-length */
@@ -79,6 +91,7 @@ void init_genrand(unsigned long s)
 /* slight change for C++, 2004/2/26 */
 void init_by_array(unsigned long init_key[], int key_length)
 {
+    unsigned long* mt = default_state.mt;
     int i, j, k;
     init_genrand(19650218UL);
     i=1; j=0;
@@ -105,15 +118,22 @@ void init_by_array(unsigned long init_key[], int key_length)
 /* generates a random number on [0,0xffffffff]-interval */
 unsigned long genrand_int32(void)
 {
+    return state_int32(&default_state);
+}
+
+/* generates a random number on [0,0xffffffff]-interval from a stream */
+static unsigned long state_int32(TwisterState* ts)
+{
+    unsigned long* mt = ts->mt;
     unsigned long y;
-    static unsigned long mag01[2]={0x0UL, MATRIX_A};
+    static const unsigned long mag01[2]={0x0UL, MATRIX_A};
     /* mag01[x] = x * MATRIX_A  for x=0,1 */
 
-    if (mti >= N) { /* generate N words at one time */
+    if (ts->mti >= N) { /* generate N words at one time */
         int kk;
 
-        if (mti == N+1)   /* if init_genrand() has not been called, */
-            init_genrand(5489UL); /* a default initial seed is used */
+        if (ts->mti == N+1)   /* if init_genrand() has not been called, */
+            init_state(ts, 5489UL); /* a default initial seed is used */
 
         for (kk=0;kk<N-M;kk++) {
             y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
@@ -126,10 +146,10 @@ unsigned long genrand_int32(void)
         y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
         mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
 
-        mti = 0;
+        ts->mti = 0;
     }
   
-    y = mt[mti++];
+    y = mt[ts->mti++];
 
     /* Tempering */
     y ^= (y >> 11);
@@ -221,4 +241,14 @@ unsigned RandTwisterUnsigned()
 	return genrand_int32();
 }
 
+void SetTwisterStateSeed(TwisterState* ts, unsigned long seed)
+{
+	init_state(ts, seed);
+}
+
+double RandTwisterStateDouble(TwisterState* ts)
+{
+	return state_int32(ts)*(1.0/4294967295.0);
+}
+
 
@@ -10,6 +10,22 @@ unsigned long CreateTwisterSeed(void);
 double RandTwisterDouble (void);
 unsigned RandTwisterUnsigned(void);
 
+#define TWISTER_STATE_SIZE 624
+
+/**
+ * The state of a random number stream.  Code that runs concurrently with
+ * other users of the generator keeps its own stream so that the numbers it
+ * draws do not depend on what the others draw
+ */
+typedef struct TwisterState
+{
+	unsigned long mt[TWISTER_STATE_SIZE];
+	int mti;
+} TwisterState;
+
+void SetTwisterStateSeed (TwisterState* ts, unsigned long seed);
+double RandTwisterStateDouble (TwisterState* ts);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,9 +23,10 @@ int main( int argc, char* argv[] ){
 		cerr << "Error opening alignment file \"" << argv[1] << "\"\n";
 		return -2;
 	}
+	in_aln.close();
+	// blocks are read from the alignment as they get queried
 	IntervalList iv_list;
-	iv_list.ReadStandardAlignment(in_aln);
-	LoadSequences( iv_list, NULL );
+	iv_list.OpenIndexedAlignment(argv[1]);
 
 	ifstream in_coords( argv[2] );
 	if(!in_coords.is_open() ){
@@ -36,9 +37,13 @@ int main( int argc, char* argv[] ){
 	while( in_coords >> block_id ){
 		int block_col;
 		in_coords >> block_col;
+		if( block_id < 0 || (size_t)block_id >= iv_list.size() ){
+			cerr << "Invalid block ID " << block_id << "\n";
+			return -3;
+		}
 		std::vector<gnSeqI> pos;
 		std::vector<bool> column;
-		iv_list[block_id].GetColumn( block_col, pos, column );
+		iv_list.LoadInterval(block_id).GetColumn( block_col, pos, column );
 		for(int i=0; i<pos.size(); i++){
 			if(i>0) cout << "\t";
 			cout << (column[i] ? pos[i] : 0); 
@@ -0,0 +1,136 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/DNAFileSML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include "boost/filesystem/operations.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Measures the throughput of building several sorted mer lists with the
+ * external dmSML sorter under a fixed memory budget.  The SMLs are first built
+ * one at a time, each with the whole budget, and then all at once, each with
+ * an equal share of it.  The concurrently built SMLs must match the others.
+ */
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+static string smlName( const string& scratch_path, const string& run, size_t seqI )
+{
+	stringstream name;
+	name << scratch_path << "/dmSMLBenchmark." << run << "." << seqI << ".sslist";
+	return name.str();
+}
+
+/** @return true if both SMLs hold the same mers at the same positions */
+static bool sameSML( DNAFileSML& a, DNAFileSML& b )
+{
+	if( a.SMLLength() != b.SMLLength() )
+		return false;
+	vector< bmer > a_mers;
+	vector< bmer > b_mers;
+	a.Read( a_mers, a.SMLLength(), 0 );
+	b.Read( b_mers, b.SMLLength(), 0 );
+	for( size_t merI = 0; merI < a_mers.size(); merI++ )
+		if( a_mers[merI].mer != b_mers[merI].mer || a_mers[merI].position != b_mers[merI].position )
+			return false;
+	return a_mers.size() == b_mers.size();
+}
+
+int main( int argc, char* argv[] )
+{
+	long budget_mb = 256;
+	uint seed_weight = 15;
+	string scratch_path = ".";
+	vector< string > seq_files;
+	for( int argI = 1; argI < argc; argI++ )
+	{
+		string arg = argv[argI];
+		if( arg == "--memory" && argI + 1 < argc )
+			budget_mb = atol( argv[++argI] );
+		else if( arg == "--seed-weight" && argI + 1 < argc )
+			seed_weight = atoi( argv[++argI] );
+		else if( arg == "--scratch-path" && argI + 1 < argc )
+			scratch_path = argv[++argI];
+		else
+			seq_files.push_back( arg );
+	}
+	if( seq_files.size() < 1 || budget_mb < (long)seq_files.size() )
+	{
+		cerr << "Usage: dmSMLBenchmark [--memory <megabytes>] [--seed-weight <weight>] [--scratch-path <directory>] <sequence file>...\n";
+		cerr << "The memory budget must allow at least one megabyte per sequence\n";
+		return -1;
+	}
+	FileSML::registerTempPath( scratch_path );
+	uint64 seed = getSeed( seed_weight );
+
+	vector< gnSequence* > seqs( seq_files.size() );
+	gnSeqI total_len = 0;
+	try{
+		for( size_t seqI = 0; seqI < seq_files.size(); seqI++ )
+		{
+			seqs[seqI] = new gnSequence();
+			seqs[seqI]->LoadSource( seq_files[seqI] );
+			total_len += seqs[seqI]->length();
+		}
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -2;
+	}
+	const int seq_count = seqs.size();
+	cout << "Sorting " << seq_count << " sequences, " << total_len << " bp in total, in " << budget_mb << " MB\n";
+
+	vector< DNAFileSML* > serial( seq_count );
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for( int seqI = 0; seqI < seq_count; seqI++ )
+	{
+		serial[seqI] = new DNAFileSML( smlName( scratch_path, "serial", seqI ) );
+		serial[seqI]->dmCreate( *seqs[seqI], seed, budget_mb );
+	}
+	double serial_time = seconds( start );
+	cout << "one at a time:\t" << serial_time << " seconds\t" << total_len / serial_time / 1000000.0 << " Mbp/s\n";
+
+	vector< DNAFileSML* > parallel( seq_count );
+	for( int seqI = 0; seqI < seq_count; seqI++ )
+		parallel[seqI] = new DNAFileSML( smlName( scratch_path, "parallel", seqI ) );
+	start = boost::posix_time::microsec_clock::universal_time();
+#pragma omp parallel for schedule(dynamic)
+	for( int seqI = 0; seqI < seq_count; seqI++ )
+		parallel[seqI]->dmCreate( *seqs[seqI], seed, budget_mb / seq_count );
+	double parallel_time = seconds( start );
+	cout << "all at once:\t" << parallel_time << " seconds\t" << total_len / parallel_time / 1000000.0 << " Mbp/s\n";
+
+	bool all_same = true;
+	for( int seqI = 0; seqI < seq_count; seqI++ )
+	{
+		if( !sameSML( *serial[seqI], *parallel[seqI] ) )
+		{
+			cerr << "The sorted mer lists of " << seq_files[seqI] << " differ\n";
+			all_same = false;
+		}
+		serial[seqI]->Clear();
+		parallel[seqI]->Clear();
+		delete serial[seqI];
+		delete parallel[seqI];
+		delete seqs[seqI];
+		boost::filesystem::remove( smlName( scratch_path, "serial", seqI ) );
+		boost::filesystem::remove( smlName( scratch_path, "serial", seqI ) + ".coords" );
+		boost::filesystem::remove( smlName( scratch_path, "parallel", seqI ) );
+		boost::filesystem::remove( smlName( scratch_path, "parallel", seqI ) + ".coords" );
+	}
+	return all_same ? 0 : 1;
+}
@@ -15,6 +15,7 @@
 #include "libGenome/gnFASSource.h"
 #include "libMems/GappedAlignment.h"
 #include "libMems/Interval.h"
+#include "libMems/XmfaReader.h"
 #include <boost/filesystem/operations.hpp>
 #include <boost/algorithm/string/erase.hpp>
 
@@ -48,36 +49,44 @@ int main( int argc, const char* argv[] ){
 		return -1;
 	}
 	
-	IntervalList aligned_ivs;
-	aligned_ivs.ReadStandardAlignment( alignment_in );
-	cout << "Read " << aligned_ivs[0].SeqCount() << " sequences with " << aligned_ivs.size() << " aligned intervals from " << alignment_fname << endl;
-	cout.flush();
+	// intervals are read one at a time
+	XmfaReader reader( alignment_in );
 	MatchList mlist;
-	mlist.seq_filename = aligned_ivs.seq_filename;
+	mlist.seq_filename = reader.seq_filename;
+	CompactGappedAlignment<> iv;
+	vector< string > seqs;
+	bool have_iv = reader.Next( iv, mlist.seq_filename.size() > 0 ? NULL : &seqs );
+	if( !have_iv )
+	{
+		cerr << "Error, no aligned intervals in " << alignment_fname << endl;
+		return -1;
+	}
+	cout << "Reading " << iv.SeqCount() << " sequences from " << alignment_fname << endl;
+	cout.flush();
 	if( mlist.seq_filename.size() > 0 )
 		LoadSequences(mlist, &cout);
-	else if( aligned_ivs.size() == 1 )
+	else
 	{
-		mlist.seq_filename.resize( aligned_ivs[0].SeqCount() );	
-		mlist.seq_table.resize( aligned_ivs[0].SeqCount() );
-		std::vector< mems::AbstractMatch* > matches;
-		aligned_ivs[0].StealMatches(matches);
-		std::vector< string > seqs = mems::GetAlignment( *((mems::GappedAlignment*)matches[0]), mlist.seq_table );
+		// without sequence files the alignment must be a single interval
+		CompactGappedAlignment<> next_iv;
+		if( reader.Next( next_iv ) )
+		{
+			cerr << "Error, source sequence file references not given\n";
+			return -1;
+		}
+		mlist.seq_filename.resize( iv.SeqCount() );	
+		mlist.seq_table.resize( iv.SeqCount() );
 		for( size_t seqI = 0; seqI < mlist.seq_table.size(); ++seqI )
 		{
 			boost::algorithm::erase_all( seqs[seqI], std::string("-") );
 			mlist.seq_table[seqI] = new gnSequence( seqs[seqI] );
 		}
-		aligned_ivs[0].SetMatches( matches );
-	}else{
-		cerr << "Error, source sequence file references not given\n";
 	}
 	// for each interval, extract sliding windows and write them to Multi-FastA files
-	for( uint ivI = 0; ivI < aligned_ivs.size(); ivI++ )
+	for( uint ivI = 0; have_iv; ivI++, have_iv = reader.Next( iv ) )
 	{
 		vector< string > alignment;
-		GetAlignment( aligned_ivs[ivI], mlist.seq_table, alignment );
-		Interval& iv = aligned_ivs[ivI];
+		GetAlignment( iv, mlist.seq_table, alignment );
 		stringstream ivnum;
 		ivnum << ivI;
 		boost::filesystem::path base_path = output_basename;
@@ -132,6 +141,7 @@ int main( int argc, const char* argv[] ){
 		gnFASSource::Write( fns, lcb_out, false, false );
 
 	}
+	cout << "Wrote windows of " << reader.BlocksRead() << " aligned intervals\n";
 	return 0;
 }
 
@@ -0,0 +1,183 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/GreedyBreakpointElimination.h"
+#include "libMems/Match.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Times greedy breakpoint elimination with each removal applied to the
+ * pairwise alignments one at a time and in parallel, for a growing number of
+ * pairwise alignments, to find the number of pairs from which the parallel
+ * removal pays off.  The scorer applies removals in parallel from
+ * REMOVAL_PARALLEL_PAIR_MIN pairs on, which is serial unless set otherwise
+ * with setRemovalParallelPairMin().  The matches are blocks shared by all genomes that each went
+ * through their own inversions, with short blocks scattered at random.
+ * usage: greedyBreakpointBenchmark [block count] [random seed] [repeats]
+ */
+
+static const uint GENOME_COUNT = 10;
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+/** matches over genomes in which blocks were inverted and short blocks were moved at random */
+static void makeMatches( uint genome_count, size_t block_count, vector< AbstractMatch* >& matches )
+{
+	vector< gnSeqI > lengths( block_count );
+	for( size_t blockI = 0; blockI < block_count; blockI++ )
+		lengths[blockI] = rand() % 10 == 0 ? 10 + rand() % 30 : 100 + rand() % 1000;
+
+	vector< Match > blocks( block_count, Match( genome_count ) );
+	for( uint genomeI = 0; genomeI < genome_count; genomeI++ )
+	{
+		vector< size_t > order( block_count );
+		vector< bool > reverse( block_count, false );
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+			order[blockI] = blockI;
+		for( size_t invI = block_count / 40; invI > 0; invI-- )
+		{
+			size_t first = rand() % block_count;
+			size_t last = (std::min)( block_count, first + 1 + rand() % 20 );
+			std::reverse( order.begin() + first, order.begin() + last );
+			for( size_t blockI = first; blockI < last; blockI++ )
+				reverse[ order[blockI] ] = !reverse[ order[blockI] ];
+		}
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+			if( lengths[ order[blockI] ] < 100 )
+				std::swap( order[blockI], order[ rand() % block_count ] );
+
+		int64 pos = 1;
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+		{
+			size_t block = order[blockI];
+			pos += rand() % 50;
+			if( rand() % 20 != 0 )
+				blocks[block].SetStart( genomeI, reverse[block] ? -pos : pos );
+			pos += lengths[block];
+		}
+	}
+	for( size_t blockI = 0; blockI < block_count; blockI++ )
+	{
+		blocks[blockI].SetLength( lengths[blockI] );
+		matches.push_back( blocks[blockI].Copy() );
+	}
+}
+
+/**
+ * runs greedy breakpoint elimination on the matches between genomes
+ * [0, n1_count) and [n1_count, n1_count + n2_count).  returns the final score
+ * and the number of matches kept, and adds the time spent searching to elapsed
+ */
+static double eliminate( vector< AbstractMatch* >& matches, uint n1_count, uint n2_count, size_t pair_min, size_t& kept, double& elapsed )
+{
+	vector< node_id_t > n1_des;
+	vector< node_id_t > n2_des;
+	for( uint genomeI = 0; genomeI < n1_count + n2_count; genomeI++ )
+		(genomeI < n1_count ? n1_des : n2_des).push_back( genomeI );
+
+	vector< TrackingMatch > tracking_matches( matches.size() );
+	boost::multi_array< double, 3 > tm_score_array( boost::extents[matches.size()][n1_des.size()][n2_des.size()] );
+	for( size_t mI = 0; mI < matches.size(); mI++ )
+	{
+		tracking_matches[mI].original_match = matches[mI];
+		tracking_matches[mI].node_match = matches[mI];
+		tracking_matches[mI].match_id = mI;
+		for( size_t i = 0; i < n1_des.size(); i++ )
+			for( size_t j = 0; j < n2_des.size(); j++ )
+				tm_score_array[mI][i][j] = matches[mI]->LeftEnd( n1_des[i] ) == NO_MATCH || matches[mI]->LeftEnd( n2_des[j] ) == NO_MATCH ? 0 : matches[mI]->Length( n1_des[i] );
+	}
+	boost::multi_array< size_t, 3 > tm_lcb_id_array;
+	initTrackingMatchLCBTracking( tracking_matches, n1_des.size(), n2_des.size(), tm_lcb_id_array );
+
+	vector< TrackingMatch* > t_matches( tracking_matches.size() );
+	for( size_t mI = 0; mI < tracking_matches.size(); mI++ )
+		t_matches[mI] = &tracking_matches[mI];
+	PairwiseLCBMatrix pairwise_adj_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	for( uint i = 0; i < n1_des.size(); i++ )
+		for( uint j = 0; j < n2_des.size(); j++ )
+			getPairwiseLCBs( n1_des[i], n2_des[j], i, j, t_matches, pairwise_adj_mat[i][j], tm_score_array, tm_lcb_id_array );
+	sort( t_matches.begin(), t_matches.end() );
+
+	boost::multi_array< double, 2 > bp_dist_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	boost::multi_array< double, 2 > cons_dist_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	EvenFasterSumOfPairsBreakpointScorer spbs( 500, 100, bp_dist_mat, cons_dist_mat,
+		t_matches, pairwise_adj_mat, n1_des, n2_des,
+		tm_score_array, tm_lcb_id_array, 0, n1_des.size(), 0, n2_des.size() );
+	spbs.setStatusOut( NULL );
+	spbs.setRemovalParallelPairMin( pair_min );
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	double score = greedySearch( spbs, NULL );
+	elapsed += seconds( start );
+	kept = spbs.getResults().size();
+	return score;
+}
+
+int main( int argc, char* argv[] )
+{
+	size_t block_count = argc > 1 ? atoi( argv[1] ) : 2000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+	int repeats = argc > 3 ? atoi( argv[3] ) : 3;
+	if( block_count < 100 || repeats < 1 )
+	{
+		cerr << "Usage: greedyBreakpointBenchmark [block count] [random seed] [repeats]\n";
+		cerr << "At least 100 blocks are needed\n";
+		return -1;
+	}
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	vector< AbstractMatch* > matches;
+	makeMatches( GENOME_COUNT, block_count, matches );
+
+	// the genomes on either side of the ancestor being aligned
+	const uint groups[][2] = { {1,1}, {1,2}, {2,2}, {2,3}, {2,4}, {3,3}, {3,4}, {4,4}, {4,6}, {5,5} };
+	cout << threads << " threads, " << block_count << " blocks, ";
+	if( REMOVAL_PARALLEL_PAIR_MIN == (std::numeric_limits<size_t>::max)() )
+		cout << "serial removal by default\n";
+	else
+		cout << "parallel from " << REMOVAL_PARALLEL_PAIR_MIN << " pairs by default\n";
+	cout << "pairs\tserial seconds\tparallel seconds\tspeedup\n";
+	int failures = 0;
+	for( size_t groupI = 0; groupI < sizeof(groups) / sizeof(groups[0]); groupI++ )
+	{
+		double serial_time = 0;
+		double parallel_time = 0;
+		for( int repeatI = 0; repeatI < repeats; repeatI++ )
+		{
+			size_t serial_kept = 0;
+			size_t parallel_kept = 0;
+			double serial_score = eliminate( matches, groups[groupI][0], groups[groupI][1], (size_t)-1, serial_kept, serial_time );
+			double parallel_score = eliminate( matches, groups[groupI][0], groups[groupI][1], 1, parallel_kept, parallel_time );
+			if( serial_score != parallel_score || serial_kept != parallel_kept )
+				failures++;
+		}
+		cout << groups[groupI][0] * groups[groupI][1] << "\t" << serial_time / repeats << "\t" << parallel_time / repeats << "\t" << serial_time / parallel_time << endl;
+	}
+
+	for( size_t mI = 0; mI < matches.size(); mI++ )
+		matches[mI]->Free();
+	if( failures > 0 )
+	{
+		cerr << "parallel and serial removal gave different results\n";
+		return 1;
+	}
+	return 0;
+}
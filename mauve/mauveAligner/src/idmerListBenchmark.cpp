@@ -0,0 +1,146 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/MatchList.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/pool/pool_alloc.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Compares building seed match lists in a std::list<idmer>, as MatchFinder
+ * used to, and in a std::list<idmer> with boost::fast_pool_allocator, with
+ * refilling one IdmerList.  MemHash is run once on the given sequences while
+ * every list of matching mers it enumerates is recorded.  The lists are then
+ * rebuilt and sorted by sequence id each way, and the sorted results are
+ * compared.
+ */
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+/** A MemHash that records each list of matching mers it enumerates */
+class RecordingMemHash : public MemHash {
+public:
+	vector< vector< idmer > > match_lists;
+protected:
+	virtual boolean EnumerateMatches( IdmerList& match_list ){
+		match_lists.push_back( vector< idmer >( match_list.begin(), match_list.end() ) );
+		return MemHash::EnumerateMatches( match_list );
+	}
+};
+
+/** folds the ids and positions of a sorted list of mers into a checksum */
+template< class List >
+static uint64 checksum( const List& mers, uint64 sum )
+{
+	typename List::const_iterator iter = mers.begin();
+	for( ; iter != mers.end(); ++iter )
+		sum = (sum ^ (iter->position * 31 + iter->id)) * 1099511628211ULL;
+	return sum;
+}
+
+int main( int argc, char* argv[] )
+{
+	uint seed_weight = 0;
+	int repetitions = 10;
+	MatchList ml;
+	for( int argI = 1; argI < argc; argI++ )
+	{
+		string arg = argv[argI];
+		if( arg == "--seed-weight" && argI + 1 < argc )
+			seed_weight = atoi( argv[++argI] );
+		else if( arg == "--repetitions" && argI + 1 < argc )
+			repetitions = atoi( argv[++argI] );
+		else
+			ml.seq_filename.push_back( arg );
+	}
+	if( ml.seq_filename.size() < 2 || repetitions < 1 )
+	{
+		cerr << "Usage: idmerListBenchmark [--seed-weight <weight>] [--repetitions <count>] <sequence file> <sequence file> [sequence file]...\n";
+		return -1;
+	}
+
+	try{
+		LoadSequences( ml, &cout );
+		ml.CreateMemorySMLs( seed_weight, &cout );
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -2;
+	}
+
+	RecordingMemHash mh;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	mh.FindMatches( ml );
+	cout << "MemHash found " << ml.size() << " matches in " << seconds( start ) << " seconds\n";
+	const vector< vector< idmer > >& match_lists = mh.match_lists;
+	size_t mer_count = 0;
+	for( size_t listI = 0; listI < match_lists.size(); listI++ )
+		mer_count += match_lists[listI].size();
+	cout << "Rebuilding " << match_lists.size() << " mer lists with " << mer_count << " mers " << repetitions << " times\n";
+
+	uint64 list_sum = 0;
+	start = boost::posix_time::microsec_clock::universal_time();
+	for( int repI = 0; repI < repetitions; repI++ )
+	{
+		for( size_t listI = 0; listI < match_lists.size(); listI++ )
+		{
+			list< idmer > mers;
+			for( size_t merI = 0; merI < match_lists[listI].size(); merI++ )
+				mers.push_back( match_lists[listI][merI] );
+			mers.sort( &idmer_id_lessthan );
+			list_sum = checksum( mers, list_sum );
+		}
+	}
+	cout << "std::list<idmer>:\t" << seconds( start ) << " seconds\n";
+
+	uint64 pool_sum = 0;
+	start = boost::posix_time::microsec_clock::universal_time();
+	for( int repI = 0; repI < repetitions; repI++ )
+	{
+		for( size_t listI = 0; listI < match_lists.size(); listI++ )
+		{
+			list< idmer, boost::fast_pool_allocator< idmer > > mers;
+			for( size_t merI = 0; merI < match_lists[listI].size(); merI++ )
+				mers.push_back( match_lists[listI][merI] );
+			mers.sort( &idmer_id_lessthan );
+			pool_sum = checksum( mers, pool_sum );
+		}
+	}
+	cout << "std::list<idmer> with fast_pool_allocator:\t" << seconds( start ) << " seconds\n";
+
+	uint64 vector_sum = 0;
+	start = boost::posix_time::microsec_clock::universal_time();
+	IdmerList mers;
+	for( int repI = 0; repI < repetitions; repI++ )
+	{
+		for( size_t listI = 0; listI < match_lists.size(); listI++ )
+		{
+			mers.clear();
+			for( size_t merI = 0; merI < match_lists[listI].size(); merI++ )
+				mers.push_back( match_lists[listI][merI] );
+			mers.sort( &idmer_id_lessthan );
+			vector_sum = checksum( mers, vector_sum );
+		}
+	}
+	cout << "IdmerList:\t" << seconds( start ) << " seconds\n";
+
+	ml.Clear();
+	if( list_sum != vector_sum || pool_sum != vector_sum )
+	{
+		cerr << "The sorted mer lists differ\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/MatchHashTable.h"
+#include "libMems/MatchList.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Compares MatchHashTable with the sorted vector buckets that MemHash used
+ * before it.  MemHash is run once on the given sequences while every lookup
+ * and insertion it makes in its match table is recorded.  The recorded
+ * operations are then replayed against both structures, which must find the
+ * same entries that MemHash found.
+ */
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+/** One call to AddHashEntry: the match looked up and the entry it resolved to */
+struct TableOp {
+	MatchHashEntry query;
+	MatchHashEntry* result;
+	bool inserted;	/**< true if result was added to the table by this call */
+};
+
+/** A MemHash that records the operations on its match table */
+class RecordingMemHash : public MemHash {
+public:
+	vector< TableOp > ops;
+	uint32 TableSize() const{ return table_size; }
+protected:
+	virtual MatchHashEntry* AddHashEntry( MatchHashEntry& mhe ){
+		size_t opI = ops.size();
+		ops.push_back( TableOp() );
+		ops[opI].query = mhe;
+		size_t allocated_count = allocated.size();
+		MatchHashEntry* result = MemHash::AddHashEntry( mhe );
+		ops[opI].result = result;
+		ops[opI].inserted = allocated.size() > allocated_count && allocated[allocated_count] == result;
+		return result;
+	}
+};
+
+/** replays the operations against buckets of sorted vectors, @return the number of mismatches */
+static size_t replaySortedBuckets( const vector< TableOp >& ops, uint32 table_size )
+{
+	MheCompare mhecomp;
+	vector< vector< MatchHashEntry* > > buckets( table_size );
+	size_t mismatches = 0;
+	for( size_t opI = 0; opI < ops.size(); opI++ )
+	{
+		int64 offset = ops[opI].query.Offset();
+		uint32 bucketI = ((offset % table_size) + table_size) % table_size;
+		vector< MatchHashEntry* >& bucket = buckets[bucketI];
+		MatchHashEntry* query = const_cast< MatchHashEntry* >( &ops[opI].query );
+		vector< MatchHashEntry* >::iterator mhe_iter = std::lower_bound( bucket.begin(), bucket.end(), query, mhecomp );
+		MatchHashEntry* found = NULL;
+		if( mhe_iter != bucket.end() && !mhecomp( *mhe_iter, query ) && !mhecomp( query, *mhe_iter ) )
+			found = *mhe_iter;
+		if( ops[opI].inserted )
+		{
+			if( found != NULL )
+				mismatches++;
+			bucket.insert( std::lower_bound( bucket.begin(), bucket.end(), ops[opI].result, mhecomp ), ops[opI].result );
+		}else if( found != ops[opI].result )
+			mismatches++;
+	}
+	return mismatches;
+}
+
+/** replays the operations against a MatchHashTable, @return the number of mismatches */
+static size_t replayMatchHashTable( const vector< TableOp >& ops )
+{
+	MatchHashTable table;
+	size_t mismatches = 0;
+	for( size_t opI = 0; opI < ops.size(); opI++ )
+	{
+		MatchHashEntry* found = table.Find( ops[opI].query );
+		if( ops[opI].inserted )
+		{
+			if( found != NULL )
+				mismatches++;
+			table.Insert( ops[opI].result );
+		}else if( found != ops[opI].result )
+			mismatches++;
+	}
+	return mismatches;
+}
+
+int main( int argc, char* argv[] )
+{
+	uint seed_weight = 0;
+	MatchList ml;
+	for( int argI = 1; argI < argc; argI++ )
+	{
+		string arg = argv[argI];
+		if( arg == "--seed-weight" && argI + 1 < argc )
+			seed_weight = atoi( argv[++argI] );
+		else
+			ml.seq_filename.push_back( arg );
+	}
+	if( ml.seq_filename.size() < 2 )
+	{
+		cerr << "Usage: matchHashTableBenchmark [--seed-weight <weight>] <sequence file> <sequence file> [sequence file]...\n";
+		return -1;
+	}
+
+	try{
+		LoadSequences( ml, &cout );
+		ml.CreateMemorySMLs( seed_weight, &cout );
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -2;
+	}
+
+	RecordingMemHash mh;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	mh.FindMatches( ml );
+	cout << "MemHash found " << ml.size() << " matches in " << seconds( start ) << " seconds\n";
+	size_t insert_count = 0;
+	for( size_t opI = 0; opI < mh.ops.size(); opI++ )
+		insert_count += mh.ops[opI].inserted ? 1 : 0;
+	cout << "Replaying " << mh.ops.size() << " lookups with " << insert_count << " insertions\n";
+
+	start = boost::posix_time::microsec_clock::universal_time();
+	size_t bucket_mismatches = replaySortedBuckets( mh.ops, mh.TableSize() );
+	cout << "sorted buckets:\t" << seconds( start ) << " seconds\t" << bucket_mismatches << " mismatches\n";
+
+	start = boost::posix_time::microsec_clock::universal_time();
+	size_t table_mismatches = replayMatchHashTable( mh.ops );
+	cout << "MatchHashTable:\t" << seconds( start ) << " seconds\t" << table_mismatches << " mismatches\n";
+
+	ml.Clear();
+	return bucket_mismatches == 0 && table_mismatches == 0 ? 0 : 1;
+}
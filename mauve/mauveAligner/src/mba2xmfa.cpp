@@ -0,0 +1,36 @@
+#include "libMems/IntervalList.h"
+#include "libMems/BinaryAlignment.h"
+#include <fstream>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+int main(int argc, char* argv[] ){
+	if(argc != 3){
+		cerr << "Usage: mba2xmfa <binary alignment input> <xmfa output>\n";
+		return -1;
+	}
+	if(!BinaryAlignment::IsBinaryAlignment(argv[1])){
+		cerr << "\"" << argv[1] << "\" is not a binary alignment\n";
+		return -2;
+	}
+	ofstream ofile(argv[2]);
+	if(!ofile.is_open()){
+		cerr << "Error writing to \"" << argv[2] << "\"\n";
+		return -2;
+	}
+
+	IntervalList aln;
+	try{
+		aln.ReadBinaryAlignment(argv[1]);
+		// alignments stored without residues are filled in from the sequence files
+		if( aln.size() > 0 && GetStoredAlignment(aln[0]) == NULL )
+			LoadSequences(aln, &cout);
+		aln.WriteStandardAlignment(ofile);
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/ParallelMemHash.h"
+#include "libMems/MatchList.h"
+#include "libMUSCLE/threadstorage.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Measures how the seed match search in ParallelMemHash scales with the
+ * number of threads.  Matches are first found with the serial MemHash, then
+ * with ParallelMemHash on 1, 2, 4, ... threads, and every parallel MatchList
+ * is checked against the serial one.  Thread-local storage is sized when the
+ * program starts, so set OMP_NUM_THREADS to the largest thread count wanted.
+ */
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+/** copies the length and start coordinates of each match, in list order */
+static void matchCoordinates( const MatchList& ml, vector< int64 >& coords )
+{
+	coords.clear();
+	for( size_t mI = 0; mI < ml.size(); mI++ )
+	{
+		coords.push_back( ml[mI]->Length() );
+		for( uint seqI = 0; seqI < ml[mI]->SeqCount(); seqI++ )
+			coords.push_back( ml[mI]->Start(seqI) );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	int max_threads = TLSThreadCount();
+	uint seed_weight = 0;
+	MatchList ml;
+	for( int argI = 1; argI < argc; argI++ )
+	{
+		string arg = argv[argI];
+		if( arg == "--max-threads" && argI + 1 < argc )
+			max_threads = atoi( argv[++argI] );
+		else if( arg == "--seed-weight" && argI + 1 < argc )
+			seed_weight = atoi( argv[++argI] );
+		else
+			ml.seq_filename.push_back( arg );
+	}
+	if( ml.seq_filename.size() < 2 || max_threads < 1 )
+	{
+		cerr << "Usage: memHashScaling [--max-threads <count>] [--seed-weight <weight>] <sequence file> <sequence file> [sequence file]...\n";
+		return -1;
+	}
+
+	if( max_threads > TLSThreadCount() )
+	{
+		cerr << "Only " << TLSThreadCount() << " threads are available, set OMP_NUM_THREADS to use more\n";
+		max_threads = TLSThreadCount();
+	}
+
+	try{
+		LoadSequences( ml, &cout );
+		ml.CreateMemorySMLs( seed_weight, &cout );
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -2;
+	}
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	MatchList serial_ml = ml;
+	MemHash mh;
+	mh.FindMatches( serial_ml );
+	double serial_time = seconds( start );
+	vector< int64 > serial_coords;
+	matchCoordinates( serial_ml, serial_coords );
+	cout << "MemHash found " << serial_ml.size() << " matches in " << serial_time << " seconds\n";
+
+	cout << "threads\tseconds\tspeedup\tmatches\tsame as MemHash\n";
+	cout << setiosflags( ios::fixed ) << setprecision( 3 );
+	bool all_same = true;
+	for( int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads )
+	{
+#ifdef _OPENMP
+		omp_set_num_threads( threads );
+#endif
+		MatchList parallel_ml = ml;
+		start = boost::posix_time::microsec_clock::universal_time();
+		ParallelMemHash pmh;
+		pmh.FindMatches( parallel_ml );
+		double parallel_time = seconds( start );
+		vector< int64 > parallel_coords;
+		matchCoordinates( parallel_ml, parallel_coords );
+		bool same = parallel_coords == serial_coords;
+		all_same = all_same && same;
+		cout << threads << "\t" << parallel_time << "\t" << serial_time / parallel_time << "\t" << parallel_ml.size() << "\t" << (same ? "yes" : "NO") << endl;
+		parallel_ml.clear();
+		pmh.Clear();
+		if( threads == max_threads )
+			break;
+	}
+	mh.Clear();
+	ml.Clear();
+	return all_same ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/GreedyBreakpointElimination.h"
+#include "libMems/Islands.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libMems/Match.h"
+#include "libMems/CompactGappedAlignment.h"
+#include "libGenome/gnSequence.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks GetPairwiseMatchScore against scoring a materialized alignment column
+ * by column, the way GetPairwiseAnchorScore used to score every match, and
+ * times both.  Matches are drawn at random on either strand of a repeat rich
+ * sequence and a mutated copy of it, half of them ungapped and half with
+ * random indels, and are scored with and without the repeat penalty.
+ * usage: pairwiseScoreBenchmark [match count] [random seed] [sequence length]
+ */
+
+static const char* BASES = "ACGT";
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+/** a random sequence in which short segments are copied many times over */
+static string repetitiveSequence( size_t len )
+{
+	string seq( len, 'A' );
+	for( size_t charI = 0; charI < len; charI++ )
+		seq[charI] = BASES[ rand() % 4 ];
+	for( size_t repI = 0; repI < len / 10; repI++ )
+	{
+		size_t pos = rand() % (len - 5000);
+		seq.replace( pos + 2000, 200, seq.substr( pos, 200 ) );
+	}
+	for( size_t nI = 0; nI < len / 50000; nI++ )
+		seq[ rand() % len ] = 'N';
+	return seq;
+}
+
+/** an ungapped match of random length and strand */
+static AbstractMatch* randomUngappedMatch( gnSeqI seq_len )
+{
+	Match m( 2 );
+	gnSeqI len = 100 + rand() % 2000;
+	int64 start = 1 + rand() % (seq_len - len - 1);
+	m.SetStart( 0, start );
+	m.SetStart( 1, rand() % 2 ? -start : start );
+	m.SetLength( len );
+	return m.Copy();
+}
+
+/** a gapped match of random length and strand, with runs of gap columns in either row */
+static AbstractMatch* randomGappedMatch( gnSeqI seq_len )
+{
+	gnSeqI aln_length = 100 + rand() % 2000;
+	vector< bitset_t > aln_mat( 2, bitset_t( aln_length ) );
+	gnSeqI lengths[2] = { 0, 0 };
+	for( gnSeqI colI = 0; colI < aln_length; )
+	{
+		int r = rand() % 100;
+		gnSeqI run_len = r < 90 ? 1 + rand() % 40 : 1 + rand() % 8;
+		for( ; run_len > 0 && colI < aln_length; run_len--, colI++ )
+		{
+			if( r < 90 || r % 2 == 0 )
+				aln_mat[0].set( colI );
+			if( r < 90 || r % 2 == 1 )
+				aln_mat[1].set( colI );
+		}
+	}
+	lengths[0] = aln_mat[0].count();
+	lengths[1] = aln_mat[1].count();
+	CompactGappedAlignment<> cga( 2, aln_length );
+	for( uint seqI = 0; seqI < 2; seqI++ )
+	{
+		int64 start = 1 + rand() % (seq_len - lengths[seqI] - 1);
+		cga.SetLength( lengths[seqI], seqI );
+		cga.SetStart( seqI, seqI == 1 && rand() % 2 ? -start : start );
+	}
+	cga.SetAlignment( aln_mat );
+	return cga.Copy();
+}
+
+/** scores a match from its materialized alignment, as GetPairwiseAnchorScore did without gap penalties */
+static double columnScore( AbstractMatch* m, vector< gnSequence* >& seq_table, const PairwiseScoringScheme& subst_scoring, SeedOccurrenceList& sol_1, SeedOccurrenceList& sol_2 )
+{
+	vector< score_t > scores( m->AlignmentLength(), 0 );
+	vector< string > et;
+	GetAlignment( *m, seq_table, et );
+	computeMatchScores( et[0], et[1], subst_scoring, scores );
+	size_t merI = 0;
+	size_t merJ = 0;
+	for( size_t colI = 0; colI < m->AlignmentLength(); ++colI )
+	{
+		if( et[0][colI] != '-' && et[1][colI] != '-' )
+		{
+			SeedOccurrenceList::frequency_type uni1 = sol_1.getFrequency( m->LeftEnd(0) + merI - 1 );
+			SeedOccurrenceList::frequency_type uni2 = sol_2.getFrequency( m->LeftEnd(1) + merJ - 1 );
+			SeedOccurrenceList::frequency_type uniprod = uni1*uni2;
+			uniprod = uniprod == 0 ? 1 : uniprod;
+			if( scores[colI] > 0 )
+			{
+				if( penalize_repeats )
+					scores[colI] = (score_t)((double)scores[colI] * (2.0 / uniprod)) - scores[colI];
+				else
+					scores[colI] = (score_t)((SeedOccurrenceList::frequency_type)scores[colI] / uniprod);
+			}
+		}
+		if( et[0][colI] != '-' )
+			merI++;
+		if( et[1][colI] != '-' )
+			merJ++;
+	}
+	double m_score = 0;
+	for( size_t colI = 0; colI < scores.size(); ++colI )
+		if( scores[colI] != INV_SCORE )
+			m_score += scores[colI];
+	return m_score;
+}
+
+int main( int argc, char* argv[] )
+{
+	int match_count = argc > 1 ? atoi( argv[1] ) : 4000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+	size_t seq_len = argc > 3 ? atoi( argv[3] ) : 400000;
+	if( match_count < 1 || seq_len < 10000 )
+	{
+		cerr << "Usage: pairwiseScoreBenchmark [match count] [random seed] [sequence length]\n";
+		cerr << "The sequences must be at least 10000 bp long\n";
+		return -1;
+	}
+
+	string seq_a = repetitiveSequence( seq_len );
+	string seq_b = seq_a;
+	for( size_t charI = 0; charI < seq_len; charI++ )
+		if( rand() % 10 == 0 )
+			seq_b[charI] = BASES[ rand() % 4 ];
+	gnSequence gn_a( seq_a );
+	gnSequence gn_b( seq_b );
+	vector< gnSequence* > seq_table;
+	seq_table.push_back( &gn_a );
+	seq_table.push_back( &gn_b );
+
+	DNAMemorySML sml_a;
+	DNAMemorySML sml_b;
+	sml_a.Create( gn_a, getSeed( 15 ) );
+	sml_b.Create( gn_b, getSeed( 15 ) );
+	SeedOccurrenceList sol_a;
+	SeedOccurrenceList sol_b;
+	sol_a.construct( sml_a );
+	sol_b.construct( sml_b );
+	PairwiseScoringScheme subst_scoring;
+
+	vector< AbstractMatch* > matches;
+	for( int mI = 0; mI < match_count; mI++ )
+		matches.push_back( mI % 2 ? randomGappedMatch( seq_len ) : randomUngappedMatch( seq_len ) );
+
+	int failures = 0;
+	for( int repeatI = 0; repeatI < 2; repeatI++ )
+	{
+		penalize_repeats = repeatI == 1;
+		vector< double > column_scores( matches.size() );
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		for( size_t mI = 0; mI < matches.size(); mI++ )
+			column_scores[mI] = columnScore( matches[mI], seq_table, subst_scoring, sol_a, sol_b );
+		double column_time = seconds( start );
+
+		vector< double > match_scores( matches.size() );
+		vector< bool > scored( matches.size() );
+		start = boost::posix_time::microsec_clock::universal_time();
+		for( size_t mI = 0; mI < matches.size(); mI++ )
+			scored[mI] = GetPairwiseMatchScore( *matches[mI], seq_table, subst_scoring, sol_a, sol_b, match_scores[mI] );
+		double match_time = seconds( start );
+
+		// matches that GetPairwiseMatchScore declines get scored column by column anyway
+		size_t fallbacks = 0;
+		size_t mismatches = 0;
+		for( size_t mI = 0; mI < matches.size(); mI++ )
+		{
+			if( !scored[mI] )
+				fallbacks++;
+			else if( match_scores[mI] != column_scores[mI] )
+				mismatches++;
+		}
+		cout << (penalize_repeats ? "penalizing repeats\n" : "scaling by uniqueness\n");
+		cout << "columns:\t" << column_time << " seconds\n";
+		cout << "GetPairwiseMatchScore:\t" << match_time << " seconds\t" << fallbacks << " fallbacks\t" << mismatches << " mismatches\n";
+		failures += mismatches > 0 ? 1 : 0;
+	}
+
+	for( size_t mI = 0; mI < matches.size(); mI++ )
+		matches[mI]->Free();
+	if( failures > 0 )
+	{
+		cerr << "GetPairwiseMatchScore and the column scores differ\n";
+		return 1;
+	}
+	return 0;
+}
@@ -34,6 +34,7 @@
 #include "UniqueMatchFinder.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "libMems/Memory.h"
 
@@ -281,6 +282,7 @@ int doAlignment( int argc, char* argv[] ){
 	MauveOption opt_debug( mauve_options, "debug", no_argument, "Run in debug mode (perform internal consistency checks--very slow)" );
 	MauveOption opt_scratch_path_1( mauve_options, "scratch-path-1", required_argument, "<path> Designate a path that can be used for temporary data storage.  Two or more paths should be specified." );
 	MauveOption opt_scratch_path_2( mauve_options, "scratch-path-2", required_argument, "<path> Designate a path that can be used for temporary data storage.  Two or more paths should be specified." );
+	MauveOption opt_sml_cache( mauve_options, "sml-cache", required_argument, "<path> Keep sorted mer lists in a directory that can be shared between runs.  Lists are found by sequence content and seed pattern, wherever the sequence files are" );
 	MauveOption opt_collinear( mauve_options, "collinear", no_argument, "Assume that input sequences are collinear--they have no rearrangements" );
 	MauveOption opt_scoring_scheme( mauve_options, "scoring-scheme", required_argument, "<ancestral|sp_ancestral|sp> Selects the anchoring score function.  Default is extant sum-of-pairs (sp)." );
 	MauveOption opt_no_weight_scaling( mauve_options, "no-weight-scaling", no_argument, "Don't scale LCB weights by conservation distance and breakpoint distance" );
@@ -288,6 +290,7 @@ int doAlignment( int argc, char* argv[] ){
 	MauveOption opt_conservation_distance_scale( mauve_options, "conservation-distance-scale", required_argument, "<number [0,1]> Scale conservation distances by this amount.  Defaults to 0.5" );
 	MauveOption opt_muscle_args( mauve_options, "muscle-args", required_argument, "<arguments in quotes> Additional command-line options for MUSCLE.  Any quotes should be escaped with a backslash" );
 	MauveOption opt_skip_refinement( mauve_options, "skip-refinement", no_argument, "Do not perform iterative refinement" );
+	MauveOption opt_parallel_refinement( mauve_options, "parallel-refinement", no_argument, "Refine windows of the gapped alignment concurrently on all available threads" );
 	MauveOption opt_skip_gapped_alignment( mauve_options, "skip-gapped-alignment", no_argument, "Do not perform gapped alignment" );
 	MauveOption opt_bp_dist_estimate_min_score( mauve_options, "bp-dist-estimate-min-score", required_argument, "<number> Minimum LCB score for estimating pairwise breakpoint distance" );
 	MauveOption opt_mem_clean( mauve_options, "mem-clean", no_argument, "Set this to true when debugging memory allocations" );
@@ -303,6 +306,7 @@ int doAlignment( int argc, char* argv[] ){
 	MauveOption opt_seed_family( mauve_options, "seed-family", no_argument, "Use a family of spaced seeds to improve sensitivity" );
 	MauveOption opt_solid_seeds( mauve_options, "solid-seeds", no_argument, "Use solid seeds. Do not permit substitutions in anchor matches." );
 	MauveOption opt_coding_seeds( mauve_options, "coding-seeds", no_argument, "Use coding pattern seeds. Useful to generate matches coding regions with 3rd codon position degeneracy." );
+	MauveOption opt_packed_sequences( mauve_options, "packed-sequences", no_argument, "Keep the input genomes in memory at two bits per base instead of writing temporary raw sequence files" );
 	MauveOption opt_disable_cache( mauve_options, "disable-cache", no_argument, "Disable recursive anchor search cacheing to workaround a crash bug" );
 	MauveOption opt_recursive( mauve_options, "no-recursion", no_argument, "Disable recursive anchor search" );
 
@@ -349,6 +353,8 @@ int doAlignment( int argc, char* argv[] ){
 		FileSML::registerTempPath( opt_scratch_path_1.arg_value.c_str() );
 	if( opt_scratch_path_2.set )
 		FileSML::registerTempPath( opt_scratch_path_2.arg_value.c_str() );
+	if( opt_sml_cache.set )
+		FileSML::registerCachePath( opt_sml_cache.arg_value );
 
 	// set the random number generator to a fixed seed for repeatability
 	// this should be changed if the algorithm ever depends on true pseudo-randomness
@@ -440,8 +446,10 @@ int doAlignment( int argc, char* argv[] ){
 	}else{
 		pairwise_match_list.seq_filename = seq_files;
 		pairwise_match_list.sml_filename = sml_files;
-		// testing: rewrite seq files in RAW format
-		LoadAndCreateRawSequences( pairwise_match_list, &cout );
+		if( opt_packed_sequences.set )
+			LoadPackedSequences( pairwise_match_list, &cout );
+		else	// testing: rewrite seq files in RAW format
+			LoadAndCreateRawSequences( pairwise_match_list, &cout );
 //		LoadSequences( pairwise_match_list, &cout );
 		if(opt_solid_seeds.set)
 			pairwise_match_list.LoadSMLs( mer_size, &cout, SOLID_SEED, true );
@@ -577,6 +585,8 @@ int doAlignment( int argc, char* argv[] ){
 		aligner.setGappedAlignment(false);
 	if( opt_skip_refinement.set )
 		aligner.setRefinement(false);
+	if( opt_parallel_refinement.set )
+		aligner.setParallelRefinement(true);
 	if( opt_debug.set )
 		debug_aligner = true;
 
@@ -719,8 +729,18 @@ int doAlignment( int argc, char* argv[] ){
 		applyBackbone( interval_list, bbcols_fname, bb_seq_fname, island_gap_size, hmm_identity, pgh, pgu );
 	}
 
-	interval_list.WriteStandardAlignment(*match_out);
+	boost::posix_time::ptime write_start = boost::posix_time::microsec_clock::universal_time();
+	uint64 bytes_written = interval_list.WriteStandardAlignment(*match_out);
 	match_out->flush();
+	if( opt_output.set )
+	{
+		double write_seconds = (boost::posix_time::microsec_clock::universal_time() - write_start).total_microseconds() / 1000000.0;
+		double write_mb = bytes_written / (1024.0 * 1024.0);
+		cerr << "Wrote " << write_mb << " MB of alignment";
+		if( write_seconds > 0 )
+			cerr << " at " << write_mb / write_seconds << " MB/s";
+		cerr << endl;
+	}
 
 	for( size_t seqI = 0; seqI < pairwise_match_list.seq_table.size(); seqI++ )
 		delete pairwise_match_list.seq_table[seqI];	// an auto_ptr or shared_ptr could be great for this
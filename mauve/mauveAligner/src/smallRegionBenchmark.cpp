@@ -0,0 +1,204 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/SmallRegionMatchFinder.h"
+#include "libMems/MatchList.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks SmallRegionMatchFinder against a MemHash search over DNAMemorySMLs,
+ * the way anchors used to be found in the gaps between anchors, and times
+ * both.  Each trial draws a random region and a mutated copy of it with
+ * substitutions, an inversion, a tandem duplication and a deletion, or
+ * sometimes an unrelated region, and searches them with one or three seeds.
+ * usage: smallRegionBenchmark [trial count] [random seed] [maximum region length]
+ */
+
+static const char* BASES = "ACGT";
+
+static double seconds( const boost::posix_time::ptime& start )
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+}
+
+static string randomRegion( size_t len )
+{
+	string region( len, 'A' );
+	for( size_t charI = 0; charI < len; charI++ )
+		region[charI] = BASES[ rand() % 4 ];
+	if( len > 10 && rand() % 3 == 0 )
+		for( int nI = 0; nI < 5; nI++ )
+			region[ rand() % len ] = 'N';
+	return region;
+}
+
+static string reverseComplement( const string& s )
+{
+	string rc( s.rbegin(), s.rend() );
+	for( size_t charI = 0; charI < rc.size(); charI++ )
+	{
+		char c = rc[charI];
+		rc[charI] = c == 'A' ? 'T' : c == 'T' ? 'A' : c == 'C' ? 'G' : c == 'G' ? 'C' : c;
+	}
+	return rc;
+}
+
+static string mutateRegion( const string& region )
+{
+	string mutant = region;
+	if( mutant.size() == 0 )
+		return mutant;
+	for( size_t subI = 0; subI < mutant.size() / 30; subI++ )
+		mutant[ rand() % mutant.size() ] = BASES[ rand() % 4 ];
+	if( rand() % 2 && mutant.size() > 100 )
+	{
+		size_t pos = rand() % (mutant.size() - 50);
+		size_t len = rand() % 50;
+		mutant = mutant.substr( 0, pos ) + reverseComplement( mutant.substr( pos, len ) ) + mutant.substr( pos + len );
+	}
+	if( rand() % 2 && mutant.size() > 100 )
+	{
+		size_t pos = rand() % (mutant.size() - 50);
+		size_t len = rand() % 50;
+		mutant = mutant.substr( 0, pos ) + mutant.substr( pos, len ) + mutant.substr( pos );
+	}
+	if( rand() % 2 && mutant.size() > 20 )
+		mutant.erase( rand() % (mutant.size() - 10), rand() % 10 );
+	return mutant;
+}
+
+/** writes the length and start coordinates of each match, in list order */
+static string matchCoordinates( const MatchList& ml )
+{
+	stringstream coords;
+	for( size_t mI = 0; mI < ml.size(); mI++ )
+	{
+		coords << ml[mI]->Length();
+		for( uint seqI = 0; seqI < ml[mI]->SeqCount(); seqI++ )
+			coords << ' ' << ml[mI]->Start(seqI);
+		coords << '\n';
+	}
+	return coords.str();
+}
+
+/** searches the regions with a MemHash over DNAMemorySMLs, once per seed in the family */
+static void memHashSearch( const string& region_a, const string& region_b, uint seed_weight, uint seed_count, MemHash& gap_mh, MatchList& gap_list )
+{
+	gap_list.seq_table.push_back( new gnSequence( region_a ) );
+	gap_list.seq_table.push_back( new gnSequence( region_b ) );
+	gap_list.sml_table.push_back( new DNAMemorySML() );
+	gap_list.sml_table.push_back( new DNAMemorySML() );
+	gap_mh.Clear();
+	for( uint seedI = 0; seedI < seed_count; seedI++ )
+	{
+		uint64 seed = getSeed( seed_weight, seedI );
+		for( uint seqI = 0; seqI < 2; seqI++ )
+		{
+			gap_list.sml_table[seqI]->Clear();
+			gap_list.sml_table[seqI]->Create( *gap_list.seq_table[seqI], seed );
+		}
+		gap_mh.ClearSequences();
+		if( seed_count > 1 )
+		{
+			MatchList cur_list = gap_list;
+			gap_mh.FindMatches( cur_list );
+			for( size_t mI = 0; mI < cur_list.size(); mI++ )
+				cur_list[mI]->Free();
+		}else
+			gap_mh.FindMatches( gap_list );
+	}
+	if( seed_count > 1 )
+		gap_mh.GetMatchList( gap_list );
+}
+
+int main( int argc, char* argv[] )
+{
+	int trial_count = argc > 1 ? atoi( argv[1] ) : 2000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+	size_t max_len = argc > 3 ? atoi( argv[3] ) : 3000;
+	if( trial_count < 1 || max_len < 1 )
+	{
+		cerr << "Usage: smallRegionBenchmark [trial count] [random seed] [maximum region length]\n";
+		return -1;
+	}
+
+	MemHash gap_mh;
+	SmallRegionMatchFinder region_finder;
+	int failures = 0;
+	int searches = 0;
+	size_t match_count = 0;
+	double memhash_time = 0;
+	double region_time = 0;
+	for( int trialI = 0; trialI < trial_count; trialI++ )
+	{
+		string region_a = randomRegion( rand() % max_len );
+		string region_b = rand() % 10 == 0 ? randomRegion( rand() % max_len ) : mutateRegion( region_a );
+		if( rand() % 20 == 0 )
+			region_a = "";
+		uint seed_count = rand() % 2 ? 3 : 1;
+		uint seed_weight = getDefaultSeedWeight( (region_a.size() + region_b.size()) / 2 );
+		if( seed_weight < MIN_DNA_SEED_WEIGHT )
+			continue;
+		searches++;
+
+		// the regions sit inside longer sequences, as gaps between anchors do
+		string prefix_a = randomRegion( 37 );
+		string prefix_b = randomRegion( 11 );
+		gnSequence seq_a( prefix_a + region_a + randomRegion( 5 ) );
+		gnSequence seq_b( prefix_b + region_b );
+
+		MatchList memhash_list;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		memHashSearch( region_a, region_b, seed_weight, seed_count, gap_mh, memhash_list );
+		memhash_time += seconds( start );
+
+		MatchList region_list;
+		start = boost::posix_time::microsec_clock::universal_time();
+		region_finder.Clear();
+		region_finder.SetRegion( 0, seq_a, prefix_a.size() + 1, region_a.size() );
+		region_finder.SetRegion( 1, seq_b, prefix_b.size() + 1, region_b.size() );
+		for( uint seedI = 0; seedI < seed_count; seedI++ )
+			region_finder.FindRegionMatches( getSeed( seed_weight, seedI ) );
+		region_finder.GetMatchList( region_list );
+		region_time += seconds( start );
+
+		match_count += memhash_list.size();
+		if( matchCoordinates( memhash_list ) != matchCoordinates( region_list ) )
+		{
+			cerr << "trial " << trialI << " differs: region lengths " << region_a.size() << " and " << region_b.size();
+			cerr << ", seed weight " << seed_weight << ", " << memhash_list.size() << " vs " << region_list.size() << " matches\n";
+			failures++;
+		}
+		for( size_t mI = 0; mI < memhash_list.size(); mI++ )
+			memhash_list[mI]->Free();
+		for( size_t mI = 0; mI < region_list.size(); mI++ )
+			region_list[mI]->Free();
+		for( uint seqI = 0; seqI < 2; seqI++ )
+		{
+			delete memhash_list.seq_table[seqI];
+			delete memhash_list.sml_table[seqI];
+		}
+	}
+	cout << searches << " region pairs, " << match_count << " matches\n";
+	cout << "MemHash:\t" << memhash_time << " seconds\n";
+	cout << "SmallRegionMatchFinder:\t" << region_time << " seconds\n";
+	if( failures > 0 )
+	{
+		cerr << failures << " region pairs gave different matches\n";
+		return 1;
+	}
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "libMems/IntervalList.h"
 #include "libMems/MatchList.h"
 #include "libMems/GappedAlignment.h"
+#include "libMems/XmfaReader.h"
 #include <fstream>
 #include <string>
 #include <vector>
@@ -23,45 +24,10 @@ int main( int argc, char* argv[] )
 		cerr << "Error opening \"" << argv[1] << "\"\n";
 		return -1;
 	}
+	// strip one block at a time, the residues come from the rows of each block
+	XmfaReader reader( aln_infile );
 	IntervalList iv_list;
-	iv_list.ReadStandardAlignment( aln_infile );
-	LoadSequences( iv_list, &cout );
-	IntervalList iv_outlist;
-	iv_outlist.seq_filename = iv_list.seq_filename;
-	iv_outlist.seq_table = iv_list.seq_table;
-	for( uint ivI = 0; ivI < iv_list.size(); ivI++ )
-	{
-		Interval& cur_iv = iv_list[ivI];
-		vector< string > alignment;
-		GetAlignment( cur_iv, iv_list.seq_table, alignment );
-		vector< string > seq_align = vector< string >( cur_iv.SeqCount() );
-		for( gnSeqI colI = 0; colI < cur_iv.AlignmentLength(); colI++ )
-		{
-			uint seqI = 0;
-			for( ; seqI < cur_iv.SeqCount(); seqI++ )
-			{
-				if( alignment[seqI][colI] == '-' )
-					break;
-			}
-			if( seqI != cur_iv.SeqCount() )
-				continue;
-			for( seqI = 0; seqI < cur_iv.SeqCount(); seqI++ )
-			{
-				seq_align[seqI] += alignment[seqI][colI];
-			}
-		}
-
-		GappedAlignment* new_ga = new GappedAlignment( seq_align.size(), seq_align[0].size() );
-		new_ga->SetAlignment( seq_align );
-		for( uint seqI = 0; seqI < cur_iv.SeqCount(); seqI++ )
-		{
-			new_ga->SetStart( seqI, cur_iv.Start( seqI ) );
-			new_ga->SetLength( cur_iv.Length( seqI ), seqI );
-		}
-		vector< AbstractMatch* > am_list( 1, new_ga );
-		Interval new_iv(am_list.begin(), am_list.end());
-		iv_outlist.push_back( new_iv );
-	}
+	iv_list.seq_filename = reader.seq_filename;
 
 	ofstream iv_outfile( argv[2] );
 	if( !iv_outfile.is_open() )
@@ -69,6 +35,33 @@ int main( int argc, char* argv[] )
 		cerr << "Error opening \"" << argv[2] << "\"\n" << endl;
 		return -2;
 	}
-	iv_outlist.WriteStandardAlignment( iv_outfile );
+	CompactGappedAlignment<> cur_iv;
+	vector< string > alignment;
+	for( size_t ivI = 0; reader.Next( cur_iv, &alignment ); ivI++ )
+	{
+		if( ivI == 0 )
+			iv_list.WriteStandardAlignmentHeader( iv_outfile );
+		// keep the columns without gaps
+		vector< bitset_t > aln_mat;
+		cur_iv.GetAlignment( aln_mat );
+		bitset_t gap_free = aln_mat[0];
+		for( uint seqI = 1; seqI < aln_mat.size(); seqI++ )
+			gap_free &= aln_mat[seqI];
+		vector< string > seq_align( cur_iv.SeqCount(), string( gap_free.count(), '-' ) );
+		size_t new_colI = 0;
+		for( bitset_t::size_type colI = gap_free.find_first(); colI != bitset_t::npos; colI = gap_free.find_next( colI ), new_colI++ )
+			for( uint seqI = 0; seqI < cur_iv.SeqCount(); seqI++ )
+				seq_align[seqI][new_colI] = alignment[seqI][colI];
+
+		GappedAlignment new_ga( seq_align.size(), seq_align[0].size() );
+		new_ga.SetAlignment( seq_align );
+		for( uint seqI = 0; seqI < cur_iv.SeqCount(); seqI++ )
+		{
+			new_ga.SetStart( seqI, cur_iv.Start( seqI ) );
+			new_ga.SetLength( cur_iv.Length( seqI ), seqI );
+		}
+		// without sequences loaded the block is written from the stripped rows
+		iv_list.WriteStandardAlignmentBlock( iv_outfile, new_ga, ivI == 0 );
+	}
 	return 0;
 }
@@ -0,0 +1,195 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/ProgressiveAligner.h"
+#include "libMems/PairwiseMatchFinder.h"
+#include "libMems/Backbone.h"
+#include "libMems/HomologyHMM/parameters.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that backbone detection gives the same backbone, backbone
+ * coordinates and unaligned islands on one thread as on several, where
+ * the homology of each pair of genomes is predicted concurrently and the
+ * predictions are merged afterwards.  The alignment is made once and each
+ * run detects backbone in its own copy.  The genomes evolve from a random
+ * ancestor with substitutions, indels, an inversion, and genome specific
+ * islands and deletions, so there are homologous segments to merge and
+ * islands to unalign.
+ * usage: testBackbone [thread count]
+ */
+
+static const uint SEQ_COUNT = 5;
+static const size_t ANCESTOR_LENGTH = 30000;
+
+static char randomBase()
+{
+	return "ACGT"[ rand() % 4 ];
+}
+
+/** copies a sequence with about one change per 40 sites */
+static string mutate( const string& parent )
+{
+	string child;
+	for( size_t baseI = 0; baseI < parent.size(); baseI++ )
+	{
+		int r = rand() % 200;
+		if( r < 4 )
+			child += randomBase();
+		else if( r == 4 )
+			baseI += rand() % 6;	// deletion
+		else if( r == 5 )
+		{
+			child += parent[baseI];
+			for( int insI = rand() % 6; insI >= 0; insI-- )
+				child += randomBase();
+		}else
+			child += parent[baseI];
+	}
+	return child;
+}
+
+static string reverseComplement( const string& seq )
+{
+	string rc( seq.rbegin(), seq.rend() );
+	for( size_t baseI = 0; baseI < rc.size(); baseI++ )
+		rc[baseI] = rc[baseI] == 'A' ? 'T' : rc[baseI] == 'C' ? 'G' : rc[baseI] == 'G' ? 'C' : 'A';
+	return rc;
+}
+
+/** evolves genomes along (((seq1,seq2),seq3),(seq4,seq5)) */
+static void makeGenomes( vector< string >& genomes )
+{
+	string ancestor;
+	for( size_t baseI = 0; baseI < ANCESTOR_LENGTH; baseI++ )
+		ancestor += randomBase();
+
+	string left = mutate( ancestor );
+	string right = mutate( ancestor );
+	size_t inv_start = right.size() / 3;
+	size_t inv_len = right.size() / 5;
+	right.replace( inv_start, inv_len, reverseComplement( right.substr( inv_start, inv_len ) ) );
+	string left_pair = mutate( left );
+
+	genomes.push_back( mutate( left_pair ) );
+	genomes.push_back( mutate( left_pair ) );
+	genomes.push_back( mutate( left ) );
+	genomes.push_back( mutate( right ) );
+	genomes.push_back( mutate( right ) );
+
+	for( int islandI = 0; islandI < 10; islandI++ )
+	{
+		string island;
+		for( size_t baseI = 300 + rand() % 1500; baseI > 0; baseI-- )
+			island += randomBase();
+		string& gainer = genomes[ rand() % SEQ_COUNT ];
+		gainer.insert( rand() % gainer.size(), island );
+		string& loser = genomes[ rand() % SEQ_COUNT ];
+		loser.erase( rand() % (loser.size() - 2000), 300 + rand() % 1500 );
+	}
+}
+
+/** aligns the genomes on one thread */
+static void align( const vector< string >& genomes, MatchList& pairwise_match_list, IntervalList& interval_list )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( 1 );
+#endif
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		pairwise_match_list.seq_table.push_back( new gnSequence( genomes[seqI] ) );
+		stringstream name;
+		name << "seq" << seqI + 1;
+		pairwise_match_list.seq_filename.push_back( name.str() );
+	}
+	pairwise_match_list.CreateMemorySMLs( getDefaultSeedWeight( ANCESTOR_LENGTH ), NULL );
+	PairwiseMatchFinder pmf;
+	pmf.FindMatches( pairwise_match_list );
+	pmf.Clear();
+
+	ProgressiveAligner aligner( SEQ_COUNT );
+	aligner.setLcbScoringScheme( ProgressiveAligner::ExtantSumOfPairsScoring );
+	aligner.SetRecursive( true );
+	aligner.setPairwiseScoringScheme( PairwiseScoringScheme() );
+	aligner.setPairwiseMatches( pairwise_match_list );
+
+	interval_list.seq_table = pairwise_match_list.seq_table;
+	interval_list.seq_filename = pairwise_match_list.seq_filename;
+	aligner.align( interval_list.seq_table, interval_list );
+}
+
+/** detects backbone in a copy of the alignment with the given number of threads and returns everything written about it */
+static string backbone( const IntervalList& aligned, int threads, size_t& bb_count )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	IntervalList interval_list( aligned );
+	Params hmm_params = getAdaptedHoxdMatrixParameters( computeGC( interval_list.seq_table ) );
+	backbone_list_t bb_list;
+	detectAndApplyBackbone( interval_list, bb_list, hmm_params );
+	bb_count = 0;
+	for( size_t ivI = 0; ivI < bb_list.size(); ivI++ )
+		bb_count += bb_list[ivI].size();
+
+	stringstream result;
+	interval_list.WriteStandardAlignment( result );
+	writeBackboneColumns( result, bb_list );
+	writeBackboneSeqCoordinates( bb_list, interval_list, result );
+	for( size_t ivI = 0; ivI < bb_list.size(); ivI++ )
+		for( size_t bbI = 0; bbI < bb_list[ivI].size(); bbI++ )
+			bb_list[ivI][bbI]->Free();
+	return result.str();
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+	srand( 2 );
+	vector< string > genomes;
+	makeGenomes( genomes );
+
+	MatchList pairwise_match_list;
+	IntervalList aligned;
+	align( genomes, pairwise_match_list, aligned );
+
+	int failures = 0;
+	size_t bb_count = 0;
+	string serial = backbone( aligned, 1, bb_count );
+	cout << aligned.size() << " LCBs, " << bb_count << " backbone segments" << endl;
+	if( bb_count == 0 )
+	{
+		cerr << "no backbone was found\n";
+		failures++;
+	}
+	for( int runI = 0; runI < 2; runI++ )
+	{
+		size_t parallel_count = 0;
+		if( backbone( aligned, threads, parallel_count ) != serial )
+		{
+			cerr << "backbone with " << threads << " threads differs from backbone with 1 thread on run " << runI << endl;
+			failures++;
+		}
+	}
+
+	for( size_t seqI = 0; seqI < pairwise_match_list.sml_table.size(); seqI++ )
+		delete pairwise_match_list.sml_table[seqI];
+	for( size_t seqI = 0; seqI < pairwise_match_list.seq_table.size(); seqI++ )
+		delete pairwise_match_list.seq_table[seqI];
+	if( failures == 0 )
+		cout << "backbone is the same with 1 and " << threads << " threads\n";
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/IntervalList.h"
+#include "libMems/BinaryAlignment.h"
+#include "libMems/GappedAlignment.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that alignments written with WriteBinaryAlignment read back with
+ * ReadBinaryAlignment exactly as written, and write out again byte for byte.
+ * The blocks mix lowercase and IUPAC residues, reverse strand genomes and
+ * rows of genomes that are absent from a block.  Truncated and corrupted
+ * files must throw InvalidFileFormat without changing the list they were
+ * read into, and a region whose residues can not be read must throw from
+ * WriteBinaryAlignment and WriteStandardAlignment instead of ending the
+ * program.
+ * usage: testBinaryAlignment
+ */
+
+static const uint SEQ_COUNT = 3;
+static const char* RESIDUES = "ACGTACGTACGTacgtNnRYKMSWrykmswBDHV";
+
+/** a block of random rows with runs of gaps, sometimes without one of the genomes */
+static Interval randomBlock()
+{
+	const size_t aln_length = 1 + rand() % 700;
+	vector< string > rows( SEQ_COUNT, string( aln_length, '-' ) );
+	GappedAlignment* ga = new GappedAlignment( SEQ_COUNT, aln_length );
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		gnSeqI length = 0;
+		if( rand() % 6 != 0 )
+		{
+			for( size_t colI = 0; colI < aln_length; )
+			{
+				size_t run_len = 1 + rand() % 40;
+				bool gap = rand() % 3 == 0;
+				for( ; run_len > 0 && colI < aln_length; run_len--, colI++ )
+				{
+					if( gap )
+						continue;
+					rows[seqI][colI] = RESIDUES[ rand() % strlen( RESIDUES ) ];
+					length++;
+				}
+			}
+		}
+		int64 start = length == 0 ? 0 : 1 + rand() % 1000000;
+		ga->SetLength( length, seqI );
+		ga->SetStart( seqI, rand() % 2 ? -start : start );
+	}
+	ga->SetAlignment( rows );
+	vector< AbstractMatch* > matches( 1, ga );
+	Interval iv;
+	iv.SetMatches( matches );
+	return iv;
+}
+
+static string readFile( const string& fname )
+{
+	ifstream in_file( fname.c_str(), ios::binary );
+	stringstream contents;
+	contents << in_file.rdbuf();
+	return contents.str();
+}
+
+static void writeFile( const string& fname, const string& contents )
+{
+	ofstream out_file( fname.c_str(), ios::binary );
+	out_file.write( contents.data(), contents.size() );
+}
+
+/** @return the number of blocks of read that differ from the blocks of written */
+static size_t compareBlocks( const IntervalList& written, const IntervalList& read )
+{
+	size_t mismatches = written.size() > read.size() ? written.size() - read.size() : read.size() - written.size();
+	for( size_t ivI = 0; ivI < written.size() && ivI < read.size(); ivI++ )
+	{
+		const vector< string >* written_rows = GetStoredAlignment( written[ivI] );
+		const vector< string >* read_rows = GetStoredAlignment( read[ivI] );
+		bool same = written_rows != NULL && read_rows != NULL && *written_rows == *read_rows;
+		for( uint seqI = 0; same && seqI < SEQ_COUNT; seqI++ )
+			same = written[ivI].Start( seqI ) == read[ivI].Start( seqI ) &&
+				(written[ivI].Start( seqI ) == NO_MATCH || written[ivI].Length( seqI ) == read[ivI].Length( seqI ));
+		if( !same )
+			mismatches++;
+	}
+	return mismatches;
+}
+
+/**
+ * @return true if reading contents as a binary alignment throws InvalidFileFormat
+ * and leaves the list it was read into as it was
+ */
+static bool rejects( const string& fname, const string& contents )
+{
+	writeFile( fname, contents );
+	IntervalList iv_list;
+	iv_list.seq_filename.push_back( "earlier.fas" );
+	iv_list.push_back( randomBlock() );
+	try{
+		iv_list.ReadBinaryAlignment( fname );
+	}catch( gnException& gne ){
+		// exception codes are created separately in each translation unit, so compare names
+		return gne.GetCode().GetName() == "InvalidFileFormat" &&
+			iv_list.size() == 1 && iv_list.seq_filename == vector< string >( 1, "earlier.fas" );
+	}
+	return false;
+}
+
+/** @return the offset of the first block, as recorded in the block offset table */
+static uint64 firstBlockOffset( const string& contents )
+{
+	BinaryAlignment::FileTrailer trailer;
+	memcpy( &trailer, contents.data() + contents.size() - sizeof(trailer), sizeof(trailer) );
+	uint64 offset;
+	memcpy( &offset, contents.data() + trailer.table_offset, sizeof(offset) );
+	return offset;
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 5 );
+	int failures = 0;
+	const string fname = "testBinaryAlignment.mba";
+	const string copy_fname = "testBinaryAlignment.copy.mba";
+
+	IntervalList written;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		stringstream name;
+		name << "genome" << seqI + 1 << ".fas";
+		written.seq_filename.push_back( name.str() );
+	}
+	written.backbone_filename = "genomes.backbone";
+	for( int blockI = 0; blockI < 400; blockI++ )
+		written.push_back( randomBlock() );
+	// a block without residues in any genome
+	{
+		GappedAlignment* ga = new GappedAlignment( SEQ_COUNT, 0 );
+		ga->SetAlignment( vector< string >( SEQ_COUNT ) );
+		vector< AbstractMatch* > matches( 1, ga );
+		written.push_back( Interval() );
+		written.back().SetMatches( matches );
+	}
+	{
+		ofstream out_file( fname.c_str(), ios::binary );
+		written.WriteBinaryAlignment( out_file, true );
+	}
+
+	IntervalList read;
+	read.ReadBinaryAlignment( fname );
+	size_t mismatches = compareBlocks( written, read );
+	bool same_names = read.seq_filename == written.seq_filename && read.backbone_filename == written.backbone_filename;
+	cout << "round trip: " << written.size() << " blocks, " << mismatches << " mismatches" << (same_names ? "" : ", file names differ") << endl;
+	failures += mismatches > 0 || !same_names ? 1 : 0;
+
+	{
+		ofstream out_file( copy_fname.c_str(), ios::binary );
+		read.WriteBinaryAlignment( out_file, true );
+	}
+	const string contents = readFile( fname );
+	bool identical = contents == readFile( copy_fname );
+	cout << "rewritten file: " << (identical ? "identical" : "differs") << endl;
+	failures += identical ? 0 : 1;
+
+	// truncated files
+	const size_t cuts[] = { 0, 10, contents.size() / 2, contents.size() - 1 };
+	for( size_t cutI = 0; cutI < sizeof(cuts) / sizeof(cuts[0]); cutI++ )
+	{
+		if( !rejects( copy_fname, contents.substr( 0, cuts[cutI] ) ) )
+		{
+			cerr << "a file cut to " << cuts[cutI] << " bytes was accepted\n";
+			failures++;
+		}
+	}
+
+	// corrupted files
+	string bad_magic = contents;
+	bad_magic[ bad_magic.size() - 1 ] ^= 0x20;
+	string bad_table = contents;
+	BinaryAlignment::FileTrailer trailer;
+	memcpy( &trailer, contents.data() + contents.size() - sizeof(trailer), sizeof(trailer) );
+	uint64 past_end = contents.size();
+	memcpy( &bad_table[ trailer.table_offset + sizeof(uint64) ], &past_end, sizeof(past_end) );
+	string bad_seq_count = contents;
+	uint64 seq_count_offset = firstBlockOffset( contents );
+	while( bad_seq_count[ seq_count_offset ] & 0x80 )
+		seq_count_offset++;	// skip the alignment length
+	seq_count_offset++;
+	bad_seq_count[ seq_count_offset ] = SEQ_COUNT + 1;
+	if( !rejects( copy_fname, bad_magic ) )
+	{
+		cerr << "a file with a corrupt trailer was accepted\n";
+		failures++;
+	}
+	if( !rejects( copy_fname, bad_table ) )
+	{
+		cerr << "a file with a corrupt block offset was accepted\n";
+		failures++;
+	}
+	if( !rejects( copy_fname, bad_seq_count ) )
+	{
+		cerr << "a file with a corrupt block was accepted\n";
+		failures++;
+	}
+
+	// sequences too short for the blocks make GetAlignment throw while the blocks are encoded
+	IntervalList unreadable = written;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		unreadable.seq_table.push_back( new gnSequence( "ACGT" ) );
+	bool thrown = false;
+	try{
+		stringstream out_stream;
+		unreadable.WriteBinaryAlignment( out_stream, true );
+	}catch( gnException& gne ){
+		thrown = true;
+	}
+	cout << "unreadable residues: " << (thrown ? "exception" : "no error") << endl;
+	failures += thrown ? 0 : 1;
+	// the same while the XMFA blocks are rendered
+	thrown = false;
+	try{
+		stringstream out_stream;
+		unreadable.WriteStandardAlignment( out_stream );
+	}catch( gnException& gne ){
+		thrown = true;
+	}
+	cout << "unreadable XMFA residues: " << (thrown ? "exception" : "no error") << endl;
+	failures += thrown ? 0 : 1;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		delete unreadable.seq_table[seqI];
+
+	remove( fname.c_str() );
+	remove( copy_fname.c_str() );
+	return failures == 0 ? 0 : 1;
+}
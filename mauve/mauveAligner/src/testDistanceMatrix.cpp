@@ -0,0 +1,193 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// Matrix.h uses memcpy without including its header
+#include <cstring>
+#include "libMems/NumericMatrix.h"
+#include "libMems/DistanceMatrix.h"
+#include "libMems/GappedAlignment.h"
+#include "libGenome/gnSequence.h"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that SingleCopyDistanceMatrix gives the same genome conservation
+ * distances as the per genome pair bit vectors it used to build.  The
+ * alignments have runs of gaps, reverse strand rows, rows without one of the
+ * genomes, and overlap each other in every genome so that positions aligned by
+ * several blocks are only counted once.  A set of many short alignments that
+ * keep switching between a few column patterns checks that blocks sharing a
+ * pattern are still counted against the right genomes.
+ * usage: testDistanceMatrix
+ */
+
+static const uint SEQ_COUNT = 5;
+
+/** the distance computation from before coverage runs, kept to check against */
+static void bitsetDistanceMatrix( vector< GappedAlignment* >& iv_list, vector< gnSequence* >& seq_table, NumericMatrix<double>& distance )
+{
+	uint seq_count = seq_table.size();
+	distance = NumericMatrix<double>( seq_count, seq_count );
+	distance.init( 0 );
+	std::vector< std::pair< bitset_t, bitset_t > > tmp_comp( seq_count );
+	std::vector< std::vector< std::pair< bitset_t, bitset_t > > > pair_comp( seq_count, tmp_comp );
+	for( uint seqI = 0; seqI < seq_count; ++seqI )
+	{
+		for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+		{
+			pair_comp[seqI][seqJ].first.resize( seq_table[seqI]->length(), false );
+			pair_comp[seqI][seqJ].second.resize( seq_table[seqJ]->length(), false );
+		}
+	}
+	for( size_t ivI = 0; ivI < iv_list.size(); ++ivI )
+	{
+		std::vector< bitset_t > aln_table;
+		iv_list[ivI]->GetAlignment(aln_table);
+		for( uint seqI = 0; seqI < seq_count; ++seqI )
+		{
+			for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+			{
+				gnSeqI seqI_pos = iv_list[ivI]->LeftEnd(seqI);
+				gnSeqI seqJ_pos = iv_list[ivI]->LeftEnd(seqJ);
+				AbstractMatch::orientation o_i = iv_list[ivI]->Orientation(seqI);
+				AbstractMatch::orientation o_j = iv_list[ivI]->Orientation(seqJ);
+				if( o_i == AbstractMatch::reverse )
+					seqI_pos = iv_list[ivI]->RightEnd(seqI);
+				if( o_j == AbstractMatch::reverse )
+					seqJ_pos = iv_list[ivI]->RightEnd(seqJ);
+				if( seqI_pos == NO_MATCH || seqJ_pos == NO_MATCH )
+					continue;
+				for( size_t colI = 0; colI < aln_table[seqI].size(); ++colI )
+				{
+					if( aln_table[seqI].test(colI) && aln_table[seqJ].test(colI) )
+					{
+						pair_comp[seqI][seqJ].first.set(seqI_pos-1,true);
+						pair_comp[seqI][seqJ].second.set(seqJ_pos-1,true);
+					}
+					if( aln_table[seqI].test(colI) )
+					{
+						if( o_i == AbstractMatch::forward )
+							seqI_pos++;
+						else
+							seqI_pos--;
+					}
+					if( aln_table[seqJ].test(colI) )
+					{
+						if( o_j == AbstractMatch::forward )
+							seqJ_pos++;
+						else
+							seqJ_pos--;
+					}
+				}
+			}
+		}
+	}
+	for( uint seqI = 0; seqI < seq_count; ++seqI )
+	{
+		distance(seqI,seqI) = 1;
+		for( uint seqJ = seqI+1; seqJ < seq_count; ++seqJ )
+		{
+			double pI = ((double)pair_comp[seqI][seqJ].first.count())/((double)pair_comp[seqI][seqJ].first.size());
+			double pJ = ((double)pair_comp[seqI][seqJ].second.count())/((double)pair_comp[seqI][seqJ].second.size());
+			distance(seqI,seqJ) = (pI + pJ) / 2.0;
+			distance(seqJ,seqI) = (pI + pJ) / 2.0;
+		}
+	}
+	TransformDistanceIdentity(distance);
+}
+
+/**
+ * an alignment of random rows placed at random in each genome
+ * @param max_run	the longest run of gaps or residues in a row
+ * @param gap_odds	one in gap_odds runs are gaps
+ */
+static GappedAlignment* randomAlignment( const vector< gnSequence* >& seq_table, size_t aln_length, size_t max_run, int gap_odds )
+{
+	vector< string > rows( SEQ_COUNT, string( aln_length, '-' ) );
+	GappedAlignment* ga = new GappedAlignment( SEQ_COUNT, aln_length );
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		gnSeqI length = 0;
+		if( rand() % 5 != 0 )
+		{
+			for( size_t colI = 0; colI < aln_length; )
+			{
+				size_t run_len = 1 + rand() % max_run;
+				bool gap = rand() % gap_odds == 0;
+				for( ; run_len > 0 && colI < aln_length; run_len--, colI++ )
+				{
+					if( gap )
+						continue;
+					rows[seqI][colI] = "ACGT"[ rand() % 4 ];
+					length++;
+				}
+			}
+		}
+		int64 start = length == 0 ? 0 : 1 + rand() % ( seq_table[seqI]->length() - length + 1 );
+		ga->SetLength( length, seqI );
+		ga->SetStart( seqI, rand() % 2 ? -start : start );
+	}
+	ga->SetAlignment( rows );
+	return ga;
+}
+
+/** @return the number of entries in which the two matrices differ */
+static uint compareDistances( const vector< GappedAlignment* >& iv_list, vector< gnSequence* >& seq_table, const char* name )
+{
+	vector< GappedAlignment* > ivs( iv_list );
+	NumericMatrix< double > expected;
+	bitsetDistanceMatrix( ivs, seq_table, expected );
+	NumericMatrix< double > distance;
+	SingleCopyDistanceMatrix( ivs, seq_table, distance );
+	uint mismatches = 0;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		for( uint seqJ = 0; seqJ < SEQ_COUNT; seqJ++ )
+		{
+			if( distance(seqI,seqJ) == expected(seqI,seqJ) )
+				continue;
+			cerr << name << ": distance " << seqI << "," << seqJ << " is " << distance(seqI,seqJ) << ", expected " << expected(seqI,seqJ) << endl;
+			mismatches++;
+		}
+	}
+	cout << name << ": " << iv_list.size() << " alignments, " << mismatches << " mismatches" << endl;
+	return mismatches;
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 7 );
+	vector< gnSequence* > seq_table( SEQ_COUNT );
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		seq_table[seqI] = new gnSequence( string( 20000 + seqI * 3000, 'A' ) );
+
+	uint failures = 0;
+
+	vector< GappedAlignment* > long_blocks;
+	for( uint ivI = 0; ivI < 60; ivI++ )
+		long_blocks.push_back( randomAlignment( seq_table, 1 + rand() % 3000, 40, 3 ) );
+	failures += compareDistances( long_blocks, seq_table, "overlapping alignments" );
+
+	vector< GappedAlignment* > short_blocks;
+	for( uint ivI = 0; ivI < 300; ivI++ )
+		short_blocks.push_back( randomAlignment( seq_table, 1 + rand() % 400, 3, 2 ) );
+	failures += compareDistances( short_blocks, seq_table, "short pattern blocks" );
+
+	vector< GappedAlignment* > none;
+	failures += compareDistances( none, seq_table, "no alignments" );
+
+	for( size_t ivI = 0; ivI < long_blocks.size(); ivI++ )
+		delete long_blocks[ivI];
+	for( size_t ivI = 0; ivI < short_blocks.size(); ivI++ )
+		delete short_blocks[ivI];
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		delete seq_table[seqI];
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/DNAFileSML.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include "boost/filesystem/operations.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that the external dmSML sorter builds several sorted mer lists at once
+ * correctly.  Each list is built concurrently with a small memory budget and
+ * must hold the same mers and positions as a DNAMemorySML of its sequence, in
+ * mer order.
+ * usage: testDmSML [thread count]
+ */
+
+static const int SEQ_COUNT = 4;
+
+static string smlName( int seqI )
+{
+	stringstream name;
+	name << "testDmSML." << seqI << ".sslist";
+	return name.str();
+}
+
+/** @return the mer and position of each entry, sorted, or an empty list if the mers are out of order */
+static vector< pair< uint64, gnSeqI > > sortedEntries( SortedMerList& sml )
+{
+	vector< bmer > mers;
+	sml.Read( mers, sml.SMLLength(), 0 );
+	uint64 mer_mask = sml.GetMerMask();
+	vector< pair< uint64, gnSeqI > > entries( mers.size() );
+	for( size_t merI = 0; merI < mers.size(); merI++ )
+	{
+		entries[merI] = make_pair( mers[merI].mer & mer_mask, mers[merI].position );
+		if( merI > 0 && entries[merI].first < entries[merI - 1].first )
+			return vector< pair< uint64, gnSeqI > >();
+	}
+	sort( entries.begin(), entries.end() );
+	return entries;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	srand( 29 );
+	FileSML::registerTempPath( "." );
+	uint64 seed = getSeed( 15 );
+
+	vector< gnSequence* > seqs( SEQ_COUNT );
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		string seq;
+		for( size_t baseI = 100000 + rand() % 200000; baseI > 0; baseI-- )
+			seq += "ACGT"[ rand() % 4 ];
+		seqs[seqI] = new gnSequence( seq );
+	}
+
+	vector< DNAFileSML* > file_smls( SEQ_COUNT );
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		file_smls[seqI] = new DNAFileSML( smlName( seqI ) );
+#pragma omp parallel for schedule(dynamic)
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		file_smls[seqI]->dmCreate( *seqs[seqI], seed, 1 );
+
+	int failures = 0;
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		DNAMemorySML memory_sml;
+		memory_sml.Create( *seqs[seqI], seed );
+		vector< pair< uint64, gnSeqI > > expected = sortedEntries( memory_sml );
+		vector< pair< uint64, gnSeqI > > found = sortedEntries( *file_smls[seqI] );
+		cout << "sequence " << seqI << ": " << found.size() << " of " << expected.size() << " mers\n";
+		if( expected.empty() || found != expected )
+			failures++;
+		memory_sml.Clear();
+		file_smls[seqI]->Clear();
+		delete file_smls[seqI];
+		delete seqs[seqI];
+		boost::filesystem::remove( smlName( seqI ) );
+		boost::filesystem::remove( smlName( seqI ) + ".coords" );
+	}
+	if( failures > 0 )
+	{
+		cerr << "dmSML sorted mer lists differ from in-memory ones\n";
+		return 1;
+	}
+	return 0;
+}
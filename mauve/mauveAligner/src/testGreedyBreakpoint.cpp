@@ -0,0 +1,164 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/GreedyBreakpointElimination.h"
+#include "libMems/Match.h"
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that greedy breakpoint elimination removes the same LCBs and reaches
+ * the same score whether each removal is applied to the pairwise alignments
+ * one at a time or concurrently.  The matches are blocks shared by several
+ * genomes that each went through their own inversions, with short blocks
+ * scattered at random so that there are breakpoints worth removing.  The
+ * parallel run applies every removal in parallel, however few pairs it touches.
+ * usage: testGreedyBreakpoint [thread count]
+ */
+
+static const uint GENOME_COUNT = 6;
+static const uint GROUP_ONE_COUNT = 3;
+static const size_t BLOCK_COUNT = 600;
+
+/** matches over genomes in which blocks were inverted and short blocks were moved at random */
+static void makeMatches( uint genome_count, size_t block_count, vector< AbstractMatch* >& matches )
+{
+	vector< gnSeqI > lengths( block_count );
+	for( size_t blockI = 0; blockI < block_count; blockI++ )
+		lengths[blockI] = rand() % 10 == 0 ? 10 + rand() % 30 : 100 + rand() % 1000;
+
+	vector< Match > blocks( block_count, Match( genome_count ) );
+	for( uint genomeI = 0; genomeI < genome_count; genomeI++ )
+	{
+		vector< size_t > order( block_count );
+		vector< bool > reverse( block_count, false );
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+			order[blockI] = blockI;
+		for( size_t invI = block_count / 40; invI > 0; invI-- )
+		{
+			size_t first = rand() % block_count;
+			size_t last = (std::min)( block_count, first + 1 + rand() % 20 );
+			std::reverse( order.begin() + first, order.begin() + last );
+			for( size_t blockI = first; blockI < last; blockI++ )
+				reverse[ order[blockI] ] = !reverse[ order[blockI] ];
+		}
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+			if( lengths[ order[blockI] ] < 100 )
+				std::swap( order[blockI], order[ rand() % block_count ] );
+
+		int64 pos = 1;
+		for( size_t blockI = 0; blockI < block_count; blockI++ )
+		{
+			size_t block = order[blockI];
+			pos += rand() % 50;
+			if( rand() % 20 != 0 )
+				blocks[block].SetStart( genomeI, reverse[block] ? -pos : pos );
+			pos += lengths[block];
+		}
+	}
+	for( size_t blockI = 0; blockI < block_count; blockI++ )
+	{
+		blocks[blockI].SetLength( lengths[blockI] );
+		matches.push_back( blocks[blockI].Copy() );
+	}
+}
+
+/**
+ * runs greedy breakpoint elimination on the matches between the first
+ * group_one_count genomes and the rest, returns the final score and the
+ * ids of the matches that were kept
+ */
+static double eliminate( vector< AbstractMatch* >& matches, uint group_one_count, size_t pair_min, vector< size_t >& kept )
+{
+	const uint genome_count = matches[0]->SeqCount();
+	vector< node_id_t > n1_des;
+	vector< node_id_t > n2_des;
+	for( uint genomeI = 0; genomeI < genome_count; genomeI++ )
+		(genomeI < group_one_count ? n1_des : n2_des).push_back( genomeI );
+
+	vector< TrackingMatch > tracking_matches( matches.size() );
+	boost::multi_array< double, 3 > tm_score_array( boost::extents[matches.size()][n1_des.size()][n2_des.size()] );
+	for( size_t mI = 0; mI < matches.size(); mI++ )
+	{
+		tracking_matches[mI].original_match = matches[mI];
+		tracking_matches[mI].node_match = matches[mI];
+		tracking_matches[mI].match_id = mI;
+		for( size_t i = 0; i < n1_des.size(); i++ )
+			for( size_t j = 0; j < n2_des.size(); j++ )
+				tm_score_array[mI][i][j] = matches[mI]->LeftEnd( n1_des[i] ) == NO_MATCH || matches[mI]->LeftEnd( n2_des[j] ) == NO_MATCH ? 0 : matches[mI]->Length( n1_des[i] );
+	}
+	boost::multi_array< size_t, 3 > tm_lcb_id_array;
+	initTrackingMatchLCBTracking( tracking_matches, n1_des.size(), n2_des.size(), tm_lcb_id_array );
+
+	vector< TrackingMatch* > t_matches( tracking_matches.size() );
+	for( size_t mI = 0; mI < tracking_matches.size(); mI++ )
+		t_matches[mI] = &tracking_matches[mI];
+	PairwiseLCBMatrix pairwise_adj_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	for( uint i = 0; i < n1_des.size(); i++ )
+		for( uint j = 0; j < n2_des.size(); j++ )
+			getPairwiseLCBs( n1_des[i], n2_des[j], i, j, t_matches, pairwise_adj_mat[i][j], tm_score_array, tm_lcb_id_array );
+	sort( t_matches.begin(), t_matches.end() );
+
+	boost::multi_array< double, 2 > bp_dist_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	boost::multi_array< double, 2 > cons_dist_mat( boost::extents[n1_des.size()][n2_des.size()] );
+	EvenFasterSumOfPairsBreakpointScorer spbs( 500, 100, bp_dist_mat, cons_dist_mat,
+		t_matches, pairwise_adj_mat, n1_des, n2_des,
+		tm_score_array, tm_lcb_id_array, 0, n1_des.size(), 0, n2_des.size() );
+	spbs.setStatusOut( NULL );
+	spbs.setRemovalParallelPairMin( pair_min );
+	double score = greedySearch( spbs, NULL );
+
+	vector< TrackingMatch* > final = spbs.getResults();
+	kept.clear();
+	for( size_t mI = 0; mI < final.size(); mI++ )
+		kept.push_back( final[mI]->match_id );
+	sort( kept.begin(), kept.end() );
+	return score;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+	srand( 17 );
+	vector< AbstractMatch* > matches;
+	makeMatches( GENOME_COUNT, BLOCK_COUNT, matches );
+
+#ifdef _OPENMP
+	omp_set_num_threads( 1 );
+#endif
+	vector< size_t > serial_kept;
+	double serial_score = eliminate( matches, GROUP_ONE_COUNT, (size_t)-1, serial_kept );
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	vector< size_t > parallel_kept;
+	double parallel_score = eliminate( matches, GROUP_ONE_COUNT, 1, parallel_kept );
+
+	cout << "serial: kept " << serial_kept.size() << " of " << matches.size() << " matches, score " << serial_score << endl;
+	cout << "parallel: kept " << parallel_kept.size() << " of " << matches.size() << " matches, score " << parallel_score << endl;
+	int failures = 0;
+	if( serial_kept.size() == matches.size() )
+	{
+		cerr << "nothing was removed\n";
+		failures++;
+	}
+	if( parallel_kept != serial_kept || parallel_score != serial_score )
+	{
+		cerr << "parallel removals differ from serial removals\n";
+		failures++;
+	}
+	for( size_t mI = 0; mI < matches.size(); mI++ )
+		matches[mI]->Free();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/Islands.h"
+#include "libMems/IntervalList.h"
+#include "libMems/HomologyHMM/parameters.h"
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that the specialized forward-backward kernel in run(), one sequence
+ * at a time and in batches, predicts the same homologous sites as the HMMoC
+ * generated runGeneric().  Site patterns come from random runs of homologous
+ * and unrelated columns, from simulated pairwise alignments, and from every
+ * pair of rows of the XMFA alignments named on the command line.
+ * usage: testHomologyHMM [XMFA file]...
+ */
+
+static const char* BASES = "ACGT";
+
+/** site patterns in alternating runs of homologous and unrelated columns */
+static string randomSites()
+{
+	size_t len = 1 + rand() % 20000;
+	string sites( len, '1' );
+	bool homologous = rand() % 2 == 0;
+	for( size_t siteI = 0; siteI < len; homologous = !homologous )
+	{
+		size_t run_len = 50 + rand() % 3000;
+		for( size_t runI = 0; runI < run_len && siteI < len; runI++, siteI++ )
+		{
+			int r = rand() % 100;
+			if( r < (homologous ? 80 : 40) )
+				sites[siteI] = rand() % 2 ? '1' : '2';
+			else if( r < (homologous ? 95 : 80) )
+				sites[siteI] = '3' + rand() % 4;
+			else
+				sites[siteI] = '7' + rand() % 2;
+		}
+	}
+	return sites;
+}
+
+/** a pairwise alignment of a sequence with a copy that has an unrelated insert */
+static vector< string > simulatedAlignment()
+{
+	size_t len = 200 + rand() % 5000;
+	vector< string > rows( 2 );
+	while( rows[0].size() < len )
+	{
+		int r = rand() % 1000;
+		char base = BASES[ rand() % 4 ];
+		if( r < 3 )
+		{
+			// an unrelated stretch aligned against the other sequence
+			size_t stretch = 20 + rand() % 400;
+			for( size_t charI = 0; charI < stretch; charI++ )
+			{
+				rows[0] += BASES[ rand() % 4 ];
+				rows[1] += BASES[ rand() % 4 ];
+			}
+		}else if( r < 15 )
+		{
+			rows[0] += base;
+			rows[1] += '-';
+		}else if( r < 27 )
+		{
+			rows[0] += '-';
+			rows[1] += base;
+		}else
+		{
+			rows[0] += base;
+			rows[1] += r < 120 ? BASES[ rand() % 4 ] : base;
+		}
+	}
+	return rows;
+}
+
+/** @return the number of sites where run() disagrees with runGeneric() */
+static size_t comparePredictions( vector< string >& site_patterns, const Params& params, size_t& site_count )
+{
+	vector< string > batch_predictions;
+	run( site_patterns, batch_predictions, params );
+	size_t mismatches = 0;
+	for( size_t seqI = 0; seqI < site_patterns.size(); seqI++ )
+	{
+		string generic_prediction;
+		string prediction;
+		runGeneric( site_patterns[seqI], generic_prediction, params );
+		run( site_patterns[seqI], prediction, params );
+		site_count += generic_prediction.size();
+		if( prediction != batch_predictions[seqI] )
+			mismatches++;
+		for( size_t siteI = 0; siteI < generic_prediction.size(); siteI++ )
+			if( siteI >= prediction.size() || generic_prediction[siteI] != prediction[siteI] )
+				mismatches++;
+	}
+	return mismatches;
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 17 );
+	Params params = getAdaptedHoxdMatrixParameters( 0.5 );
+	int failures = 0;
+
+	vector< string > site_patterns;
+	for( int seqI = 0; seqI < 200; seqI++ )
+		site_patterns.push_back( randomSites() );
+	size_t site_count = 0;
+	size_t mismatches = comparePredictions( site_patterns, params, site_count );
+	cout << "random sites: " << site_count << " sites, " << mismatches << " mismatches\n";
+	failures += mismatches > 0 ? 1 : 0;
+
+	site_patterns.clear();
+	vector< size_t > col_reference;
+	for( int alnI = 0; alnI < 200; alnI++ )
+	{
+		vector< string > aln_table = simulatedAlignment();
+		site_patterns.push_back( string() );
+		encodeHomologyColumns( aln_table, 0, 1, true, true, site_patterns.back(), col_reference );
+	}
+	site_count = 0;
+	mismatches = comparePredictions( site_patterns, params, site_count );
+	cout << "simulated alignments: " << site_count << " sites, " << mismatches << " mismatches\n";
+	failures += mismatches > 0 ? 1 : 0;
+
+	for( int argI = 1; argI < argc; argI++ )
+	{
+		ifstream xmfa_file( argv[argI] );
+		if( !xmfa_file.is_open() )
+		{
+			cerr << "Error opening " << argv[argI] << endl;
+			return -1;
+		}
+		site_patterns.clear();
+		IntervalList iv_list;
+		iv_list.ReadStandardAlignment( xmfa_file );
+		for( size_t ivI = 0; ivI < iv_list.size(); ivI++ )
+		{
+			const GappedAlignment* ga = dynamic_cast< const GappedAlignment* >( iv_list[ivI].GetMatches()[0] );
+			vector< string > aln_table = GetAlignment( *ga, iv_list.seq_table );
+			for( uint seqI = 0; seqI < ga->SeqCount(); seqI++ )
+			{
+				if( ga->Length(seqI) == 0 )
+					continue;
+				for( uint seqJ = seqI + 1; seqJ < ga->SeqCount(); seqJ++ )
+				{
+					if( ga->Length(seqJ) == 0 )
+						continue;
+					site_patterns.push_back( string() );
+					encodeHomologyColumns( aln_table, seqI, seqJ, true, true, site_patterns.back(), col_reference );
+				}
+			}
+		}
+		site_count = 0;
+		mismatches = comparePredictions( site_patterns, params, site_count );
+		cout << argv[argI] << ": " << site_count << " sites, " << mismatches << " mismatches\n";
+		failures += mismatches > 0 ? 1 : 0;
+	}
+
+	if( failures > 0 )
+	{
+		cerr << "run() and runGeneric() predictions differ\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/MatchList.h"
+#include <iostream>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that sorting the seed match lists of MatchFinder in an IdmerList
+ * gives the same order as the std::list<idmer> it replaced, including the
+ * order of mers with equal ids.  The lists are the ones MemHash enumerates on
+ * synthetic genomes with repeats, so many lists hold several mers per genome.
+ */
+
+static const uint SEQ_COUNT = 3;
+
+/** A MemHash that records each list of matching mers it enumerates */
+class RecordingMemHash : public MemHash {
+public:
+	vector< vector< idmer > > match_lists;
+protected:
+	virtual boolean EnumerateMatches( IdmerList& match_list ){
+		match_lists.push_back( vector< idmer >( match_list.begin(), match_list.end() ) );
+		return MemHash::EnumerateMatches( match_list );
+	}
+};
+
+static char randomBase()
+{
+	return "ACGT"[ rand() % 4 ];
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 31 );
+	string ancestor;
+	for( size_t baseI = 0; baseI < 200000; baseI++ )
+		ancestor += randomBase();
+	string repeat = ancestor.substr( 5000, 500 );
+
+	MatchList ml;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		string genome;
+		for( size_t baseI = 0; baseI < ancestor.size(); baseI++ )
+		{
+			int r = rand() % 10000;
+			if( r < 100 )
+				genome += randomBase();
+			else if( r == 100 )
+				genome += repeat;
+			else
+				genome += ancestor[baseI];
+		}
+		ml.seq_table.push_back( new gnSequence( genome ) );
+		ml.seq_filename.push_back( "genome" );
+	}
+	ml.CreateMemorySMLs( 15, NULL );
+
+	RecordingMemHash mh;
+	mh.FindMatches( ml );
+	size_t multi_lists = 0;
+	size_t failures = 0;
+	IdmerList mers;
+	for( size_t listI = 0; listI < mh.match_lists.size(); listI++ )
+	{
+		const vector< idmer >& match_list = mh.match_lists[listI];
+		if( match_list.size() > SEQ_COUNT )
+			multi_lists++;
+		list< idmer > expected( match_list.begin(), match_list.end() );
+		expected.sort( &idmer_id_lessthan );
+		mers.clear();
+		mers.insert( mers.end(), match_list.begin(), match_list.end() );
+		mers.sort( &idmer_id_lessthan );
+		list< idmer >::const_iterator exp_iter = expected.begin();
+		for( size_t merI = 0; merI < mers.size(); merI++, ++exp_iter )
+		{
+			if( mers[merI].id != exp_iter->id || mers[merI].position != exp_iter->position )
+			{
+				failures++;
+				break;
+			}
+		}
+	}
+	cout << mh.match_lists.size() << " mer lists, " << multi_lists << " with repeated mers, " << failures << " sorted differently\n";
+
+	for( size_t mI = 0; mI < ml.size(); mI++ )
+		ml[mI]->Free();
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		delete ml.sml_table[seqI];
+		delete ml.seq_table[seqI];
+	}
+	if( failures > 0 || multi_lists == 0 )
+	{
+		cerr << "IdmerList sorts seed match lists differently from std::list<idmer>\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,321 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/ProgressiveAligner.h"
+#include "libMems/PairwiseMatchFinder.h"
+#include "libMems/Backbone.h"
+#include "libMems/Files.h"
+#include "libMems/HomologyHMM/parameters.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that aligning the two halves of a balanced guide tree concurrently
+ * gives the same alignment and backbone as aligning one pair of nodes at a
+ * time in the order chosen by chooseNextAlignmentPair, whether the concurrent
+ * alignment gets one thread or several.  The
+ * genomes evolve from a random ancestor with substitutions, indels, an
+ * inversion and genome specific insertions and deletions.  Gap marbling with
+ * a generator seeded per node must also not depend on the thread it runs on,
+ * and an exception thrown while aligning one node must reach the caller.
+ * usage: testParallelAlignment [thread count]
+ */
+
+static const uint SEQ_COUNT = 4;
+static const size_t ANCESTOR_LENGTH = 30000;
+
+static char randomBase()
+{
+	return "ACGT"[ rand() % 4 ];
+}
+
+/** copies a sequence with about one change per 40 sites */
+static string mutate( const string& parent )
+{
+	string child;
+	for( size_t baseI = 0; baseI < parent.size(); baseI++ )
+	{
+		int r = rand() % 200;
+		if( r < 4 )
+			child += randomBase();
+		else if( r == 4 )
+			baseI += rand() % 6;	// deletion
+		else if( r == 5 )
+		{
+			child += parent[baseI];
+			for( int insI = rand() % 6; insI >= 0; insI-- )
+				child += randomBase();
+		}else
+			child += parent[baseI];
+	}
+	return child;
+}
+
+static string reverseComplement( const string& seq )
+{
+	string rc( seq.rbegin(), seq.rend() );
+	for( size_t baseI = 0; baseI < rc.size(); baseI++ )
+		rc[baseI] = rc[baseI] == 'A' ? 'T' : rc[baseI] == 'C' ? 'G' : rc[baseI] == 'G' ? 'C' : 'A';
+	return rc;
+}
+
+/** evolves genomes along ((seq1,seq2),(seq3,seq4)) */
+static void makeGenomes( vector< string >& genomes )
+{
+	string ancestor;
+	for( size_t baseI = 0; baseI < ANCESTOR_LENGTH; baseI++ )
+		ancestor += randomBase();
+
+	string left = mutate( ancestor );
+	string right = mutate( ancestor );
+	size_t inv_start = right.size() / 3;
+	size_t inv_len = right.size() / 5;
+	right.replace( inv_start, inv_len, reverseComplement( right.substr( inv_start, inv_len ) ) );
+
+	genomes.push_back( mutate( left ) );
+	genomes.push_back( mutate( left ) );
+	genomes.push_back( mutate( right ) );
+	genomes.push_back( mutate( right ) );
+
+	// islands and deletions leave regions that backbone detection must unalign
+	for( int islandI = 0; islandI < 6; islandI++ )
+	{
+		string island;
+		for( size_t baseI = 300 + rand() % 1500; baseI > 0; baseI-- )
+			island += randomBase();
+		string& gainer = genomes[ rand() % SEQ_COUNT ];
+		gainer.insert( rand() % gainer.size(), island );
+		string& loser = genomes[ rand() % SEQ_COUNT ];
+		loser.erase( rand() % (loser.size() - 2000), 300 + rand() % 1500 );
+	}
+}
+
+/** an aligner whose first node alignment throws instead of aligning */
+class FailingAligner : public ProgressiveAligner
+{
+public:
+	FailingAligner( uint seq_count ) : ProgressiveAligner( seq_count ), calls( 0 ) {}
+	void alignNodes( NodeAlignmentContext& context )
+	{
+		int call;
+#pragma omp critical(FailingAligner_calls)
+		call = calls++;
+		if( call == 0 )
+			Throw_gnExMsg( FileUnreadable(), "node alignment failed on purpose" );
+		ProgressiveAligner::alignNodes( context );
+	}
+	int calls;	/**< the number of node alignments that were started */
+};
+
+/** finds pairwise matches among the genomes */
+static void findMatches( const vector< string >& genomes, MatchList& pairwise_match_list )
+{
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		pairwise_match_list.seq_table.push_back( new gnSequence( genomes[seqI] ) );
+		stringstream name;
+		name << "seq" << seqI + 1;
+		pairwise_match_list.seq_filename.push_back( name.str() );
+	}
+	pairwise_match_list.CreateMemorySMLs( getDefaultSeedWeight( ANCESTOR_LENGTH ), NULL );
+	PairwiseMatchFinder pmf;
+	pmf.FindMatches( pairwise_match_list );
+	pmf.Clear();
+}
+
+static void freeMatches( MatchList& pairwise_match_list )
+{
+	for( size_t seqI = 0; seqI < pairwise_match_list.sml_table.size(); seqI++ )
+		delete pairwise_match_list.sml_table[seqI];
+	for( size_t seqI = 0; seqI < pairwise_match_list.seq_table.size(); seqI++ )
+		delete pairwise_match_list.seq_table[seqI];
+}
+
+static void configure( ProgressiveAligner& aligner, string& tree_fname, MatchList& pairwise_match_list )
+{
+	aligner.setLcbScoringScheme( ProgressiveAligner::ExtantSumOfPairsScoring );
+	aligner.SetRecursive( true );
+	aligner.setPairwiseScoringScheme( PairwiseScoringScheme() );
+	aligner.setInputGuideTreeFileName( tree_fname );
+	aligner.setPairwiseMatches( pairwise_match_list );
+}
+
+/**
+ * aligns the genomes with the given number of threads and returns the XMFA and backbone
+ * @param parallel_tree	align independent subtrees concurrently rather than one pair at a time
+ */
+static string align( const vector< string >& genomes, string& tree_fname, int threads, bool parallel_tree )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	MatchList pairwise_match_list;
+	findMatches( genomes, pairwise_match_list );
+
+	ProgressiveAligner aligner( SEQ_COUNT );
+	configure( aligner, tree_fname, pairwise_match_list );
+	aligner.setParallelTreeAlignment( parallel_tree );
+
+	IntervalList interval_list;
+	interval_list.seq_table = pairwise_match_list.seq_table;
+	interval_list.seq_filename = pairwise_match_list.seq_filename;
+	aligner.align( interval_list.seq_table, interval_list );
+
+	Params hmm_params = getAdaptedHoxdMatrixParameters( computeGC( interval_list.seq_table ) );
+	backbone_list_t bb_list;
+	detectAndApplyBackbone( interval_list, bb_list, hmm_params );
+
+	stringstream result;
+	interval_list.WriteStandardAlignment( result );
+	writeBackboneColumns( result, bb_list );
+
+	freeMatches( pairwise_match_list );
+	return result.str();
+}
+
+/**
+ * Aligns the genomes concurrently with an aligner whose first node alignment
+ * throws and returns true if that exception reached the caller without the
+ * root being aligned
+ */
+static bool checkFailure( const vector< string >& genomes, string& tree_fname, int threads )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	MatchList pairwise_match_list;
+	findMatches( genomes, pairwise_match_list );
+
+	FailingAligner aligner( SEQ_COUNT );
+	configure( aligner, tree_fname, pairwise_match_list );
+	IntervalList interval_list;
+	interval_list.seq_table = pairwise_match_list.seq_table;
+	bool caught = false;
+	try{
+		aligner.align( interval_list.seq_table, interval_list );
+	}catch( gnException& gne ){
+		caught = gne.GetMessage() == "node alignment failed on purpose";
+	}
+	freeMatches( pairwise_match_list );
+	// the other cherry may be aligned, but never the root above the failure
+	return caught && aligner.calls <= 2 && interval_list.size() == 0;
+}
+
+/** marbles the gaps of a copy of iv with a generator seeded by seed and returns the order of its pieces */
+static string marble( const Interval& iv, unsigned long seed )
+{
+	Interval marbled( iv );
+	TwisterState random;
+	SetTwisterStateSeed( &random, seed );
+	marbled.Marble( 50, &random );
+	stringstream order;
+	const vector< AbstractMatch* >& pieces = marbled.GetMatches();
+	for( size_t pieceI = 0; pieceI < pieces.size(); pieceI++ )
+		order << pieces[pieceI]->LeftEnd(0) << ',' << pieces[pieceI]->LeftEnd(1) << ' ';
+	return order.str();
+}
+
+/**
+ * Marbles an interval with long unaligned regions in both genomes once per seed,
+ * on one thread and then concurrently, and returns the number of seeds that
+ * marbled differently.  Different seeds must also give different orders.
+ */
+static int checkMarbling( int threads )
+{
+	Match left( 2 );
+	left.SetStart( 0, 1 );
+	left.SetStart( 1, 1 );
+	left.SetLength( 100 );
+	Match right( 2 );
+	right.SetStart( 0, 1001 );
+	right.SetStart( 1, 1501 );
+	right.SetLength( 100 );
+	vector< AbstractMatch* > anchors;
+	anchors.push_back( &left );
+	anchors.push_back( &right );
+	Interval iv( anchors.begin(), anchors.end() );
+
+	const int SEED_COUNT = 64;
+	vector< string > serial( SEED_COUNT );
+	for( int seedI = 0; seedI < SEED_COUNT; seedI++ )
+		serial[seedI] = marble( iv, seedI + 1 );
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	vector< string > parallel( SEED_COUNT );
+#pragma omp parallel for schedule(dynamic)
+	for( int seedI = 0; seedI < SEED_COUNT; seedI++ )
+		parallel[seedI] = marble( iv, seedI + 1 );
+
+	int differences = serial[0] == serial[1] ? 1 : 0;
+	for( int seedI = 0; seedI < SEED_COUNT; seedI++ )
+		if( parallel[seedI] != serial[seedI] )
+			differences++;
+	return differences;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+	srand( 1 );
+	vector< string > genomes;
+	makeGenomes( genomes );
+
+	// a balanced tree lets the two cherries be aligned concurrently
+	string tree_fname = CreateTempFileName( "guide_tree" );
+	{
+		ofstream tree_out( tree_fname.c_str() );
+		tree_out << "((seq1:0.01,seq2:0.02):0.01,(seq3:0.03,seq4:0.02):0.01);\n";
+	}
+
+	int failures = 0;
+	string serial = align( genomes, tree_fname, 1, false );
+	if( serial.find( "=" ) == string::npos )
+	{
+		cerr << "nothing was aligned\n";
+		failures++;
+	}
+	if( align( genomes, tree_fname, 1, true ) != serial )
+	{
+		cerr << "concurrent alignment on 1 thread differs from the serial order\n";
+		failures++;
+	}
+	for( int runI = 0; runI < 2; runI++ )
+	{
+		string parallel = align( genomes, tree_fname, threads, true );
+		if( parallel != serial )
+		{
+			cerr << "concurrent alignment with " << threads << " threads differs from the serial order on run " << runI << endl;
+			failures++;
+		}
+	}
+	if( !checkFailure( genomes, tree_fname, threads ) )
+	{
+		cerr << "an exception thrown by a node alignment did not reach the caller\n";
+		failures++;
+	}
+	remove( tree_fname.c_str() );
+	if( checkMarbling( threads ) > 0 )
+	{
+		cerr << "gap marbling depends on the thread it runs on\n";
+		failures++;
+	}
+
+	if( failures == 0 )
+		cout << "parallel alignment matches serial alignment\n";
+	return failures == 0 ? 0 : 1;
+}
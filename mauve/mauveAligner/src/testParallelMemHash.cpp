@@ -0,0 +1,168 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MemHash.h"
+#include "libMems/ParallelMemHash.h"
+#include "libMems/PairwiseMatchFinder.h"
+#include "libMems/MatchList.h"
+#include "UniqueMatchFinder.h"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that ParallelMemHash finds the same matches, in the same order, as
+ * MemHash, and that PairwiseMatchFinder and UniqueMatchFinder find the same
+ * matches when their search runs in parallel as when it runs serially.  The genomes are long enough for the search to be split into
+ * several chunks, and repeats make sure that copies of a mer fall on both
+ * sides of chunk breakpoints.  In a second set of genomes a short repeat has
+ * more copies than the search will enumerate, so the search must skip its
+ * mers and carry on with the rest of the chunk.
+ * usage: testParallelMemHash [thread count]
+ */
+
+static const uint SEQ_COUNT = 3;
+static const size_t ANCESTOR_LENGTH = 500000;
+
+static char randomBase()
+{
+	return "ACGT"[ rand() % 4 ];
+}
+
+/**
+ * copies a sequence with about one substitution per 100 sites and
+ * a copy of repeat at about one site in repeat_rate
+ */
+static string mutate( const string& parent, const string& repeat, int repeat_rate )
+{
+	string child;
+	for( size_t baseI = 0; baseI < parent.size(); baseI++ )
+	{
+		int r = rand() % repeat_rate;
+		if( r == 0 )
+			child += repeat;
+		if( rand() % 100 == 0 )
+			child += randomBase();
+		else
+			child += parent[baseI];
+	}
+	return child;
+}
+
+/** PairwiseMatchFinder with the serial search of MemHash */
+class SerialPairwiseMatchFinder : public PairwiseMatchFinder {
+public:
+	virtual void FindMatches( MatchList& ml ){ MemHash::FindMatches( ml ); }
+};
+
+/** UniqueMatchFinder with the serial search of MemHash */
+class SerialUniqueMatchFinder : public UniqueMatchFinder {
+public:
+	virtual void FindMatches( MatchList& ml ){ MemHash::FindMatches( ml ); }
+};
+
+/** copies the length and start coordinates of each match, in list order */
+static void matchCoordinates( const MatchList& ml, vector< int64 >& coords )
+{
+	coords.clear();
+	for( size_t mI = 0; mI < ml.size(); mI++ )
+	{
+		coords.push_back( ml[mI]->Length() );
+		for( uint seqI = 0; seqI < ml[mI]->SeqCount(); seqI++ )
+			coords.push_back( ml[mI]->Start(seqI) );
+	}
+}
+
+/** finds matches with mh and returns their coordinates */
+static void findMatches( MemHash& mh, const MatchList& ml, vector< int64 >& coords )
+{
+	MatchList found_ml = ml;
+	mh.FindMatches( found_ml );
+	matchCoordinates( found_ml, coords );
+	for( size_t mI = 0; mI < found_ml.size(); mI++ )
+		found_ml[mI]->Free();
+	mh.Clear();
+}
+
+/** searches ml with serial_mh and parallel_mh and returns true if both found the same matches */
+static bool compareFinders( MemHash& serial_mh, MemHash& parallel_mh, const MatchList& ml, const string& name )
+{
+	vector< int64 > serial_coords;
+	vector< int64 > parallel_coords;
+	findMatches( serial_mh, ml, serial_coords );
+	findMatches( parallel_mh, ml, parallel_coords );
+	cout << "serial " << name << ": " << serial_coords.size() << " coordinates, parallel: " << parallel_coords.size() << " coordinates\n";
+	return !serial_coords.empty() && serial_coords == parallel_coords;
+}
+
+/**
+ * searches genomes evolved from a random ancestor with each finder serially
+ * and in parallel, and returns true if every finder found the same matches both ways
+ */
+static bool compareSearches( size_t ancestor_length, size_t repeat_length, int repeat_rate )
+{
+	string ancestor;
+	for( size_t baseI = 0; baseI < ancestor_length; baseI++ )
+		ancestor += randomBase();
+	string repeat;
+	for( size_t baseI = 0; baseI < repeat_length; baseI++ )
+		repeat += randomBase();
+
+	MatchList ml;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		ml.seq_table.push_back( new gnSequence( mutate( ancestor, repeat, repeat_rate ) ) );
+		ml.seq_filename.push_back( "genome" );
+	}
+	ml.CreateMemorySMLs( 15, NULL );
+
+	MemHash mh;
+	ParallelMemHash pmh;
+	bool same = compareFinders( mh, pmh, ml, "MemHash" );
+	SerialPairwiseMatchFinder serial_pmf;
+	PairwiseMatchFinder pmf;
+	same = compareFinders( serial_pmf, pmf, ml, "PairwiseMatchFinder" ) && same;
+	SerialUniqueMatchFinder serial_umf;
+	UniqueMatchFinder umf;
+	same = compareFinders( serial_umf, umf, ml, "UniqueMatchFinder" ) && same;
+
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		delete ml.sml_table[seqI];
+		delete ml.seq_table[seqI];
+	}
+	return same;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	srand( 23 );
+	int failures = 0;
+	// a few copies of a long repeat
+	if( !compareSearches( ANCESTOR_LENGTH, 300, 20000 ) )
+		failures++;
+	// more than MER_REPEAT_LIMIT copies of a short repeat in all
+	if( !compareSearches( ANCESTOR_LENGTH, 30, 1000 ) )
+		failures++;
+
+	if( failures > 0 )
+	{
+		cerr << "parallel and serial match searches differ\n";
+		return 1;
+	}
+	return 0;
+}
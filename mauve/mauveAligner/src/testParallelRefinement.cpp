@@ -0,0 +1,204 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/ProgressiveAligner.h"
+#include "libMems/GappedAlignment.h"
+#include <iostream>
+#include <streambuf>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <set>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that refining the windows of a gapped alignment concurrently gives
+ * the same alignment as refining them one at a time, on one thread and on
+ * several, and that more than one thread did the refining.  The windows are
+ * random sequences with substitutions and indels.
+ * usage: testParallelRefinement [thread count]
+ */
+
+static const uint SEQ_COUNT = 4;
+static const uint WINDOW_COUNT = 48;
+
+static char randomBase()
+{
+	return "ACGT"[ rand() % 4 ];
+}
+
+/** creates unaligned windows of sequences that were mutated from a common ancestor */
+static void makeWindows( vector< GappedAlignment >& windows, vector< bool >& is_gap )
+{
+	vector< int64 > starts( SEQ_COUNT, 1 );
+	for( uint windowI = 0; windowI < WINDOW_COUNT; windowI++ )
+	{
+		string ancestor;
+		size_t anc_len = 100 + rand() % 700;
+		for( size_t baseI = 0; baseI < anc_len; baseI++ )
+			ancestor += randomBase();
+
+		vector< string > rows( SEQ_COUNT );
+		string::size_type aln_len = 0;
+		for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		{
+			for( size_t baseI = 0; baseI < anc_len; baseI++ )
+			{
+				int r = rand() % 100;
+				if( r < 8 )
+					rows[seqI] += randomBase();
+				else if( r < 10 )
+					continue;	// deletion
+				else if( r < 12 )
+				{
+					rows[seqI] += ancestor[baseI];
+					rows[seqI] += randomBase();
+				}else
+					rows[seqI] += ancestor[baseI];
+			}
+			aln_len = rows[seqI].size() > aln_len ? rows[seqI].size() : aln_len;
+		}
+
+		windows.push_back( GappedAlignment( SEQ_COUNT, aln_len ) );
+		GappedAlignment& window = windows.back();
+		for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		{
+			window.SetStart( seqI, starts[seqI] );
+			window.SetLength( rows[seqI].size(), seqI );
+			starts[seqI] += rows[seqI].size();
+			rows[seqI].resize( aln_len, '-' );
+		}
+		window.SetAlignment( rows );
+		is_gap.push_back( windowI % 7 == 3 );
+	}
+}
+
+/**
+ * Passes progress output on to another stream buffer and records which
+ * threads wrote it.  refineWindows reports progress from the thread that
+ * finished each window.
+ */
+class ThreadRecordingBuf : public std::streambuf
+{
+public:
+	ThreadRecordingBuf( std::streambuf* out ) : out( out ) {}
+	std::set< int > writers;
+protected:
+	int overflow( int c )
+	{
+		record();
+		return c == traits_type::eof() ? traits_type::not_eof( c ) : out->sputc( (char)c );
+	}
+	std::streamsize xsputn( const char* s, std::streamsize n )
+	{
+		record();
+		return out->sputn( s, n );
+	}
+	int sync(){ return out->pubsync(); }
+private:
+	void record()
+	{
+#ifdef _OPENMP
+		writers.insert( omp_get_thread_num() );
+#else
+		writers.insert( 0 );
+#endif
+	}
+	std::streambuf* out;
+};
+
+/**
+ * refines copies of the windows and returns the resulting alignment rows
+ * @param writers	(output) the threads that reported refining a window
+ */
+static vector< vector< string > > refine( const vector< GappedAlignment >& windows, const vector< bool >& is_gap, bool profile_aln, bool parallel, int threads, std::set< int >& writers )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	vector< GappedAlignment* > copies( windows.size() );
+	AlnProgressTracker apt;
+	apt.total_len = 0;
+	apt.cur_leftend = 0;
+	apt.prev_progress = 0;
+	for( size_t galI = 0; galI < windows.size(); galI++ )
+	{
+		copies[galI] = windows[galI].Copy();
+		apt.total_len += windows[galI].AlignmentLength();
+	}
+
+	vector< size_t > seqs1;
+	vector< size_t > seqs2;
+	for( size_t seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		(seqI < SEQ_COUNT / 2 ? seqs1 : seqs2).push_back( seqI );
+	ThreadRecordingBuf progress_buf( cout.rdbuf() );
+	ostream progress_out( &progress_buf );
+	refineWindows( copies, is_gap, profile_aln, seqs1, seqs2, parallel, apt, progress_out );
+	progress_out << endl;
+	writers = progress_buf.writers;
+
+	vector< vector< string > > result( copies.size() );
+	for( size_t galI = 0; galI < copies.size(); galI++ )
+	{
+		result[galI] = GetAlignment( *copies[galI], vector< gnSequence* >( SEQ_COUNT ) );
+		copies[galI]->Free();
+	}
+	return result;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+	srand( 31 );
+	vector< GappedAlignment > windows;
+	vector< bool > is_gap;
+	makeWindows( windows, is_gap );
+
+	int failures = 0;
+	for( int profile = 0; profile < 2; profile++ )
+	{
+		bool profile_aln = profile == 1;
+		std::set< int > writers;
+		vector< vector< string > > serial = refine( windows, is_gap, profile_aln, false, 1, writers );
+		vector< vector< string > > parallel1 = refine( windows, is_gap, profile_aln, true, 1, writers );
+		vector< vector< string > > parallelN = refine( windows, is_gap, profile_aln, true, threads, writers );
+		if( threads > 1 && writers.size() < 2 )
+		{
+			cerr << "only " << writers.size() << " of " << threads << " threads refined" << (profile_aln ? " profile" : "") << " windows\n";
+			failures++;
+		}
+		for( size_t galI = 0; galI < windows.size(); galI++ )
+		{
+			if( !is_gap[galI] && serial[galI] == GetAlignment( windows[galI], vector< gnSequence* >( SEQ_COUNT ) ) )
+			{
+				cerr << "window " << galI << " was not refined\n";
+				failures++;
+			}
+			if( parallel1[galI] != serial[galI] )
+			{
+				cerr << "window " << galI << (profile_aln ? " profile" : "") << " differs with 1 thread\n";
+				failures++;
+			}
+			if( parallelN[galI] != serial[galI] )
+			{
+				cerr << "window " << galI << (profile_aln ? " profile" : "") << " differs with " << threads << " threads\n";
+				failures++;
+			}
+		}
+	}
+	if( failures > 0 )
+	{
+		cerr << failures << " window comparisons failed\n";
+		return 1;
+	}
+	cout << "Parallel refinement matches serial refinement on " << windows.size() << " windows\n";
+	return 0;
+}
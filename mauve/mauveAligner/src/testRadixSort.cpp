@@ -0,0 +1,181 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/SortedMerList.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that RadixSortMers orders mers exactly as std::stable_sort with
+ * bmer_lessthan does, including the position order of equal mers, on one
+ * thread and on several.  Also checks that a DNAMemorySML built on several
+ * threads is the same as one built on one thread.
+ * usage: testRadixSort [thread count]
+ */
+
+/** enough mers that every thread gets a block to count and scatter */
+static const size_t MER_COUNT = 1 << 20;
+
+static uint64 rng_state = 88172645463325252ULL;
+
+/** a 64 bit xorshift generator, rand() gives too few bits for a mer */
+static uint64 random64()
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/** fills mers with keys made by make_mer, the positions record the input order */
+template< class MerMaker >
+static void makeMers( vector< bmer >& mers, size_t mer_count, MerMaker make_mer )
+{
+	mers.resize( mer_count );
+	for( size_t merI = 0; merI < mer_count; merI++ )
+	{
+		mers[merI].position = merI;
+		mers[merI].mer = make_mer();
+	}
+}
+
+/** any 64 bit key */
+static uint64 randomMer()
+{
+	return random64();
+}
+
+/** only 64 distinct keys, so most mers tie */
+static uint64 tieHeavyMer()
+{
+	return (random64() % 64) << 40;
+}
+
+/** the low bytes are the same in every mer, as they are for a short seed */
+static uint64 constantLowByteMer()
+{
+	return (random64() << 24) | 0xA5A5A5ULL;
+}
+
+/** a spaced seed, whose mask leaves bytes in the middle of the key at zero */
+static uint64 spacedSeedMer()
+{
+	return random64() & 0xFFFF0000FF00FFF0ULL;
+}
+
+static int check( const string& name, const vector< bmer >& input, int threads )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	vector< bmer > expected = input;
+	stable_sort( expected.begin(), expected.end(), &bmer_lessthan );
+	vector< bmer > sorted = input;
+	RadixSortMers( sorted );
+	for( size_t merI = 0; merI < expected.size(); merI++ )
+	{
+		if( sorted[merI].mer != expected[merI].mer || sorted[merI].position != expected[merI].position )
+		{
+			cerr << name << " with " << threads << " threads differs from stable_sort at mer " << merI << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/** reads every entry of a sorted mer list */
+static void readSML( SortedMerList& sml, vector< bmer >& mers )
+{
+	mers.clear();
+	sml.Read( mers, sml.SMLLength(), 0 );
+}
+
+/** @return 1 if a DNAMemorySML of seq built on several threads differs from one built on one thread */
+static int checkMemorySML( const gnSequence& seq, uint64 seed, int threads )
+{
+#ifdef _OPENMP
+	omp_set_num_threads( 1 );
+#endif
+	DNAMemorySML serial_sml;
+	serial_sml.Create( seq, seed );
+	vector< bmer > expected;
+	readSML( serial_sml, expected );
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	DNAMemorySML parallel_sml;
+	parallel_sml.Create( seq, seed );
+	vector< bmer > sorted;
+	readSML( parallel_sml, sorted );
+	if( expected.size() != seq.length() - getSeedLength( seed ) + 1 || sorted.size() != expected.size() )
+	{
+		cerr << "DNAMemorySML with " << threads << " threads has " << sorted.size() << " mers\n";
+		return 1;
+	}
+	for( size_t merI = 0; merI < expected.size(); merI++ )
+	{
+		if( sorted[merI].mer != expected[merI].mer || sorted[merI].position != expected[merI].position )
+		{
+			cerr << "DNAMemorySML with " << threads << " threads differs from one thread at mer " << merI << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+	vector< string > names;
+	vector< vector< bmer > > inputs( 6 );
+	makeMers( inputs[0], MER_COUNT, randomMer );
+	names.push_back( "random" );
+	makeMers( inputs[1], MER_COUNT, tieHeavyMer );
+	names.push_back( "tie-heavy" );
+	makeMers( inputs[2], MER_COUNT, constantLowByteMer );
+	names.push_back( "constant low byte" );
+	makeMers( inputs[3], MER_COUNT, spacedSeedMer );
+	names.push_back( "spaced seed" );
+	makeMers( inputs[4], 1000, tieHeavyMer );
+	names.push_back( "short" );
+	makeMers( inputs[5], MER_COUNT, tieHeavyMer );
+	std::fill( inputs[5].begin(), inputs[5].end(), inputs[5].front() );
+	for( size_t merI = 0; merI < inputs[5].size(); merI++ )
+		inputs[5][merI].position = merI;
+	names.push_back( "all equal" );
+
+	int failures = 0;
+	for( size_t inputI = 0; inputI < inputs.size(); inputI++ )
+	{
+		failures += check( names[inputI], inputs[inputI], 1 );
+		failures += check( names[inputI], inputs[inputI], threads );
+	}
+
+	string seq_str;
+	for( size_t baseI = 0; baseI < 500000; baseI++ )
+		seq_str += "ACGT"[ random64() % 4 ];
+	// a repeat gives the mer lists long runs of equal mers
+	seq_str += seq_str.substr( 1000, 20000 );
+	gnSequence seq( seq_str );
+	failures += checkMemorySML( seq, getSeed( 15 ), threads );
+	failures += checkMemorySML( seq, getSolidSeed( 15 ), threads );
+
+	if( failures == 0 )
+		cout << "RadixSortMers matches stable_sort and DNAMemorySML does not depend on the thread count\n";
+	return failures == 0 ? 0 : 1;
+}
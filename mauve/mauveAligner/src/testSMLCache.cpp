@@ -0,0 +1,195 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/MatchList.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include "boost/filesystem/operations.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks the content-addressed sorted mer list cache used by LoadSMLs.  A cold
+ * run must create and publish an SML for each sequence, a warm run must load
+ * them again, a sequence under another file name must find the SML of its
+ * content, and an entry without its completion marker must be rebuilt rather
+ * than loaded.  Every SML must hold the same mers as an uncached DNAMemorySML.
+ * usage: testSMLCache [thread count]
+ */
+
+static const int SEQ_COUNT = 3;
+static const uint MER_SIZE = 15;
+static const char* CACHE_DIR = "testSMLCache.cache";
+
+/** @return the mer and position of each entry, sorted, or an empty list if the mers are out of order */
+static vector< pair< uint64, gnSeqI > > sortedEntries( SortedMerList& sml )
+{
+	vector< bmer > mers;
+	sml.Read( mers, sml.SMLLength(), 0 );
+	uint64 mer_mask = sml.GetMerMask();
+	vector< pair< uint64, gnSeqI > > entries( mers.size() );
+	for( size_t merI = 0; merI < mers.size(); merI++ )
+	{
+		entries[merI] = make_pair( mers[merI].mer & mer_mask, mers[merI].position );
+		if( merI > 0 && entries[merI].first < entries[merI - 1].first )
+			return vector< pair< uint64, gnSeqI > >();
+	}
+	sort( entries.begin(), entries.end() );
+	return entries;
+}
+
+/** @return the number of times text appears in log */
+static size_t countLines( const string& log, const string& text )
+{
+	size_t count = 0;
+	for( size_t pos = log.find( text ); pos != string::npos; pos = log.find( text, pos + 1 ) )
+		count++;
+	return count;
+}
+
+/**
+ * loads SMLs for seqs through the cache under the given file names, checks each
+ * against expected and returns the log
+ */
+static string loadSMLs( vector< gnSequence* >& seqs, const vector< string >& names, const vector< vector< pair< uint64, gnSeqI > > >& expected, vector< string >& sml_names, int& failures )
+{
+	MatchList match_list;
+	match_list.seq_table = seqs;
+	match_list.seq_filename = names;
+	stringstream log;
+	match_list.LoadSMLs( MER_SIZE, &log );
+	sml_names = match_list.sml_filename;
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		if( !FileSML::isCachePublished( sml_names[seqI] ) )
+		{
+			cerr << sml_names[seqI] << " was not published\n";
+			failures++;
+		}
+		if( sortedEntries( *match_list.sml_table[seqI] ) != expected[seqI] )
+		{
+			cerr << "cached sorted mer list for sequence " << seqI << " differs from an uncached one\n";
+			failures++;
+		}
+		match_list.sml_table[seqI]->Clear();
+		delete match_list.sml_table[seqI];
+	}
+	return log.str();
+}
+
+static void expectCount( const string& log, const string& text, size_t expected, const string& run, int& failures )
+{
+	size_t found = countLines( log, text );
+	if( found != expected )
+	{
+		cerr << run << " run logged \"" << text << "\" " << found << " times instead of " << expected << endl;
+		failures++;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	srand( 31 );
+	FileSML::registerTempPath( "." );
+	boost::filesystem::remove_all( CACHE_DIR );
+	FileSML::registerCachePath( CACHE_DIR );
+	if( FileSML::getCachePath() != CACHE_DIR )
+	{
+		cerr << "unable to register the cache directory\n";
+		return 1;
+	}
+
+	vector< gnSequence* > seqs( SEQ_COUNT );
+	vector< string > names( SEQ_COUNT );
+	vector< vector< pair< uint64, gnSeqI > > > expected( SEQ_COUNT );
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		string seq;
+		for( size_t baseI = 50000 + rand() % 50000; baseI > 0; baseI-- )
+			seq += "ACGT"[ rand() % 4 ];
+		seqs[seqI] = new gnSequence( seq );
+		stringstream name;
+		name << "testSMLCache." << seqI << ".fas";
+		names[seqI] = name.str();
+		DNAMemorySML memory_sml;
+		memory_sml.Create( *seqs[seqI], getSeed( MER_SIZE ) );
+		expected[seqI] = sortedEntries( memory_sml );
+		memory_sml.Clear();
+	}
+
+	int failures = 0;
+	vector< string > cold_names;
+	string log = loadSMLs( seqs, names, expected, cold_names, failures );
+	expectCount( log, "Sorted mer list will be cached as", SEQ_COUNT, "cold", failures );
+	expectCount( log, "Creating sorted mer list", SEQ_COUNT, "cold", failures );
+	expectCount( log, "Using cached sorted mer list", 0, "cold", failures );
+
+	vector< string > warm_names;
+	log = loadSMLs( seqs, names, expected, warm_names, failures );
+	expectCount( log, "Using cached sorted mer list", SEQ_COUNT, "warm", failures );
+	expectCount( log, "Sorted mer list loaded successfully", SEQ_COUNT, "warm", failures );
+	expectCount( log, "Creating sorted mer list", 0, "warm", failures );
+	if( warm_names != cold_names )
+	{
+		cerr << "the warm run named its sorted mer lists differently\n";
+		failures++;
+	}
+
+	// the cache is keyed by content, so a renamed sequence file still hits it
+	vector< string > renamed( names );
+	renamed[0] = "testSMLCache.renamed.fas";
+	vector< string > renamed_names;
+	log = loadSMLs( seqs, renamed, expected, renamed_names, failures );
+	expectCount( log, "Using cached sorted mer list", SEQ_COUNT, "renamed", failures );
+	expectCount( log, "Creating sorted mer list", 0, "renamed", failures );
+	if( renamed_names != cold_names )
+	{
+		cerr << "a renamed sequence missed the cache\n";
+		failures++;
+	}
+
+	// an entry without its marker may be partially written, so truncate it
+	// and check that it gets rebuilt instead of loaded
+	boost::filesystem::remove( cold_names[1] + ".complete" );
+	boost::filesystem::resize_file( cold_names[1], 16 );
+	vector< string > rebuilt_names;
+	log = loadSMLs( seqs, names, expected, rebuilt_names, failures );
+	expectCount( log, "Using cached sorted mer list", SEQ_COUNT - 1, "unmarked", failures );
+	expectCount( log, "Sorted mer list will be cached as", 1, "unmarked", failures );
+	expectCount( log, "Creating sorted mer list", 1, "unmarked", failures );
+	if( rebuilt_names != cold_names )
+	{
+		cerr << "the rebuilt sorted mer list was cached under another name\n";
+		failures++;
+	}
+
+	for( int seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		delete seqs[seqI];
+	boost::filesystem::remove_all( CACHE_DIR );
+	if( failures > 0 )
+	{
+		cerr << "the sorted mer list cache failed " << failures << " checks\n";
+		return 1;
+	}
+	cout << "cached sorted mer lists match uncached ones\n";
+	return 0;
+}
@@ -0,0 +1,202 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/SeedOccurrenceList.h"
+#include "libMems/DNAMemorySML.h"
+#include "libMems/SeedMasks.h"
+#include "libGenome/gnSequence.h"
+#include "boost/filesystem/operations.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that SeedOccurrenceList gives the same frequency for every position
+ * as the array of floats it used to keep, for a genome whose sums nearly all
+ * fit in a byte, and for one with enough repeats that the sums are kept in two
+ * bytes.  Both genomes contain a long homopolymer, so each also has sums in the
+ * overflow table.  Each list must read back from a saved file with the same
+ * frequencies, and the file must be refused for another sequence length or
+ * seed.
+ * usage: testSeedOccurrenceList
+ */
+
+static const uint MER_SIZE = 15;
+static const char* SOL_FNAME = "testSeedOccurrenceList.sol";
+
+/** the seed occurrence list from before sums were kept in bytes, kept to check against */
+class FloatSeedOccurrenceList
+{
+public:
+	typedef float32 frequency_type;
+
+	template< typename SMLType >
+	void construct( SMLType& sml )
+	{
+		const size_t total_len = sml.Length();
+		count.resize(total_len);
+		size_t seed_start = 0;
+		size_t cur_seed_count = 1;
+		uint64 mer_mask = sml.GetSeedMask();
+		size_t seedI = 1;
+		bmer prevmer;
+		bmer merI;
+		const size_t sml_length = sml.SMLLength();
+		if( sml_length > 0 )
+			merI = sml[0];
+		for( seedI = 1; seedI < sml_length; seedI++ )
+		{
+			prevmer = merI;
+			merI = sml[seedI];
+			if( (merI.mer & mer_mask) == (prevmer.mer & mer_mask) )
+			{
+				++cur_seed_count;
+				continue;
+			}
+			for( size_t i = seed_start; i < seedI; ++i )
+				count[sml[i].position] = (frequency_type)cur_seed_count;
+			seed_start = seedI;
+			cur_seed_count = 1;
+		}
+		for( size_t i = seed_start; i < seedI && i < sml_length; ++i )
+			count[sml[i].position] = (frequency_type)cur_seed_count;
+		for( ; seedI < total_len; ++seedI )
+			count[seedI]=1;
+
+		size_t seed_length = sml.SeedLength();
+		double sum = seed_length - 1 + count[0];
+		std::vector<frequency_type> buf(seed_length, 1);
+		buf[0] = count[0];
+		for( size_t i = 1; i < sml.Length(); i++ )
+		{
+			count[i-1] = sum / seed_length;
+			sum += count[i];
+			size_t bufI = i % seed_length;
+			sum -= buf[bufI];
+			buf[bufI] = count[i];
+		}
+
+		for( size_t i = 0; i < total_len; ++i )
+			if( count[i]== 0 )
+				count[i] = 1;
+	}
+
+	frequency_type getFrequency( gnSeqI position )
+	{
+		return count[position];
+	}
+
+protected:
+	std::vector<frequency_type> count;
+};
+
+/** exposes how a list stores its sums */
+class SeedOccurrenceListLayout : public SeedOccurrenceList
+{
+public:
+	uint sumWidth() const { return sum_width; }
+	size_t overflowEntries() const { return overflow_count; }
+};
+
+static string randomSequence( size_t length )
+{
+	string seq( length, 'A' );
+	for( size_t i = 0; i < length; i++ )
+		seq[i] = "ACGT"[ rand() % 4 ];
+	return seq;
+}
+
+/** @return the number of positions at which the two lists give different frequencies */
+static size_t compareFrequencies( FloatSeedOccurrenceList& expected, const SeedOccurrenceList& sol, gnSeqI length )
+{
+	size_t mismatches = 0;
+	for( gnSeqI posI = 0; posI < length; posI++ )
+	{
+		if( sol.getFrequency( posI ) == expected.getFrequency( posI ) )
+			continue;
+		if( mismatches == 0 )
+			cerr << "position " << posI << " has frequency " << sol.getFrequency( posI ) << ", expected " << expected.getFrequency( posI ) << endl;
+		mismatches++;
+	}
+	return mismatches;
+}
+
+/** @return the number of failed checks for a list of the seeds in seq */
+static int checkSequence( const string& seq, const char* name, uint expected_width )
+{
+	int failures = 0;
+	gnSequence gn_seq( seq );
+	DNAMemorySML sml;
+	uint64 seed = getSeed( MER_SIZE );
+	sml.Create( gn_seq, seed );
+
+	FloatSeedOccurrenceList expected;
+	expected.construct( sml );
+	SeedOccurrenceListLayout sol;
+	sol.construct( sml );
+	size_t mismatches = compareFrequencies( expected, sol, seq.size() );
+	cout << name << ": " << seq.size() << " positions, " << sol.sumWidth() << " byte sums, " << sol.overflowEntries() << " overflow entries, " << mismatches << " mismatches" << endl;
+	if( mismatches > 0 )
+		failures++;
+	if( sol.sumWidth() != expected_width )
+	{
+		cerr << name << ": expected " << expected_width << " byte sums\n";
+		failures++;
+	}
+	if( sol.overflowEntries() == 0 )
+	{
+		cerr << name << ": expected sums in the overflow table\n";
+		failures++;
+	}
+
+	sol.save( SOL_FNAME );
+	SeedOccurrenceList loaded;
+	if( !loaded.load( SOL_FNAME, seq.size(), seed ) )
+	{
+		cerr << name << ": the saved list could not be loaded\n";
+		failures++;
+	}else{
+		mismatches = compareFrequencies( expected, loaded, seq.size() );
+		// a copy of a mapped list shares the mapping
+		SeedOccurrenceList copied( loaded );
+		mismatches += compareFrequencies( expected, copied, seq.size() );
+		cout << name << " loaded: " << mismatches << " mismatches" << endl;
+		if( mismatches > 0 )
+			failures++;
+	}
+	SeedOccurrenceList refused;
+	if( refused.load( SOL_FNAME, seq.size() + 1, seed ) || refused.load( SOL_FNAME, seq.size(), getSeed( MER_SIZE - 2 ) ) )
+	{
+		cerr << name << ": a list was loaded for another sequence\n";
+		failures++;
+	}
+	boost::filesystem::remove( SOL_FNAME );
+	return failures;
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 11 );
+	int failures = 0;
+
+	// unique seeds, with a homopolymer long enough that its sums overflow a byte
+	string unique_seq = randomSequence( 100000 ) + string( 3000, 'A' ) + randomSequence( 100000 );
+	failures += checkSequence( unique_seq, "one byte sums", 1 );
+
+	// a unit repeated often enough that most sums need two bytes, and a
+	// homopolymer long enough that its sums overflow two bytes
+	string unit = randomSequence( 400 );
+	string repeat_seq = randomSequence( 20000 );
+	for( uint copyI = 0; copyI < 150; copyI++ )
+		repeat_seq += unit;
+	repeat_seq += string( 12000, 'T' ) + randomSequence( 20000 );
+	failures += checkSequence( repeat_seq, "two byte sums", 2 );
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/XmfaReader.h"
+#include "libMems/XmfaIndex.h"
+#include "libMems/MatchList.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks XmfaReader and stripGapColumns on random alignments of gapped blocks.
+ * Each block read back must have the rows, coordinates and gap pattern it was
+ * written with, an alignment whose last block is cut off before its '=' line
+ * must throw InvalidFileFormat, and stripGapColumns must keep exactly the
+ * residues of the columns without gaps.  stripGapColumns keeps the coordinates
+ * of each block, which only reads back on the forward strand, so it is given
+ * forward strand blocks.  XmfaIndex::FindBlock() must find the block of the
+ * first and last position of every genome in every block.
+ * usage: testXmfaReader [stripGapColumns program]
+ */
+
+static const char* RESIDUES = "ACGTACGTACGTacgtN";
+
+/** One block of an alignment, as it is written */
+struct TestBlock {
+	vector< int64 > starts;
+	vector< gnSeqI > lengths;
+	vector< string > rows;
+};
+
+/** a block of three rows with runs of gaps, sometimes without the second genome */
+static TestBlock randomBlock( bool forward_only )
+{
+	const uint seq_count = 3;
+	const size_t aln_length = 1 + rand() % 500;
+	TestBlock block;
+	block.rows.resize( seq_count );
+	block.starts.resize( seq_count );
+	block.lengths.resize( seq_count );
+	for( uint seqI = 0; seqI < seq_count; seqI++ )
+	{
+		string& row = block.rows[seqI];
+		row.assign( aln_length, '-' );
+		if( seqI == 1 && rand() % 5 == 0 )
+			continue;
+		for( size_t colI = 0; colI < aln_length; )
+		{
+			size_t run_len = 1 + rand() % 30;
+			bool gap = rand() % 4 == 0;
+			for( ; run_len > 0 && colI < aln_length; run_len--, colI++ )
+				if( !gap )
+					row[colI] = RESIDUES[ rand() % 17 ];
+		}
+		gnSeqI length = aln_length - count( row.begin(), row.end(), '-' );
+		if( length == 0 )
+			continue;
+		int64 start = 1 + rand() % 100000;
+		block.starts[seqI] = !forward_only && rand() % 2 ? -start : start;
+		block.lengths[seqI] = length;
+	}
+	return block;
+}
+
+static void writeBlock( ostream& out, const TestBlock& block )
+{
+	for( uint seqI = 0; seqI < block.rows.size(); seqI++ )
+	{
+		int64 left = block.starts[seqI] < 0 ? -block.starts[seqI] : block.starts[seqI];
+		if( block.starts[seqI] == 0 )
+			out << "> " << seqI + 1 << ":0-0 + genome" << seqI + 1 << ".fas\n";
+		else
+			out << "> " << seqI + 1 << ':' << left << '-' << left + block.lengths[seqI] - 1 << (block.starts[seqI] < 0 ? " - " : " + ") << "genome" << seqI + 1 << ".fas\n";
+		for( size_t colI = 0; colI < block.rows[seqI].size(); colI += 80 )
+			out << block.rows[seqI].substr( colI, 80 ) << '\n';
+	}
+	out << "=\n";
+}
+
+static void writeAlignment( ostream& out, const vector< TestBlock >& blocks )
+{
+	out << "#FormatVersion Mauve1\n";
+	for( uint seqI = 0; seqI < 3; seqI++ )
+	{
+		out << "#Sequence" << seqI + 1 << "File\tgenome" << seqI + 1 << ".fas\n";
+		out << "#Sequence" << seqI + 1 << "Format\tFastA\n";
+	}
+	for( size_t blockI = 0; blockI < blocks.size(); blockI++ )
+		writeBlock( out, blocks[blockI] );
+}
+
+/** @return the number of blocks that were not read back as they were written */
+static size_t readBlocks( istream& in, const vector< TestBlock >& blocks )
+{
+	XmfaReader reader( in );
+	CompactGappedAlignment<> cga;
+	vector< string > rows;
+	size_t mismatches = 0;
+	size_t blockI = 0;
+	for( ; reader.Next( cga, &rows ); blockI++ )
+	{
+		if( blockI >= blocks.size() || rows != blocks[blockI].rows || cga.AlignmentLength() != rows[0].size() )
+		{
+			mismatches++;
+			continue;
+		}
+		for( uint seqI = 0; seqI < cga.SeqCount(); seqI++ )
+		{
+			bool same = cga.Start(seqI) == blocks[blockI].starts[seqI] && cga.Length(seqI) == blocks[blockI].lengths[seqI];
+			for( size_t colI = 0; colI < rows[seqI].size(); colI++ )
+				same = same && cga.IsGap( seqI, colI ) == (rows[seqI][colI] == '-');
+			if( !same )
+			{
+				mismatches++;
+				break;
+			}
+		}
+	}
+	return mismatches + (blockI > blocks.size() ? blockI - blocks.size() : blocks.size() - blockI);
+}
+
+/** removes every column with a gap, leaving the starts as they were */
+static TestBlock stripGaps( const TestBlock& block )
+{
+	TestBlock stripped = block;
+	for( uint seqI = 0; seqI < block.rows.size(); seqI++ )
+		stripped.rows[seqI].clear();
+	for( size_t colI = 0; colI < block.rows[0].size(); colI++ )
+	{
+		uint seqI = 0;
+		for( ; seqI < block.rows.size(); seqI++ )
+			if( block.rows[seqI][colI] == '-' )
+				break;
+		if( seqI < block.rows.size() )
+			continue;
+		for( seqI = 0; seqI < block.rows.size(); seqI++ )
+			stripped.rows[seqI] += block.rows[seqI][colI];
+	}
+	// lengths are read back from the residues of each row
+	for( uint seqI = 0; seqI < block.rows.size(); seqI++ )
+		stripped.lengths[seqI] = stripped.rows[seqI].size();
+	return stripped;
+}
+
+/**
+ * @return the number of lookups that XmfaIndex::FindBlock() answers wrongly,
+ * for blocks laid end to end along each genome in a different order
+ */
+static size_t findBlocks()
+{
+	vector< TestBlock > blocks;
+	for( int blockI = 0; blockI < 200; blockI++ )
+		blocks.push_back( randomBlock( false ) );
+	vector< int64 > genome_ends( 3 );
+	for( uint seqI = 0; seqI < 3; seqI++ )
+	{
+		vector< size_t > order( blocks.size() );
+		for( size_t blockI = 0; blockI < order.size(); blockI++ )
+			order[blockI] = blockI;
+		for( size_t blockI = order.size(); blockI > 1; blockI-- )
+			swap( order[blockI - 1], order[ rand() % blockI ] );
+		int64 left = 1;
+		for( size_t orderI = 0; orderI < order.size(); orderI++ )
+		{
+			TestBlock& block = blocks[ order[orderI] ];
+			if( block.starts[seqI] == 0 )
+				continue;
+			block.starts[seqI] = block.starts[seqI] < 0 ? -left : left;
+			left += block.lengths[seqI];
+		}
+		genome_ends[seqI] = left;
+	}
+	stringstream aln_stream;
+	writeAlignment( aln_stream, blocks );
+	XmfaIndex index;
+	index.Build( aln_stream );
+
+	size_t wrong = 0;
+	for( uint seqI = 0; seqI < 3; seqI++ )
+	{
+		for( size_t blockI = 0; blockI < blocks.size(); blockI++ )
+		{
+			int64 start = blocks[blockI].starts[seqI];
+			if( start == 0 )
+				continue;
+			gnSeqI left = start < 0 ? -start : start;
+			wrong += index.FindBlock( seqI, left ) == blockI ? 0 : 1;
+			wrong += index.FindBlock( seqI, left + blocks[blockI].lengths[seqI] - 1 ) == blockI ? 0 : 1;
+		}
+		// positions outside the genome are not aligned
+		wrong += index.FindBlock( seqI, 0 ) == blocks.size() ? 0 : 1;
+		wrong += index.FindBlock( seqI, genome_ends[seqI] ) == blocks.size() ? 0 : 1;
+	}
+	return wrong;
+}
+
+int main( int argc, char* argv[] )
+{
+	srand( 11 );
+	string strip_program = argc > 1 ? argv[1] : "./stripGapColumns";
+	int failures = 0;
+
+	vector< TestBlock > blocks;
+	for( int blockI = 0; blockI < 300; blockI++ )
+		blocks.push_back( randomBlock( false ) );
+	stringstream aln_stream;
+	writeAlignment( aln_stream, blocks );
+	const string aln_text = aln_stream.str();
+	size_t mismatches = readBlocks( aln_stream, blocks );
+	cout << "gapped blocks: " << blocks.size() << " blocks, " << mismatches << " mismatches\n";
+	failures += mismatches > 0 ? 1 : 0;
+
+	// cut the alignment off inside its last block
+	size_t cut = aln_text.rfind( "=\n" );
+	cut = aln_text.rfind( '\n', cut - 2 );
+	stringstream truncated_stream( aln_text.substr( 0, cut + 1 ) );
+	bool thrown = false;
+	try{
+		readBlocks( truncated_stream, blocks );
+	}catch( gnException& gne ){
+		// exception codes are created separately in each translation unit, so compare names
+		thrown = gne.GetCode().GetName() == "InvalidFileFormat";
+	}
+	cout << "truncated block: " << (thrown ? "InvalidFileFormat" : "no error") << endl;
+	failures += thrown ? 0 : 1;
+
+	// strip the gap columns of blocks where every genome has residues
+	vector< TestBlock > gapped;
+	vector< TestBlock > stripped;
+	while( gapped.size() < 200 )
+	{
+		TestBlock block = randomBlock( true );
+		if( count( block.starts.begin(), block.starts.end(), 0 ) > 0 )
+			continue;
+		gapped.push_back( block );
+		TestBlock stripped_block = stripGaps( block );
+		if( stripped_block.rows[0].size() > 0 )
+			stripped.push_back( stripped_block );
+	}
+	const string in_fname = "testXmfaReader.xmfa";
+	const string out_fname = "testXmfaReader.stripped.xmfa";
+	{
+		ofstream in_file( in_fname.c_str() );
+		writeAlignment( in_file, gapped );
+	}
+	string command = strip_program + " " + in_fname + " " + out_fname;
+	if( system( command.c_str() ) != 0 )
+	{
+		cerr << "Error running " << command << endl;
+		failures++;
+	}else{
+		ifstream out_file( out_fname.c_str() );
+		mismatches = readBlocks( out_file, stripped );
+		cout << "stripped gap columns: " << stripped.size() << " blocks, " << mismatches << " mismatches\n";
+		failures += mismatches > 0 ? 1 : 0;
+	}
+	remove( in_fname.c_str() );
+	remove( out_fname.c_str() );
+
+	size_t wrong = findBlocks();
+	cout << "block index lookups: " << wrong << " wrong\n";
+	failures += wrong > 0 ? 1 : 0;
+
+	if( failures > 0 )
+	{
+		cerr << "XmfaReader, stripGapColumns or XmfaIndex failed\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,223 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "libMems/IntervalList.h"
+#include "libMems/GappedAlignment.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+/**
+ * Checks that WriteStandardAlignment writes the same bytes as the serial XMFA
+ * writer it replaced.  The alignment is written in one batch, and in batches
+ * of a few regions that are rendered on several threads.  The regions have
+ * runs of gaps, reverse strand rows, rows of genomes that are absent from a
+ * region and rows longer than a line.  When a region in the middle of the
+ * alignment can not be read, both writers must throw, and the parallel writer
+ * must have written a prefix of what the serial writer wrote before it threw.
+ * usage: testXmfaWriter [thread count]
+ */
+
+static const uint SEQ_COUNT = 4;
+static const gnSeqI SEQ_LENGTH = 50000;
+
+/** the XMFA writer from before regions were rendered in batches, kept to check against */
+static void serialWriteStandardAlignment( const IntervalList& iv_list, std::ostream& out_file )
+{
+	if( iv_list.size() == 0 )
+		return;
+	const vector< string >& seq_filename = iv_list.seq_filename;
+	const vector< gnSequence* >& seq_table = iv_list.seq_table;
+
+	uint seqI = 0;
+	out_file << "#FormatVersion Mauve1" << std::endl;
+	boolean single_input = true;
+	for( seqI = 1; seqI < seq_filename.size(); seqI++ ){
+		if( seq_filename[ 0 ] != seq_filename[ seqI ] ){
+			single_input = false;
+			break;
+		}
+	}
+	for( seqI = 0; seqI < seq_filename.size(); seqI++ ){
+		out_file << "#Sequence" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
+		if( single_input )
+			out_file << "#Sequence" << seqI + 1 << "Entry\t" << seqI + 1 << std::endl;
+		genome::gnSourceFactory* sf = genome::gnSourceFactory::GetSourceFactory();
+		genome::gnBaseSource* gnbs = sf->MatchSourceClass( seq_filename[ seqI ] );
+		if( dynamic_cast< genome::gnFASSource* >(gnbs) != NULL )
+			out_file << "#Sequence" << seqI + 1 << "Format\tFastA" << std::endl;
+		else if( dynamic_cast< genome::gnRAWSource* >(gnbs) != NULL )
+			out_file << "#Sequence" << seqI + 1 << "Format\traw" << std::endl;
+		else if( dynamic_cast< genome::gnSEQSource* >(gnbs) != NULL ){
+			out_file << "#Sequence" << seqI + 1 << "Format\tDNAstar" << std::endl;
+			out_file << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
+			out_file << "#Annotation" << seqI + 1 << "Format\tDNAstar" << std::endl;
+		}else if( dynamic_cast< genome::gnGBKSource* >(gnbs) != NULL ){
+			out_file << "#Sequence" << seqI + 1 << "Format\tGenBank" << std::endl;
+			out_file << "#Annotation" << seqI + 1 << "File\t" << seq_filename[ seqI ] << std::endl;
+			out_file << "#Annotation" << seqI + 1 << "Format\tGenBank" << std::endl;
+		}
+	}
+	if( iv_list.backbone_filename != "" )
+		out_file << "#BackboneFile\t" << iv_list.backbone_filename << std::endl;
+
+	for( uint ivI = 0; ivI < iv_list.size(); ivI++ ){
+		if( iv_list[ ivI ].AlignmentLength() == 0 )
+			continue;
+		std::vector<std::string> alignment;
+		GetAlignment( iv_list[ ivI ], seq_table, alignment );
+		for( seqI = 0; seqI < iv_list[ ivI ].SeqCount(); seqI++ ){
+			int64 startI = iv_list[ ivI ].Start( seqI );
+			gnSeqI length = iv_list[ ivI ].Length( seqI );
+			if( startI == 0 && ivI > 0 )
+				continue;
+			out_file << "> " << seqI + 1 << ":";
+			if( startI > 0 ){
+				out_file << genome::absolut( startI ) << "-" << genome::absolut( startI ) + length - 1 << " + ";
+			}else if(startI == 0){
+				out_file << 0 << "-" << 0 << " + ";
+			}else{
+				out_file << genome::absolut( startI ) << "-" << genome::absolut( startI ) + length - 1 << " - ";
+			}
+			if( single_input )
+				out_file << seq_filename[ 0 ];
+			else
+				out_file << seq_filename[ seqI ];
+			out_file << std::endl;
+			gnSeqI cur_pos = 0;
+			for( ; cur_pos < alignment[ seqI ].length(); cur_pos += 80 ){
+				gnSeqI cur_len = cur_pos + 80 < alignment[ seqI ].length() ? 80 : alignment[ seqI ].length() - cur_pos;
+				out_file.write( alignment[ seqI ].data() + cur_pos, cur_len );
+				out_file << std::endl;
+			}
+		}
+		out_file << "=" << std::endl;
+		out_file.flush();
+	}
+}
+
+/**
+ * a region of random rows with runs of gaps, sometimes without one of the genomes
+ * @param past_end	place the rows after the end of the sequences, so they can not be read
+ */
+static Interval randomRegion( bool past_end = false )
+{
+	const size_t aln_length = 1 + rand() % 900;
+	vector< string > rows( SEQ_COUNT, string( aln_length, '-' ) );
+	GappedAlignment* ga = new GappedAlignment( SEQ_COUNT, aln_length );
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		gnSeqI length = 0;
+		if( past_end || rand() % 6 != 0 )
+		{
+			for( size_t colI = 0; colI < aln_length; )
+			{
+				size_t run_len = 1 + rand() % 40;
+				bool gap = rand() % 3 == 0;
+				for( ; run_len > 0 && colI < aln_length; run_len--, colI++ )
+				{
+					if( gap )
+						continue;
+					// the writers take residues from the sequences
+					rows[seqI][colI] = 'A';
+					length++;
+				}
+			}
+		}
+		int64 start = length == 0 ? 0 : 1 + rand() % ( SEQ_LENGTH - length + 1 );
+		if( length > 0 && past_end )
+			start = 2 * SEQ_LENGTH;
+		ga->SetLength( length, seqI );
+		ga->SetStart( seqI, rand() % 2 ? -start : start );
+	}
+	ga->SetAlignment( rows );
+	vector< AbstractMatch* > matches( 1, ga );
+	Interval iv;
+	iv.SetMatches( matches );
+	return iv;
+}
+
+static string randomSequence( gnSeqI length )
+{
+	string seq( length, 'A' );
+	for( gnSeqI i = 0; i < length; i++ )
+		seq[i] = "ACGTacgtNRYK"[ rand() % 12 ];
+	return seq;
+}
+
+/** @return 1 if the parallel writer's output differs from the serial writer's, 0 otherwise */
+static int compareWriters( const IntervalList& iv_list, uint64 batch_size, const char* name )
+{
+	stringstream serial_out;
+	serialWriteStandardAlignment( iv_list, serial_out );
+	stringstream parallel_out;
+	uint64 bytes_written = iv_list.WriteStandardAlignment( parallel_out, batch_size );
+	bool identical = parallel_out.str() == serial_out.str() && bytes_written == parallel_out.str().size();
+	cout << name << ": " << parallel_out.str().size() << " bytes, " << (identical ? "identical" : "differs") << endl;
+	return identical ? 0 : 1;
+}
+
+int main( int argc, char* argv[] )
+{
+	int threads = argc > 1 ? atoi( argv[1] ) : 4;
+#ifdef _OPENMP
+	omp_set_num_threads( threads );
+#endif
+	srand( 3 );
+	int failures = 0;
+
+	IntervalList iv_list;
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+	{
+		iv_list.seq_table.push_back( new gnSequence( randomSequence( SEQ_LENGTH ) ) );
+		stringstream fname;
+		fname << "genome" << seqI << ( seqI % 2 ? ".fas" : ".gbk" );
+		iv_list.seq_filename.push_back( fname.str() );
+	}
+	iv_list.backbone_filename = "genomes.backbone";
+	for( uint ivI = 0; ivI < 400; ivI++ )
+		iv_list.push_back( randomRegion() );
+
+	failures += compareWriters( iv_list, XMFA_WRITE_BATCH_SIZE, "one batch" );
+	// batches of a few regions each
+	failures += compareWriters( iv_list, 6000, "small batches" );
+	// every region in its own batch
+	failures += compareWriters( iv_list, 1, "single region batches" );
+
+	// a region past the end of its sequences, in the middle of a batch
+	IntervalList unreadable = iv_list;
+	unreadable.insert( unreadable.begin() + 250, randomRegion( true ) );
+	stringstream serial_out;
+	string serial_error = "no error";
+	try{
+		serialWriteStandardAlignment( unreadable, serial_out );
+	}catch( gnException& gne ){
+		serial_error = gne.GetCode().GetName();
+	}
+	stringstream parallel_out;
+	string parallel_error = "no error";
+	try{
+		unreadable.WriteStandardAlignment( parallel_out, 6000 );
+	}catch( gnException& gne ){
+		parallel_error = gne.GetCode().GetName();
+	}
+	bool prefix = serial_out.str().compare( 0, parallel_out.str().size(), parallel_out.str() ) == 0;
+	cout << "unreadable region: serial " << serial_error << ", parallel " << parallel_error << ", " << parallel_out.str().size() << " of " << serial_out.str().size() << " bytes written" << (prefix ? "" : ", output differs") << endl;
+	if( serial_error == "no error" || parallel_error != serial_error || !prefix || parallel_out.str().size() == 0 )
+		failures++;
+
+	for( uint seqI = 0; seqI < SEQ_COUNT; seqI++ )
+		delete iv_list.seq_table[seqI];
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+#include "libMems/IntervalList.h"
+#include <fstream>
+#include <string>
+
+using namespace mems;
+using namespace std;
+using namespace genome;
+
+int main(int argc, char* argv[] ){
+	bool write_residues = true;
+	if( argc == 4 && string(argv[1]) == "--no-residues" ){
+		write_residues = false;
+		argv++;
+		argc--;
+	}
+	if(argc != 3){
+		cerr << "Usage: xmfa2mba [--no-residues] <xmfa input> <binary alignment output>\n";
+		cerr << "Alignments written with --no-residues need the original sequence files to be converted back to xmfa\n";
+		return -1;
+	}
+	ifstream ifile(argv[1]);
+	if(!ifile.is_open()){
+		cerr << "Error reading \"" << argv[1] << "\"\n";
+		return -2;
+	}
+	ofstream ofile(argv[2], ios::binary);
+	if(!ofile.is_open()){
+		cerr << "Error writing to \"" << argv[2] << "\"\n";
+		return -2;
+	}
+
+	IntervalList xmfa;
+	try{
+		xmfa.ReadStandardAlignment(ifile);
+		xmfa.WriteBinaryAlignment(ofile, write_residues);
+	}catch( gnException& gne ){
+		cerr << gne << endl;
+		return -1;
+	}
+	return 0;
+}
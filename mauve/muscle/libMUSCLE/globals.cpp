@@ -276,25 +276,25 @@ void Call_MY_ASSERT(const char *file, int line, bool b, const char *msg)
 	Quit("%s(%d): MY_ASSERT(%s)", file, line, msg);
 	}
 
-static size_t g_MemTotal;
+static TLS<size_t> g_MemTotal(0);
 
 void MemPlus(size_t Bytes, char *Where)
 	{
-	g_MemTotal += Bytes;
+	g_MemTotal.get() += Bytes;
 	Log("+%10u  %6u  %6u  %s\n",
 	  (unsigned) Bytes,
 	  (unsigned) GetMemUseMB(),
-	  (unsigned) (g_MemTotal/1000000),
+	  (unsigned) (g_MemTotal.get()/1000000),
 	  Where);
 	}
 
 void MemMinus(size_t Bytes, char *Where)
 	{
-	g_MemTotal -= Bytes;
+	g_MemTotal.get() -= Bytes;
 	Log("-%10u  %6u  %6u  %s\n",
 	  (unsigned) Bytes,
 	  (unsigned) GetMemUseMB(),
-	  (unsigned) (g_MemTotal/1000000),
+	  (unsigned) (g_MemTotal.get()/1000000),
 	  Where);
 	}
 } 
@@ -63,10 +63,10 @@ double GetMemUseMB()
 
 	if (n <= 0)
 		{
-		static bool Warned = false;
-		if (!Warned)
+		static TLS<bool> Warned(false);
+		if (!Warned.get())
 			{
-			Warned = true;
+			Warned.get() = true;
 			Warning("*Warning* Cannot read %s errno=%d %s",
 			  statm.get(), errno, strerror(errno));
 			}
@@ -88,12 +88,12 @@ void SaveCmdLine(int argc, char *argv[])
 		}
 	}
 
-double dPeakMemUseMB = 0;
+static TLS<double> dPeakMemUseMB(0);
 
 double GetPeakMemUseMB()
 	{
 	CheckMemUse();
-	return dPeakMemUseMB;
+	return dPeakMemUseMB.get();
 	}
 
 double GetCPUGHz()
@@ -108,24 +108,24 @@ double GetCPUGHz()
 void CheckMemUse()
 	{
 	double dMB = GetMemUseMB();
-	if (dMB > dPeakMemUseMB)
-		dPeakMemUseMB = dMB;
+	if (dMB > dPeakMemUseMB.get())
+		dPeakMemUseMB.get() = dMB;
 	}
 
 double GetRAMSizeMB()
 	{
 	const double DEFAULT_RAM = 500;
-	static double RAMMB = 0;
-	if (RAMMB != 0)
-		return RAMMB;
+	static TLS<double> RAMMB(0);
+	if (RAMMB.get() != 0)
+		return RAMMB.get();
 
 	int fd = open("/proc/meminfo", O_RDONLY);
 	if (-1 == fd)
 		{
-		static bool Warned = false;
-		if (!Warned)
+		static TLS<bool> Warned(false);
+		if (!Warned.get())
 			{
-			Warned = true;
+			Warned.get() = true;
 			Warning("*Warning* Cannot open /proc/meminfo errno=%d %s",
 			  errno, strerror(errno));
 			}
@@ -138,10 +138,10 @@ double GetRAMSizeMB()
 
 	if (n <= 0)
 		{
-		static bool Warned = false;
-		if (!Warned)
+		static TLS<bool> Warned(false);
+		if (!Warned.get())
 			{
-			Warned = true;
+			Warned.get() = true;
 			Warning("*Warning* Cannot read /proc/meminfo errno=%d %s",
 			  errno, strerror(errno));
 			}
@@ -151,10 +151,10 @@ double GetRAMSizeMB()
 	char *pMem = strstr(Buffer, "MemTotal: ");
 	if (0 == pMem)
 		{
-		static bool Warned = false;
-		if (!Warned)
+		static TLS<bool> Warned(false);
+		if (!Warned.get())
 			{
-			Warned = true;
+			Warned.get() = true;
 			Warning("*Warning* 'MemTotal:' not found in /proc/meminfo");
 			}
 		return DEFAULT_RAM;
@@ -237,8 +237,8 @@ SCORE ObjScoreSP(const MSA &msa, SCORE MatchScore[])
 	Log("msa=\n");
 	msa.LogMe();
 #endif
-	g_SPScoreLetters = 0;
-	g_SPScoreGaps = 0;
+	g_SPScoreLetters.setLocal(0);
+	g_SPScoreGaps.setLocal(0);
 
 	if (0 != MatchScore)
 		{
@@ -1,26 +1,24 @@
 #include "libMUSCLE/muscle.h"
 #include <stdio.h>
 #include <time.h>
+#include "libMUSCLE/threadstorage.h"
 
 namespace muscle {
 
 // Functions that provide visible feedback to the user
 // that progress is being made.
-#ifdef _OPENMP
-#ifdef __GNUG__
-#warning "progress indicators have not been made parallel-safe yet"
-#endif
-#endif
-
-static unsigned g_uIter = 0;		// Main MUSCLE iteration 1, 2..
-static unsigned g_uLocalMaxIters = 0;	// Max iters
+// Each thread keeps its own progress state, so that alignments running
+// concurrently do not overwrite each other's iteration and description.
+
+static TLS<unsigned> g_uIter(0);		// Main MUSCLE iteration 1, 2..
+static TLS<unsigned> g_uLocalMaxIters(0);	// Max iters
 static FILE *g_fProgress = stderr;	// Default to standard error
-static char g_strFileName[32];		// File name
-static time_t g_tLocalStart;				// Start time
-static char g_strDesc[32];			// Description
-static bool g_bWipeDesc = false;
-static int g_nPrevDescLength;
-static unsigned g_uTotalSteps;
+static TLS<char[32]> g_strFileName;		// File name
+static TLS<time_t> g_tLocalStart;				// Start time
+static TLS<char[32]> g_strDesc;			// Description
+static TLS<bool> g_bWipeDesc(false);
+static TLS<int> g_nPrevDescLength;
+static TLS<unsigned> g_uTotalSteps;
 
 double GetCheckMemUseMB()
 	{
@@ -39,7 +37,7 @@ double GetCheckMemUseMB()
 const char *ElapsedTimeAsStr()
 	{
 	time_t Now = time(0);
-	unsigned long ElapsedSecs = (unsigned long) (Now - g_tLocalStart);
+	unsigned long ElapsedSecs = (unsigned long) (Now - g_tLocalStart.get());
 	return SecsToStr(ElapsedSecs);
 	}
 
@@ -48,25 +46,25 @@ const char *MemToStr(double MB)
 	if (MB < 0)
 		return "";
 
-	static char Str[11];
-	static double MaxMB = 0;
-	static double RAMMB = 0;
+	static TLS<char[11]> Str;
+	static TLS<double> MaxMB(0);
+	static TLS<double> RAMMB(0);
 
-	if (RAMMB == 0)
-		RAMMB = GetRAMSizeMB();
+	if (RAMMB.get() == 0)
+		RAMMB.get() = GetRAMSizeMB();
 
-	if (MB > MaxMB)
-		MaxMB = MB;
-	double Pct = (MaxMB*100.0)/RAMMB;
+	if (MB > MaxMB.get())
+		MaxMB.get() = MB;
+	double Pct = (MaxMB.get()*100.0)/RAMMB.get();
 	if (Pct > 100)
 		Pct = 100;
-	sprintf(Str, "%.0f MB(%.0f%%)", MaxMB, Pct);
-	return Str;
+	sprintf(Str.get(), "%.0f MB(%.0f%%)", MaxMB.get(), Pct);
+	return Str.get();
 	}
 
 void SetInputFileName(const char *pstrFileName)
 	{
-	NameFromPath(pstrFileName, g_strFileName, sizeof(g_strFileName));
+	NameFromPath(pstrFileName, g_strFileName.get(), sizeof(g_strFileName.get()));
 	}
 
 void SetSeqStats(unsigned uSeqCount, unsigned uMaxL, unsigned uAvgL)
@@ -75,7 +73,7 @@ void SetSeqStats(unsigned uSeqCount, unsigned uMaxL, unsigned uAvgL)
 		return;
 
 	fprintf(g_fProgress, "%s %u seqs, max length %u, avg  length %u\n",
-	  g_strFileName, uSeqCount, uMaxL, uAvgL);
+	  g_strFileName.get(), uSeqCount, uMaxL, uAvgL);
 	if (g_bVerbose.get())
 		Log("%u seqs, max length %u, avg  length %u\n",
 		  uSeqCount, uMaxL, uAvgL);
@@ -83,33 +81,33 @@ void SetSeqStats(unsigned uSeqCount, unsigned uMaxL, unsigned uAvgL)
 
 void SetStartTime()
 	{
-	time(&g_tLocalStart);
+	time(&g_tLocalStart.get());
 	}
 
 unsigned long GetStartTime()
 	{
-	return (unsigned long) g_tLocalStart;
+	return (unsigned long) g_tLocalStart.get();
 	}
 
 void SetIter(unsigned uIter)
 	{
-	g_uIter = uIter;
+	g_uIter.get() = uIter;
 	}
 
 void IncIter()
 	{
-	++g_uIter;
+	++g_uIter.get();
 	}
 
 void SetMaxIters(unsigned uMaxIters)
 	{
-	g_uLocalMaxIters = uMaxIters;
+	g_uLocalMaxIters.get() = uMaxIters;
 	}
 
 void SetProgressDesc(const char szDesc[])
 	{
-	strncpy(g_strDesc, szDesc, sizeof(g_strDesc));
-	g_strDesc[sizeof(g_strDesc) - 1] = 0;
+	strncpy(g_strDesc.get(), szDesc, sizeof(g_strDesc.get()));
+	g_strDesc.get()[sizeof(g_strDesc.get()) - 1] = 0;
 	}
 
 static void Wipe(int n)
@@ -153,20 +151,20 @@ void Progress(unsigned uStep, unsigned uTotalSteps)
 	fprintf(g_fProgress, "%8.8s  %12s  Iter %3u  %6.2f%%  %s",
 	  ElapsedTimeAsStr(),
 	  MemToStr(MB),
-	  g_uIter,
+	  g_uIter.get(),
 	  dPct,
-	  g_strDesc);
+	  g_strDesc.get());
 
-	if (g_bWipeDesc)
+	if (g_bWipeDesc.get())
 		{
-		int n = g_nPrevDescLength - (int) strlen(g_strDesc);
+		int n = g_nPrevDescLength.get() - (int) strlen(g_strDesc.get());
 		Wipe(n);
-		g_bWipeDesc = false;
+		g_bWipeDesc.get() = false;
 		}
 
 	fprintf(g_fProgress, "\r");
 
-	g_uTotalSteps = uTotalSteps;
+	g_uTotalSteps.get() = uTotalSteps;
 	}
 
 void ProgressStepsDone()
@@ -179,16 +177,16 @@ void ProgressStepsDone()
 		Log("Elapsed time %8.8s  Peak memory use %12s  Iteration %3u %s\n",
 		 ElapsedTimeAsStr(),
 		 MemToStr(MB),
-		 g_uIter,
-		 g_strDesc);
+		 g_uIter.get(),
+		 g_strDesc.get());
 		}
 
 	if (g_bQuiet.get())
 		return;
 
-	Progress(g_uTotalSteps - 1, g_uTotalSteps);
+	Progress(g_uTotalSteps.get() - 1, g_uTotalSteps.get());
 	fprintf(g_fProgress, "\n");
-	g_bWipeDesc = true;
-	g_nPrevDescLength = (int) strlen(g_strDesc);
+	g_bWipeDesc.get() = true;
+	g_nPrevDescLength.get() = (int) strlen(g_strDesc.get());
 	}
 } 
@@ -170,8 +170,8 @@ static void RefineHeightParts(MSA &msaIn, const Tree &tree,
 		else
 			uNeighborNodeIndex = tree.GetLeft(uInternalNodeIndex);
 
-		g_uTreeSplitNode1 = uInternalNodeIndex;
-		g_uTreeSplitNode2 = uNeighborNodeIndex;
+		g_uTreeSplitNode1.setLocal(uInternalNodeIndex);
+		g_uTreeSplitNode2.setLocal(uNeighborNodeIndex);
 
 		unsigned uCount1;
 		unsigned uCount2;
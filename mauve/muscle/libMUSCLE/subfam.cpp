@@ -247,14 +247,14 @@ void ProgAlignSubFams()
 			}
 		TextFile File(FileName);
 		UserMatrix = ReadMx(File);
-		g_Alpha = ALPHA_Amino;
-		g_PPScore = PPSCORE_SP;
+		g_Alpha.setLocal(ALPHA_Amino);
+		g_PPScore.setLocal(PPSCORE_SP);
 		}
 
 	SetPPScore();
 
 	if (0 != UserMatrix)
-		g_ptrScoreMatrix = UserMatrix;
+		g_ptrScoreMatrix.setLocal(UserMatrix);
 
 	if (ALPHA_DNA == Alpha || ALPHA_RNA == Alpha)
 		{
@@ -7,20 +7,154 @@
 //
 // The TLS template defines thread-local storage for a particular variable
 //
+// Each variable keeps one slot per thread, for the largest of
+// omp_get_max_threads(), the number of processors and the former fixed cap of
+// 16 threads.  Every thread's copy sits on its own cache line(s) so that
+// neighbouring threads do not false-share.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
 
 #ifdef _OPENMP
-#define MAX_THREAD_COUNT	16
-#define OMP_GET_THREAD_NUM	omp_get_thread_num()
+#define OMP_GET_THREAD_NUM	TLSThreadNum()
 #include <omp.h>
 #else
-#define MAX_THREAD_COUNT	1
 #define OMP_GET_THREAD_NUM	0
 
 #endif
 
+#define TLS_CACHE_LINE_SIZE	64
+#define TLS_MIN_THREAD_COUNT	16
+
+/** Reports a thread slot that thread-local storage does not have, and aborts */
+inline void TLSSlotError( int slot )
+{
+	fprintf( stderr, "Thread-local storage has no slot %d, set OMP_NUM_THREADS to use more threads\n", slot );
+	abort();
+}
+
+/** Returns the number of per-thread slots every TLS variable has */
+inline int TLSThreadCount()
+{
+#ifdef _OPENMP
+	static int thread_count = 0;
+	if( thread_count == 0 )
+	{
+		int count = omp_get_max_threads() > omp_get_num_procs() ? omp_get_max_threads() : omp_get_num_procs();
+		thread_count = count > TLS_MIN_THREAD_COUNT ? count : TLS_MIN_THREAD_COUNT;
+	}
+	return thread_count;
+#else
+	return 1;
+#endif
+}
+
+/**
+ * Returns the slot used by the calling thread, omp_get_thread_num() outside of
+ * nested parallelism.  With OpenMP 3.0 the thread numbers along the nesting
+ * path are read as a mixed radix number, least significant level first, with
+ * each team's size as the radix.  A parallel loop nested inside a task, which
+ * runs with a team of one, then keeps its thread's own slot.  OpenMP 2.0 only
+ * numbers threads within the innermost team.
+ */
+inline int TLSThreadNum()
+{
+#if defined(_OPENMP) && _OPENMP >= 200805
+	int level = omp_get_level();
+	if( level <= 1 )
+		return omp_get_thread_num();
+	int slot = 0;
+	int radix = 1;
+	for( int levelI = 1; levelI <= level; levelI++ )
+	{
+		slot += omp_get_ancestor_thread_num(levelI) * radix;
+		radix *= omp_get_team_size(levelI);
+		if( slot >= TLSThreadCount() )
+			TLSSlotError( slot );
+	}
+	return slot;
+#elif defined(_OPENMP)
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+// kept for source compatibility with code that sized loops by the old fixed cap
+#define MAX_THREAD_COUNT	TLSThreadCount()
+
 
 #define NELEMS(o)	sizeof(o)/sizeof(o[0])
 
+/** Copies a per-thread value, element by element for arrays */
+template<typename T>
+inline void TLSCopy( T& dst, const T& src ){ dst = src; }
+template<typename T, size_t N>
+inline void TLSCopy( T (&dst)[N], const T (&src)[N] )
+{
+	for(size_t i = 0; i < N; i++)
+		TLSCopy( dst[i], src[i] );
+}
+
+/**
+ * TLSThreadCount() cache-line padded slots, used by TLS and TLSstr.  Slots
+ * are value-initialized, matching the zero-initialization that the former
+ * static arrays received.
+ */
+template<typename T>
+class TLSSlots
+{
+public:
+	TLSSlots() : count(TLSThreadCount())
+	{
+		stride = ((sizeof(Slot) + TLS_CACHE_LINE_SIZE - 1) / TLS_CACHE_LINE_SIZE) * TLS_CACHE_LINE_SIZE;
+		raw = (char*)malloc( stride * count + TLS_CACHE_LINE_SIZE );
+		if( raw == NULL )
+			throw std::bad_alloc();
+		base = raw + (TLS_CACHE_LINE_SIZE - ((size_t)raw % TLS_CACHE_LINE_SIZE)) % TLS_CACHE_LINE_SIZE;
+		for(int i = 0; i < count; i++)
+			new (slot( i )) Slot();
+	}
+	~TLSSlots()
+	{
+		for(int i = 0; i < count; i++)
+			slot( i )->~Slot();
+		free( raw );
+	}
+	/** assignment copies every thread's value, as the former array members did */
+	TLSSlots& operator=( const TLSSlots& tls )
+	{
+		for(int i = 0; i < count; i++)
+			TLSCopy( slot( i )->t, tls.slot( i )->t );
+		return *this;
+	}
+	T& operator[]( int i )
+	{
+		if( i < 0 || i >= count )
+			TLSSlotError( i );
+		return slot( i )->t;
+	}
+	/** sets every slot to t_val */
+	void setAll( const T& t_val )
+	{
+		for(int i = 0; i < count; i++)
+			TLSCopy( slot( i )->t, t_val );
+	}
+	int size() const { return count; }
+private:
+	TLSSlots( const TLSSlots& tls );	// disallow copying
+	struct Slot { T t; };
+	Slot* slot( int i ) const { return (Slot*)(base + i * stride); }
+
+	int count;
+	size_t stride;
+	char* raw;
+	char* base;	/**< raw rounded up to a cache line */
+};
+
 template<typename T>
 class TLS
 {
@@ -28,8 +162,22 @@ public:
 	TLS(){};
 
 	TLS( T t_val ){
-		for(int i = 0; i < MAX_THREAD_COUNT; i++)
-			t[i] = t_val;
+		t.setAll( t_val );
+	}
+
+	/** Sets every thread's copy */
+	TLS& operator=( const T& t_val ){
+		t.setAll( t_val );
+		return *this;
+	}
+
+	/**
+	 * Sets only the calling thread's copy.  MUSCLE code that can run in
+	 * several threads at once uses this so that concurrent alignments do not
+	 * reset each other's state.
+	 */
+	void setLocal( const T& t_val ){
+		TLSCopy( get(), t_val );
 	}
 
 	T& get()
@@ -38,7 +186,7 @@ public:
 	}
 private:
 	TLS( const TLS& tls );	// disallow copying
-	T t[MAX_THREAD_COUNT];
+	TLSSlots<T> t;
 };
 
 
@@ -53,7 +201,7 @@ public:
 	TLSstr(){};
 
 	TLSstr( T t_val ){
-		for(int i = 0; i < MAX_THREAD_COUNT; i++)
+		for(int i = 0; i < t.size(); i++)
 			memcpy(t[i], t_val, sizeof(t_val));
 	}
 
@@ -63,9 +211,8 @@ public:
 	}
 private:
 	TLSstr( const TLSstr& tls );	// disallow copying
-	T t[MAX_THREAD_COUNT];
+	TLSSlots<T> t;
 };
 
 
 #endif	// _threadstorage_h_
-